@@ -0,0 +1,319 @@
+#include "lp.h"
+#include "lp_font.h"
+#include "lp_printer.h"
+#include <font_rsrc.h>
+#include <rb/rbi.h>
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <wm/wm_device.h>
+#include <wm/wm_window.h>
+
+#include <stdbool.h>
+
+#define NB_FRAMES 64
+#define TERM_COLUMNS 200
+#define TERM_ROWS 60
+#define HUD_STRINGS_COUNT 32
+#define PARAGRAPH_LEN 16384
+#define CHARSET_LEN_MAX 512
+
+enum scenario {
+  SCENARIO_HUD, /* Short strings spread over the window */
+  SCENARIO_TERMINAL, /* Full screen of a 200x60 terminal, one print per row */
+  SCENARIO_PARAGRAPH, /* Long paragraph wrapped at the viewport width */
+  SCENARIO_TABS, /* Columns separated by tabulations */
+  SCENARIO_NEWLINES, /* Short lines */
+  SCENARIOS_COUNT
+};
+
+static const char* scenario_name[SCENARIOS_COUNT] = {
+  "hud", "terminal", "paragraph", "tabs", "newlines"
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+/* Fill the scenario strings. The HUD and terminal strings are NUL separated
+ * in `buf', the other scenarios are a single string */
+static void
+setup_scenario(const enum scenario scn, wchar_t* buf, const size_t len)
+{
+  size_t i = 0;
+  ASSERT(buf && len);
+
+  for(i = 0; i < len - 1; ++i) {
+    switch(scn) {
+      case SCENARIO_HUD:
+        buf[i] = i % 12 == 11 ? L'\0' : (wchar_t)(L'A' + (wchar_t)(i % 26));
+        break;
+      case SCENARIO_TERMINAL:
+        buf[i] = i % (TERM_COLUMNS + 1) == TERM_COLUMNS
+          ? L'\0' : (wchar_t)(L'!' + (wchar_t)(i % 94));
+        break;
+      case SCENARIO_PARAGRAPH:
+        buf[i] = i % 7 == 6 ? L' ' : (wchar_t)(L'a' + (wchar_t)(i % 26));
+        break;
+      case SCENARIO_TABS:
+        buf[i] = i % 80 == 79
+          ? L'\n' : i % 8 == 7 ? L'\t' : (wchar_t)(L'0' + (wchar_t)(i % 10));
+        break;
+      case SCENARIO_NEWLINES:
+        buf[i] = i % 4 == 3 ? L'\n' : (wchar_t)(L'a' + (wchar_t)(i % 26));
+        break;
+      default: ASSERT(0); break;
+    }
+  }
+  buf[len - 1] = L'\0';
+}
+
+/* Print the scenario once. Return the number of printed strings */
+static size_t
+print_scenario
+  (struct lp_printer* printer,
+   const enum scenario scn,
+   const wchar_t* buf,
+   const int height)
+{
+  const float color[3] = { 1.f, 1.f, 1.f };
+  const wchar_t* str = buf;
+  size_t i = 0;
+
+  switch(scn) {
+    case SCENARIO_HUD:
+      for(i = 0; i < HUD_STRINGS_COUNT; ++i, str += wcslen(str) + 1) {
+        LP(printer_print_wstring
+          (printer, (int)(i % 4) * 200, height - 16 - (int)(i / 4) * 16, str,
+           color, NULL, NULL));
+      }
+      return HUD_STRINGS_COUNT;
+    case SCENARIO_TERMINAL:
+      for(i = 0; i < TERM_ROWS; ++i, str += wcslen(str) + 1) {
+        LP(printer_print_wstring
+          (printer, 0, height - 16 - (int)i * 16, str, color, NULL, NULL));
+      }
+      return TERM_ROWS;
+    default:
+      LP(printer_print_wstring
+        (printer, 0, height - 16, str, color, NULL, NULL));
+      return 1;
+  }
+}
+
+/* Return the number of glyphs laid out by one print of the scenario */
+static size_t
+measure_scenario
+  (struct lp_printer* printer,
+   const enum scenario scn,
+   const wchar_t* buf,
+   const int height)
+{
+  struct lp_printer_metrics metrics;
+  const wchar_t* str = buf;
+  size_t nb_strings = 1;
+  size_t nb_glyphs = 0;
+  size_t i = 0;
+
+  if(scn == SCENARIO_HUD)
+    nb_strings = HUD_STRINGS_COUNT;
+  else if(scn == SCENARIO_TERMINAL)
+    nb_strings = TERM_ROWS;
+
+  for(i = 0; i < nb_strings; ++i, str += wcslen(str) + 1) {
+    LP(printer_measure_wstring(printer, 0, height - 16, str, &metrics));
+    nb_glyphs += metrics.nb_glyphs;
+  }
+  return nb_glyphs;
+}
+
+/* Print the scenario for NB_FRAMES frames and report the printer stats. If
+ * `changing' is set, the first glyph of the scenario is replaced on each
+ * frame so that the flushed glyphs differ from the uploaded ones; otherwise
+ * the frames print the same glyphs and their upload may be skipped */
+static void
+run_scenario
+  (struct lp* lp,
+   struct lp_printer* printer,
+   const enum scenario scn,
+   wchar_t* buf,
+   const int height,
+   const int changing)
+{
+  struct lp_printer_stats stats;
+  const size_t nb_glyphs = measure_scenario(printer, scn, buf, height);
+  const wchar_t first = buf[0];
+  size_t nb_strings = 0;
+  int i = 0;
+
+  /* Warm up the printer storage */
+  print_scenario(printer, scn, buf, height);
+  LP(printer_flush(printer));
+
+  LP(printer_clear_stats(printer));
+  for(i = 0; i < NB_FRAMES; ++i) {
+    if(changing)
+      buf[0] = (wchar_t)(L'A' + (wchar_t)(i % 26));
+    LP(begin_frame(lp));
+    nb_strings = print_scenario(printer, scn, buf, height);
+    LP(printer_flush(printer));
+    LP(end_frame(lp));
+  }
+  LP(printer_get_stats(printer, &stats));
+  buf[0] = first;
+
+  printf("%-10s %-8s %8lu glyphs %4lu prints | layout %12.0f glyphs/s | "
+    "flush %8.3f ms\n",
+    scenario_name[scn],
+    changing ? "changing" : "static",
+    (unsigned long)nb_glyphs,
+    (unsigned long)nb_strings,
+    stats.layout_time > 0.0
+      ? (double)(nb_glyphs * NB_FRAMES) * 1000.0 / stats.layout_time : 0.0,
+    stats.flush_time / NB_FRAMES);
+  printf("%-19s per frame: %.0f flushed %.0f culled | %.2f flushes "
+    "%.2f forced %.2f draws | %.0f bytes uploaded %.2f skipped\n",
+    "",
+    (double)stats.nb_glyphs / NB_FRAMES,
+    (double)stats.nb_culled_glyphs / NB_FRAMES,
+    (double)stats.nb_flushes / NB_FRAMES,
+    (double)stats.nb_forced_flushes / NB_FRAMES,
+    (double)stats.nb_draw_calls / NB_FRAMES,
+    (double)stats.uploaded_size / NB_FRAMES,
+    (double)stats.nb_skipped_uploads / NB_FRAMES);
+}
+
+int
+main(int argc, char** argv)
+{
+  /* Check command arguments */
+  if(argc != 3) {
+    printf("usage: %s RB_DRIVER FONT\n", argv[0]);
+    return -1;
+  }
+  const char* driver_name = argv[1];
+  const char* font_name = argv[2];
+
+  FILE* file = fopen(driver_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid driver %s\n", driver_name);
+    return -1;
+  }
+  fclose(file);
+
+  file = fopen(font_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid font name %s\n", font_name);
+    return -1;
+  }
+  fclose(file);
+
+  /* Spawn a window large enough for the terminal scenario */
+  struct wm_device* device = NULL;
+  struct wm_window* window = NULL;
+  const struct wm_window_desc win_desc =
+    { .width = 1920, .height = 1080, .fullscreen = false };
+  WM(create_device(NULL, &device));
+  WM(create_window(device, &win_desc, &window));
+
+  /* Create a render backend */
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  CHECK(rbi_init(driver_name, &rbi), 0);
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+
+  /* Load font resource */
+  struct font_system* font_sys = NULL;
+  struct font_rsrc* font_rsrc = NULL;
+  bool is_font_scalable = false;
+  int line_space = 0;
+  FONT(system_create(NULL, &font_sys));
+  FONT(rsrc_create(font_sys, font_name, &font_rsrc));
+  FONT(rsrc_get_line_space(font_rsrc, &line_space));
+  FONT(rsrc_is_scalable(font_rsrc, &is_font_scalable));
+  if(is_font_scalable) {
+    FONT(rsrc_set_size(font_rsrc, 16, 16));
+  }
+
+  /* Printable ASCII characters */
+  struct lp_font_glyph_desc lp_font_glyph_desc_list[CHARSET_LEN_MAX];
+  unsigned char* glyph_bitmap_list[CHARSET_LEN_MAX];
+  const size_t charset_len = 95;
+  size_t i = 0;
+  for(i = 0; i < charset_len; ++i) {
+    struct font_glyph_desc font_glyph_desc;
+    struct font_glyph* font_glyph = NULL;
+    int width = 0;
+    int height = 0;
+    int Bpp = 0;
+
+    FONT(rsrc_get_glyph(font_rsrc, (wchar_t)(L' ' + i), &font_glyph));
+    FONT(glyph_get_desc(font_glyph, &font_glyph_desc));
+    lp_font_glyph_desc_list[i].width = font_glyph_desc.width;
+    lp_font_glyph_desc_list[i].character = font_glyph_desc.character;
+    lp_font_glyph_desc_list[i].bitmap_left = font_glyph_desc.bbox.x_min;
+    lp_font_glyph_desc_list[i].bitmap_top = font_glyph_desc.bbox.y_min;
+
+    glyph_bitmap_list[i] = NULL;
+    FONT(glyph_get_bitmap(font_glyph, true, &width, &height, &Bpp, NULL));
+    if(width && height) {
+      glyph_bitmap_list[i] = MEM_CALLOC
+        (&mem_default_allocator, (size_t)(width*height), (size_t)Bpp);
+      NCHECK(glyph_bitmap_list[i], NULL);
+      FONT(glyph_get_bitmap
+        (font_glyph, true, &width, &height, &Bpp, glyph_bitmap_list[i]));
+    }
+    lp_font_glyph_desc_list[i].bitmap.width = width;
+    lp_font_glyph_desc_list[i].bitmap.height = height;
+    lp_font_glyph_desc_list[i].bitmap.bytes_per_pixel = Bpp;
+    lp_font_glyph_desc_list[i].bitmap.buffer = glyph_bitmap_list[i];
+
+    FONT(glyph_ref_put(font_glyph));
+  }
+
+  struct lp* lp = NULL;
+  struct lp_font* lp_font = NULL;
+  struct lp_printer* lp_printer = NULL;
+  LP(create(&rbi, rb_ctxt, NULL, &lp));
+  LP(font_create(lp, &lp_font));
+  LP(font_set_data
+    (lp_font, line_space, (int)charset_len, lp_font_glyph_desc_list));
+  LP(printer_create(lp, &lp_printer));
+  LP(printer_set_font(lp_printer, lp_font));
+  LP(printer_set_timing(lp_printer, 1));
+  LP(printer_set_viewport
+    (lp_printer, 0, 0, win_desc.width, win_desc.height));
+
+  /* The largest scenario string */
+  const size_t buf_len = MAX
+    ((size_t)PARAGRAPH_LEN, (size_t)(TERM_COLUMNS + 1) * TERM_ROWS) + 1;
+  wchar_t* buf = MEM_ALLOC(&mem_default_allocator, buf_len * sizeof(wchar_t));
+  NCHECK(buf, NULL);
+
+  printf("%d frames per scenario\n", NB_FRAMES);
+  for(i = 0; i < SCENARIOS_COUNT; ++i) {
+    setup_scenario((enum scenario)i, buf, buf_len);
+    run_scenario(lp, lp_printer, (enum scenario)i, buf, win_desc.height, 0);
+    run_scenario(lp, lp_printer, (enum scenario)i, buf, win_desc.height, 1);
+  }
+
+  /* Release data */
+  MEM_FREE(&mem_default_allocator, buf);
+  for(i = 0; i < charset_len; ++i) {
+    if(glyph_bitmap_list[i])
+      MEM_FREE(&mem_default_allocator, glyph_bitmap_list[i]);
+  }
+  LP(printer_ref_put(lp_printer));
+  LP(font_ref_put(lp_font));
+  LP(ref_put(lp));
+  FONT(rsrc_ref_put(font_rsrc));
+  FONT(system_ref_put(font_sys));
+  RBI(&rbi, context_ref_put(rb_ctxt));
+  CHECK(rbi_shutdown(&rbi), 0);
+  WM(window_ref_put(window));
+  WM(device_ref_put(device));
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+
+  return 0;
+}
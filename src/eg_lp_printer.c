@@ -1,6 +1,7 @@
 #include "lp.h"
 #include "lp_font.h"
 #include "lp_printer.h"
+#include "lp_text.h"
 #include <font_rsrc.h>
 #include <rb/rbi.h>
 #include <snlsys/math.h>
@@ -122,25 +123,35 @@ main(int argc, char** argv)
   LP(printer_create(lp, &lp_printer));
   LP(printer_set_font(lp_printer, lp_font));
   LP(printer_set_viewport(lp_printer, 0, 0, win_desc.width, win_desc.height));
+
+  /* Create a retained text. It is laid out once and then only drawn */
+  struct lp_text* lp_text = NULL;
+  LP(text_create(lp, &lp_text));
+  LP(text_set_font(lp_text, lp_font));
+  LP(text_set_wstring(lp_text, L"Press ESC to exit"));
+
+  /* Prompt line printed in one call. The spans follow each other */
+  #define SPAN(Str, R, G, B) \
+    { Str, LP_PRINTER_SPAN_NUL_TERMINATED, LP_PRINTER_ENCODING_WCHAR, \
+      { R, G, B }, 0, 0, 0, NULL }
+  const struct lp_printer_span prompt[4] = {
+    SPAN(L">$ ", 0.f, 1.f, 0.f),
+    SPAN(L"Hello", 1.f, 1.f, 1.f),
+    SPAN(L" World", 1.f, 0.f, 0.f),
+    SPAN(L"!", 0.f, 1.f, 0.f)
+  };
+  #undef SPAN
+
   enum wm_state esc = WM_STATE_UNKNOWN;
   do {
-    int cur[2] = { 0, 0 };
-
     RBI(&rbi, clear
       (rb_ctxt, RB_CLEAR_COLOR_BIT, (float[]){0.05f, 0.05f, 0.05f}, 0.f, 0));
-    LP(printer_print_wstring
-      (lp_printer, 50, 70, L">$ ",
-       (float[]){0.f, 1.f, 0.f}, cur+0, cur+1));
-    LP(printer_print_wstring
-      (lp_printer, cur[0], cur[1], L"Hello",
-       (float[]){1.f, 1.f, 1.f}, cur+0, cur+1));
-    LP(printer_print_wstring
-      (lp_printer, cur[0], cur[1], L" World",
-       (float[]){1.f, 0.f, 0.f}, cur+0, cur+1));
-    LP(printer_print_wstring
-      (lp_printer, cur[0], cur[1], L"!",
-       (float[]){0.f, 1.f, 0.f}, cur+0, cur+1));
+    LP(begin_frame(lp));
+    LP(printer_print_spans(lp_printer, 50, 70, prompt, 4, NULL, NULL));
+    LP(printer_print_text
+      (lp_printer, 50, 30, lp_text, (float[]){0.5f, 0.5f, 0.5f}));
     LP(printer_flush(lp_printer));
+    LP(end_frame(lp));
 
     WM(swap(window));
     WM(flush_events(device));
@@ -151,6 +162,7 @@ main(int argc, char** argv)
   for(i = 0; i < charset_len; ++i) {
     MEM_FREE(&mem_default_allocator, glyph_bitmap_list[i]);
   }
+  LP(text_ref_put(lp_text));
   LP(printer_ref_put(lp_printer));
   LP(font_ref_put(lp_font));
   LP(ref_put(lp));
@@ -2,6 +2,7 @@
 #include "lp_c.h"
 #include <rb/rbi.h>
 #include <snlsys/mem_allocator.h>
+#include <string.h>
 
 /*******************************************************************************
  *
@@ -87,3 +88,35 @@ lp_ref_put(struct lp* lp)
   return LP_NO_ERROR;
 }
 
+enum lp_error
+lp_begin_frame(struct lp* lp)
+{
+  if(!lp || lp->state.is_in_frame)
+    return LP_INVALID_ARGUMENT;
+  render_state_setup(lp);
+  lp->state.is_in_frame = 1;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_end_frame(struct lp* lp)
+{
+  if(!lp || !lp->state.is_in_frame)
+    return LP_INVALID_ARGUMENT;
+  render_state_reset(lp);
+  lp->state.is_in_frame = 0;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_set_trace_hooks(struct lp* lp, const struct lp_trace_hooks* hooks)
+{
+  if(!lp)
+    return LP_INVALID_ARGUMENT;
+  if(hooks) {
+    lp->trace = *hooks;
+  } else {
+    memset(&lp->trace, 0, sizeof(lp->trace));
+  }
+  return LP_NO_ERROR;
+}
@@ -3,6 +3,7 @@
 
 #include "lp_error.h"
 #include <snlsys/snlsys.h>
+#include <stddef.h>
 
 #if defined(LP_SHARED_BUILD)
   #define LP_API EXPORT_SYM
@@ -22,6 +23,18 @@ struct mem_allocator;
 struct rbi;
 struct rb_context;
 
+/* Hooks invoked on the begin and on the end of the zones of the library work,
+ * e.g. a print, a flush or a font update. `name' is a static string that
+ * identifies the zone and `payload' a count specific to the zone, e.g. a
+ * number of glyphs or of bytes. The zones may be nested and are entered on the
+ * thread that calls the library. The hooks are invoked only if the library
+ * was built with LP_TRACE defined; otherwise the zones are compiled out */
+struct lp_trace_hooks {
+  void (*begin)(const char* name, void* data);
+  void (*end)(const char* name, const size_t payload, void* data);
+  void* data; /* Client data sent to the hooks */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -41,6 +54,25 @@ LP_API enum lp_error
 lp_ref_put
   (struct lp* lp);
 
+/* Set the render state shared by the printer flushes once for the frame.
+ * Until lp_end_frame, the flushes only submit the state changes that differ
+ * from the previous draw and the render state must not be modified out of
+ * the library */
+LP_API enum lp_error
+lp_begin_frame
+  (struct lp* lp);
+
+/* Unbind the resources of the library and restore the blend state */
+LP_API enum lp_error
+lp_end_frame
+  (struct lp* lp);
+
+/* The hooks are copied. NULL <=> no hooks (default) */
+LP_API enum lp_error
+lp_set_trace_hooks
+  (struct lp* lp,
+   const struct lp_trace_hooks* hooks); /* May be NULL */
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
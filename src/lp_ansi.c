@@ -0,0 +1,182 @@
+#include "lp_ansi_c.h"
+#include <snlsys/math.h>
+#include <snlsys/snlsys.h>
+#include <string.h>
+
+#define ANSI_PARAMS_COUNT_MAX 16
+#define ANSI_PARAM_MAX 9999
+
+/* Default colors of the xterm 16 colors palette */
+static const unsigned char ansi_palette[16][3] = {
+  {   0,   0,   0 }, { 205,   0,   0 }, {   0, 205,   0 }, { 205, 205,   0 },
+  {   0,   0, 238 }, { 205,   0, 205 }, {   0, 205, 205 }, { 229, 229, 229 },
+  { 127, 127, 127 }, { 255,   0,   0 }, {   0, 255,   0 }, { 255, 255,   0 },
+  {  92,  92, 255 }, { 255,   0, 255 }, {   0, 255, 255 }, { 255, 255, 255 }
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+/* The parameters are positive */
+static void
+set_color_rgb(struct ansi_state* ansi, const int r, const int g, const int b)
+{
+  ASSERT(ansi && r >= 0 && g >= 0 && b >= 0);
+  ansi->color[0] = (float)MIN(r, 255) / 255.f;
+  ansi->color[1] = (float)MIN(g, 255) / 255.f;
+  ansi->color[2] = (float)MIN(b, 255) / 255.f;
+}
+
+/* Set the color `id' of the xterm 256 colors palette, i.e. the 16 colors
+ * palette followed by a 6x6x6 color cube and a ramp of 24 grays */
+static void
+set_color_256(struct ansi_state* ansi, const int id)
+{
+  ASSERT(ansi);
+  if(id < 0 || id > 255)
+    return;
+  if(id < 16) {
+    set_color_rgb
+      (ansi, ansi_palette[id][0], ansi_palette[id][1], ansi_palette[id][2]);
+  } else if(id < 232) {
+    const int cube = id - 16;
+    #define LEVEL(I) ((I) ? 55 + (I) * 40 : 0)
+    set_color_rgb
+      (ansi, LEVEL(cube / 36), LEVEL((cube / 6) % 6), LEVEL(cube % 6));
+    #undef LEVEL
+  } else {
+    const int gray = 8 + (id - 232) * 10;
+    set_color_rgb(ansi, gray, gray, gray);
+  }
+}
+
+static void
+apply_sgr(struct ansi_state* ansi, const int* params, const int nb_params)
+{
+  int i = 0;
+  ASSERT(ansi && params && nb_params > 0);
+
+  for(i = 0; i < nb_params; ++i) {
+    const int p = params[i];
+    if(p == 0) {
+      memcpy(ansi->color, ansi->base_color, sizeof(ansi->color));
+      ansi->is_bold = 0;
+    } else if(p == 1) {
+      ansi->is_bold = 1;
+    } else if(p == 22) {
+      ansi->is_bold = 0;
+    } else if(p >= 30 && p <= 37) {
+      set_color_256(ansi, p - 30);
+    } else if(p >= 90 && p <= 97) {
+      set_color_256(ansi, p - 90 + 8);
+    } else if(p == 39) {
+      memcpy(ansi->color, ansi->base_color, sizeof(ansi->color));
+    } else if(p == 38 || p == 48) {
+      /* Extended colors. The background ones are consumed and ignored */
+      if(i + 2 < nb_params && params[i + 1] == 5) {
+        if(p == 38)
+          set_color_256(ansi, params[i + 2]);
+        i += 2;
+      } else if(i + 4 < nb_params && params[i + 1] == 2) {
+        if(p == 38)
+          set_color_rgb(ansi, params[i + 2], params[i + 3], params[i + 4]);
+        i += 4;
+      } else {
+        break; /* Malformed extended color */
+      }
+    }
+    /* The other attributes are not supported */
+  }
+  ansi->is_updated = 1;
+}
+
+/*******************************************************************************
+ *
+ * Internal ANSI functions
+ *
+ ******************************************************************************/
+void
+ansi_state_init
+  (struct ansi_state* ansi,
+   const float color[3],
+   struct lp_font* font,
+   struct lp_font* bold_font)
+{
+  ASSERT(ansi && color && font);
+  memcpy(ansi->base_color, color, sizeof(ansi->base_color));
+  memcpy(ansi->color, color, sizeof(ansi->color));
+  ansi->font = font;
+  ansi->bold_font = bold_font;
+  ansi->is_bold = 0;
+  ansi->is_updated = 0;
+}
+
+enum ansi_cursor
+ansi_read_sequence
+  (struct ansi_state* ansi,
+   struct string_reader* reader,
+   int* count)
+{
+  int params[ANSI_PARAMS_COUNT_MAX];
+  int nb_params = 0;
+  int param = 0;
+  size_t id = 0;
+  wchar_t ch = 0;
+  ASSERT(ansi && reader && count);
+
+  if(!string_reader_next(reader, &id, &ch))
+    return ANSI_CURSOR_NONE;
+  /* The control strings, e.g. OSC titles, are skipped up to their BEL or ST
+   * (ESC \) terminator. Any ESC ends the string and begins the next sequence,
+   * the ST being an escape sequence without intermediate byte */
+  while(ch == L']' || ch == L'P' || ch == L'X' || ch == L'^' || ch == L'_') {
+    do {
+      if(!string_reader_next(reader, &id, &ch))
+        return ANSI_CURSOR_NONE;
+    } while(ch != ANSI_BEL && ch != ANSI_ESC);
+    if(ch == ANSI_BEL || !string_reader_next(reader, &id, &ch))
+      return ANSI_CURSOR_NONE;
+  }
+  /* Only the Control Sequence Introducer is interpreted. The other escape
+   * sequences are skipped up to their final byte */
+  if(ch != L'[') {
+    while(ch >= 0x20 && ch <= 0x2F) { /* Intermediate bytes */
+      if(!string_reader_next(reader, &id, &ch))
+        break;
+    }
+    return ANSI_CURSOR_NONE;
+  }
+
+  /* Parameter bytes, then intermediate bytes and final byte */
+  while(string_reader_next(reader, &id, &ch)) {
+    if(ch >= L'0' && ch <= L'9') {
+      param = MIN(param * 10 + (int)(ch - L'0'), ANSI_PARAM_MAX);
+    } else if(ch == L';' || ch == L':') {
+      if(nb_params < ANSI_PARAMS_COUNT_MAX)
+        params[nb_params++] = param;
+      param = 0;
+    } else if(ch >= 0x20 && ch <= 0x3F) {
+      continue; /* Private parameter or intermediate bytes */
+    } else {
+      break;
+    }
+  }
+  if(ch < 0x40 || ch > 0x7E) /* Truncated or invalid sequence */
+    return ANSI_CURSOR_NONE;
+  if(nb_params < ANSI_PARAMS_COUNT_MAX)
+    params[nb_params++] = param;
+
+  *count = MAX(params[0], 1);
+  switch(ch) {
+    case L'm': apply_sgr(ansi, params, nb_params); break;
+    case L'A': return ANSI_CURSOR_UP;
+    case L'B': return ANSI_CURSOR_DOWN;
+    case L'C': return ANSI_CURSOR_FORWARD;
+    case L'D': return ANSI_CURSOR_BACK;
+    case L'G': return ANSI_CURSOR_COLUMN;
+    default: break; /* Unsupported sequence */
+  }
+  return ANSI_CURSOR_NONE;
+}
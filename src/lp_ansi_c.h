@@ -0,0 +1,57 @@
+#ifndef LP_ANSI_C_H
+#define LP_ANSI_C_H
+
+#include "lp_string_c.h"
+
+#define ANSI_BEL 0x07 /* Bell character, terminator of the control strings */
+#define ANSI_ESC 0x1B /* Escape character */
+
+struct lp_font;
+
+/* Pen movement requested by an ANSI control sequence */
+enum ansi_cursor {
+  ANSI_CURSOR_NONE,
+  ANSI_CURSOR_UP, /* CUU: move up by `count' lines */
+  ANSI_CURSOR_DOWN, /* CUD: move down by `count' lines */
+  ANSI_CURSOR_FORWARD, /* CUF: move right by `count' cells */
+  ANSI_CURSOR_BACK, /* CUB: move left by `count' cells */
+  ANSI_CURSOR_COLUMN /* CHA: move to the 1 based cell `count' of the line */
+};
+
+/* Graphic rendition set by the SGR sequences of a printed string */
+struct ansi_state {
+  float base_color[3]; /* Color of the print, restored by the SGR reset */
+  float color[3];
+  struct lp_font* font; /* Regular font. Not referenced */
+  struct lp_font* bold_font; /* Not referenced. NULL <=> bold is ignored */
+  int is_bold;
+  int is_updated; /* The color or the font changed. Cleared by the caller */
+};
+
+extern void
+ansi_state_init
+  (struct ansi_state* ansi,
+   const float color[3],
+   struct lp_font* font,
+   struct lp_font* bold_font); /* May be NULL */
+
+/* Consume the escape sequence following the ESC character last read from
+ * `reader'. The SGR sequences update the state, the supported cursor
+ * sequences are returned with their count and the other ones are skipped.
+ * The control strings (OSC, DCS, SOS, PM and APC) are skipped up to their BEL
+ * or ST terminator. A truncated sequence consumes the remaining characters */
+extern enum ansi_cursor
+ansi_read_sequence
+  (struct ansi_state* ansi,
+   struct string_reader* reader,
+   int* count);
+
+/* Font of the next glyphs */
+static FINLINE struct lp_font*
+ansi_state_font(const struct ansi_state* ansi)
+{
+  ASSERT(ansi);
+  return ansi->is_bold && ansi->bold_font ? ansi->bold_font : ansi->font;
+}
+
+#endif /* LP_ANSI_C_H */
@@ -1,11 +1,14 @@
 #ifndef LP_C_H
 #define LP_C_H
 
+#include "lp.h"
+#include "lp_render_state_c.h"
 #include <rb/rb_types.h>
 #include <snlsys/ref_count.h>
 
 struct rb_context;
 struct mem_allocator;
+struct rsrc;
 
 struct lp {
   struct ref ref;
@@ -13,6 +16,12 @@ struct lp {
   struct rb_config rb_cfg;
   struct rb_context* rb_ctxt;
   struct mem_allocator* allocator;
+  struct render_state state;
+  struct lp_trace_hooks trace; /* Null hooks <=> no tracing */
+  uint32_t printer_serial; /* Serial of the last created printer */
+  /* GPU resources shared by the printers. Not referenced; the printers own
+   * it and it unregisters itself on release */
+  struct rsrc* rsrc;
 };
 
 #endif /* LP_C_H */
@@ -0,0 +1,549 @@
+#include "lp_c.h"
+#include "lp_document.h"
+#include "lp_document_c.h"
+#include "lp_printer_c.h"
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <snlsys/snlsys.h>
+#include <string.h>
+
+struct lp_document {
+  struct ref ref;
+  struct lp* lp;
+
+  struct document_paragraph* paragraph_list;
+  size_t nb_paragraphs;
+  size_t max_nb_paragraphs;
+  /* Number of rows that precede each paragraph. Only the `nb_valid_offsets'
+   * first offsets are up to date */
+  size_t* row_offset_list;
+  size_t nb_valid_offsets;
+
+  struct layout_stamp stamp; /* Layout with which the rows were measured */
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+/* Ensure that the paragraph can store `len' characters */
+static enum lp_error
+paragraph_reserve
+  (struct lp_document* document,
+   struct document_paragraph* paragraph,
+   const size_t len)
+{
+  wchar_t* dst = NULL;
+  size_t capacity = 0;
+  ASSERT(document && paragraph);
+
+  if(len + 1 <= paragraph->capacity)
+    return LP_NO_ERROR;
+  /* Grow geometrically since a paragraph is typically edited char by char */
+  capacity = MAX(len + 1, paragraph->capacity * 2);
+  dst = MEM_REALLOC
+    (document->lp->allocator, paragraph->wstr, capacity * sizeof(wchar_t));
+  if(!dst)
+    return LP_MEMORY_ERROR;
+  paragraph->wstr = dst;
+  paragraph->capacity = capacity;
+  return LP_NO_ERROR;
+}
+
+/* Initialise the paragraph with a copy of the `len' characters of `wstr'
+ * followed by the `tail_len' characters of `tail' */
+static enum lp_error
+paragraph_init
+  (struct lp_document* document,
+   struct document_paragraph* paragraph,
+   const wchar_t* wstr,
+   const size_t len,
+   const wchar_t* tail,
+   const size_t tail_len)
+{
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(document && paragraph && (wstr || !len) && (tail || !tail_len));
+
+  memset(paragraph, 0, sizeof(struct document_paragraph));
+  lp_err = paragraph_reserve(document, paragraph, len + tail_len);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  if(len)
+    memcpy(paragraph->wstr, wstr, len * sizeof(wchar_t));
+  if(tail_len)
+    memcpy(paragraph->wstr + len, tail, tail_len * sizeof(wchar_t));
+  paragraph->len = len + tail_len;
+  paragraph->wstr[paragraph->len] = L'\0';
+  return LP_NO_ERROR;
+}
+
+static void
+paragraph_release
+  (struct lp_document* document,
+   struct document_paragraph* paragraph)
+{
+  ASSERT(document && paragraph);
+  if(paragraph->wstr)
+    MEM_FREE(document->lp->allocator, paragraph->wstr);
+  memset(paragraph, 0, sizeof(struct document_paragraph));
+}
+
+/* Ensure that the document can store `nb_paragraphs' paragraphs */
+static enum lp_error
+reserve_paragraphs(struct lp_document* document, const size_t nb_paragraphs)
+{
+  struct document_paragraph* paragraph_list = NULL;
+  size_t* row_offset_list = NULL;
+  size_t max_nb_paragraphs = 0;
+  ASSERT(document);
+
+  if(nb_paragraphs <= document->max_nb_paragraphs)
+    return LP_NO_ERROR;
+  max_nb_paragraphs = MAX(nb_paragraphs, document->max_nb_paragraphs * 2);
+  paragraph_list = MEM_REALLOC(document->lp->allocator,
+    document->paragraph_list,
+    max_nb_paragraphs * sizeof(struct document_paragraph));
+  if(!paragraph_list)
+    return LP_MEMORY_ERROR;
+  document->paragraph_list = paragraph_list;
+  row_offset_list = MEM_REALLOC(document->lp->allocator,
+    document->row_offset_list, max_nb_paragraphs * sizeof(size_t));
+  if(!row_offset_list)
+    return LP_MEMORY_ERROR;
+  document->row_offset_list = row_offset_list;
+  memset(document->paragraph_list + document->max_nb_paragraphs, 0,
+    (max_nb_paragraphs - document->max_nb_paragraphs)
+    * sizeof(struct document_paragraph));
+  document->max_nb_paragraphs = max_nb_paragraphs;
+  return LP_NO_ERROR;
+}
+
+/* The rows of the edited paragraph and the row offsets of the following
+ * paragraphs are out of date */
+static void
+invalidate_paragraph(struct lp_document* document, const size_t id)
+{
+  ASSERT(document && id < document->nb_paragraphs);
+  document->paragraph_list[id].nb_rows = 0;
+  document->nb_valid_offsets = MIN(document->nb_valid_offsets, id + 1);
+}
+
+static int
+is_pos_valid
+  (const struct lp_document* document,
+   const struct lp_document_pos* pos)
+{
+  ASSERT(document && pos);
+  return pos->paragraph < document->nb_paragraphs
+      && pos->offset <= document->paragraph_list[pos->paragraph].len;
+}
+
+static void
+release_document(struct ref* ref)
+{
+  struct lp* lp = NULL;
+  struct lp_document* document = NULL;
+  size_t i = 0;
+  ASSERT(NULL != ref);
+
+  document = CONTAINER_OF(ref, struct lp_document, ref);
+  for(i = 0; i < document->nb_paragraphs; ++i)
+    paragraph_release(document, document->paragraph_list + i);
+  if(document->paragraph_list)
+    MEM_FREE(document->lp->allocator, document->paragraph_list);
+  if(document->row_offset_list)
+    MEM_FREE(document->lp->allocator, document->row_offset_list);
+  lp = document->lp;
+  MEM_FREE(lp->allocator, document);
+  LP(ref_put(lp));
+}
+
+/*******************************************************************************
+ *
+ * Internal document functions
+ *
+ ******************************************************************************/
+void
+document_sync
+  (struct lp_document* document,
+   const struct lp_printer* printer)
+{
+  size_t i = 0;
+  ASSERT(document && printer);
+
+  if(!layout_stamp_sync(&document->stamp, printer))
+    return;
+  for(i = 0; i < document->nb_paragraphs; ++i)
+    document->paragraph_list[i].nb_rows = 0;
+  document->nb_valid_offsets = 0;
+}
+
+size_t
+document_paragraphs_count(const struct lp_document* document)
+{
+  ASSERT(document);
+  return document->nb_paragraphs;
+}
+
+struct document_paragraph*
+document_get_paragraph(struct lp_document* document, const size_t id)
+{
+  ASSERT(document);
+  return id < document->nb_paragraphs ? document->paragraph_list + id : NULL;
+}
+
+enum lp_error
+document_find_row
+  (struct lp_document* document,
+   const size_t row,
+   document_measure_T measure,
+   void* data,
+   size_t* out_paragraph,
+   size_t* out_paragraph_row)
+{
+  struct document_paragraph* paragraph_list = NULL;
+  size_t* offsets = NULL;
+  size_t i = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(document && measure && out_paragraph && out_paragraph_row);
+  ASSERT(document->nb_paragraphs);
+
+  paragraph_list = document->paragraph_list;
+  offsets = document->row_offset_list;
+  if(!document->nb_valid_offsets) {
+    offsets[0] = 0;
+    document->nb_valid_offsets = 1;
+  }
+
+  i = document->nb_valid_offsets - 1;
+  if(row < offsets[i]) {
+    /* The rows of the paragraphs with a valid successor offset are measured.
+     * Look for the last paragraph that begins before the row */
+    size_t lo = 0;
+    size_t hi = i;
+    while(lo < hi) {
+      const size_t mid = lo + (hi - lo + 1) / 2;
+      if(offsets[mid] <= row) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    i = lo;
+  } else {
+    /* Accumulate the offsets of the next paragraphs up to the row */
+    for(;;) {
+      if(!paragraph_list[i].nb_rows) {
+        lp_err = measure(data, paragraph_list + i);
+        if(lp_err != LP_NO_ERROR)
+          return lp_err;
+        ASSERT(paragraph_list[i].nb_rows > 0);
+      }
+      if(row - offsets[i] < (size_t)paragraph_list[i].nb_rows)
+        break;
+      if(i + 1 == document->nb_paragraphs) {
+        *out_paragraph = document->nb_paragraphs;
+        *out_paragraph_row = 0;
+        return LP_NO_ERROR;
+      }
+      offsets[i + 1] = offsets[i] + (size_t)paragraph_list[i].nb_rows;
+      document->nb_valid_offsets = ++i + 1;
+    }
+  }
+  *out_paragraph = i;
+  *out_paragraph_row = row - offsets[i];
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+document_rows_count
+  (struct lp_document* document,
+   document_measure_T measure,
+   void* data,
+   size_t* nb_rows)
+{
+  const struct document_paragraph* last = NULL;
+  size_t paragraph = 0;
+  size_t paragraph_row = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(document && measure && nb_rows);
+
+  /* Accumulate the offsets of all the paragraphs */
+  lp_err = document_find_row
+    (document, (size_t)-1, measure, data, &paragraph, &paragraph_row);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  ASSERT(document->nb_valid_offsets == document->nb_paragraphs);
+  last = document->paragraph_list + document->nb_paragraphs - 1;
+  *nb_rows = document->row_offset_list[document->nb_paragraphs - 1]
+    + (size_t)last->nb_rows;
+  return LP_NO_ERROR;
+}
+
+/*******************************************************************************
+ *
+ * lp_document functions
+ *
+ ******************************************************************************/
+enum lp_error
+lp_document_create(struct lp* lp, struct lp_document** out_document)
+{
+  struct lp_document* document = NULL;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(UNLIKELY(!lp || !out_document))
+    return LP_INVALID_ARGUMENT;
+
+  document = MEM_CALLOC(lp->allocator, 1, sizeof(struct lp_document));
+  if(UNLIKELY(!document))
+    return LP_MEMORY_ERROR;
+  ref_init(&document->ref);
+  document->lp = lp;
+  LP(ref_get(lp));
+
+  /* Empty paragraph */
+  lp_err = reserve_paragraphs(document, 1);
+  if(lp_err == LP_NO_ERROR) {
+    lp_err = paragraph_init
+      (document, document->paragraph_list, NULL, 0, NULL, 0);
+  }
+  if(lp_err != LP_NO_ERROR) {
+    LP(document_ref_put(document));
+    return lp_err;
+  }
+  document->nb_paragraphs = 1;
+  *out_document = document;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_document_ref_get(struct lp_document* document)
+{
+  if(UNLIKELY(!document))
+    return LP_INVALID_ARGUMENT;
+  ref_get(&document->ref);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_document_ref_put(struct lp_document* document)
+{
+  if(UNLIKELY(!document))
+    return LP_INVALID_ARGUMENT;
+  ref_put(&document->ref, release_document);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_document_set_wstring(struct lp_document* document, const wchar_t* wstr)
+{
+  const struct lp_document_pos pos = { 0, 0 };
+
+  if(UNLIKELY(!document || !wstr))
+    return LP_INVALID_ARGUMENT;
+  LP(document_clear(document));
+  return lp_document_insert_wstring(document, &pos, wstr, NULL);
+}
+
+enum lp_error
+lp_document_insert_wstring
+  (struct lp_document* document,
+   const struct lp_document_pos* position,
+   const wchar_t* wstr,
+   struct lp_document_pos* end)
+{
+  struct lp_document_pos pos;
+  struct document_paragraph* paragraph = NULL;
+  struct document_paragraph* new_list = NULL;
+  const wchar_t* seg = NULL;
+  size_t nb_new = 0;
+  size_t len = 0;
+  size_t i = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(UNLIKELY(!document || !position || !wstr))
+    return LP_INVALID_ARGUMENT;
+  if(UNLIKELY(!is_pos_valid(document, position)))
+    return LP_INVALID_ARGUMENT;
+  /* `end' may alias the insert position */
+  pos = *position;
+
+  for(len = 0; wstr[len] != L'\0'; ++len) {
+    if(wstr[len] == L'\n')
+      ++nb_new;
+  }
+  paragraph = document->paragraph_list + pos.paragraph;
+
+  if(!nb_new) { /* Insert the characters in place */
+    lp_err = paragraph_reserve(document, paragraph, paragraph->len + len);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    memmove(paragraph->wstr + pos.offset + len,
+      paragraph->wstr + pos.offset,
+      (paragraph->len - pos.offset + 1) * sizeof(wchar_t));
+    memcpy(paragraph->wstr + pos.offset, wstr, len * sizeof(wchar_t));
+    paragraph->len += len;
+    invalidate_paragraph(document, pos.paragraph);
+    if(end) {
+      end->paragraph = pos.paragraph;
+      end->offset = pos.offset + len;
+    }
+    return LP_NO_ERROR;
+  }
+
+  /* Allocate everything before any change, so that the document is left
+   * unchanged on error */
+  lp_err = reserve_paragraphs(document, document->nb_paragraphs + nb_new);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  paragraph = document->paragraph_list + pos.paragraph;
+  seg = wcschr(wstr, L'\n');
+  lp_err = paragraph_reserve
+    (document, paragraph, pos.offset + (size_t)(seg - wstr));
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  new_list = MEM_CALLOC
+    (document->lp->allocator, nb_new, sizeof(struct document_paragraph));
+  if(!new_list)
+    return LP_MEMORY_ERROR;
+  for(i = 0; i < nb_new; ++i) {
+    const wchar_t* begin = seg + 1;
+    size_t seg_len = 0;
+    seg = wcschr(begin, L'\n');
+    if(seg) {
+      seg_len = (size_t)(seg - begin);
+      lp_err = paragraph_init
+        (document, new_list + i, begin, seg_len, NULL, 0);
+    } else { /* The last paragraph ends with the tail of the split one */
+      ASSERT(i == nb_new - 1);
+      seg_len = wcslen(begin);
+      lp_err = paragraph_init
+        (document, new_list + i, begin, seg_len,
+         paragraph->wstr + pos.offset, paragraph->len - pos.offset);
+      if(end) {
+        end->paragraph = pos.paragraph + nb_new;
+        end->offset = seg_len;
+      }
+    }
+    if(lp_err != LP_NO_ERROR)
+      goto error;
+  }
+
+  /* The split paragraph ends with the first segment */
+  len = (size_t)(wcschr(wstr, L'\n') - wstr);
+  memcpy(paragraph->wstr + pos.offset, wstr, len * sizeof(wchar_t));
+  paragraph->len = pos.offset + len;
+  paragraph->wstr[paragraph->len] = L'\0';
+
+  memmove(paragraph + 1 + nb_new, paragraph + 1,
+    (document->nb_paragraphs - pos.paragraph - 1)
+    * sizeof(struct document_paragraph));
+  memcpy(paragraph + 1, new_list, nb_new * sizeof(struct document_paragraph));
+  document->nb_paragraphs += nb_new;
+  invalidate_paragraph(document, pos.paragraph);
+
+exit:
+  MEM_FREE(document->lp->allocator, new_list);
+  return lp_err;
+error:
+  for(i = 0; i < nb_new; ++i)
+    paragraph_release(document, new_list + i);
+  goto exit;
+}
+
+enum lp_error
+lp_document_erase
+  (struct lp_document* document,
+   const struct lp_document_pos* begin,
+   const struct lp_document_pos* end)
+{
+  struct document_paragraph* first = NULL;
+  struct document_paragraph* last = NULL;
+  size_t tail_len = 0;
+  size_t nb_removed = 0;
+  size_t i = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(UNLIKELY(!document || !begin || !end))
+    return LP_INVALID_ARGUMENT;
+  if(UNLIKELY(!is_pos_valid(document, begin) || !is_pos_valid(document, end)))
+    return LP_INVALID_ARGUMENT;
+  if(UNLIKELY(begin->paragraph > end->paragraph
+  || (begin->paragraph == end->paragraph && begin->offset > end->offset)))
+    return LP_INVALID_ARGUMENT;
+
+  first = document->paragraph_list + begin->paragraph;
+  last = document->paragraph_list + end->paragraph;
+  tail_len = last->len - end->offset;
+  if(first == last) {
+    if(begin->offset == end->offset)
+      return LP_NO_ERROR;
+  } else {
+    lp_err = paragraph_reserve(document, first, begin->offset + tail_len);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+  }
+  /* Join the head of the first paragraph and the tail of the last one */
+  memmove(first->wstr + begin->offset, last->wstr + end->offset,
+    (tail_len + 1) * sizeof(wchar_t));
+  first->len = begin->offset + tail_len;
+
+  nb_removed = end->paragraph - begin->paragraph;
+  if(nb_removed) {
+    for(i = 1; i <= nb_removed; ++i)
+      paragraph_release(document, first + i);
+    memmove(first + 1, last + 1,
+      (document->nb_paragraphs - end->paragraph - 1)
+      * sizeof(struct document_paragraph));
+    document->nb_paragraphs -= nb_removed;
+    memset(document->paragraph_list + document->nb_paragraphs, 0,
+      nb_removed * sizeof(struct document_paragraph));
+  }
+  invalidate_paragraph(document, begin->paragraph);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_document_clear(struct lp_document* document)
+{
+  size_t i = 0;
+
+  if(UNLIKELY(!document))
+    return LP_INVALID_ARGUMENT;
+  /* Keep the memory of the first paragraph for the next edits */
+  for(i = 1; i < document->nb_paragraphs; ++i)
+    paragraph_release(document, document->paragraph_list + i);
+  document->nb_paragraphs = 1;
+  document->paragraph_list[0].len = 0;
+  document->paragraph_list[0].wstr[0] = L'\0';
+  invalidate_paragraph(document, 0);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_document_get_paragraphs_count
+  (const struct lp_document* document,
+   size_t* count)
+{
+  if(UNLIKELY(!document || !count))
+    return LP_INVALID_ARGUMENT;
+  *count = document->nb_paragraphs;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_document_get_paragraph
+  (const struct lp_document* document,
+   const size_t paragraph,
+   const wchar_t** wstr,
+   size_t* len)
+{
+  if(UNLIKELY(!document || !wstr || paragraph >= document->nb_paragraphs))
+    return LP_INVALID_ARGUMENT;
+  *wstr = document->paragraph_list[paragraph].wstr;
+  if(len)
+    *len = document->paragraph_list[paragraph].len;
+  return LP_NO_ERROR;
+}
+
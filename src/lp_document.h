@@ -0,0 +1,89 @@
+#ifndef LP_DOCUMENT_H
+#define LP_DOCUMENT_H
+
+#include "lp.h"
+#include <stddef.h>
+#include <wchar.h>
+
+/* A document is an editable text split in paragraphs at its new line
+ * characters, e.g. the buffer of an editor. Each paragraph is stored in its
+ * own string and its number of wrapped rows is measured once and cached with
+ * the offset of its first row. An edit only invalidates the rows of the edited
+ * paragraphs and the row offsets of the following ones, which are
+ * re-accumulated on demand. Printing the document thus lays out the edited
+ * paragraphs and the visible ones, whatever the size of the document. A
+ * document has at least one, possibly empty, paragraph. */
+struct lp_document;
+
+/* Position of a character in a document */
+struct lp_document_pos {
+  size_t paragraph; /* Index of the paragraph */
+  size_t offset; /* Index of the character in the paragraph */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LP_API enum lp_error
+lp_document_create
+  (struct lp* lp,
+   struct lp_document** document);
+
+LP_API enum lp_error
+lp_document_ref_get
+  (struct lp_document* document);
+
+LP_API enum lp_error
+lp_document_ref_put
+  (struct lp_document* document);
+
+/* Replace the document content by a copy of `wstr' */
+LP_API enum lp_error
+lp_document_set_wstring
+  (struct lp_document* document,
+   const wchar_t* wstr);
+
+/* Insert a copy of `wstr' before the character at `pos'. Its new line
+ * characters split the paragraph. `end' is the position following the
+ * inserted characters, i.e. the caret after the insertion */
+LP_API enum lp_error
+lp_document_insert_wstring
+  (struct lp_document* document,
+   const struct lp_document_pos* pos,
+   const wchar_t* wstr,
+   struct lp_document_pos* end); /* May be NULL */
+
+/* Remove the characters from `begin' to `end' excluded. The paragraphs
+ * between them are merged */
+LP_API enum lp_error
+lp_document_erase
+  (struct lp_document* document,
+   const struct lp_document_pos* begin,
+   const struct lp_document_pos* end);
+
+/* Remove all the paragraphs but an empty one */
+LP_API enum lp_error
+lp_document_clear
+  (struct lp_document* document);
+
+LP_API enum lp_error
+lp_document_get_paragraphs_count
+  (const struct lp_document* document,
+   size_t* count);
+
+/* Return the NUL terminated string of a paragraph, without its new line. It
+ * is valid until the next edit of the document */
+LP_API enum lp_error
+lp_document_get_paragraph
+  (const struct lp_document* document,
+   const size_t paragraph,
+   const wchar_t** wstr,
+   size_t* len); /* May be NULL */
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LP_DOCUMENT_H */
+
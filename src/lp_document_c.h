@@ -0,0 +1,58 @@
+#ifndef LP_DOCUMENT_C_H
+#define LP_DOCUMENT_C_H
+
+#include "lp_document.h"
+
+struct lp_printer;
+
+struct document_paragraph {
+  wchar_t* wstr; /* NUL terminated */
+  size_t len;
+  size_t capacity; /* Number of wchar_t allocated for `wstr' */
+  int nb_rows; /* Number of wrapped rows. 0 <=> not measured yet */
+};
+
+/* Measure the number of wrapped rows of the paragraph */
+typedef enum lp_error (*document_measure_T)
+  (void* data,
+   struct document_paragraph* paragraph);
+
+/* Invalidate the cached rows if they were not measured with the current font
+ * and line width of `printer' */
+extern void
+document_sync
+  (struct lp_document* document,
+   const struct lp_printer* printer);
+
+extern size_t
+document_paragraphs_count
+  (const struct lp_document* document);
+
+extern struct document_paragraph*
+document_get_paragraph
+  (struct lp_document* document,
+   const size_t id);
+
+/* Find the paragraph that contains the wrapped row `row' of the document and
+ * the index of this row in the paragraph. The paragraphs that precede it are
+ * measured if needed. `paragraph' is the number of paragraphs if the document
+ * has not as many rows */
+extern enum lp_error
+document_find_row
+  (struct lp_document* document,
+   const size_t row,
+   document_measure_T measure,
+   void* data,
+   size_t* paragraph,
+   size_t* paragraph_row);
+
+/* Overall number of wrapped rows. All the paragraphs are measured if needed */
+extern enum lp_error
+document_rows_count
+  (struct lp_document* document,
+   document_measure_T measure,
+   void* data,
+   size_t* nb_rows);
+
+#endif /* LP_DOCUMENT_C_H */
+
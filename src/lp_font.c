@@ -1,6 +1,7 @@
 #include "lp_c.h"
 #include "lp_error_c.h"
 #include "lp_font.h"
+#include "lp_trace_c.h"
 
 #include <sl/sl.h>
 #include <sl/sl_hash_table.h>
@@ -533,6 +534,7 @@ lp_font_set_data
   if(0 == nb_glyphs)
     goto exit;
 
+  LP_TRACE_BEGIN(font->lp, "lp_font_set_data");
   reset_font(font);
 
   /* Retrieve global font metrics. */
@@ -661,6 +663,8 @@ lp_font_set_data
   #undef CALLOC
 
 exit:
+  if(font && nb_glyphs && glyph_lst)
+    LP_TRACE_END(font->lp, "lp_font_set_data", nb_glyphs);
   if(font)
     free_default_glyph(font->lp->allocator, &default_glyph);
   if(root)
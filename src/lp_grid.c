@@ -0,0 +1,603 @@
+#include "lp_c.h"
+#include "lp_font.h"
+#include "lp_grid.h"
+#include "lp_grid_c.h"
+#include "lp_printer_c.h"
+#include "lp_rsrc_c.h"
+#include <rb/rbi.h>
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <snlsys/snlsys.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define GRID_VERTEX_FLOATS_COUNT (LP_SIZEOF_GRID_VERTEX / sizeof(float))
+#define GRID_CELL_FLOATS_COUNT \
+  (LP_GLYPH_VERTICES_COUNT * GRID_VERTEX_FLOATS_COUNT)
+#define SIZEOF_GRID_CELL (LP_GLYPH_VERTICES_COUNT * LP_SIZEOF_GRID_VERTEX)
+
+/* Range [begin, end[ of the changed cells of a row */
+struct row_range {
+  int begin, end;
+};
+
+struct lp_grid {
+  struct ref ref;
+  struct lp* lp;
+
+  struct lp_font* font;
+  lp_font_callback_T on_font_data_update;
+
+  struct lp_grid_cell* cell_list; /* nb_rows * nb_cols cells, row major */
+  int nb_cols, nb_rows;
+
+  struct row_range* dirty_range_list; /* Per row range of changed cells */
+  struct scratch dirty_rows; /* List of int, i.e. rows with changed cells */
+  struct scratch vertices; /* Staging memory of the uploaded cells */
+  bool is_dirty; /* The whole geometry must be rebuilt */
+  bool is_font_dirty; /* The vertices of all the cells must be written anew */
+
+  /* Geometry */
+  struct rb_buffer* vertex_buffer;
+  struct rb_buffer* index_buffer;
+  struct rb_vertex_array* vertex_array;
+  uint32_t nb_cells; /* Number of cells of the geometry */
+  int cell_width, cell_height;
+  int baseline; /* Offset of the pen from the bottom of its cell */
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+static FINLINE bool
+cell_eq(const struct lp_grid_cell* a, const struct lp_grid_cell* b)
+{
+  ASSERT(a && b);
+  return a->character == b->character
+      && a->attribs == b->attribs
+      && a->fg[0] == b->fg[0] && a->fg[1] == b->fg[1] && a->fg[2] == b->fg[2]
+      && a->bg[0] == b->bg[0] && a->bg[1] == b->bg[1] && a->bg[2] == b->bg[2];
+}
+
+static void
+release_geometry(struct lp_grid* grid)
+{
+  ASSERT(grid);
+
+  #define REF_PUT(Type, Data)                                                  \
+    if(Data) {                                                                 \
+      RBI(grid->lp->rbi, Type ## _ref_put(Data));                              \
+      Data = NULL;                                                             \
+    } (void)0
+  REF_PUT(buffer, grid->vertex_buffer);
+  REF_PUT(buffer, grid->index_buffer);
+  REF_PUT(vertex_array, grid->vertex_array);
+  #undef REF_PUT
+  grid->nb_cells = 0;
+}
+
+static void
+clear_dirty_rows(struct lp_grid* grid)
+{
+  const int* rows = NULL;
+  size_t nb_rows = 0;
+  size_t i = 0;
+  ASSERT(grid);
+
+  rows = scratch_buffer(&grid->dirty_rows);
+  nb_rows = grid->dirty_rows.id / sizeof(int);
+  for(i = 0; i < nb_rows; ++i) {
+    grid->dirty_range_list[rows[i]].begin = 0;
+    grid->dirty_range_list[rows[i]].end = 0;
+  }
+  scratch_clear(&grid->dirty_rows);
+}
+
+/* Copy `nb' cells into the row from the column `col' and extend the dirty
+ * range of the row to the changed ones. The source cells are read with a
+ * `step' of 1, or the same source cell is repeated with a step of 0 */
+static void
+patch_row
+  (struct lp_grid* grid,
+   const int col,
+   const int row,
+   const struct lp_grid_cell* cells,
+   const int nb,
+   const int step)
+{
+  struct lp_grid_cell* dst = NULL;
+  struct row_range* range = NULL;
+  int begin = INT_MAX;
+  int end = 0;
+  int i = 0;
+  ASSERT(grid && cells && col >= 0 && nb >= 0 && col + nb <= grid->nb_cols);
+  ASSERT(row >= 0 && row < grid->nb_rows && (step == 0 || step == 1));
+
+  dst = grid->cell_list + row * grid->nb_cols + col;
+  for(i = 0; i < nb; ++i) {
+    const struct lp_grid_cell* src = cells + i * step;
+    if(cell_eq(dst + i, src))
+      continue;
+    dst[i] = *src;
+    begin = MIN(begin, col + i);
+    end = col + i + 1;
+  }
+  if(begin >= end) /* No cell changed */
+    return;
+
+  range = grid->dirty_range_list + row;
+  if(range->begin >= range->end) {
+    const enum lp_error lp_err =
+      scratch_push_back(&grid->dirty_rows, &row, sizeof(int));
+    if(lp_err != LP_NO_ERROR) { /* Fall back to a full rebuild */
+      grid->is_dirty = true;
+      return;
+    }
+    range->begin = begin;
+    range->end = end;
+  } else {
+    range->begin = MIN(range->begin, begin);
+    range->end = MAX(range->end, end);
+  }
+}
+
+/* Write the 4 vertices of the cell quad. The vertices are ordered bottom left,
+ * top left, top right and bottom right as the glyph quads. The glyph texture
+ * coordinates are extrapolated onto the whole cell and the glyph texture
+ * bounds let the fragment shader discard the texels out of the glyph */
+static void
+cell_vertices_write
+  (const struct lp_grid* grid,
+   const struct lp_grid_cell* cell,
+   const int col,
+   const int row,
+   float vertices[GRID_CELL_FLOATS_COUNT])
+{
+  struct lp_font_glyph glyph;
+  const float* fg = NULL;
+  const float* bg = NULL;
+  float cell_pos[4]; /* x0, y0, x1, y1 */
+  float tex[4]; /* u0, v0, u1, v1 of the cell corners */
+  float bounds[4] = { 1.f, 1.f, 0.f, 0.f }; /* Empty bounds */
+  int i = 0;
+  ASSERT(grid && grid->font && cell && vertices);
+
+  cell_pos[0] = (float)(col * grid->cell_width);
+  cell_pos[1] = (float)((grid->nb_rows - 1 - row) * grid->cell_height);
+  cell_pos[2] = cell_pos[0] + (float)grid->cell_width;
+  cell_pos[3] = cell_pos[1] + (float)grid->cell_height;
+  memset(tex, 0, sizeof(tex));
+
+  LP(font_get_glyph(grid->font, cell->character, &glyph));
+  if(!(cell->attribs & LP_GRID_HIDDEN)
+  && glyph.pos[0].x != glyph.pos[1].x
+  && glyph.pos[0].y != glyph.pos[1].y) {
+    const float pen[2] = { cell_pos[0], cell_pos[1] + (float)grid->baseline };
+    const float pos[2][2] = {
+      { glyph.pos[0].x + pen[0], glyph.pos[0].y + pen[1] },
+      { glyph.pos[1].x + pen[0], glyph.pos[1].y + pen[1] }
+    };
+    const float uv[2][2] = {
+      { glyph.tex[0].x, glyph.tex[0].y },
+      { glyph.tex[1].x, glyph.tex[1].y }
+    };
+    for(i = 0; i < 2; ++i) { /* x then y */
+      const float slope = (uv[1][i] - uv[0][i]) / (pos[1][i] - pos[0][i]);
+      tex[i + 0] = uv[0][i] + (cell_pos[i + 0] - pos[0][i]) * slope;
+      tex[i + 2] = uv[0][i] + (cell_pos[i + 2] - pos[0][i]) * slope;
+      bounds[i + 0] = MIN(uv[0][i], uv[1][i]);
+      bounds[i + 2] = MAX(uv[0][i], uv[1][i]);
+    }
+  }
+  if(cell->attribs & LP_GRID_INVERSE) {
+    fg = cell->bg;
+    bg = cell->fg;
+  } else {
+    fg = cell->fg;
+    bg = cell->bg;
+  }
+
+  for(i = 0; i < LP_GLYPH_VERTICES_COUNT; ++i) {
+    /* Corners: bottom left, top left, top right and bottom right */
+    const int right = i >= 2;
+    const int top = i == 1 || i == 2;
+    float* dst = vertices + (size_t)i * GRID_VERTEX_FLOATS_COUNT;
+    dst[0] = cell_pos[right ? 2 : 0];
+    dst[1] = cell_pos[top ? 3 : 1];
+    dst[2] = tex[right ? 2 : 0];
+    dst[3] = tex[top ? 3 : 1];
+    memcpy(dst + 4, bounds, sizeof(bounds));
+    memcpy(dst + 8, fg, 3 * sizeof(float));
+    memcpy(dst + 11, bg, 3 * sizeof(float));
+  }
+}
+
+/* Write the vertices of `nb' contiguous cells of a row in the staging
+ * memory */
+static float*
+write_cells
+  (struct lp_grid* grid,
+   const int col,
+   const int row,
+   const int nb)
+{
+  float* vertices = NULL;
+  int i = 0;
+  ASSERT(grid && col >= 0 && row >= 0 && nb > 0);
+  ASSERT(col + nb <= grid->nb_cols && row < grid->nb_rows);
+
+  scratch_clear(&grid->vertices);
+  vertices = scratch_alloc(&grid->vertices, (size_t)nb * SIZEOF_GRID_CELL);
+  if(!vertices)
+    return NULL;
+  for(i = 0; i < nb; ++i) {
+    const int id = row * grid->nb_cols + col + i;
+    cell_vertices_write
+      (grid, grid->cell_list + id, col + i, row,
+       vertices + (size_t)i * GRID_CELL_FLOATS_COUNT);
+  }
+  return vertices;
+}
+
+/* Set the cell size and the pen offset with respect to the grid font */
+static void
+setup_cell_metrics(struct lp_grid* grid)
+{
+  struct lp_font_metrics metrics;
+  struct lp_font_glyph glyph;
+  ASSERT(grid && grid->font);
+
+  LP(font_get_metrics(grid->font, &metrics));
+  LP(font_get_glyph(grid->font, L' ', &glyph));
+  grid->cell_width = glyph.width ? glyph.width : metrics.min_glyph_width;
+  grid->cell_height = metrics.line_space;
+  grid->baseline = -metrics.min_glyph_pos_y;
+}
+
+/* Upload the cells of the rows [begin, end[. The cells are uploaded row per
+ * row in order to bound the staging memory */
+static enum lp_error
+upload_rows(struct lp_grid* grid, const int begin, const int end)
+{
+  int row = 0;
+  ASSERT(grid && grid->vertex_buffer);
+  ASSERT(begin >= 0 && begin <= end && end <= grid->nb_rows);
+
+  for(row = begin; row < end; ++row) {
+    const float* vertices = write_cells(grid, 0, row, grid->nb_cols);
+    if(!vertices)
+      return LP_MEMORY_ERROR;
+    RBI(grid->lp->rbi, buffer_data
+      (grid->vertex_buffer, (int)((size_t)row * grid->vertices.id),
+       (int)grid->vertices.id, vertices));
+  }
+  return LP_NO_ERROR;
+}
+
+static enum lp_error
+build_geometry(struct lp_grid* grid, struct rsrc* rsrc)
+{
+  struct rb_buffer_attrib attrib_list[LP_GRID_ATTRIBS_COUNT];
+  struct rb_buffer_desc buffer_desc;
+  struct rbi* rbi = NULL;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(grid && grid->font && grid->nb_cols && grid->nb_rows && rsrc);
+
+  rbi = grid->lp->rbi;
+  setup_cell_metrics(grid);
+
+  grid->nb_cells = (uint32_t)(grid->nb_cols * grid->nb_rows);
+  buffer_desc.size = grid->nb_cells * SIZEOF_GRID_CELL;
+  buffer_desc.target = RB_BIND_VERTEX_BUFFER;
+  buffer_desc.usage = RB_USAGE_DYNAMIC;
+  RBI(rbi, create_buffer
+    (grid->lp->rb_ctxt, &buffer_desc, NULL, &grid->vertex_buffer));
+  lp_err = upload_rows(grid, 0, grid->nb_rows);
+  if(lp_err != LP_NO_ERROR)
+    goto error;
+
+  /* The cells are indexed as glyph quads */
+  lp_err = rsrc_get_glyph_index_buffer
+    (rsrc, grid->nb_cells, &grid->index_buffer);
+  if(lp_err != LP_NO_ERROR)
+    goto error;
+
+  #define REGISTER_ATTRIB(Id, Type, Offset)                                    \
+    {                                                                          \
+      attrib_list[Id].index = Id;                                              \
+      attrib_list[Id].stride = LP_SIZEOF_GRID_VERTEX;                          \
+      attrib_list[Id].offset = (Offset) * sizeof(float);                       \
+      attrib_list[Id].type = Type;                                             \
+    } (void)0
+  REGISTER_ATTRIB(LP_GRID_ATTRIB_POSITION_ID, RB_FLOAT2, 0);
+  REGISTER_ATTRIB(LP_GRID_ATTRIB_TEXCOORD_ID, RB_FLOAT2, 2);
+  REGISTER_ATTRIB(LP_GRID_ATTRIB_TEX_BOUNDS_ID, RB_FLOAT4, 4);
+  REGISTER_ATTRIB(LP_GRID_ATTRIB_FG_ID, RB_FLOAT3, 8);
+  REGISTER_ATTRIB(LP_GRID_ATTRIB_BG_ID, RB_FLOAT3, 11);
+  #undef REGISTER_ATTRIB
+  RBI(rbi, create_vertex_array(grid->lp->rb_ctxt, &grid->vertex_array));
+  RBI(rbi, vertex_attrib_array
+    (grid->vertex_array, grid->vertex_buffer, LP_GRID_ATTRIBS_COUNT,
+     attrib_list));
+  RBI(rbi, vertex_index_array(grid->vertex_array, grid->index_buffer));
+
+exit:
+  return lp_err;
+error:
+  release_geometry(grid);
+  goto exit;
+}
+
+/* Upload the changed range of each dirty row */
+static enum lp_error
+update_geometry(struct lp_grid* grid)
+{
+  const int* rows = NULL;
+  size_t nb_rows = 0;
+  size_t i = 0;
+  ASSERT(grid && grid->vertex_buffer);
+
+  rows = scratch_buffer(&grid->dirty_rows);
+  nb_rows = grid->dirty_rows.id / sizeof(int);
+  for(i = 0; i < nb_rows; ++i) {
+    const struct row_range* range = grid->dirty_range_list + rows[i];
+    const size_t offset = (size_t)(rows[i] * grid->nb_cols + range->begin);
+    const float* vertices = write_cells
+      (grid, range->begin, rows[i], range->end - range->begin);
+    if(!vertices)
+      return LP_MEMORY_ERROR;
+    RBI(grid->lp->rbi, buffer_data
+      (grid->vertex_buffer, (int)(offset * SIZEOF_GRID_CELL),
+       (int)grid->vertices.id, vertices));
+  }
+  return LP_NO_ERROR;
+}
+
+static void
+on_font_data_update(struct lp_font* font, void* data)
+{
+  (void)font;
+  struct lp_grid* grid = data;
+  ASSERT(font && data && grid->font == font);
+  /* The number of cells does not change, hence the geometry is kept */
+  grid->is_font_dirty = true;
+}
+
+static void
+release_grid(struct ref* ref)
+{
+  struct lp* lp = NULL;
+  struct lp_grid* grid = NULL;
+  ASSERT(NULL != ref);
+
+  grid = CONTAINER_OF(ref, struct lp_grid, ref);
+
+  release_geometry(grid);
+  CALLBACK_DISCONNECT(&grid->on_font_data_update);
+  if(grid->font)
+    LP(font_ref_put(grid->font));
+  if(grid->cell_list)
+    MEM_FREE(grid->lp->allocator, grid->cell_list);
+  if(grid->dirty_range_list)
+    MEM_FREE(grid->lp->allocator, grid->dirty_range_list);
+  scratch_release(&grid->dirty_rows);
+  scratch_release(&grid->vertices);
+  lp = grid->lp;
+  MEM_FREE(lp->allocator, grid);
+  LP(ref_put(lp));
+}
+
+/*******************************************************************************
+ *
+ * Internal grid functions
+ *
+ ******************************************************************************/
+enum lp_error
+grid_setup(struct lp_grid* grid, struct rsrc* rsrc)
+{
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(grid && rsrc);
+
+  if(grid->is_dirty || !grid->vertex_buffer) {
+    release_geometry(grid);
+    if(grid->font && grid->nb_cols && grid->nb_rows)
+      lp_err = build_geometry(grid, rsrc);
+    grid->is_dirty = false;
+  } else if(grid->is_font_dirty) {
+    /* The glyphs and the cell metrics may change but not the cell count */
+    setup_cell_metrics(grid);
+    lp_err = upload_rows(grid, 0, grid->nb_rows);
+  } else {
+    lp_err = update_geometry(grid);
+  }
+  grid->is_font_dirty = false;
+  clear_dirty_rows(grid);
+  if(lp_err != LP_NO_ERROR) /* Rebuild the whole geometry on the next setup */
+    grid->is_dirty = true;
+  return lp_err;
+}
+
+void
+grid_draw
+  (struct lp_grid* grid,
+   struct shading* shading,
+   const float bias[3])
+{
+  struct rb_tex2d* font_tex = NULL;
+  struct rbi* rbi = NULL;
+  struct rb_context* rb_ctxt = NULL;
+  ASSERT(grid && shading && bias && !grid->is_dirty);
+
+  if(!grid->nb_cells)
+    return;
+
+  rbi = grid->lp->rbi;
+  rb_ctxt = grid->lp->rb_ctxt;
+  LP(font_get_texture(grid->font, &font_tex));
+  RBI(rbi, bind_tex2d(rb_ctxt, font_tex, LP_FONT_TEX_UNIT));
+  shading_set_bias(grid->lp, shading, bias);
+  RBI(rbi, bind_vertex_array(rb_ctxt, grid->vertex_array));
+  RBI(rbi, draw_indexed
+    (rb_ctxt, RB_TRIANGLE_LIST, grid->nb_cells * LP_GLYPH_INDICES_COUNT));
+}
+
+/*******************************************************************************
+ *
+ * lp_grid functions
+ *
+ ******************************************************************************/
+enum lp_error
+lp_grid_create(struct lp* lp, struct lp_grid** out_grid)
+{
+  struct lp_grid* grid = NULL;
+
+  if(UNLIKELY(!lp || !out_grid))
+    return LP_INVALID_ARGUMENT;
+
+  grid = MEM_CALLOC(lp->allocator, 1, sizeof(struct lp_grid));
+  if(UNLIKELY(!grid))
+    return LP_MEMORY_ERROR;
+
+  ref_init(&grid->ref);
+  grid->lp = lp;
+  LP(ref_get(lp));
+  CALLBACK_INIT(&grid->on_font_data_update);
+  CALLBACK_SETUP(&grid->on_font_data_update, on_font_data_update, grid);
+  scratch_init(lp->allocator, &grid->dirty_rows);
+  scratch_init(lp->allocator, &grid->vertices);
+  *out_grid = grid;
+
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_grid_ref_get(struct lp_grid* grid)
+{
+  if(UNLIKELY(!grid))
+    return LP_INVALID_ARGUMENT;
+  ref_get(&grid->ref);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_grid_ref_put(struct lp_grid* grid)
+{
+  if(UNLIKELY(!grid))
+    return LP_INVALID_ARGUMENT;
+  ref_put(&grid->ref, release_grid);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_grid_set_font(struct lp_grid* grid, struct lp_font* font)
+{
+  if(UNLIKELY(!grid || !font))
+    return LP_INVALID_ARGUMENT;
+
+  if(font != grid->font) {
+    if(grid->font) {
+      LP(font_ref_put(grid->font));
+    }
+    LP(font_ref_get(font));
+    CALLBACK_DISCONNECT(&grid->on_font_data_update);
+    LP(font_signal_connect
+      (font, LP_FONT_SIGNAL_DATA_UPDATE, &grid->on_font_data_update));
+    grid->font = font;
+    grid->is_font_dirty = true;
+  }
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_grid_resize(struct lp_grid* grid, const int nb_cols, const int nb_rows)
+{
+  const struct lp_grid_cell blank = {
+    L' ', { 1.f, 1.f, 1.f }, { 0.f, 0.f, 0.f }, 0
+  };
+  struct lp_grid_cell* cell_list = NULL;
+  struct row_range* dirty_range_list = NULL;
+  size_t nb_cells = 0;
+  size_t i = 0;
+
+  if(UNLIKELY(!grid || nb_cols < 0 || nb_rows < 0))
+    return LP_INVALID_ARGUMENT;
+  /* The byte offsets of the cell vertices must fit in an int */
+  if(nb_rows
+  && (size_t)nb_cols > (size_t)INT_MAX / SIZEOF_GRID_CELL / (size_t)nb_rows)
+    return LP_INVALID_ARGUMENT;
+
+  nb_cells = (size_t)nb_cols * (size_t)nb_rows;
+  if(nb_cells) {
+    cell_list = MEM_ALLOC
+      (grid->lp->allocator, nb_cells * sizeof(struct lp_grid_cell));
+    dirty_range_list = MEM_CALLOC
+      (grid->lp->allocator, (size_t)nb_rows, sizeof(struct row_range));
+    if(!cell_list || !dirty_range_list) {
+      if(cell_list)
+        MEM_FREE(grid->lp->allocator, cell_list);
+      if(dirty_range_list)
+        MEM_FREE(grid->lp->allocator, dirty_range_list);
+      return LP_MEMORY_ERROR;
+    }
+    for(i = 0; i < nb_cells; ++i)
+      cell_list[i] = blank;
+  }
+  if(grid->cell_list)
+    MEM_FREE(grid->lp->allocator, grid->cell_list);
+  if(grid->dirty_range_list)
+    MEM_FREE(grid->lp->allocator, grid->dirty_range_list);
+  grid->cell_list = cell_list;
+  grid->dirty_range_list = dirty_range_list;
+  grid->nb_cols = nb_cols;
+  grid->nb_rows = nb_rows;
+  scratch_clear(&grid->dirty_rows);
+  grid->is_dirty = true;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_grid_get_size(struct lp_grid* grid, int* nb_cols, int* nb_rows)
+{
+  if(UNLIKELY(!grid))
+    return LP_INVALID_ARGUMENT;
+  if(nb_cols)
+    *nb_cols = grid->nb_cols;
+  if(nb_rows)
+    *nb_rows = grid->nb_rows;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_grid_set_cells
+  (struct lp_grid* grid,
+   const int col,
+   const int row,
+   const struct lp_grid_cell* cells,
+   const int nb_cells)
+{
+  if(UNLIKELY(!grid || !cells || nb_cells < 0))
+    return LP_INVALID_ARGUMENT;
+  if(UNLIKELY(col < 0 || row < 0 || row >= grid->nb_rows))
+    return LP_INVALID_ARGUMENT;
+  if(UNLIKELY(nb_cells > grid->nb_cols - col))
+    return LP_INVALID_ARGUMENT;
+
+  patch_row(grid, col, row, cells, nb_cells, 1);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_grid_clear(struct lp_grid* grid, const struct lp_grid_cell* cell)
+{
+  int row = 0;
+
+  if(UNLIKELY(!grid || !cell))
+    return LP_INVALID_ARGUMENT;
+
+  for(row = 0; row < grid->nb_rows; ++row)
+    patch_row(grid, 0, row, cell, grid->nb_cols, 0);
+  return LP_NO_ERROR;
+}
@@ -0,0 +1,83 @@
+#ifndef LP_GRID_H
+#define LP_GRID_H
+
+#include "lp.h"
+#include <wchar.h>
+
+/* A grid is a fixed array of cells laid out with the advance of the font
+ * space, e.g. the screen of a terminal. Its GPU geometry is kept resident and
+ * only the changed cells are uploaded. The grid is drawn through
+ * lp_printer_print_grid in one draw call. The font is assumed monospace. */
+struct lp_grid;
+struct lp_font;
+
+enum lp_grid_attrib {
+  LP_GRID_INVERSE = (1 << 0), /* Swap the foreground and background colors */
+  LP_GRID_HIDDEN = (1 << 1) /* Only draw the cell background */
+};
+
+struct lp_grid_cell {
+  wchar_t character;
+  float fg[3]; /* Glyph color */
+  float bg[3]; /* Cell color */
+  int attribs; /* Combination of enum lp_grid_attrib */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LP_API enum lp_error
+lp_grid_create
+  (struct lp* lp,
+   struct lp_grid** grid);
+
+LP_API enum lp_error
+lp_grid_ref_get
+  (struct lp_grid* grid);
+
+LP_API enum lp_error
+lp_grid_ref_put
+  (struct lp_grid* grid);
+
+LP_API enum lp_error
+lp_grid_set_font
+  (struct lp_grid* grid,
+   struct lp_font* font);
+
+/* Define the number of columns and rows of the grid. The cells are reset to
+ * white spaces on a black background */
+LP_API enum lp_error
+lp_grid_resize
+  (struct lp_grid* grid,
+   const int nb_cols,
+   const int nb_rows);
+
+LP_API enum lp_error
+lp_grid_get_size
+  (struct lp_grid* grid,
+   int* nb_cols, /* May be NULL */
+   int* nb_rows); /* May be NULL */
+
+/* Write `nb_cells' cells in the row `row' from the column `col'. The row 0 is
+ * the top of the grid. The cells must fit in the row. Only the cells whose
+ * content changes are uploaded on the next draw */
+LP_API enum lp_error
+lp_grid_set_cells
+  (struct lp_grid* grid,
+   const int col,
+   const int row,
+   const struct lp_grid_cell* cells,
+   const int nb_cells);
+
+/* Set all the cells of the grid to `cell' */
+LP_API enum lp_error
+lp_grid_clear
+  (struct lp_grid* grid,
+   const struct lp_grid_cell* cell);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LP_GRID_H */
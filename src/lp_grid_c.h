@@ -0,0 +1,37 @@
+#ifndef LP_GRID_C_H
+#define LP_GRID_C_H
+
+#include "lp_grid.h"
+
+/* A grid cell is a quad covering the whole cell. Its texture coordinates are
+ * those of the glyph quad extrapolated onto the cell, and the fragments out
+ * of the glyph texture bounds only output the background color */
+#define LP_SIZEOF_GRID_VERTEX \
+  ((2/*pos*/ + 2/*tex*/ + 4/*tex bounds*/ + 3/*fg*/ + 3/*bg*/)*sizeof(float))
+#define LP_GRID_ATTRIB_POSITION_ID 0
+#define LP_GRID_ATTRIB_TEXCOORD_ID 1
+#define LP_GRID_ATTRIB_TEX_BOUNDS_ID 2
+#define LP_GRID_ATTRIB_FG_ID 3
+#define LP_GRID_ATTRIB_BG_ID 4
+#define LP_GRID_ATTRIBS_COUNT 5
+
+struct rsrc;
+struct shading;
+
+/* Upload the changed cells, write all the cells anew if the font changed or
+ * rebuild the whole grid geometry if its size changed. The cells are indexed
+ * by the glyph index buffer of `rsrc' */
+extern enum lp_error
+grid_setup
+  (struct lp_grid* grid,
+   struct rsrc* rsrc);
+
+/* Draw the grid with the grid shading program. The program, the font sampler
+ * and the scale uniform are assumed to be already set */
+extern void
+grid_draw
+  (struct lp_grid* grid,
+   struct shading* shading,
+   const float bias[3]);
+
+#endif /* LP_GRID_C_H */
@@ -0,0 +1,452 @@
+#include "lp_c.h"
+#include "lp_font.h"
+#include "lp_hit_index.h"
+#include "lp_hit_index_c.h"
+#include "lp_scratch_c.h"
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <snlsys/ref_count.h>
+#include <snlsys/snlsys.h>
+#include <stdlib.h>
+
+/* Glyph cell of a recorded character */
+struct hit_glyph {
+  size_t begin, end; /* Offsets of the character and of the following one */
+  int x, y; /* Pen position */
+  int width;
+};
+
+/* Run of glyphs of a string on the same row, of increasing pen positions */
+struct hit_line {
+  size_t string;
+  size_t first_glyph;
+  size_t nb_glyphs;
+  int x0, x1; /* Horizontal range of the glyph cells */
+  int y, height; /* Row of the glyph cells */
+};
+
+struct hit_string {
+  size_t first_glyph;
+  size_t nb_glyphs;
+  size_t len; /* Number of code units */
+  int x, y; /* Pen position at the beginning of the string */
+  int end_x, end_y; /* Pen position at the end of the string */
+};
+
+/* Sort key of the lines */
+struct line_key {
+  int y, x;
+  size_t line;
+};
+
+struct lp_hit_index {
+  struct ref ref;
+  struct lp* lp;
+  struct scratch glyphs; /* List of struct hit_glyph */
+  struct scratch lines; /* List of struct hit_line */
+  struct scratch strings; /* List of struct hit_string */
+  struct scratch keys; /* Lines sorted by row. Valid if `is_sorted' */
+  int max_line_height;
+  int is_sorted;
+};
+
+#define COUNT(Scratch, Type) ((Scratch).id / sizeof(Type))
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+static int
+cmp_line_key(const void* a, const void* b)
+{
+  const struct line_key* key0 = a;
+  const struct line_key* key1 = b;
+  if(key0->y != key1->y)
+    return key0->y < key1->y ? -1 : 1;
+  if(key0->x != key1->x)
+    return key0->x < key1->x ? -1 : 1;
+  return key0->line < key1->line ? -1 : (key0->line > key1->line);
+}
+
+static enum lp_error
+sort_lines(struct lp_hit_index* index)
+{
+  const struct hit_line* lines = NULL;
+  struct line_key* keys = NULL;
+  const size_t nb_lines = COUNT(index->lines, struct hit_line);
+  enum lp_error lp_err = LP_NO_ERROR;
+  size_t i = 0;
+  ASSERT(index);
+
+  if(index->is_sorted)
+    return LP_NO_ERROR;
+  lp_err = scratch_reserve(&index->keys, nb_lines * sizeof(struct line_key));
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  lines = scratch_buffer(&index->lines);
+  keys = scratch_buffer(&index->keys);
+  for(i = 0; i < nb_lines; ++i) {
+    keys[i].y = lines[i].y;
+    keys[i].x = lines[i].x0;
+    keys[i].line = i;
+  }
+  if(nb_lines)
+    qsort(keys, nb_lines, sizeof(struct line_key), cmp_line_key);
+  index->is_sorted = 1;
+  return LP_NO_ERROR;
+}
+
+/* Return the glyph of the line whose cell contains x, or NULL */
+static const struct hit_glyph*
+line_hit
+  (const struct hit_line* line,
+   const struct hit_glyph* glyphs,
+   const int x)
+{
+  size_t lo = 0;
+  size_t hi = 0;
+  const struct hit_glyph* glyph = NULL;
+  ASSERT(line && glyphs && line->nb_glyphs);
+
+  /* First glyph whose pen position is greater than x */
+  lo = line->first_glyph;
+  hi = line->first_glyph + line->nb_glyphs;
+  while(lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if(glyphs[mid].x > x) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  if(lo == line->first_glyph)
+    return NULL;
+  glyph = glyphs + lo - 1;
+  return x < glyph->x + glyph->width ? glyph : NULL;
+}
+
+static void
+release_hit_index(struct ref* ref)
+{
+  struct lp* lp = NULL;
+  struct lp_hit_index* index = NULL;
+  ASSERT(ref);
+
+  index = CONTAINER_OF(ref, struct lp_hit_index, ref);
+  scratch_release(&index->glyphs);
+  scratch_release(&index->lines);
+  scratch_release(&index->strings);
+  scratch_release(&index->keys);
+  lp = index->lp;
+  MEM_FREE(lp->allocator, index);
+  LP(ref_put(lp));
+}
+
+/*******************************************************************************
+ *
+ * Internal hit index functions
+ *
+ ******************************************************************************/
+enum lp_error
+hit_index_begin_string
+  (struct lp_hit_index* index,
+   const struct string_view* str,
+   const int x,
+   const int y,
+   const int dx,
+   const int dy,
+   const int line_space,
+   struct hit_recorder* recorder)
+{
+  struct hit_string* string = NULL;
+  ASSERT(index && str && recorder);
+
+  string = scratch_alloc(&index->strings, sizeof(struct hit_string));
+  if(!string)
+    return LP_MEMORY_ERROR;
+  string->first_glyph = COUNT(index->glyphs, struct hit_glyph);
+  string->nb_glyphs = 0;
+  string->len = str->len;
+  string->x = string->end_x = x + dx;
+  string->y = string->end_y = y + dy;
+
+  recorder->index = index;
+  recorder->str = str;
+  recorder->dx = dx;
+  recorder->dy = dy;
+  recorder->line_space = line_space;
+  recorder->line = 0;
+  recorder->has_line = 0;
+  index->max_line_height = MAX(index->max_line_height, line_space);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+hit_index_record_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width)
+{
+  struct hit_recorder* recorder = data;
+  struct lp_hit_index* index = NULL;
+  struct hit_glyph* hit_glyph = NULL;
+  struct hit_line* line = NULL;
+  struct hit_string* string = NULL;
+  const int glyph_x = x + recorder->dx;
+  const int glyph_y = y + recorder->dy;
+  size_t end = id + 1;
+  (void)glyph;
+  ASSERT(data && recorder->index && recorder->str);
+
+  index = recorder->index;
+  if(recorder->str->encoding == STRING_UTF8) {
+    const unsigned char* utf8 = recorder->str->data;
+    if(utf8[id] >= 0x80) {
+      end = id;
+      utf8_decode(utf8, recorder->str->len, &end);
+    }
+  }
+
+  hit_glyph = scratch_alloc(&index->glyphs, sizeof(struct hit_glyph));
+  if(!hit_glyph)
+    return LP_MEMORY_ERROR;
+  hit_glyph->begin = id;
+  hit_glyph->end = end;
+  hit_glyph->x = glyph_x;
+  hit_glyph->y = glyph_y;
+  hit_glyph->width = width;
+
+  /* A glyph that does not follow the line cells, e.g. on a wrap or a cursor
+   * move, begins a new line */
+  if(recorder->has_line) {
+    line = (struct hit_line*)scratch_buffer(&index->lines) + recorder->line;
+    if(line->y != glyph_y || glyph_x < line->x1)
+      line = NULL;
+  }
+  if(!line) {
+    line = scratch_alloc(&index->lines, sizeof(struct hit_line));
+    if(!line)
+      return LP_MEMORY_ERROR;
+    line->string = COUNT(index->strings, struct hit_string) - 1;
+    line->first_glyph = COUNT(index->glyphs, struct hit_glyph) - 1;
+    line->nb_glyphs = 0;
+    line->x0 = glyph_x;
+    line->y = glyph_y;
+    line->height = recorder->line_space;
+    recorder->line = COUNT(index->lines, struct hit_line) - 1;
+    recorder->has_line = 1;
+  }
+  line->x1 = glyph_x + width;
+  ++line->nb_glyphs;
+
+  string = (struct hit_string*)scratch_buffer(&index->strings)
+    + COUNT(index->strings, struct hit_string) - 1;
+  ++string->nb_glyphs;
+  index->is_sorted = 0;
+  return LP_NO_ERROR;
+}
+
+void
+hit_index_end_string
+  (struct hit_recorder* recorder,
+   const int cur_x,
+   const int cur_y)
+{
+  struct lp_hit_index* index = NULL;
+  struct hit_string* string = NULL;
+  ASSERT(recorder && recorder->index);
+
+  index = recorder->index;
+  ASSERT(COUNT(index->strings, struct hit_string));
+  string = (struct hit_string*)scratch_buffer(&index->strings)
+    + COUNT(index->strings, struct hit_string) - 1;
+  string->end_x = cur_x + recorder->dx;
+  string->end_y = cur_y + recorder->dy;
+}
+
+/*******************************************************************************
+ *
+ * lp_hit_index functions
+ *
+ ******************************************************************************/
+enum lp_error
+lp_hit_index_create(struct lp* lp, struct lp_hit_index** out_index)
+{
+  struct lp_hit_index* index = NULL;
+
+  if(!lp || !out_index)
+    return LP_INVALID_ARGUMENT;
+
+  index = MEM_CALLOC(lp->allocator, 1, sizeof(struct lp_hit_index));
+  if(!index)
+    return LP_MEMORY_ERROR;
+  ref_init(&index->ref);
+  index->lp = lp;
+  LP(ref_get(lp));
+  scratch_init(lp->allocator, &index->glyphs);
+  scratch_init(lp->allocator, &index->lines);
+  scratch_init(lp->allocator, &index->strings);
+  scratch_init(lp->allocator, &index->keys);
+  index->is_sorted = 1;
+  *out_index = index;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_hit_index_ref_get(struct lp_hit_index* index)
+{
+  if(!index)
+    return LP_INVALID_ARGUMENT;
+  ref_get(&index->ref);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_hit_index_ref_put(struct lp_hit_index* index)
+{
+  if(!index)
+    return LP_INVALID_ARGUMENT;
+  ref_put(&index->ref, release_hit_index);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_hit_index_clear(struct lp_hit_index* index)
+{
+  if(!index)
+    return LP_INVALID_ARGUMENT;
+  scratch_clear(&index->glyphs);
+  scratch_clear(&index->lines);
+  scratch_clear(&index->strings);
+  index->max_line_height = 0;
+  index->is_sorted = 1;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_hit_index_get_strings_count
+  (const struct lp_hit_index* index,
+   size_t* count)
+{
+  if(!index || !count)
+    return LP_INVALID_ARGUMENT;
+  *count = COUNT(index->strings, struct hit_string);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_hit_index_hit_test
+  (struct lp_hit_index* index,
+   const int x,
+   const int y,
+   struct lp_hit* hit,
+   int* is_hit)
+{
+  const struct line_key* keys = NULL;
+  const struct hit_line* lines = NULL;
+  const struct hit_glyph* glyphs = NULL;
+  const struct hit_glyph* best_glyph = NULL;
+  const struct hit_line* best_line = NULL;
+  size_t lo = 0;
+  size_t hi = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!index || !hit || !is_hit)
+    return LP_INVALID_ARGUMENT;
+
+  lp_err = sort_lines(index);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  keys = scratch_buffer(&index->keys);
+  lines = scratch_buffer(&index->lines);
+  glyphs = scratch_buffer(&index->glyphs);
+
+  /* First line whose row begins above y */
+  hi = COUNT(index->lines, struct hit_line);
+  while(lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if(keys[mid].y > y) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  /* The rows that contain y begin less than a line height below it */
+  while(lo-- > 0 && keys[lo].y > y - index->max_line_height) {
+    const struct hit_line* line = lines + keys[lo].line;
+    const struct hit_glyph* glyph = NULL;
+    if(y >= line->y + line->height || x < line->x0 || x >= line->x1)
+      continue;
+    if(best_line && best_line->string > line->string)
+      continue;
+    glyph = line_hit(line, glyphs, x);
+    if(glyph) {
+      best_line = line;
+      best_glyph = glyph;
+    }
+  }
+
+  *is_hit = best_glyph != NULL;
+  if(best_glyph) {
+    hit->string = best_line->string;
+    hit->offset = best_glyph->begin;
+    hit->caret = x < best_glyph->x + best_glyph->width / 2
+      ? best_glyph->begin : best_glyph->end;
+  }
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_hit_index_get_caret
+  (const struct lp_hit_index* index,
+   const size_t string,
+   const size_t offset,
+   int* x,
+   int* y)
+{
+  const struct hit_string* str = NULL;
+  const struct hit_glyph* glyphs = NULL;
+  size_t lo = 0;
+  size_t hi = 0;
+
+  if(!index || !x || !y
+  || string >= COUNT(index->strings, struct hit_string))
+    return LP_INVALID_ARGUMENT;
+  str = (const struct hit_string*)index->strings.buffer + string;
+  if(offset > str->len)
+    return LP_INVALID_ARGUMENT;
+
+  if(offset == str->len) {
+    *x = str->end_x;
+    *y = str->end_y;
+    return LP_NO_ERROR;
+  }
+  /* First glyph of the string whose character is not before `offset' */
+  glyphs = index->glyphs.buffer;
+  lo = str->first_glyph;
+  hi = str->first_glyph + str->nb_glyphs;
+  while(lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if(glyphs[mid].begin < offset) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if(lo < str->first_glyph + str->nb_glyphs && glyphs[lo].begin == offset) {
+    *x = glyphs[lo].x;
+    *y = glyphs[lo].y;
+  } else if(lo > str->first_glyph) {
+    *x = glyphs[lo - 1].x + glyphs[lo - 1].width;
+    *y = glyphs[lo - 1].y;
+  } else {
+    *x = str->x;
+    *y = str->y;
+  }
+  return LP_NO_ERROR;
+}
+
@@ -0,0 +1,81 @@
+#ifndef LP_HIT_INDEX_H
+#define LP_HIT_INDEX_H
+
+#include "lp.h"
+#include <stddef.h>
+
+/* Index of the laid out glyphs of the strings printed while it is set on a
+ * printer, i.e. the printed strings and spans, the visible scrollback lines
+ * and the retained texts. Each string is identified by its rank in the
+ * recording order and its characters by their offset in code units. The
+ * glyphs are indexed per line of increasing x ranges, whether they are culled
+ * or not, so that a window position is resolved to a character in O(log n)
+ * plus the number of lines sharing its row. The glyphs of the recorders and
+ * the grid cells are not indexed. */
+struct lp_hit_index;
+
+/* Character under a window position */
+struct lp_hit {
+  size_t string; /* Rank of the string in the recording order */
+  size_t offset; /* Offset in code units of the character */
+  /* Offset of the caret boundary nearest to the position, i.e. `offset' or
+   * the offset of the following character */
+  size_t caret;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LP_API enum lp_error
+lp_hit_index_create
+  (struct lp* lp,
+   struct lp_hit_index** index);
+
+LP_API enum lp_error
+lp_hit_index_ref_get
+  (struct lp_hit_index* index);
+
+LP_API enum lp_error
+lp_hit_index_ref_put
+  (struct lp_hit_index* index);
+
+/* Remove the recorded strings, e.g. once per frame. The memory is kept */
+LP_API enum lp_error
+lp_hit_index_clear
+  (struct lp_hit_index* index);
+
+LP_API enum lp_error
+lp_hit_index_get_strings_count
+  (const struct lp_hit_index* index,
+   size_t* count);
+
+/* Resolve the window position (x, y) to the character whose glyph cell
+ * contains it. The string printed last wins if several cells overlap. `is_hit'
+ * is 0 if no cell contains the position; `hit' is then left unchanged */
+LP_API enum lp_error
+lp_hit_index_hit_test
+  (struct lp_hit_index* index,
+   const int x,
+   const int y,
+   struct lp_hit* hit,
+   int* is_hit);
+
+/* Pen position of the caret before the character at `offset' of the
+ * `string'th recorded string. The caret of an offset that has no glyph, e.g.
+ * a new line, follows the previous glyph; the caret of the string length is
+ * the pen position at the end of the string */
+LP_API enum lp_error
+lp_hit_index_get_caret
+  (const struct lp_hit_index* index,
+   const size_t string,
+   const size_t offset,
+   int* x,
+   int* y);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LP_HIT_INDEX_H */
+
@@ -0,0 +1,50 @@
+#ifndef LP_HIT_INDEX_C_H
+#define LP_HIT_INDEX_C_H
+
+#include "lp_hit_index.h"
+#include "lp_string_c.h"
+
+struct lp_font_glyph;
+
+/* Recording of a string into a hit index. The recorded glyphs are offset by
+ * (dx, dy), e.g. the origin of a retained text */
+struct hit_recorder {
+  struct lp_hit_index* index;
+  const struct string_view* str;
+  int dx, dy;
+  int line_space;
+  size_t line; /* Index of the line of the last recorded glyph */
+  int has_line; /* The string has at least one line */
+};
+
+/* Begin the record of the string laid out from the pen position (x, y) */
+extern enum lp_error
+hit_index_begin_string
+  (struct lp_hit_index* index,
+   const struct string_view* str,
+   const int x,
+   const int y,
+   const int dx,
+   const int dy,
+   const int line_space,
+   struct hit_recorder* recorder);
+
+/* Layout callback that records the glyph. `data' is a struct hit_recorder */
+extern enum lp_error
+hit_index_record_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width);
+
+/* End the record with the pen position at the end of the string */
+extern void
+hit_index_end_string
+  (struct hit_recorder* recorder,
+   const int cur_x,
+   const int cur_y);
+
+#endif /* LP_HIT_INDEX_C_H */
+
@@ -0,0 +1,208 @@
+#include "lp_layout_cache_c.h"
+#include <sl/sl.h>
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <snlsys/snlsys.h>
+#include <string.h>
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+static FINLINE size_t
+sizeof_key_string(const struct layout_cache_key* key)
+{
+  ASSERT(key);
+  return key->len
+    * (key->encoding == STRING_WCHAR ? sizeof(wchar_t) : sizeof(char));
+}
+
+static FINLINE size_t
+sizeof_entry_data(const struct layout_cache_entry* entry)
+{
+  ASSERT(entry && entry->str);
+  return sizeof_key_string(&entry->key)
+    + entry->nb_glyphs * sizeof(struct layout_glyph);
+}
+
+static void
+clear_entry
+  (struct layout_cache* cache,
+   struct layout_cache_entry* entry)
+{
+  ASSERT(cache && entry);
+  if(!entry->str)
+    return;
+  cache->memory_size -= sizeof_entry_data(entry);
+  --cache->nb_used_entries;
+  MEM_FREE(cache->allocator, entry->str);
+  if(entry->glyph_list)
+    MEM_FREE(cache->allocator, entry->glyph_list);
+  memset(entry, 0, sizeof(struct layout_cache_entry));
+}
+
+static FINLINE int
+eq_key(const struct layout_cache_key* a, const struct layout_cache_key* b)
+{
+  ASSERT(a && b);
+  return a->hash == b->hash
+      && a->len == b->len
+      && a->encoding == b->encoding
+      && a->font_generation == b->font_generation
+      && a->line_width == b->line_width
+      && a->column == b->column;
+}
+
+/*******************************************************************************
+ *
+ * Layout cache functions
+ *
+ ******************************************************************************/
+void
+layout_cache_init(struct mem_allocator* allocator, struct layout_cache* cache)
+{
+  ASSERT(allocator && cache);
+  memset(cache, 0, sizeof(struct layout_cache));
+  cache->allocator = allocator;
+  scratch_init(allocator, &cache->run);
+}
+
+void
+layout_cache_release(struct layout_cache* cache)
+{
+  ASSERT(cache);
+  layout_cache_clear(cache);
+  if(cache->entry_list)
+    MEM_FREE(cache->allocator, cache->entry_list);
+  scratch_release(&cache->run);
+}
+
+void
+layout_cache_clear(struct layout_cache* cache)
+{
+  uint32_t i = 0;
+  ASSERT(cache);
+  for(i = 0; i < cache->nb_entries; ++i)
+    clear_entry(cache, cache->entry_list + i);
+  ASSERT(cache->nb_used_entries == 0 && cache->memory_size == 0);
+}
+
+enum lp_error
+layout_cache_resize(struct layout_cache* cache, const uint32_t nb_entries)
+{
+  struct layout_cache_entry* entry_list = NULL;
+  uint32_t nb = 0;
+  ASSERT(cache);
+
+  if(nb_entries) {
+    nb = 1;
+    while(nb < nb_entries)
+      nb *= 2;
+    entry_list = MEM_CALLOC
+      (cache->allocator, nb, sizeof(struct layout_cache_entry));
+    if(!entry_list)
+      return LP_MEMORY_ERROR;
+  }
+  layout_cache_clear(cache);
+  if(cache->entry_list)
+    MEM_FREE(cache->allocator, cache->entry_list);
+  cache->entry_list = entry_list;
+  cache->nb_entries = nb;
+  cache->nb_hits = 0;
+  cache->nb_misses = 0;
+  return LP_NO_ERROR;
+}
+
+size_t
+layout_cache_hash(const struct string_view* str)
+{
+  ASSERT(str);
+  return sl_hash(str->data, string_view_size(str));
+}
+
+struct layout_cache_entry*
+layout_cache_find
+  (struct layout_cache* cache,
+   const struct layout_cache_key* key,
+   const struct string_view* str)
+{
+  struct layout_cache_entry* entry = NULL;
+  ASSERT(cache && cache->nb_entries && key && str);
+  ASSERT(key->len == str->len && key->encoding == str->encoding);
+
+  entry = cache->entry_list + (key->hash & (cache->nb_entries - 1));
+  if(entry->str
+  && eq_key(&entry->key, key)
+  && !memcmp(entry->str, str->data, string_view_size(str))) {
+    ++cache->nb_hits;
+    return entry;
+  }
+  ++cache->nb_misses;
+  return NULL;
+}
+
+enum lp_error
+layout_cache_insert
+  (struct layout_cache* cache,
+   const struct layout_cache_key* key,
+   const struct string_view* str,
+   const int end_dx,
+   const int end_dy)
+{
+  struct layout_cache_entry* entry = NULL;
+  void* dst_str = NULL;
+  struct layout_glyph* dst_glyphs = NULL;
+  const size_t run_size = cache->run.id;
+  const size_t str_size = string_view_size(str);
+  ASSERT(cache && cache->nb_entries && key && str);
+  ASSERT(key->len == str->len && key->encoding == str->encoding);
+  ASSERT(run_size % sizeof(struct layout_glyph) == 0);
+
+  /* Allocate at least one byte to flag the entry as used */
+  dst_str = MEM_ALLOC(cache->allocator, MAX(str_size, 1));
+  if(!dst_str)
+    goto error;
+  if(str_size)
+    memcpy(dst_str, str->data, str_size);
+  if(run_size) {
+    dst_glyphs = MEM_ALLOC(cache->allocator, run_size);
+    if(!dst_glyphs)
+      goto error;
+    memcpy(dst_glyphs, scratch_buffer(&cache->run), run_size);
+  }
+
+  entry = cache->entry_list + (key->hash & (cache->nb_entries - 1));
+  clear_entry(cache, entry);
+  entry->key = *key;
+  entry->str = dst_str;
+  entry->glyph_list = dst_glyphs;
+  entry->nb_glyphs = (uint32_t)(run_size / sizeof(struct layout_glyph));
+  entry->end_dx = end_dx;
+  entry->end_dy = end_dy;
+  cache->memory_size += sizeof_entry_data(entry);
+  ++cache->nb_used_entries;
+  return LP_NO_ERROR;
+
+error:
+  if(dst_str)
+    MEM_FREE(cache->allocator, dst_str);
+  if(dst_glyphs)
+    MEM_FREE(cache->allocator, dst_glyphs);
+  return LP_MEMORY_ERROR;
+}
+
+void
+layout_cache_get_stats
+  (const struct layout_cache* cache,
+   struct lp_printer_cache_stats* stats)
+{
+  ASSERT(cache && stats);
+  stats->nb_hits = cache->nb_hits;
+  stats->nb_misses = cache->nb_misses;
+  stats->nb_entries = cache->nb_used_entries;
+  stats->nb_max_entries = cache->nb_entries;
+  stats->memory_size = cache->memory_size
+    + cache->nb_entries * sizeof(struct layout_cache_entry);
+}
+
@@ -0,0 +1,97 @@
+#ifndef LP_LAYOUT_CACHE_C_H
+#define LP_LAYOUT_CACHE_C_H
+
+#include "lp_font.h"
+#include "lp_printer.h"
+#include "lp_scratch_c.h"
+#include "lp_string_c.h"
+#include <stdint.h>
+
+struct mem_allocator;
+
+/* Glyph positioned relatively to the origin of its laid out string */
+struct layout_glyph {
+  size_t id; /* Index of the glyph character in the string */
+  int dx, dy; /* Pen position */
+  int width; /* Advance */
+  struct lp_font_glyph glyph;
+};
+
+struct layout_cache_key {
+  size_t hash; /* Hash of the string content */
+  size_t len; /* String length in code units */
+  enum string_encoding encoding;
+  uint32_t font_generation;
+  int line_width;
+  int column; /* Starting column relatively to the line origin */
+};
+
+struct layout_cache_entry {
+  struct layout_cache_key key;
+  void* str; /* Copy of the string code units. NULL <=> unused entry */
+  struct layout_glyph* glyph_list;
+  uint32_t nb_glyphs;
+  int end_dx, end_dy; /* Pen position at the end of the string */
+};
+
+/* Direct mapped cache of laid out glyph runs. An entry is replaced by the
+ * last inserted run whose key maps onto it. */
+struct layout_cache {
+  struct mem_allocator* allocator;
+  struct layout_cache_entry* entry_list;
+  uint32_t nb_entries; /* Power of 2. 0 <=> disabled cache */
+  struct scratch run; /* List of struct layout_glyph of the run to insert */
+
+  size_t nb_hits;
+  size_t nb_misses;
+  size_t nb_used_entries;
+  size_t memory_size;
+};
+
+extern void
+layout_cache_init
+  (struct mem_allocator* allocator,
+   struct layout_cache* cache);
+
+extern void
+layout_cache_release
+  (struct layout_cache* cache);
+
+/* Remove the cached runs. The statistics are preserved */
+extern void
+layout_cache_clear
+  (struct layout_cache* cache);
+
+/* The number of entries is rounded up to the next power of 2 */
+extern enum lp_error
+layout_cache_resize
+  (struct layout_cache* cache,
+   const uint32_t nb_entries);
+
+extern size_t
+layout_cache_hash
+  (const struct string_view* str);
+
+/* Return NULL if the string run is not cached. Update the hit statistics */
+extern struct layout_cache_entry*
+layout_cache_find
+  (struct layout_cache* cache,
+   const struct layout_cache_key* key,
+   const struct string_view* str);
+
+/* Cache the run currently stored in `cache->run' */
+extern enum lp_error
+layout_cache_insert
+  (struct layout_cache* cache,
+   const struct layout_cache_key* key,
+   const struct string_view* str,
+   const int end_dx,
+   const int end_dy);
+
+extern void
+layout_cache_get_stats
+  (const struct layout_cache* cache,
+   struct lp_printer_cache_stats* stats);
+
+#endif /* LP_LAYOUT_CACHE_C_H */
+
@@ -1,337 +1,306 @@
+/* clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+#include "lp_ansi_c.h"
 #include "lp_c.h"
+#include "lp_document.h"
+#include "lp_document_c.h"
 #include "lp_font.h"
+#include "lp_grid.h"
+#include "lp_grid_c.h"
+#include "lp_hit_index.h"
+#include "lp_hit_index_c.h"
 #include "lp_printer.h"
+#include "lp_printer_c.h"
+#include "lp_recorder.h"
+#include "lp_recorder_c.h"
+#include "lp_rsrc_c.h"
+#include "lp_scrollback.h"
+#include "lp_scrollback_c.h"
+#include "lp_text_c.h"
+#include "lp_trace_c.h"
 #include <rb/rbi.h>
 #include <snlsys/snlsys.h>
 #include <snlsys/math.h>
 #include <snlsys/mem_allocator.h>
-#include <float.h>
 #include <limits.h>
+#include <stdio.h>
 #include <string.h>
-
-#define LP_SIZEOF_GLYPH_VERTEX ((3/*pos*/ + 2/*tex*/ + 3/*col*/)*sizeof(float))
-#define LP_GLYPH_ATTRIB_POSITION_ID 0
-#define LP_GLYPH_ATTRIB_TEXCOORD_ID 1
-#define LP_GLYPH_ATTRIB_COLOR_ID 2
-#define LP_GLYPH_ATTRIBS_COUNT 3
-#define LP_GLYPH_VERTICES_COUNT 4
-#define LP_GLYPH_INDICES_COUNT 6
-#define LP_GLYPH_COUNT_MAX 4096 /* Count of buffered glyphes */
-
-#define LP_TAB_SPACES_COUNT 4 /* This may be a configurable parameter */
-
-/* Minimal scratch data structure */
-struct scratch {
-  struct mem_allocator* allocator;
-  void* buffer;
-  size_t size;
-  size_t id;
-};
-
-/* Window coordinate of the printable zone */
-struct viewport {
-  int x0, y0, x1, y1;
-};
-
-struct lp_printer {
-  struct ref ref;
-  struct scratch scratch;
-  struct viewport viewport;
-  struct lp* lp;
-
-  struct lp_font* font;
-  lp_font_callback_T on_font_data_update;
-
-  struct rb_buffer_attrib glyph_attrib_list[LP_GLYPH_ATTRIBS_COUNT];
-  struct rb_buffer* glyph_vertex_buffer;
-  struct rb_buffer* glyph_index_buffer;
-
-  struct rb_vertex_array* vertex_array;
-  struct rb_shader* vertex_shader;
-  struct rb_shader* fragment_shader;
-  struct rb_program* shading_program;
-  struct rb_sampler* sampler;
-  struct rb_uniform* uniform_sampler;
-  struct rb_uniform* uniform_scale;
-  struct rb_uniform* uniform_bias;
-
-  uint32_t max_nb_glyphs; /* Maximum number glyphs that the printer can draw */
-  uint32_t nb_glyphs; /* Number of glyphs printed but not flushed */
-};
-
-/*******************************************************************************
- *
- * Embedded shader sources
- *
- ******************************************************************************/
-static const char* print_vs_src =
-  "#version 330\n"
-  "layout(location =" STR(LP_GLYPH_ATTRIB_POSITION_ID) ") in vec3 pos;\n"
-  "layout(location =" STR(LP_GLYPH_ATTRIB_TEXCOORD_ID) ") in vec2 tex;\n"
-  "layout(location =" STR(LP_GLYPH_ATTRIB_COLOR_ID) ") in vec3 col;\n"
-  "uniform vec3 scale;\n"
-  "uniform vec3 bias;\n"
-  "smooth out vec2 glyph_tex;\n"
-  "flat   out vec3 glyph_col;\n"
-  "void main()\n"
-  "{\n"
-  "  glyph_tex = tex;\n"
-  "  glyph_col = col;\n"
-  "  gl_Position = vec4(pos * scale + bias, 1.f);\n"
-  "}\n";
-
-static const char* print_fs_src =
-  "#version 330\n"
-  "uniform sampler2D glyph_cache;\n"
-  "smooth in vec2 glyph_tex;\n"
-  "flat   in vec3 glyph_col;\n"
-  "out vec4 color;\n"
-  "void main()\n"
-  "{\n"
-  "  float val = texture(glyph_cache, glyph_tex).r;\n"
-  "  color = vec4(val * glyph_col, val);\n"
-  "}\n";
+#include <time.h>
 
 /*******************************************************************************
  *
- * Minimal implementation of a growable scratch buffer
+ * Helper functions
  *
  ******************************************************************************/
-static void
-scratch_init(struct mem_allocator* allocator, struct scratch* scratch)
+/* Monotonic time in ms */
+static FINLINE double
+time_ms(void)
 {
-  ASSERT(allocator && scratch);
-  memset(scratch, 0, sizeof(struct scratch));
-  scratch->allocator = allocator;
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec * 1.0e3 + (double)t.tv_nsec * 1.0e-6;
 }
 
-static enum lp_error
-scratch_reserve(struct scratch* scratch, size_t size)
+static void
+printer_storage_release(struct lp_printer* printer)
 {
-  enum lp_error lp_err = LP_NO_ERROR;
-  ASSERT(scratch && scratch->allocator);
-
-  if(size <= scratch->size)
-    return LP_NO_ERROR;
+  uint32_t i = 0;
+  ASSERT(printer);
 
-  if(scratch->buffer) {
-    scratch->buffer = MEM_REALLOC(scratch->allocator, scratch->buffer, size);
-  } else {
-    scratch->buffer = MEM_ALIGNED_ALLOC(scratch->allocator, size, 16);
-    memset(scratch->buffer, 0, size);
+  if(printer->segment_list) {
+    for(i = 0; i < printer->nb_segments; ++i) {
+      struct segment* seg = printer->segment_list + i;
+      if(seg->vertex_buffer)
+        RBI(printer->lp->rbi, buffer_ref_put(seg->vertex_buffer));
+      if(seg->record_tex)
+        RBI(printer->lp->rbi, tex2d_ref_put(seg->record_tex));
+      if(seg->vertex_array)
+        RBI(printer->lp->rbi, vertex_array_ref_put(seg->vertex_array));
+    }
+    MEM_FREE(printer->lp->allocator, printer->segment_list);
+    printer->segment_list = NULL;
   }
-  if(!scratch->buffer) {
-    lp_err = LP_MEMORY_ERROR;
-    goto error;
+  if(printer->glyph_index_buffer) {
+    RBI(printer->lp->rbi, buffer_ref_put(printer->glyph_index_buffer));
+    printer->glyph_index_buffer = NULL;
   }
-  scratch->size = size;
+  printer->segment_id = 0;
+}
 
-exit:
-  return lp_err;
-error:
-  if(scratch->buffer) {
-    MEM_FREE(scratch->allocator, scratch->buffer);
-    scratch->buffer = NULL;
+/* Size in bytes of the scratch/GPU data of `nb_glyphs' with respect to the
+ * glyph format */
+static size_t
+glyph_storage_size
+  (const enum lp_printer_glyph_format format,
+   const uint32_t nb_glyphs)
+{
+  size_t size = 0;
+  switch(format) {
+    case LP_PRINTER_GLYPH_RECORD:
+      size = glyph_records_size(nb_glyphs);
+      break;
+    case LP_PRINTER_GLYPH_VERTICES:
+      size = nb_glyphs * LP_GLYPH_VERTICES_COUNT * LP_SIZEOF_GLYPH_VERTEX;
+      break;
+    default: ASSERT(0); break;
   }
-  scratch->size = 0;
-  scratch->id = 0;
-  goto exit;
+  return size;
 }
 
-static void
-scratch_release(struct scratch* scratch)
+/* 64 bits hash of the glyph data, read by 8 bytes words */
+static uint64_t
+fingerprint(const void* data, const size_t size)
 {
-  ASSERT(scratch && scratch->allocator);
-  MEM_FREE(scratch->allocator, scratch->buffer);
+  const unsigned char* bytes = data;
+  uint64_t hash = 0xCBF29CE484222325ULL ^ (uint64_t)size;
+  size_t i = 0;
+  ASSERT(data || !size);
+
+  for(i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(uint64_t));
+    hash ^= word * 0x9E3779B97F4A7C15ULL;
+    hash = ((hash << 31) | (hash >> 33)) * 0xBF58476D1CE4E5B9ULL;
+  }
+  for(; i < size; ++i)
+    hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+  /* Final avalanche */
+  hash ^= hash >> 32;
+  hash *= 0x94D049BB133111EBULL;
+  hash ^= hash >> 29;
+  return hash;
 }
 
-static FINLINE void
-scratch_clear(struct scratch* scratch)
+/* Point the vertex attribs of the segment to its glyph `first_glyph', from
+ * which the LP_PRINTER_GLYPH_VERTICES format is drawn. Only the offsets of
+ * the attribs move; the backend has no call to set them alone, hence the
+ * attribs are set again */
+static void
+segment_set_first_glyph
+  (struct lp_printer* printer,
+   struct segment* seg,
+   const uint32_t first_glyph)
 {
-  ASSERT(scratch);
-  scratch->id = 0;
+  const int glyph_size =
+    (int)(LP_GLYPH_VERTICES_COUNT * LP_SIZEOF_GLYPH_VERTEX);
+  const int delta = ((int)first_glyph - (int)seg->first_glyph) * glyph_size;
+  int i = 0;
+  ASSERT(printer && seg && seg->vertex_buffer);
+
+  if(!delta)
+    return;
+  for(i = 0; i < LP_GLYPH_ATTRIBS_COUNT; ++i)
+    seg->attrib_list[i].offset += delta;
+  RBI(printer->lp->rbi, vertex_attrib_array
+    (seg->vertex_array, seg->vertex_buffer, LP_GLYPH_ATTRIBS_COUNT,
+     seg->attrib_list));
+  seg->first_glyph = first_glyph;
 }
 
-static FINLINE void*
-scratch_buffer(struct scratch* scratch)
+/* Ensure that the record texture of the segment has the rows of `nb_glyphs'
+ * records. Its whole level is uploaded at once, hence the texture is sized to
+ * the flushed glyphs rather than to the storage capacity. The number of rows
+ * is rounded up to a power of two in order not to create a texture at each
+ * flush of a slightly different number of glyphs */
+static void
+segment_setup_record_tex
+  (struct lp_printer* printer,
+   struct segment* seg,
+   const uint32_t nb_glyphs)
 {
-  ASSERT(scratch);
-  return scratch->buffer;
+  struct rb_tex2d_desc tex2d_desc;
+  const uint32_t max_nb_rows = (uint32_t)
+    (glyph_records_size(printer->max_nb_glyphs) / LP_SIZEOF_GLYPH_RECORD_ROW);
+  uint32_t nb_rows = 1;
+  ASSERT(printer && seg && nb_glyphs <= printer->max_nb_glyphs);
+
+  while(nb_rows * LP_GLYPH_RECORDS_PER_ROW < nb_glyphs)
+    nb_rows *= 2;
+  nb_rows = MIN(nb_rows, max_nb_rows);
+  if(seg->record_tex && seg->nb_record_rows == nb_rows)
+    return;
+
+  if(seg->record_tex)
+    RBI(printer->lp->rbi, tex2d_ref_put(seg->record_tex));
+  memset(&tex2d_desc, 0, sizeof(tex2d_desc));
+  tex2d_desc.width = LP_GLYPH_RECORDS_PER_ROW * LP_GLYPH_RECORD_TEXELS_COUNT;
+  tex2d_desc.height = nb_rows;
+  tex2d_desc.mip_count = 1;
+  tex2d_desc.format = RB_RGBA;
+  tex2d_desc.usage = RB_USAGE_DYNAMIC;
+  tex2d_desc.compress = 0;
+  RBI(printer->lp->rbi, create_tex2d
+    (printer->lp->rb_ctxt, &tex2d_desc, NULL, &seg->record_tex));
+  seg->nb_record_rows = nb_rows;
 }
 
+/* (Re)create the ring of `nb_segments' vertex buffers, each one storing up to
+ * `max_nb_glyphs' glyphs. The scratch is not used to build the index buffer,
+ * i.e. the printed but not flushed glyphs are preserved. */
 static enum lp_error
-scratch_push_back(struct scratch* scratch, const void* data, size_t size)
+printer_storage
+  (struct lp_printer* printer,
+   const uint32_t nb_segments,
+   const uint32_t max_nb_glyphs)
 {
+  struct rb_buffer_desc buffer_desc;
+  size_t vbufsiz = 0;
+  uint32_t i = 0;
   enum lp_error lp_err = LP_NO_ERROR;
-  ASSERT(scratch && data);
+  ASSERT(printer && nb_segments);
 
-  if(scratch->id + size > scratch->size) {
-    lp_err = scratch_reserve(scratch, scratch->id + size);
-    if(lp_err != LP_NO_ERROR)
-      return lp_err;
+  printer_storage_release(printer);
+  printer->nb_segments = nb_segments;
+  printer->max_nb_glyphs = max_nb_glyphs;
+  if(max_nb_glyphs == 0)
+    goto exit;
+
+  vbufsiz = glyph_storage_size(printer->glyph_format, max_nb_glyphs);
+
+  /* Get the immutable index buffer shared by all the segments and the other
+   * printers of the lp */
+  lp_err = rsrc_get_glyph_index_buffer
+    (printer->rsrc, max_nb_glyphs, &printer->glyph_index_buffer);
+  if(lp_err != LP_NO_ERROR)
+    goto error;
+
+  /* Create the ring of vertex buffers or record textures. Their data are
+   * going to be filled by the flush function with respect to the printed
+   * glyphs. */
+  printer->segment_list = MEM_CALLOC
+    (printer->lp->allocator, nb_segments, sizeof(struct segment));
+  if(!printer->segment_list) {
+    lp_err = LP_MEMORY_ERROR;
+    goto error;
+  }
+  for(i = 0; i < nb_segments; ++i) {
+    struct segment* seg = printer->segment_list + i;
+
+    RBI(printer->lp->rbi, create_vertex_array
+      (printer->lp->rb_ctxt, &seg->vertex_array));
+    /* The record textures are sized on upload with respect to the flushed
+     * glyphs */
+    if(printer->glyph_format == LP_PRINTER_GLYPH_VERTICES) {
+      buffer_desc.size = vbufsiz;
+      buffer_desc.target = RB_BIND_VERTEX_BUFFER;
+      buffer_desc.usage = RB_USAGE_DYNAMIC;
+      RBI(printer->lp->rbi, create_buffer
+        (printer->lp->rb_ctxt, &buffer_desc, NULL, &seg->vertex_buffer));
+      memcpy(seg->attrib_list, printer->rsrc->glyph_attrib_list,
+        sizeof(seg->attrib_list));
+      RBI(printer->lp->rbi, vertex_attrib_array
+        (seg->vertex_array, seg->vertex_buffer,
+         LP_GLYPH_ATTRIBS_COUNT, seg->attrib_list));
+    }
+    RBI(printer->lp->rbi, vertex_index_array
+      (seg->vertex_array, printer->glyph_index_buffer));
   }
-  memcpy((void*)((uintptr_t)scratch->buffer + scratch->id), data, size);
-  scratch->id += size;
-  return LP_NO_ERROR;
-}
 
-/*******************************************************************************
- *
- * Helper functions
- *
- ******************************************************************************/
-static void
-printer_rb_init(struct lp_printer* printer)
-{
-  ASSERT(printer);
-  struct rb_sampler_desc sampler_desc;
-  struct rbi* rbi = printer->lp->rbi;
-  struct rb_context* ctxt = printer->lp->rb_ctxt;
-
-  #define REGISTER_ATTRIB(Id, Index, Type, Offset )                            \
-    {                                                                          \
-      printer->glyph_attrib_list[Id].index = Index;                            \
-      printer->glyph_attrib_list[Id].stride = LP_SIZEOF_GLYPH_VERTEX;          \
-      printer->glyph_attrib_list[Id].offset = Offset;                          \
-      printer->glyph_attrib_list[Id].type = Type;                              \
-    } (void)0
-  REGISTER_ATTRIB(0, LP_GLYPH_ATTRIB_POSITION_ID, RB_FLOAT3, 0 * sizeof(float));
-  REGISTER_ATTRIB(1, LP_GLYPH_ATTRIB_TEXCOORD_ID, RB_FLOAT2, 3 * sizeof(float));
-  REGISTER_ATTRIB(2, LP_GLYPH_ATTRIB_COLOR_ID,    RB_FLOAT3, 5 * sizeof(float));
-  #undef REGISTER_ATTRIB
-
-  RBI(rbi, create_vertex_array(ctxt, &printer->vertex_array));
-
-  /* Sampler */
-  sampler_desc.filter = RB_MIN_POINT_MAG_POINT_MIP_POINT;
-  sampler_desc.address_u = RB_ADDRESS_CLAMP;
-  sampler_desc.address_v = RB_ADDRESS_CLAMP;
-  sampler_desc.address_w = RB_ADDRESS_CLAMP;
-  sampler_desc.lod_bias = 0;
-  sampler_desc.min_lod = -FLT_MAX;
-  sampler_desc.max_lod = FLT_MAX;
-  sampler_desc.max_anisotropy = 1;
-  RBI(rbi, create_sampler(ctxt, &sampler_desc, &printer->sampler));
-
-  /* Shaders */
-  RBI(rbi, create_shader
-    (ctxt, RB_VERTEX_SHADER, print_vs_src, strlen(print_vs_src),
-     &printer->vertex_shader));
-  RBI(rbi, create_shader
-    (ctxt, RB_FRAGMENT_SHADER, print_fs_src, strlen(print_fs_src),
-     &printer->fragment_shader));
-
-  /* Shading program */
-  RBI(rbi, create_program(ctxt, &printer->shading_program));
-  RBI(rbi, attach_shader(printer->shading_program, printer->vertex_shader));
-  RBI(rbi, attach_shader(printer->shading_program, printer->fragment_shader));
-  RBI(rbi, link_program(printer->shading_program));
-
-  /* Uniforms */
-  RBI(rbi, get_named_uniform
-    (ctxt, printer->shading_program, "glyph_cache", &printer->uniform_sampler));
-  RBI(rbi, get_named_uniform
-    (ctxt, printer->shading_program, "scale", &printer->uniform_scale));
-  RBI(rbi, get_named_uniform
-    (ctxt, printer->shading_program, "bias", &printer->uniform_bias));
+  /* Pre-allocate the scratch in which the glyph vertices are written */
+  lp_err = scratch_reserve(&printer->scratch, vbufsiz);
+  if(lp_err != LP_NO_ERROR)
+    goto error;
+
+exit:
+  return lp_err;
+error:
+  /* Release the partially created storage. The printer keeps its storage
+   * parameters and the storage is created anew by the next flush */
+  printer_storage_release(printer);
+  goto exit;
 }
 
-static void
-printer_rb_shutdown(struct lp_printer* printer)
+/* Reserve the scratch memory of `nb_glyphs' further glyphs at once rather than
+ * growing it glyph per glyph. The reservation is bounded by the number of
+ * glyphs that can be pending before a forced flush */
+static enum lp_error
+printer_reserve_glyphs(struct lp_printer* printer, const size_t nb_glyphs)
 {
-  ASSERT(printer);
-  struct rbi* rbi = printer->lp->rbi;
-
-  #define REF_PUT(Type, Data) if(Data) RBI(rbi, Type ## _ref_put(Data))
-  REF_PUT(buffer, printer->glyph_vertex_buffer);
-  REF_PUT(buffer, printer->glyph_index_buffer);
-  REF_PUT(vertex_array, printer->vertex_array);
-  REF_PUT(shader, printer->vertex_shader);
-  REF_PUT(shader, printer->fragment_shader);
-  REF_PUT(program, printer->shading_program);
-  REF_PUT(sampler, printer->sampler);
-  REF_PUT(uniform, printer->uniform_sampler);
-  REF_PUT(uniform, printer->uniform_scale);
-  REF_PUT(uniform, printer->uniform_bias);
-  #undef REF_PUT
+  size_t nb = 0;
+  ASSERT(printer && printer->nb_glyphs <= LP_GLYPH_COUNT_MAX);
+  nb = MIN(nb_glyphs, (size_t)(LP_GLYPH_COUNT_MAX - printer->nb_glyphs));
+  return scratch_grow(&printer->scratch, nb*sizeof_glyph(printer->glyph_format));
 }
 
-static void
-printer_storage(struct lp_printer* printer, const uint32_t max_nb_glyphs)
+/* Write the glyph of pen position (x, y) in place into the scratch with
+ * respect to the printer glyph format */
+static FINLINE enum lp_error
+printer_push_glyph
+  (struct lp_printer* printer,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const struct glyph_color* color)
 {
-  ASSERT(printer);
-
-  if(printer->glyph_vertex_buffer) {
-    RBI(printer->lp->rbi, buffer_ref_put(printer->glyph_vertex_buffer));
-    printer->glyph_vertex_buffer = NULL;
-  }
-  if(printer->glyph_index_buffer) {
-    RBI(printer->lp->rbi, buffer_ref_put(printer->glyph_index_buffer));
-    printer->glyph_index_buffer = NULL;
-  }
+  void* dst = NULL;
+  ASSERT(printer && glyph && color);
 
-  printer->nb_glyphs = 0;
-  printer->max_nb_glyphs = max_nb_glyphs;
-  if(max_nb_glyphs == 0) {
-    const int attr_id_list[LP_GLYPH_ATTRIBS_COUNT] = {
-      [0] = LP_GLYPH_ATTRIB_POSITION_ID,
-      [1] = LP_GLYPH_ATTRIB_TEXCOORD_ID,
-      [2] = LP_GLYPH_ATTRIB_COLOR_ID
-    };
-    STATIC_ASSERT(LP_GLYPH_ATTRIBS_COUNT == 3, Unexpected_constant);
-    RBI(printer->lp->rbi, remove_vertex_attrib
-      (printer->vertex_array, LP_GLYPH_ATTRIBS_COUNT, attr_id_list));
+  dst = scratch_alloc(&printer->scratch, sizeof_glyph(printer->glyph_format));
+  if(!dst)
+    return LP_MEMORY_ERROR;
+  if(printer->glyph_format == LP_PRINTER_GLYPH_RECORD) {
+    glyph_record_write(dst, glyph, x, y, color);
   } else {
-    struct rb_buffer_desc buffer_desc;
-    const size_t vbufsiz =
-      max_nb_glyphs * LP_GLYPH_VERTICES_COUNT * LP_SIZEOF_GLYPH_VERTEX;
-    const size_t ibufsiz =
-      max_nb_glyphs * LP_GLYPH_INDICES_COUNT * sizeof(unsigned int);
-    unsigned int i = 0;
-
-    /* Create the vertex buffer. The vertex buffer data are going to be filled
-     * by the draw function with respect to the printed terminal lines. */
-    buffer_desc.size = vbufsiz;
-    buffer_desc.target = RB_BIND_VERTEX_BUFFER;
-    buffer_desc.usage = RB_USAGE_DYNAMIC;
-    RBI(printer->lp->rbi, create_buffer
-      (printer->lp->rb_ctxt, &buffer_desc, NULL,
-       &printer->glyph_vertex_buffer));
-
-    /* Create the immutable index buffer. Its internal data are the indices of
-     * the ordered glyphs of the vertex buffer. */
-    LP_CALL(scratch_reserve(&printer->scratch, MAX(vbufsiz, ibufsiz)));
-    scratch_clear(&printer->scratch);
-    for(i = 0; i < max_nb_glyphs; ++i) {
-      const unsigned id_first = i * LP_GLYPH_VERTICES_COUNT;
-      const unsigned int indices[LP_GLYPH_INDICES_COUNT] = {
-        0+id_first, 1+id_first, 3+id_first, 3+id_first, 1+id_first, 2+id_first
-      };
-      scratch_push_back(&printer->scratch, indices, sizeof(indices));
-    }
-    buffer_desc.size = vbufsiz;
-    buffer_desc.target = RB_BIND_INDEX_BUFFER;
-    buffer_desc.usage = RB_USAGE_IMMUTABLE;
-    RBI(printer->lp->rbi, create_buffer
-      (printer->lp->rb_ctxt, &buffer_desc, scratch_buffer(&printer->scratch),
-       &printer->glyph_index_buffer));
-
-    /* Setup the vertex array */
-    RBI(printer->lp->rbi, vertex_attrib_array
-      (printer->vertex_array, printer->glyph_vertex_buffer,
-       LP_GLYPH_ATTRIBS_COUNT, printer->glyph_attrib_list));
-    RBI(printer->lp->rbi, vertex_index_array
-      (printer->vertex_array, printer->glyph_index_buffer));
+    glyph_vertices_write(dst, glyph, x, y, color);
   }
-  /* Clear the scratch for subsecquent uses */
-  scratch_clear(&printer->scratch);
+  return LP_NO_ERROR;
 }
 
-static void
+/* The pending glyphs reference their font run and are thus preserved */
+static enum lp_error
 setup_font(struct lp_printer* printer)
 {
   ASSERT(printer);
-  printer_storage(printer, LP_GLYPH_COUNT_MAX);
+  /* The cached glyph runs reference the previous font data */
+  ++printer->font_generation;
+  layout_cache_clear(&printer->cache);
+  /* The storage does not depend on the font. It is created with the first
+   * one */
+  if(printer->segment_list)
+    return LP_NO_ERROR;
+  return printer_storage
+    (printer, printer->nb_segments, MAX(printer->max_nb_glyphs, 1));
 }
 
 static void
@@ -340,312 +309,1994 @@ on_font_data_update(struct lp_font* font, void* data)
   (void)font;
   struct lp_printer* printer = data;
   ASSERT(font && data && printer->font == font);
-  setup_font(printer);
+  LP_CALL(setup_font(printer));
 }
 
 static void
-release_printer(struct ref* ref)
+on_bold_font_data_update(struct lp_font* font, void* data)
 {
-  struct lp* lp = NULL;
-  struct lp_printer* printer = NULL;
-  ASSERT(NULL != ref);
+  (void)font;
+  struct lp_printer* printer = data;
+  ASSERT(font && data && printer->bold_font == font);
+  /* The wrapped ANSI strings may change */
+  ++printer->font_generation;
+}
 
-  printer = CONTAINER_OF(ref, struct lp_printer, ref);
+/* Release the references onto the submitted recorders */
+static void
+clear_recorder_queue(struct lp_printer* printer)
+{
+  struct lp_recorder** queue = NULL;
+  size_t nb_recorders = 0;
+  size_t i = 0;
+  ASSERT(printer);
 
-  printer_rb_shutdown(printer);
-  CALLBACK_DISCONNECT(&printer->on_font_data_update);
-  scratch_release(&printer->scratch);
-  if(printer->font)
-    LP(font_ref_put(printer->font));
-  lp = printer->lp;
-  MEM_FREE(lp->allocator, printer);
-  LP(ref_put(lp));
+  queue = scratch_buffer(&printer->recorder_queue);
+  nb_recorders = printer->recorder_queue.id / sizeof(struct lp_recorder*);
+  for(i = 0; i < nb_recorders; ++i)
+    LP(recorder_ref_put(queue[i]));
+  scratch_clear(&printer->recorder_queue);
 }
 
-/*******************************************************************************
- *
- * lp_printer functions
- *
- ******************************************************************************/
-enum lp_error
-lp_printer_create(struct lp* lp, struct lp_printer** out_printer)
+/* Release the references onto the queued retained texts */
+static void
+clear_text_queue(struct lp_printer* printer)
 {
-  struct lp_printer* printer = NULL;
+  struct text_draw* queue = NULL;
+  size_t nb_texts = 0;
+  size_t i = 0;
+  ASSERT(printer);
 
-  if(UNLIKELY(!lp || !out_printer))
-    return LP_INVALID_ARGUMENT;
+  queue = scratch_buffer(&printer->text_queue);
+  nb_texts = printer->text_queue.id / sizeof(struct text_draw);
+  for(i = 0; i < nb_texts; ++i)
+    LP(text_ref_put(queue[i].text));
+  scratch_clear(&printer->text_queue);
+}
 
-  printer = MEM_CALLOC(lp->allocator, 1, sizeof(struct lp_printer));
-  if(UNLIKELY(!printer))
-    return LP_MEMORY_ERROR;
+static void
+clear_grid_queue(struct lp_printer* printer)
+{
+  struct grid_draw* queue = NULL;
+  size_t nb_grids = 0;
+  size_t i = 0;
+  ASSERT(printer);
 
-  ref_init(&printer->ref);
-  printer->lp = lp;
-  LP(ref_get(lp));
-  printer_rb_init(printer);
-  CALLBACK_INIT(&printer->on_font_data_update);
-  CALLBACK_SETUP(&printer->on_font_data_update, on_font_data_update, printer);
-  scratch_init(lp->allocator, &printer->scratch);
-  *out_printer = printer;
+  queue = scratch_buffer(&printer->grid_queue);
+  nb_grids = printer->grid_queue.id / sizeof(struct grid_draw);
+  for(i = 0; i < nb_grids; ++i)
+    LP(grid_ref_put(queue[i].grid));
+  scratch_clear(&printer->grid_queue);
+}
 
-  return LP_NO_ERROR;
+/* Setup `ansi' for a print in `color' if the ANSI mode of the printer is
+ * enabled. Return NULL otherwise */
+static struct ansi_state*
+printer_ansi_state
+  (const struct lp_printer* printer,
+   const float color[3],
+   struct ansi_state* ansi)
+{
+  ASSERT(printer && printer->font && color && ansi);
+  if(!printer->is_ansi)
+    return NULL;
+  ansi_state_init(ansi, color, printer->font, printer->bold_font);
+  return ansi;
 }
 
-enum lp_error
-lp_printer_ref_get(struct lp_printer* printer)
+static void
+font_run_setup
+  (struct lp_printer* printer,
+   struct font_run* run,
+   struct lp_font* font,
+   struct rb_tex2d* tex)
 {
-  if(UNLIKELY(!printer))
-    return LP_INVALID_ARGUMENT;
-  ref_get(&printer->ref);
-  return LP_NO_ERROR;
+  ASSERT(printer && run && font);
+  LP(font_ref_get(font));
+  if(tex)
+    RBI(printer->lp->rbi, tex2d_ref_get(tex));
+  run->font = font;
+  run->tex = tex;
+  run->first_glyph = printer->nb_glyphs;
 }
 
-enum lp_error
-lp_printer_ref_put(struct lp_printer* printer)
+static void
+font_run_release(struct lp_printer* printer, struct font_run* run)
 {
-  if(UNLIKELY(!printer))
-    return LP_INVALID_ARGUMENT;
-  ref_put(&printer->ref, release_printer);
-  return LP_NO_ERROR;
+  ASSERT(printer && run && run->font);
+  if(run->tex)
+    RBI(printer->lp->rbi, tex2d_ref_put(run->tex));
+  LP(font_ref_put(run->font));
+  run->font = NULL;
+  run->tex = NULL;
 }
 
-enum lp_error
-lp_printer_set_font(struct lp_printer* printer, struct lp_font* font)
+/* Release the runs of the flushed or dropped glyphs. The next printed glyphs
+ * begin a new run */
+static void
+clear_font_runs(struct lp_printer* printer)
 {
-  if(UNLIKELY(!printer || !font))
-    return LP_INVALID_ARGUMENT;
+  struct font_run* runs = NULL;
+  size_t nb_runs = 0;
+  size_t i = 0;
+  ASSERT(printer);
 
-  if(font != printer->font) {
-    if(printer->font) {
-      LP(font_ref_put(printer->font));
-    }
-    LP(font_ref_get(font));
-    CALLBACK_DISCONNECT(&printer->on_font_data_update);
-    LP(font_signal_connect
-      (font, LP_FONT_SIGNAL_DATA_UPDATE, &printer->on_font_data_update));
-    printer->font = font;
+  runs = scratch_buffer(&printer->font_runs);
+  nb_runs = printer->font_runs.id / sizeof(struct font_run);
+  for(i = 0; i < nb_runs; ++i)
+    font_run_release(printer, runs + i);
+  scratch_clear(&printer->font_runs);
+}
 
-    setup_font(printer);
+/* Print the next glyphs with `font', the printer font or its bold font. The
+ * glyphs of other fonts remain pending: a flush draws each run of glyphs with
+ * the texture of its font */
+static enum lp_error
+printer_use_font(struct lp_printer* printer, struct lp_font* font)
+{
+  struct font_run* run = NULL;
+  struct rb_tex2d* tex = NULL;
+  size_t nb_runs = 0;
+  ASSERT(printer && font);
+  ASSERT(font == printer->font || font == printer->bold_font);
+
+  LP(font_get_texture(font, &tex));
+  nb_runs = printer->font_runs.id / sizeof(struct font_run);
+  if(nb_runs) {
+    run = (struct font_run*)scratch_buffer(&printer->font_runs) + nb_runs - 1;
+    if(run->font == font && run->tex == tex)
+      return LP_NO_ERROR;
+    if(run->first_glyph == printer->nb_glyphs) { /* Empty run */
+      font_run_release(printer, run);
+      font_run_setup(printer, run, font, tex);
+      return LP_NO_ERROR;
+    }
   }
+  run = scratch_alloc(&printer->font_runs, sizeof(struct font_run));
+  if(!run)
+    return LP_MEMORY_ERROR;
+  font_run_setup(printer, run, font, tex);
   return LP_NO_ERROR;
 }
 
-enum lp_error
-lp_printer_set_viewport
-  (struct lp_printer* printer,
-   const int x,
-   const int y,
-   const int width,
-   const int height)
+/* Move the pen with respect to the ANSI cursor sequence `cursor' */
+static void
+ansi_move_pen
+  (struct lp_font* font,
+   const int line_space,
+   const struct viewport* wrap,
+   const enum ansi_cursor cursor,
+   const int count,
+   int* line_x,
+   int* line_y,
+   int* line_count)
 {
-  if(!printer || width < 0 || height < 0)
-    return LP_INVALID_ARGUMENT;
-
-  printer->viewport.x0 = x;
-  printer->viewport.y0 = y;
-  printer->viewport.x1 = x + width;
-  printer->viewport.y1 = y + height;
-  return LP_NO_ERROR;
+  struct lp_font_glyph glyph;
+  ASSERT(font && wrap && line_x && line_y && line_count);
+
+  /* The cells are the advance of the space glyph of the regular font */
+  LP(font_get_glyph(font, L' ', &glyph));
+  switch(cursor) {
+    case ANSI_CURSOR_UP:
+      *line_y += count * line_space;
+      break;
+    case ANSI_CURSOR_DOWN:
+      *line_y -= count * line_space;
+      *line_count += count;
+      break;
+    case ANSI_CURSOR_FORWARD:
+      *line_x = MIN(*line_x + count * glyph.width, wrap->x1);
+      break;
+    case ANSI_CURSOR_BACK:
+      *line_x = MAX(*line_x - count * glyph.width, wrap->x0);
+      break;
+    case ANSI_CURSOR_COLUMN:
+      *line_x = MIN(wrap->x0 + (count - 1) * glyph.width, wrap->x1);
+      break;
+    default: ASSERT(0); break;
+  }
 }
 
-enum lp_error
-lp_printer_print_wstring
-  (struct lp_printer* printer,
+/* Lay out the string with the `line_space' of `font'. If `ansi' is not NULL,
+ * the ANSI escape sequences are consumed and update it, and the glyphs are
+ * looked up in its current font. The glyphs out of `cull' are added to
+ * `nb_culled'. Refer to printer_layout_string */
+static enum lp_error
+layout_string
+  (struct lp_font* font,
+   const int line_space,
+   const struct viewport* wrap,
+   const struct viewport* cull,
    const int x,
    const int y,
-   const wchar_t* wstr,
-   const float color[3],
+   const struct string_view* str,
+   layout_glyph_T func,
+   void* data,
    int* cur_x,
-   int* cur_y)
+   int* cur_y,
+   int* nb_lines,
+   struct ansi_state* ansi,
+   size_t* nb_culled)
 {
-  if(!printer || !wstr || !color || !printer->font)
-    return LP_INVALID_ARGUMENT;
-  if(printer->viewport.x1 <= printer->viewport.x0
-  || printer->viewport.y1 <= printer->viewport.y0)  /* No printable zone */
-    return LP_INVALID_ARGUMENT;
-
-  struct lp_font_metrics font_metrics;
-  LP(font_get_metrics(printer->font, &font_metrics));
-
-  const int line_width = printer->viewport.x1 - printer->viewport.x0;
-  int line_width_remaining = MAX(printer->viewport.x1 - x, 0);
+  struct string_reader reader;
+  struct lp_font* glyph_font = font;
+  size_t id = 0;
+  wchar_t ch = 0;
+  /* The pen only moves downward. Once it leaves the bottom of the culling
+   * zone, the remaining characters only matter for the returned cursor */
+  const int stop_below = cull && !cur_x && !cur_y && !nb_lines && !ansi;
+  ASSERT(font && wrap && str && func);
+  ASSERT(!ansi || ansi->font == font);
+
+  const int line_width = wrap->x1 - wrap->x0;
+  int line_width_remaining = MAX(wrap->x1 - x, 0);
   int line_x = x;
   int line_y = y;
+  int line_count = 1;
 
-  size_t i = 0;
-  for(i = 0; wstr[i] != L'\0'; ++i) {
+  string_reader_init(&reader, str);
+  while(string_reader_next(&reader, &id, &ch)) {
     struct lp_font_glyph glyph;
     int glyph_width_adjusted = 0;
 
-    switch(wstr[i]) {
+    if(ansi) {
+      if(ch == ANSI_ESC) {
+        int count = 0;
+        const enum ansi_cursor cursor =
+          ansi_read_sequence(ansi, &reader, &count);
+        if(cursor != ANSI_CURSOR_NONE) {
+          ansi_move_pen
+            (font, line_space, wrap, cursor, count, &line_x, &line_y,
+             &line_count);
+          line_width_remaining = MAX(wrap->x1 - line_x, 0);
+        }
+        glyph_font = ansi_state_font(ansi);
+        continue;
+      } else if(ch == L'\r') { /* Carriage return */
+        line_width_remaining = line_width;
+        line_x = wrap->x0;
+        continue;
+      }
+    }
+
+    switch(ch) {
       case L'\t': /* Tabulation */
-        LP(font_get_glyph(printer->font, L' ', &glyph));
+        LP(font_get_glyph(glyph_font, L' ', &glyph));
         glyph_width_adjusted = glyph.width * LP_TAB_SPACES_COUNT;
         break;
       case L'\n': /* New line */
-        glyph_width_adjusted = INT_MAX;
-        break;
+        line_width_remaining = line_width;
+        line_x = wrap->x0;
+        line_y = line_y - line_space;
+        ++line_count;
+        continue;
       default: /* Common characters */
-        LP(font_get_glyph(printer->font, wstr[i], &glyph));
+        LP(font_get_glyph(glyph_font, ch, &glyph));
         glyph_width_adjusted = glyph.width;
         break;
     }
 
-    /* Update remaining width */
+    /* Update remaining width. It remains the width between the pen and the
+     * wrap border, even past a glyph wider than the line, in order to be
+     * carried by the pen position to the string printed next on the line,
+     * e.g. the next span */
     if(line_width_remaining >= glyph_width_adjusted) {
       line_width_remaining -= glyph_width_adjusted;
     } else { /* Wrap the line */
-      line_width_remaining = line_width;
-      line_x = printer->viewport.x0;
-      line_y = line_y - font_metrics.line_space;
-      if(glyph_width_adjusted > INT_MAX) { /* <=> New line */
-        continue;
-      } else if(line_width_remaining >= glyph_width_adjusted) {
-        line_width_remaining = MAX(line_width_remaining-glyph_width_adjusted,0);
-      }
+      line_width_remaining = MAX(line_width - glyph_width_adjusted, 0);
+      line_x = wrap->x0;
+      line_y = line_y - line_space;
+      ++line_count;
     }
 
-    /* The char lies inside the printable viewport */
-    if(line_x >= printer->viewport.x0
-    && line_y >= printer->viewport.y0
-    && line_x + glyph_width_adjusted <= printer->viewport.x1
-    && line_y + font_metrics.line_space <= printer->viewport.y1) {
-      const struct { float x, y; } glyph_pos_adjusted[2] = {
-        [0]={ glyph.pos[0].x + (float)line_x, glyph.pos[0].y + (float)line_y },
-        [1]={ glyph.pos[1].x + (float)line_x, glyph.pos[1].y + (float)line_y }
-      };
-
-      float vertex[LP_SIZEOF_GLYPH_VERTEX / sizeof(float)];
-      #define SET_POS(Dst, X, Y, Z) Dst[0] = (X), Dst[1] = (Y), Dst[2] = (Z)
-      #define SET_TEX(Dst, U, V)    Dst[3] = (U), Dst[4] = (V)
-      #define SET_COL(Dst, R, G, B) Dst[5] = (R), Dst[6] = (G), Dst[7] = (B)
-
-      /* It is sufficient to set the color only of the first vertex */
-      SET_COL(vertex, color[0], color[1], color[2]);
-
-      /* Bottom left */
-      SET_POS(vertex, glyph_pos_adjusted[0].x, glyph_pos_adjusted[1].y, 0.f);
-      SET_TEX(vertex, glyph.tex[0].x, glyph.tex[1].y);
-      scratch_push_back(&printer->scratch, vertex, sizeof(vertex));
-      /* Top left */
-      SET_POS(vertex, glyph_pos_adjusted[0].x, glyph_pos_adjusted[0].y, 0.f);
-      SET_TEX(vertex, glyph.tex[0].x, glyph.tex[0].y);
-      scratch_push_back(&printer->scratch, vertex, sizeof(vertex));
-      /* Top right */
-      SET_POS(vertex, glyph_pos_adjusted[1].x, glyph_pos_adjusted[0].y, 0.f);
-      SET_TEX(vertex, glyph.tex[1].x, glyph.tex[0].y);
-      scratch_push_back(&printer->scratch, vertex, sizeof(vertex));
-      /* Bottom right */
-      SET_POS(vertex, glyph_pos_adjusted[1].x, glyph_pos_adjusted[1].y, 0.f);
-      SET_TEX(vertex, glyph.tex[1].x, glyph.tex[1].y);
-      scratch_push_back(&printer->scratch, vertex, sizeof(vertex));
-
-      #undef SET_POS
-      #undef SET_TEX
-      #undef SET_COL
-
-      ++printer->nb_glyphs;
+    if(stop_below && line_y < cull->y0)
+      break;
+
+    /* The char lies inside the culling zone */
+    if(!cull || is_glyph_in_zone
+      (cull, line_x, line_y, glyph_width_adjusted, line_space)) {
+      const enum lp_error lp_err =
+        func(data, id, &glyph, line_x, line_y, glyph_width_adjusted);
+      if(lp_err != LP_NO_ERROR)
+        return lp_err;
+    } else if(nb_culled) {
+      ++(*nb_culled);
     }
-
     line_x += glyph_width_adjusted;
-
-    ASSERT(printer->nb_glyphs <= printer->max_nb_glyphs);
-    if(printer->nb_glyphs == printer->max_nb_glyphs) {
-      LP(printer_flush(printer));
-    }
   }
 
   if(cur_x)
     *cur_x = line_x;
   if(cur_y)
     *cur_y = line_y;
+  if(nb_lines)
+    *nb_lines = line_count;
 
   return LP_NO_ERROR;
 }
 
-enum lp_error
-lp_printer_flush(struct lp_printer* printer)
-{
-  if(!printer)
-    return LP_INVALID_ARGUMENT;
+struct print_context {
+  struct lp_printer* printer;
+  struct glyph_color color;
+  int x, y; /* Origin of the printed string */
+  int line_space;
+  struct scratch* run; /* Recorded glyph run. May be NULL */
+  const struct viewport* clip; /* Clip zone. May be NULL */
+  struct ansi_state* ansi; /* State of the printed ANSI string. May be NULL */
+};
 
-  if(printer->nb_glyphs == 0)
-    return LP_NO_ERROR;
+static enum lp_error
+print_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width)
+{
+  struct print_context* ctxt = data;
+  struct lp_printer* printer = NULL;
+  struct lp_font_glyph clipped_glyph;
+  enum lp_error lp_err = LP_NO_ERROR;
+  (void)id, (void)width;
+  ASSERT(data && glyph);
 
-  /* No printable zone => Draw nothing */
-  if(printer->viewport.x1 <= printer->viewport.x0
-  || printer->viewport.y1 <= printer->viewport.y0) {
-    scratch_clear(&printer->scratch);
-    return LP_NO_ERROR;
+  if(ctxt->clip) {
+    if(!glyph_clip(glyph, x, y, ctxt->clip, &clipped_glyph))
+      return LP_NO_ERROR;
+    glyph = &clipped_glyph;
   }
+  printer = ctxt->printer;
+  if(ctxt->ansi && ctxt->ansi->is_updated) {
+    /* The glyph was looked up in the font of the updated SGR state */
+    ctxt->ansi->is_updated = 0;
+    glyph_color_setup(&ctxt->color, ctxt->ansi->color);
+    lp_err = printer_use_font(printer, ansi_state_font(ctxt->ansi));
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+  }
+  lp_err = printer_push_glyph(printer, glyph, x, y, &ctxt->color);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  ++printer->nb_glyphs;
+
+  /* The segments grow on flush up to LP_GLYPH_COUNT_MAX glyphs. Beyond this
+   * limit the pending glyphs are flushed. */
+  ASSERT(printer->nb_glyphs <= LP_GLYPH_COUNT_MAX);
+  if(printer->nb_glyphs == LP_GLYPH_COUNT_MAX) {
+    ++printer->stats.nb_forced_flushes;
+    lp_err = printer_flush_glyphs(printer);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    /* The flush released the font runs. The next glyphs begin a new one */
+    return printer_use_font
+      (printer, ctxt->ansi ? ansi_state_font(ctxt->ansi) : printer->font);
+  }
+  return LP_NO_ERROR;
+}
 
-  struct rbi* rbi = printer->lp->rbi;
-  struct rb_context* rb_ctxt = printer->lp->rb_ctxt;
+/* Record the glyph in the layout cache run and print it if it lies in the
+ * printer viewport */
+static enum lp_error
+record_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width)
+{
+  struct print_context* ctxt = data;
+  struct layout_glyph layout_glyph;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(data && glyph && ctxt->run);
+
+  layout_glyph.id = id;
+  layout_glyph.dx = x - ctxt->x;
+  layout_glyph.dy = y - ctxt->y;
+  layout_glyph.width = width;
+  layout_glyph.glyph = *glyph;
+  lp_err = scratch_push_back(ctxt->run, &layout_glyph, sizeof(layout_glyph));
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+
+  if(!is_glyph_in_zone
+    (&ctxt->printer->viewport, x, y, width, ctxt->line_space)) {
+    ++ctxt->printer->stats.nb_culled_glyphs;
+    return LP_NO_ERROR;
+  }
+  return print_glyph(data, id, glyph, x, y, width);
+}
 
-  void* data = scratch_buffer(&printer->scratch);
-  const size_t size =
-    4 /* vertices per glyph */ * printer->nb_glyphs * LP_SIZEOF_GLYPH_VERTEX;
-  RBI(rbi, buffer_data(printer->glyph_vertex_buffer, 0, (int)size, data));
+/* Print the string through the layout cache */
+static enum lp_error
+print_string_cached
+  (struct lp_printer* printer,
+   struct print_context* ctxt,
+   const struct string_view* str,
+   int* cur_x,
+   int* cur_y)
+{
+  struct layout_cache_key key;
+  struct layout_cache_entry* entry = NULL;
+  enum lp_error lp_err = LP_NO_ERROR;
+  uint32_t i = 0;
+  ASSERT(printer && ctxt && str);
+
+  /* The layout of a string only depends on its position relatively to the
+   * viewport left border, i.e. its starting column, and on the line width */
+  key.len = str->len;
+  key.encoding = str->encoding;
+  key.hash = layout_cache_hash(str);
+  key.font_generation = printer->font_generation;
+  key.line_width = printer->viewport.x1 - printer->viewport.x0;
+  key.column = ctxt->x - printer->viewport.x0;
+
+  entry = layout_cache_find(&printer->cache, &key, str);
+  lp_err = printer_reserve_glyphs(printer, entry ? entry->nb_glyphs : key.len);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  if(entry) { /* Copy the cached run offset by the string origin */
+    for(i = 0; i < entry->nb_glyphs; ++i) {
+      const struct layout_glyph* glyph = entry->glyph_list + i;
+      const int x = ctxt->x + glyph->dx;
+      const int y = ctxt->y + glyph->dy;
+      if(y < printer->viewport.y0) /* The next glyphs are below too */
+        break;
+      if(!is_glyph_in_zone
+        (&printer->viewport, x, y, glyph->width, ctxt->line_space)) {
+        ++printer->stats.nb_culled_glyphs;
+        continue;
+      }
+      lp_err = print_glyph
+        (ctxt, glyph->id, &glyph->glyph, x, y, glyph->width);
+      if(lp_err != LP_NO_ERROR)
+        return lp_err;
+    }
+    if(cur_x)
+      *cur_x = ctxt->x + entry->end_dx;
+    if(cur_y)
+      *cur_y = ctxt->y + entry->end_dy;
+  } else { /* Lay out the string and record its glyph run */
+    int end[2] = { 0, 0 };
+    ctxt->run = &printer->cache.run;
+    scratch_clear(ctxt->run);
+    lp_err = layout_string
+      (printer->font, ctxt->line_space, &printer->viewport, NULL, ctxt->x,
+       ctxt->y, str, record_glyph, ctxt, end + 0, end + 1, NULL, NULL, NULL);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    lp_err = layout_cache_insert
+      (&printer->cache, &key, str, end[0] - ctxt->x, end[1] - ctxt->y);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    if(cur_x)
+      *cur_x = end[0];
+    if(cur_y)
+      *cur_y = end[1];
+  }
+  return LP_NO_ERROR;
+}
+
+/* Print the string from the pen position of the print context while
+ * interpreting its ANSI escape sequences. The sequences may change the color
+ * and the font of the glyphs, and move the pen in any direction; such strings
+ * are thus neither cached nor laid out in parallel */
+static enum lp_error
+print_string_ansi
+  (struct print_context* ctxt,
+   const struct string_view* str,
+   int* cur_x,
+   int* cur_y)
+{
+  struct ansi_state ansi;
+  struct lp_printer* printer = NULL;
+  const struct glyph_color color = ctxt->color;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(ctxt && ctxt->printer && str);
+
+  printer = ctxt->printer;
+  /* The string length bounds its number of glyphs */
+  lp_err = printer_reserve_glyphs(printer, str->len);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  /* The last 3 floats of the vertex color are the RGB print color */
+  ctxt->ansi = printer_ansi_state(printer, color.vertex + 1, &ansi);
+  lp_err = layout_string
+    (printer->font, ctxt->line_space, &printer->viewport, &printer->viewport,
+     ctxt->x, ctxt->y, str, print_glyph, ctxt, cur_x, cur_y, NULL, &ansi,
+     &printer->stats.nb_culled_glyphs);
+  ctxt->ansi = NULL;
+  ctxt->color = color;
+  return lp_err;
+}
+
+static void
+print_context_setup
+  (struct print_context* ctxt,
+   struct lp_printer* printer,
+   const float color[3])
+{
+  struct lp_font_metrics font_metrics;
+  ASSERT(ctxt && printer && printer->font && color);
+  LP(font_get_metrics(printer->font, &font_metrics));
+  ctxt->printer = printer;
+  glyph_color_setup(&ctxt->color, color);
+  ctxt->x = 0;
+  ctxt->y = 0;
+  ctxt->line_space = font_metrics.line_space;
+  ctxt->run = NULL;
+  ctxt->clip = printer->is_clipped ? &printer->clip : NULL;
+  ctxt->ansi = NULL;
+}
+
+static enum lp_error
+print_context_layout
+  (struct print_context* ctxt,
+   const int x,
+   const int y,
+   const struct string_view* str,
+   int* cur_x,
+   int* cur_y)
+{
+  struct lp_printer* printer = NULL;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(ctxt && ctxt->printer && str);
+
+  printer = ctxt->printer;
+  ctxt->x = x;
+  ctxt->y = y;
+  ctxt->run = NULL;
+  /* The glyphs of a previous ANSI string may use the bold font */
+  lp_err = printer_use_font(printer, printer->font);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  if(printer->is_ansi)
+    return print_string_ansi(ctxt, str, cur_x, cur_y);
+#ifdef _OPENMP
+  if(printer->nb_layout_threads != 1 && str->len >= LP_PARALLEL_LAYOUT_MIN_LEN)
+    return printer_print_string_parallel
+      (printer, ctxt->line_space, x, y, str, &ctxt->color, ctxt->clip,
+       cur_x, cur_y);
+#endif
+  if(printer->cache.nb_entries)
+    return print_string_cached(printer, ctxt, str, cur_x, cur_y);
+  /* The string length bounds its number of glyphs */
+  lp_err = printer_reserve_glyphs(printer, str->len);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  return layout_string
+    (printer->font, ctxt->line_space, &printer->viewport, &printer->viewport,
+     x, y, str, print_glyph, ctxt, cur_x, cur_y, NULL, NULL,
+     &printer->stats.nb_culled_glyphs);
+}
+
+/* Record the glyphs of the string printed by the print context into the hit
+ * index of the printer. The string is laid out again without culling, in
+ * order to index its glyphs out of the viewport too */
+static enum lp_error
+index_string
+  (struct print_context* ctxt,
+   const int x,
+   const int y,
+   const struct string_view* str)
+{
+  struct hit_recorder recorder;
+  struct ansi_state ansi;
+  struct lp_printer* printer = NULL;
+  int end[2] = { 0, 0 };
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(ctxt && ctxt->printer && ctxt->printer->hit_index && str);
+
+  printer = ctxt->printer;
+  lp_err = hit_index_begin_string
+    (printer->hit_index, str, x, y, 0, 0, ctxt->line_space, &recorder);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  lp_err = layout_string
+    (printer->font, ctxt->line_space, &printer->viewport, NULL, x, y, str,
+     hit_index_record_glyph, &recorder, end + 0, end + 1, NULL,
+     printer_ansi_state(printer, ctxt->color.vertex + 1, &ansi), NULL);
+  hit_index_end_string(&recorder, end[0], end[1]);
+  return lp_err;
+}
+
+/* Print `str' from the pen position (x, y) with the color and the font metrics
+ * of the print context */
+static enum lp_error
+print_context_string
+  (struct print_context* ctxt,
+   const int x,
+   const int y,
+   const struct string_view* str,
+   int* cur_x,
+   int* cur_y)
+{
+  struct lp_printer_stats* stats = NULL;
+  double flush_time = 0.0;
+  double t0 = 0.0;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(ctxt && ctxt->printer);
+
+  stats = &ctxt->printer->stats;
+  flush_time = stats->flush_time;
+  LP_TRACE_BEGIN(ctxt->printer->lp, "lp_printer_print");
+  if(ctxt->printer->is_timed)
+    t0 = time_ms();
+  lp_err = print_context_layout(ctxt, x, y, str, cur_x, cur_y);
+  if(lp_err == LP_NO_ERROR && ctxt->printer->hit_index)
+    lp_err = index_string(ctxt, x, y, str);
+  /* The forced flushes of the print are accounted in the flush time */
+  if(ctxt->printer->is_timed)
+    stats->layout_time += time_ms() - t0 - (stats->flush_time - flush_time);
+  LP_TRACE_END(ctxt->printer->lp, "lp_printer_print", str->len);
+  return lp_err;
+}
+
+static enum lp_error
+print_string
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const struct string_view* str,
+   const float color[3],
+   int* cur_x,
+   int* cur_y)
+{
+  struct print_context ctxt;
+  ASSERT(printer && str && color && printer->font);
+  print_context_setup(&ctxt, printer, color);
+  return print_context_string(&ctxt, x, y, str, cur_x, cur_y);
+}
+
+struct measure_context {
+  struct lp_printer_metrics* metrics;
+  int line_space;
+};
+
+static enum lp_error
+measure_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width)
+{
+  struct measure_context* ctxt = data;
+  struct lp_printer_metrics* metrics = NULL;
+  (void)id, (void)glyph;
+  ASSERT(data);
+
+  metrics = ctxt->metrics;
+  metrics->x_min = MIN(metrics->x_min, x);
+  metrics->y_min = MIN(metrics->y_min, y);
+  metrics->x_max = MAX(metrics->x_max, x + width);
+  metrics->y_max = MAX(metrics->y_max, y + ctxt->line_space);
+  ++metrics->nb_glyphs;
+  return LP_NO_ERROR;
+}
+
+struct layout_context {
+  struct lp_printer_glyph* glyph_list;
+  size_t max_nb_glyphs;
+  size_t nb_glyphs;
+};
+
+static enum lp_error
+layout_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width)
+{
+  struct layout_context* ctxt = data;
+  ASSERT(data && glyph);
+
+  /* Count the glyphs beyond the capacity of the list */
+  if(ctxt->nb_glyphs < ctxt->max_nb_glyphs) {
+    struct lp_printer_glyph* dst = ctxt->glyph_list + ctxt->nb_glyphs;
+    dst->id = id;
+    dst->x = x;
+    dst->y = y;
+    dst->width = width;
+    dst->pos[0].x = glyph->pos[0].x + (float)x;
+    dst->pos[0].y = glyph->pos[0].y + (float)y;
+    dst->pos[1].x = glyph->pos[1].x + (float)x;
+    dst->pos[1].y = glyph->pos[1].y + (float)y;
+    dst->tex[0].x = glyph->tex[0].x;
+    dst->tex[0].y = glyph->tex[0].y;
+    dst->tex[1].x = glyph->tex[1].x;
+    dst->tex[1].y = glyph->tex[1].y;
+  }
+  ++ctxt->nb_glyphs;
+  return LP_NO_ERROR;
+}
+
+static enum lp_error
+skip_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width)
+{
+  (void)data, (void)id, (void)glyph, (void)x, (void)y, (void)width;
+  return LP_NO_ERROR;
+}
+
+/* Number of rows of the scrollback line wrapped in the printer viewport */
+static enum lp_error
+scrollback_line_rows
+  (struct lp_printer* printer,
+   const int line_space,
+   struct scrollback_line* line)
+{
+  struct string_view str;
+  struct ansi_state ansi;
+  ASSERT(printer && line);
+
+  if(line->nb_rows)
+    return LP_NO_ERROR;
+  string_view_init(&str, STRING_WCHAR, line->wstr, line->len);
+  return layout_string
+    (printer->font, line_space, &printer->viewport, NULL,
+     printer->viewport.x0, 0, &str, skip_glyph, NULL, NULL, NULL,
+     &line->nb_rows, printer_ansi_state(printer, line->color, &ansi), NULL);
+}
+
+struct paragraph_context {
+  struct lp_printer* printer;
+  const float* color;
+  int line_space;
+};
+
+/* Measure the rows of the document paragraph wrapped in the printer viewport.
+ * Match the document_measure_T signature */
+static enum lp_error
+document_paragraph_rows(void* data, struct document_paragraph* paragraph)
+{
+  struct paragraph_context* ctxt = data;
+  struct string_view str;
+  struct ansi_state ansi;
+  struct lp_printer* printer = NULL;
+  ASSERT(data && paragraph);
+
+  printer = ctxt->printer;
+  string_view_init(&str, STRING_WCHAR, paragraph->wstr, paragraph->len);
+  return layout_string
+    (printer->font, ctxt->line_space, &printer->viewport, NULL,
+     printer->viewport.x0, 0, &str, skip_glyph, NULL, NULL, NULL,
+     &paragraph->nb_rows, printer_ansi_state(printer, ctxt->color, &ansi),
+     NULL);
+}
+
+static void
+release_printer(struct ref* ref)
+{
+  struct lp* lp = NULL;
+  struct lp_printer* printer = NULL;
+  ASSERT(NULL != ref);
+
+  printer = CONTAINER_OF(ref, struct lp_printer, ref);
+
+  printer_storage_release(printer);
+  if(printer->rsrc)
+    rsrc_ref_put(printer->rsrc);
+  CALLBACK_DISCONNECT(&printer->on_font_data_update);
+  CALLBACK_DISCONNECT(&printer->on_bold_font_data_update);
+  clear_text_queue(printer);
+  clear_grid_queue(printer);
+  clear_recorder_queue(printer);
+  layout_cache_release(&printer->cache);
+  printer_parallel_release(printer);
+  printer_raster_release(printer);
+  scratch_release(&printer->text_queue);
+  scratch_release(&printer->grid_queue);
+  scratch_release(&printer->recorder_queue);
+  scratch_release(&printer->scratch);
+  clear_font_runs(printer);
+  scratch_release(&printer->font_runs);
+  if(printer->font)
+    LP(font_ref_put(printer->font));
+  if(printer->bold_font)
+    LP(font_ref_put(printer->bold_font));
+  if(printer->hit_index)
+    LP(hit_index_ref_put(printer->hit_index));
+  lp = printer->lp;
+  MEM_FREE(lp->allocator, printer);
+  LP(ref_put(lp));
+}
+
+/*******************************************************************************
+ *
+ * Internal printer functions
+ *
+ ******************************************************************************/
+enum lp_error
+printer_layout_string
+  (struct lp_font* font,
+   const struct viewport* wrap,
+   const struct viewport* cull,
+   const int x,
+   const int y,
+   const struct string_view* str,
+   layout_glyph_T func,
+   void* data,
+   int* cur_x,
+   int* cur_y,
+   int* nb_lines)
+{
+  struct lp_font_metrics font_metrics;
+  ASSERT(font);
+  LP(font_get_metrics(font, &font_metrics));
+  return layout_string
+    (font, font_metrics.line_space, wrap, cull, x, y, str, func, data,
+     cur_x, cur_y, nb_lines, NULL, NULL);
+}
+
+static enum lp_error
+flush_glyphs(struct lp_printer* printer)
+{
+  ASSERT(printer);
+
+  const size_t nb_texts = printer->text_queue.id / sizeof(struct text_draw);
+  const size_t nb_grids = printer->grid_queue.id / sizeof(struct grid_draw);
+  if(printer->nb_glyphs == 0 && nb_texts == 0 && nb_grids == 0) {
+    clear_font_runs(printer); /* Runs of culled glyphs only */
+    return LP_NO_ERROR;
+  }
+  ++printer->stats.nb_flushes;
+  printer->stats.nb_glyphs += printer->nb_glyphs;
+
+  /* No printable zone => Draw nothing */
+  if(printer->viewport.x1 <= printer->viewport.x0
+  || printer->viewport.y1 <= printer->viewport.y0) {
+    printer->nb_glyphs = 0;
+    scratch_clear(&printer->scratch);
+    clear_font_runs(printer);
+    clear_text_queue(printer);
+    clear_grid_queue(printer);
+    return LP_NO_ERROR;
+  }
+
+  /* CPU compositing. The retained texts and grids only have GPU geometry */
+  if(printer->image.pixels) {
+    enum lp_error lp_err = LP_NO_ERROR;
+    LP_TRACE_BEGIN(printer->lp, "lp_printer_rasterize");
+    lp_err = printer_rasterize(printer);
+    LP_TRACE_END(printer->lp, "lp_printer_rasterize", printer->nb_glyphs);
+    printer->nb_glyphs = 0;
+    scratch_clear(&printer->scratch);
+    clear_font_runs(printer);
+    clear_text_queue(printer);
+    clear_grid_queue(printer);
+    return lp_err;
+  }
+
+  struct lp* lp = printer->lp;
+  struct rsrc* rsrc = printer->rsrc;
+  struct rbi* rbi = lp->rbi;
+  struct rb_context* rb_ctxt = lp->rb_ctxt;
+
+  /* Create the segments if a previous storage failed, or grow them in order
+   * to upload and draw the pending glyphs at once */
+  if(printer->nb_glyphs
+  && (!printer->segment_list || printer->nb_glyphs > printer->max_nb_glyphs)) {
+    uint32_t max_nb_glyphs = MAX(printer->max_nb_glyphs, 1);
+    enum lp_error lp_err = LP_NO_ERROR;
+    while(max_nb_glyphs < printer->nb_glyphs)
+      max_nb_glyphs *= 2;
+    max_nb_glyphs = MIN(max_nb_glyphs, LP_GLYPH_COUNT_MAX);
+    lp_err = printer_storage(printer, printer->nb_segments, max_nb_glyphs);
+    if(lp_err != LP_NO_ERROR) {
+      printer->nb_glyphs = 0;
+      scratch_clear(&printer->scratch);
+      clear_font_runs(printer);
+      clear_text_queue(printer);
+      clear_grid_queue(printer);
+      return lp_err;
+    }
+  }
 
-  const struct rb_depth_stencil_desc depth_stencil_desc = {
-    .enable_depth_test = 0,
-    .enable_depth_write = 0,
-    .enable_stencil_test = 0,
-    .front_face_op.write_mask = 0,
-    .back_face_op.write_mask = 0
-  };
   const struct rb_viewport_desc viewport_desc = {
     .x = printer->viewport.x0,
     .y = printer->viewport.y0,
     .width = printer->viewport.x1 - printer->viewport.x0,
     .height = printer->viewport.y1 - printer->viewport.y0
   };
-  struct rb_blend_desc blend_desc = {
-    .enable = 1,
-    .src_blend_RGB = RB_BLEND_SRC_ALPHA,
-    .src_blend_Alpha = RB_BLEND_ONE,
-    .dst_blend_RGB = RB_BLEND_ONE_MINUS_SRC_ALPHA,
-    .dst_blend_Alpha = RB_BLEND_ZERO,
-    .blend_op_RGB = RB_BLEND_OP_ADD,
-    .blend_op_Alpha = RB_BLEND_OP_ADD
-  };
   const float scale[3] = {
     2.f/(float)viewport_desc.width,
     2.f/(float)viewport_desc.height,
     1.f
   };
   const float bias[3] = { -1.f, -1.f, 0.f };
-  struct rb_tex2d* font_tex = NULL;
-  const unsigned int font_tex_unit = 0;
+  const float tint[3] = { 1.f, 1.f, 1.f };
+
+  /* Out of a frame, the shared state is set and reset by each flush */
+  if(!lp->state.is_in_frame)
+    render_state_setup(lp);
+  render_state_viewport(lp, &viewport_desc);
+
+  /* The grids are opaque and thus drawn below the glyphs */
+  if(nb_grids) {
+    struct shading* shading = &rsrc->grid_shading;
+    const struct grid_draw* queue = scratch_buffer(&printer->grid_queue);
+    size_t i = 0;
+
+    shading_use(lp, shading, scale);
+    render_state_bind_sampler(lp, rsrc->sampler, LP_FONT_TEX_UNIT);
+    for(i = 0; i < nb_grids; ++i) {
+      /* The grid translation is folded in the projection bias */
+      const float grid_bias[3] = {
+        bias[0] + (float)queue[i].x * scale[0],
+        bias[1] + (float)queue[i].y * scale[1],
+        bias[2]
+      };
+      /* Upload the cells that changed since the grid was queued */
+      if(grid_setup(queue[i].grid, rsrc) == LP_NO_ERROR) {
+        grid_draw(queue[i].grid, shading, grid_bias);
+        ++printer->stats.nb_draw_calls;
+      }
+    }
+    clear_grid_queue(printer);
+  }
 
-  LP(font_get_texture(printer->font, &font_tex));
+  if(printer->nb_glyphs) {
+    struct shading* shading = rsrc->shading_list + printer->glyph_format;
+    struct segment* seg = NULL;
+    const struct font_run* runs = scratch_buffer(&printer->font_runs);
+    const size_t nb_runs = printer->font_runs.id / sizeof(struct font_run);
+    void* data = scratch_buffer(&printer->scratch);
+    const size_t data_size =
+      glyph_storage_size(printer->glyph_format, printer->nb_glyphs);
+    const uint64_t hash = fingerprint(data, data_size);
+    uint32_t i = 0;
+
+    /* Draw the segment that already stores the same glyphs, e.g. those of
+     * the previous frame of a static screen, rather than upload them again.
+     * Since such a segment is not written, it may still be read by the GPU */
+    for(i = 0; i < printer->nb_segments; ++i) {
+      seg = printer->segment_list + i;
+      if(seg->data_size == data_size && seg->fingerprint == hash)
+        break;
+    }
+    if(i < printer->nb_segments) {
+      ++printer->stats.nb_skipped_uploads;
+      /* Do not overwrite the drawn segment by the next upload */
+      if(printer->segment_id == i)
+        printer->segment_id = (i + 1) % printer->nb_segments;
+    } else {
+      size_t size = 0;
+      seg = printer->segment_list + printer->segment_id;
+      printer->segment_id = (printer->segment_id + 1) % printer->nb_segments;
+
+      LP_TRACE_BEGIN(lp, "lp_printer_upload");
+      if(printer->glyph_format == LP_PRINTER_GLYPH_RECORD) {
+        /* The scratch was reserved to the rows of the storage capacity on
+         * storage, i.e. it covers the rows of the record texture */
+        segment_setup_record_tex(printer, seg, printer->nb_glyphs);
+        size = seg->nb_record_rows * LP_SIZEOF_GLYPH_RECORD_ROW;
+        RBI(rbi, tex2d_data(seg->record_tex, 0, data));
+      } else {
+        size = data_size;
+        RBI(rbi, buffer_data(seg->vertex_buffer, 0, (int)size, data));
+      }
+      seg->fingerprint = hash;
+      seg->data_size = data_size;
+      printer->stats.uploaded_size += size;
+      LP_TRACE_END(lp, "lp_printer_upload", size);
+    }
 
-  RBI(rbi, depth_stencil(rb_ctxt, &depth_stencil_desc));
-  RBI(rbi, viewport(rb_ctxt, &viewport_desc));
-  RBI(rbi, blend(rb_ctxt, &blend_desc));
+    render_state_bind_sampler(lp, rsrc->sampler, LP_FONT_TEX_UNIT);
 
-  RBI(rbi, bind_tex2d(rb_ctxt, font_tex, font_tex_unit));
-  RBI(rbi, bind_sampler(rb_ctxt, printer->sampler, font_tex_unit));
+    shading_use(lp, shading, scale);
+    shading_set_bias(lp, shading, bias);
+    if(seg->record_tex) {
+      RBI(rbi, bind_tex2d(rb_ctxt, seg->record_tex, LP_RECORD_TEX_UNIT));
+      render_state_bind_sampler(lp, rsrc->sampler, LP_RECORD_TEX_UNIT);
+      /* The tint uniform is shared with the texts that set their color */
+      RBI(rbi, uniform_data(shading->uniform_tint, 1, tint));
+    }
 
-  RBI(rbi, bind_program(rb_ctxt, printer->shading_program));
-  RBI(rbi, uniform_data(printer->uniform_sampler, 1, &font_tex_unit));
-  RBI(rbi, uniform_data(printer->uniform_scale, 1, scale));
-  RBI(rbi, uniform_data(printer->uniform_bias, 1, bias));
+    RBI(rbi, bind_vertex_array(rb_ctxt, seg->vertex_array));
+    /* One draw per font run, from the same uploaded data */
+    ASSERT(nb_runs);
+    for(i = 0; i < nb_runs; ++i) {
+      const uint32_t first = runs[i].first_glyph;
+      const uint32_t end =
+        i + 1 < nb_runs ? runs[i + 1].first_glyph : printer->nb_glyphs;
+      if(first == end)
+        continue;
+      RBI(rbi, bind_tex2d(rb_ctxt, runs[i].tex, LP_FONT_TEX_UNIT));
+      if(seg->record_tex) {
+        shading_set_first_glyph(lp, shading, first);
+      } else {
+        segment_set_first_glyph(printer, seg, first);
+      }
+      RBI(rbi, draw_indexed
+        (rb_ctxt, RB_TRIANGLE_LIST, (end - first) * LP_GLYPH_INDICES_COUNT));
+      ++printer->stats.nb_draw_calls;
+    }
+  }
 
-  RBI(rbi, bind_vertex_array(rb_ctxt, printer->vertex_array));
-  RBI(rbi, draw_indexed
-    (rb_ctxt, RB_TRIANGLE_LIST, printer->nb_glyphs * LP_GLYPH_INDICES_COUNT));
+  if(nb_texts) {
+    struct shading* shading = rsrc->shading_list + LP_PRINTER_GLYPH_RECORD;
+    const struct text_draw* queue = scratch_buffer(&printer->text_queue);
+    size_t i = 0;
+
+    shading_use(lp, shading, scale);
+    shading_set_first_glyph(lp, shading, 0);
+    render_state_bind_sampler(lp, rsrc->sampler, LP_FONT_TEX_UNIT);
+    render_state_bind_sampler(lp, rsrc->sampler, LP_RECORD_TEX_UNIT);
+    for(i = 0; i < nb_texts; ++i) {
+      /* The text translation is folded in the projection bias */
+      const float text_bias[3] = {
+        bias[0] + (float)queue[i].x * scale[0],
+        bias[1] + (float)queue[i].y * scale[1],
+        bias[2]
+      };
+      /* The text may have been updated since it was queued */
+      if(text_setup(queue[i].text) == LP_NO_ERROR) {
+        text_draw(queue[i].text, shading, text_bias, queue[i].color);
+        ++printer->stats.nb_draw_calls;
+      }
+    }
+    clear_text_queue(printer);
+  }
 
-  blend_desc.enable = 0;
-  RBI(rbi, blend(rb_ctxt, &blend_desc));
-  RBI(rbi, bind_program(rb_ctxt, NULL));
-  RBI(rbi, bind_vertex_array(rb_ctxt, NULL));
-  RBI(rbi, bind_tex2d(rb_ctxt, NULL, font_tex_unit));
-  RBI(rbi, bind_sampler(rb_ctxt, NULL, font_tex_unit));
+  if(!lp->state.is_in_frame)
+    render_state_reset(lp);
 
   printer->nb_glyphs = 0;
   scratch_clear(&printer->scratch);
+  clear_font_runs(printer);
+
+  return LP_NO_ERROR;
+}
 
+enum lp_error
+printer_flush_glyphs(struct lp_printer* printer)
+{
+  const uint32_t nb_glyphs = printer->nb_glyphs;
+  double t0 = 0.0;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(printer);
+  (void)nb_glyphs; /* Only traced */
+  LP_TRACE_BEGIN(printer->lp, "lp_printer_flush");
+  if(printer->is_timed)
+    t0 = time_ms();
+  lp_err = flush_glyphs(printer);
+  if(printer->is_timed)
+    printer->stats.flush_time += time_ms() - t0;
+  LP_TRACE_END(printer->lp, "lp_printer_flush", nb_glyphs);
+  return lp_err;
+}
+
+enum lp_error
+printer_push_glyphs
+  (struct lp_printer* printer,
+   const void* glyphs,
+   const size_t nb_glyphs)
+{
+  const size_t glyph_size = sizeof_glyph(printer->glyph_format);
+  const unsigned char* src = glyphs;
+  size_t nb_remaining = nb_glyphs;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(printer && (glyphs || !nb_glyphs));
+
+  while(nb_remaining) {
+    const size_t nb = MIN
+      (nb_remaining, (size_t)(LP_GLYPH_COUNT_MAX - printer->nb_glyphs));
+    void* dst = NULL;
+    /* The pushed glyphs were written with the printer font. The run of the
+     * remaining glyphs begins again after a forced flush */
+    lp_err = printer_use_font(printer, printer->font);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    dst = scratch_alloc(&printer->scratch, nb * glyph_size);
+    if(!dst)
+      return LP_MEMORY_ERROR;
+    memcpy(dst, src, nb * glyph_size);
+    src += nb * glyph_size;
+    nb_remaining -= nb;
+    printer->nb_glyphs += (uint32_t)nb;
+    if(printer->nb_glyphs == LP_GLYPH_COUNT_MAX) {
+      ++printer->stats.nb_forced_flushes;
+      lp_err = printer_flush_glyphs(printer);
+      if(lp_err != LP_NO_ERROR)
+        return lp_err;
+    }
+  }
+  return LP_NO_ERROR;
+}
+
+void
+shading_use(struct lp* lp, struct shading* shading, const float scale[3])
+{
+  const unsigned int font_tex_unit = LP_FONT_TEX_UNIT;
+  const unsigned int record_tex_unit = LP_RECORD_TEX_UNIT;
+  ASSERT(lp && shading && scale);
+
+  render_state_bind_program(lp, shading->program);
+  if(!shading->are_units_set) {
+    RBI(lp->rbi, uniform_data(shading->uniform_sampler, 1, &font_tex_unit));
+    if(shading->uniform_records) {
+      RBI(lp->rbi, uniform_data
+        (shading->uniform_records, 1, &record_tex_unit));
+    }
+    shading->are_units_set = 1;
+  }
+  if(!shading->is_scale_set
+  || memcmp(shading->scale, scale, sizeof(shading->scale))) {
+    RBI(lp->rbi, uniform_data(shading->uniform_scale, 1, scale));
+    memcpy(shading->scale, scale, sizeof(shading->scale));
+    shading->is_scale_set = 1;
+  }
+}
+
+void
+shading_set_bias(struct lp* lp, struct shading* shading, const float bias[3])
+{
+  ASSERT(lp && shading && bias && lp->state.program == shading->program);
+  if(!shading->is_bias_set
+  || memcmp(shading->bias, bias, sizeof(shading->bias))) {
+    RBI(lp->rbi, uniform_data(shading->uniform_bias, 1, bias));
+    memcpy(shading->bias, bias, sizeof(shading->bias));
+    shading->is_bias_set = 1;
+  }
+}
+
+void
+shading_set_first_glyph
+  (struct lp* lp,
+   struct shading* shading,
+   const uint32_t first_glyph)
+{
+  const int val = (int)first_glyph;
+  ASSERT(lp && shading && lp->state.program == shading->program);
+  ASSERT(shading->uniform_first_glyph);
+  if(shading->first_glyph != val) {
+    RBI(lp->rbi, uniform_data(shading->uniform_first_glyph, 1, &val));
+    shading->first_glyph = val;
+  }
+}
+
+enum lp_error
+create_glyph_index_buffer
+  (struct lp* lp,
+   const uint32_t nb_glyphs,
+   struct rb_buffer** index_buffer)
+{
+  struct rb_buffer_desc buffer_desc;
+  unsigned int* indices = NULL;
+  const size_t ibufsiz =
+    nb_glyphs * LP_GLYPH_INDICES_COUNT * sizeof(unsigned int);
+  uint32_t i = 0;
+  ASSERT(lp && nb_glyphs && index_buffer);
+
+  indices = MEM_ALLOC(lp->allocator, ibufsiz);
+  if(!indices)
+    return LP_MEMORY_ERROR;
+
+  /* The buffer data are the indices of the ordered glyphs of a vertex buffer
+   * or of a record texture */
+  for(i = 0; i < nb_glyphs; ++i) {
+    const unsigned int id_first = i * LP_GLYPH_VERTICES_COUNT;
+    unsigned int* dst = indices + i * LP_GLYPH_INDICES_COUNT;
+    dst[0] = 0 + id_first;
+    dst[1] = 1 + id_first;
+    dst[2] = 3 + id_first;
+    dst[3] = 3 + id_first;
+    dst[4] = 1 + id_first;
+    dst[5] = 2 + id_first;
+  }
+  buffer_desc.size = ibufsiz;
+  buffer_desc.target = RB_BIND_INDEX_BUFFER;
+  buffer_desc.usage = RB_USAGE_IMMUTABLE;
+  RBI(lp->rbi, create_buffer(lp->rb_ctxt, &buffer_desc, indices, index_buffer));
+  MEM_FREE(lp->allocator, indices);
   return LP_NO_ERROR;
 }
 
+/*******************************************************************************
+ *
+ * lp_printer functions
+ *
+ ******************************************************************************/
+enum lp_error
+lp_printer_create(struct lp* lp, struct lp_printer** out_printer)
+{
+  struct lp_printer* printer = NULL;
+  struct rsrc* rsrc = NULL;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(UNLIKELY(!lp || !out_printer))
+    return LP_INVALID_ARGUMENT;
+
+  /* The GPU resources are created by the first printer of the lp only */
+  lp_err = rsrc_get(lp, &rsrc);
+  if(UNLIKELY(lp_err != LP_NO_ERROR))
+    return lp_err;
+
+  printer = MEM_CALLOC(lp->allocator, 1, sizeof(struct lp_printer));
+  if(UNLIKELY(!printer)) {
+    rsrc_ref_put(rsrc);
+    return LP_MEMORY_ERROR;
+  }
+
+  ref_init(&printer->ref);
+  printer->lp = lp;
+  LP(ref_get(lp));
+  printer->serial = ++lp->printer_serial;
+  printer->rsrc = rsrc;
+  printer->nb_segments = LP_SEGMENTS_COUNT_DEFAULT;
+  printer->max_nb_glyphs = LP_GLYPH_COUNT_DEFAULT;
+  printer->nb_layout_threads = 1;
+  CALLBACK_INIT(&printer->on_font_data_update);
+  CALLBACK_SETUP(&printer->on_font_data_update, on_font_data_update, printer);
+  CALLBACK_INIT(&printer->on_bold_font_data_update);
+  CALLBACK_SETUP
+    (&printer->on_bold_font_data_update, on_bold_font_data_update, printer);
+  scratch_init(lp->allocator, &printer->scratch);
+  scratch_init(lp->allocator, &printer->text_queue);
+  scratch_init(lp->allocator, &printer->grid_queue);
+  scratch_init(lp->allocator, &printer->recorder_queue);
+  scratch_init(lp->allocator, &printer->raster_glyphs);
+  scratch_init(lp->allocator, &printer->raster_bins);
+  scratch_init(lp->allocator, &printer->font_runs);
+  layout_cache_init(lp->allocator, &printer->cache);
+  *out_printer = printer;
+
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_ref_get(struct lp_printer* printer)
+{
+  if(UNLIKELY(!printer))
+    return LP_INVALID_ARGUMENT;
+  ref_get(&printer->ref);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_ref_put(struct lp_printer* printer)
+{
+  if(UNLIKELY(!printer))
+    return LP_INVALID_ARGUMENT;
+  ref_put(&printer->ref, release_printer);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_set_font(struct lp_printer* printer, struct lp_font* font)
+{
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(UNLIKELY(!printer || !font))
+    return LP_INVALID_ARGUMENT;
+
+  if(font != printer->font) {
+    if(printer->font) {
+      LP(font_ref_put(printer->font));
+    }
+    LP(font_ref_get(font));
+    CALLBACK_DISCONNECT(&printer->on_font_data_update);
+    LP(font_signal_connect
+      (font, LP_FONT_SIGNAL_DATA_UPDATE, &printer->on_font_data_update));
+    printer->font = font;
+
+    lp_err = setup_font(printer);
+  }
+  return lp_err;
+}
+
+enum lp_error
+lp_printer_set_storage
+  (struct lp_printer* printer,
+   const int nb_segments,
+   const int nb_glyphs)
+{
+  if(!printer || nb_segments <= 0 || nb_glyphs <= 0
+  || nb_glyphs > LP_GLYPH_COUNT_MAX)
+    return LP_INVALID_ARGUMENT;
+
+  printer->nb_segments = (uint32_t)nb_segments;
+  printer->max_nb_glyphs = (uint32_t)nb_glyphs;
+  /* Without font the storage is created on the next lp_printer_set_font */
+  if(!printer->font)
+    return LP_NO_ERROR;
+  return printer_storage
+    (printer, printer->nb_segments, printer->max_nb_glyphs);
+}
+
+enum lp_error
+lp_printer_set_glyph_format
+  (struct lp_printer* printer,
+   const enum lp_printer_glyph_format format)
+{
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer || format >= LP_PRINTER_GLYPH_FORMATS_COUNT)
+    return LP_INVALID_ARGUMENT;
+
+  if(format == printer->glyph_format)
+    return LP_NO_ERROR;
+
+  /* The pending glyphs were written with the previous format */
+  lp_err = lp_printer_flush(printer);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  printer->glyph_format = format;
+  if(!printer->font)
+    return LP_NO_ERROR;
+  return printer_storage
+    (printer, printer->nb_segments, printer->max_nb_glyphs);
+}
+
+enum lp_error
+lp_printer_set_layout_cache
+  (struct lp_printer* printer,
+   const int nb_entries)
+{
+  if(!printer || nb_entries < 0)
+    return LP_INVALID_ARGUMENT;
+  return layout_cache_resize(&printer->cache, (uint32_t)nb_entries);
+}
+
+enum lp_error
+lp_printer_set_layout_threads
+  (struct lp_printer* printer,
+   const unsigned nb_threads)
+{
+  if(!printer)
+    return LP_INVALID_ARGUMENT;
+  printer->nb_layout_threads = nb_threads;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_set_ansi(struct lp_printer* printer, const int enable)
+{
+  if(!printer)
+    return LP_INVALID_ARGUMENT;
+  if(!enable == !printer->is_ansi)
+    return LP_NO_ERROR;
+  printer->is_ansi = enable != 0;
+  /* The strings with escape sequences are wrapped differently */
+  ++printer->font_generation;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_set_bold_font(struct lp_printer* printer, struct lp_font* font)
+{
+  if(!printer)
+    return LP_INVALID_ARGUMENT;
+  if(font == printer->bold_font)
+    return LP_NO_ERROR;
+
+  /* The pending glyphs of the previous bold font keep it in their run */
+  CALLBACK_DISCONNECT(&printer->on_bold_font_data_update);
+  if(printer->bold_font)
+    LP(font_ref_put(printer->bold_font));
+  if(font) {
+    LP(font_ref_get(font));
+    LP(font_signal_connect
+      (font, LP_FONT_SIGNAL_DATA_UPDATE, &printer->on_bold_font_data_update));
+  }
+  printer->bold_font = font;
+  ++printer->font_generation;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_set_hit_index
+  (struct lp_printer* printer,
+   struct lp_hit_index* index)
+{
+  if(!printer)
+    return LP_INVALID_ARGUMENT;
+  if(index)
+    LP(hit_index_ref_get(index));
+  if(printer->hit_index)
+    LP(hit_index_ref_put(printer->hit_index));
+  printer->hit_index = index;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_set_image
+  (struct lp_printer* printer,
+   const struct lp_printer_image* image)
+{
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer)
+    return LP_INVALID_ARGUMENT;
+  if(image
+  && (!image->pixels || image->width < 0 || image->height < 0
+   || image->pitch < (size_t)image->width * 4))
+    return LP_INVALID_ARGUMENT;
+
+  /* The pending glyphs are drawn onto the previous target. The target is
+   * kept if they could not be */
+  lp_err = lp_printer_flush(printer);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  if(image) {
+    printer->image = *image;
+  } else {
+    memset(&printer->image, 0, sizeof(printer->image));
+  }
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_set_clip_rect
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const int width,
+   const int height)
+{
+  if(!printer || width < 0 || height < 0)
+    return LP_INVALID_ARGUMENT;
+
+  printer->clip.x0 = x;
+  printer->clip.y0 = y;
+  printer->clip.x1 = x + width;
+  printer->clip.y1 = y + height;
+  printer->is_clipped = 1;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_clear_clip_rect(struct lp_printer* printer)
+{
+  if(!printer)
+    return LP_INVALID_ARGUMENT;
+  printer->is_clipped = 0;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_get_layout_cache_stats
+  (const struct lp_printer* printer,
+   struct lp_printer_cache_stats* stats)
+{
+  if(!printer || !stats)
+    return LP_INVALID_ARGUMENT;
+  layout_cache_get_stats(&printer->cache, stats);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_get_stats
+  (const struct lp_printer* printer,
+   struct lp_printer_stats* stats)
+{
+  if(!printer || !stats)
+    return LP_INVALID_ARGUMENT;
+  *stats = printer->stats;
+  stats->scratch_size = printer->scratch.size;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_clear_stats(struct lp_printer* printer)
+{
+  if(!printer)
+    return LP_INVALID_ARGUMENT;
+  memset(&printer->stats, 0, sizeof(printer->stats));
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_set_timing(struct lp_printer* printer, const int enable)
+{
+  if(!printer)
+    return LP_INVALID_ARGUMENT;
+  printer->is_timed = enable != 0;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_print_stats
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const float color[3])
+{
+  struct lp_printer_stats stats;
+  struct string_view str;
+  char buf[512];
+  int len = 0;
+
+  if(!printer || !color || !printer->font)
+    return LP_INVALID_ARGUMENT;
+  if(printer->viewport.x1 <= printer->viewport.x0
+  || printer->viewport.y1 <= printer->viewport.y0)  /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+
+  LP(printer_get_stats(printer, &stats));
+  len = snprintf(buf, sizeof(buf),
+    "glyphs %lu culled %lu\n"
+    "flushes %lu forced %lu draws %lu\n"
+    "uploaded %lu B skipped %lu scratch %lu B\n"
+    "layout %.3f ms flush %.3f ms",
+    (unsigned long)stats.nb_glyphs,
+    (unsigned long)stats.nb_culled_glyphs,
+    (unsigned long)stats.nb_flushes,
+    (unsigned long)stats.nb_forced_flushes,
+    (unsigned long)stats.nb_draw_calls,
+    (unsigned long)stats.uploaded_size,
+    (unsigned long)stats.nb_skipped_uploads,
+    (unsigned long)stats.scratch_size,
+    stats.layout_time,
+    stats.flush_time);
+  ASSERT(len > 0 && (size_t)len < sizeof(buf));
+  string_view_init(&str, STRING_UTF8, buf, (size_t)len);
+  return print_string(printer, x, y, &str, color, NULL, NULL);
+}
+
+enum lp_error
+lp_printer_set_viewport
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const int width,
+   const int height)
+{
+  if(!printer || width < 0 || height < 0)
+    return LP_INVALID_ARGUMENT;
+
+  printer->viewport.x0 = x;
+  printer->viewport.y0 = y;
+  printer->viewport.x1 = x + width;
+  printer->viewport.y1 = y + height;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_print_wstring
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const wchar_t* wstr,
+   const float color[3],
+   int* cur_x,
+   int* cur_y)
+{
+  if(!wstr)
+    return LP_INVALID_ARGUMENT;
+  return lp_printer_print_wstring_n
+    (printer, x, y, wstr, wcslen(wstr), color, cur_x, cur_y);
+}
+
+enum lp_error
+lp_printer_print_wstring_n
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const wchar_t* wstr,
+   const size_t len,
+   const float color[3],
+   int* cur_x,
+   int* cur_y)
+{
+  struct string_view str;
+  if(!printer || (!wstr && len) || !color || !printer->font)
+    return LP_INVALID_ARGUMENT;
+  if(printer->viewport.x1 <= printer->viewport.x0
+  || printer->viewport.y1 <= printer->viewport.y0)  /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+
+  string_view_init(&str, STRING_WCHAR, wstr, len);
+  return print_string(printer, x, y, &str, color, cur_x, cur_y);
+}
+
+enum lp_error
+lp_printer_print_utf8
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const char* str,
+   const size_t len,
+   const float color[3],
+   int* cur_x,
+   int* cur_y)
+{
+  struct string_view view;
+  if(!printer || (!str && len) || !color || !printer->font)
+    return LP_INVALID_ARGUMENT;
+  if(printer->viewport.x1 <= printer->viewport.x0
+  || printer->viewport.y1 <= printer->viewport.y0)  /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+
+  string_view_init(&view, STRING_UTF8, str, len);
+  return print_string(printer, x, y, &view, color, cur_x, cur_y);
+}
+
+enum lp_error
+lp_printer_print_spans
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const struct lp_printer_span* span_list,
+   const size_t nb_spans,
+   int* cur_x,
+   int* cur_y)
+{
+  struct print_context ctxt;
+  const float black[3] = { 0.f, 0.f, 0.f };
+  size_t i = 0;
+  int pen[2];
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer || (nb_spans && !span_list) || !printer->font)
+    return LP_INVALID_ARGUMENT;
+  if(printer->viewport.x1 <= printer->viewport.x0
+  || printer->viewport.y1 <= printer->viewport.y0)  /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+  for(i = 0; i < nb_spans; ++i) {
+    const struct lp_printer_span* span = span_list + i;
+    if((!span->str && span->len)
+    || (unsigned)span->encoding > LP_PRINTER_ENCODING_UTF8)
+      return LP_INVALID_ARGUMENT;
+    if(span->clip && (span->clip->width < 0 || span->clip->height < 0))
+      return LP_INVALID_ARGUMENT;
+  }
+
+  pen[0] = x;
+  pen[1] = y;
+  print_context_setup(&ctxt, printer, black);
+  for(i = 0; i < nb_spans; ++i) {
+    const struct lp_printer_span* span = span_list + i;
+    struct string_view str;
+    struct viewport clip;
+    size_t len = span->len;
+
+    if(span->encoding == LP_PRINTER_ENCODING_WCHAR) {
+      if(len == LP_PRINTER_SPAN_NUL_TERMINATED)
+        len = wcslen(span->str);
+      string_view_init(&str, STRING_WCHAR, span->str, len);
+    } else {
+      if(len == LP_PRINTER_SPAN_NUL_TERMINATED)
+        len = strlen(span->str);
+      string_view_init(&str, STRING_UTF8, span->str, len);
+    }
+    if(span->is_positioned) {
+      pen[0] = span->x;
+      pen[1] = span->y;
+    }
+    if(span->clip) {
+      clip.x0 = span->clip->x;
+      clip.y0 = span->clip->y;
+      clip.x1 = span->clip->x + span->clip->width;
+      clip.y1 = span->clip->y + span->clip->height;
+      ctxt.clip = &clip;
+    } else {
+      ctxt.clip = printer->is_clipped ? &printer->clip : NULL;
+    }
+    glyph_color_setup(&ctxt.color, span->color);
+    lp_err = print_context_string
+      (&ctxt, pen[0], pen[1], &str, pen + 0, pen + 1);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+  }
+  if(cur_x)
+    *cur_x = pen[0];
+  if(cur_y)
+    *cur_y = pen[1];
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_measure_wstring
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const wchar_t* wstr,
+   struct lp_printer_metrics* metrics)
+{
+  struct measure_context ctxt;
+  struct lp_font_metrics font_metrics;
+  struct ansi_state ansi;
+  struct string_view str;
+  const float white[3] = { 1.f, 1.f, 1.f }; /* The layout ignores the color */
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer || !wstr || !metrics || !printer->font)
+    return LP_INVALID_ARGUMENT;
+  if(printer->viewport.x1 <= printer->viewport.x0
+  || printer->viewport.y1 <= printer->viewport.y0)  /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+
+  LP(font_get_metrics(printer->font, &font_metrics));
+  ctxt.metrics = metrics;
+  ctxt.line_space = font_metrics.line_space;
+  metrics->x_min = metrics->x_max = x;
+  metrics->y_min = metrics->y_max = y;
+  metrics->nb_glyphs = 0;
+
+  string_view_init(&str, STRING_WCHAR, wstr, wcslen(wstr));
+  lp_err = layout_string
+    (printer->font, font_metrics.line_space, &printer->viewport, NULL, x, y,
+     &str, measure_glyph, &ctxt, &metrics->cur_x, &metrics->cur_y,
+     &metrics->nb_lines, printer_ansi_state(printer, white, &ansi), NULL);
+  return lp_err;
+}
+
+enum lp_error
+lp_printer_layout_wstring
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const wchar_t* wstr,
+   struct lp_printer_glyph* glyph_list,
+   const size_t max_nb_glyphs,
+   size_t* nb_glyphs,
+   int* cur_x,
+   int* cur_y)
+{
+  struct layout_context ctxt;
+  struct lp_font_metrics font_metrics;
+  struct ansi_state ansi;
+  struct string_view str;
+  const float white[3] = { 1.f, 1.f, 1.f }; /* The layout ignores the color */
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer || !wstr || !nb_glyphs || !printer->font
+  || (max_nb_glyphs && !glyph_list))
+    return LP_INVALID_ARGUMENT;
+  if(printer->viewport.x1 <= printer->viewport.x0
+  || printer->viewport.y1 <= printer->viewport.y0)  /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+
+  LP(font_get_metrics(printer->font, &font_metrics));
+  ctxt.glyph_list = glyph_list;
+  ctxt.max_nb_glyphs = max_nb_glyphs;
+  ctxt.nb_glyphs = 0;
+  string_view_init(&str, STRING_WCHAR, wstr, wcslen(wstr));
+  lp_err = layout_string
+    (printer->font, font_metrics.line_space, &printer->viewport, NULL, x, y,
+     &str, layout_glyph, &ctxt, cur_x, cur_y, NULL,
+     printer_ansi_state(printer, white, &ansi), NULL);
+  *nb_glyphs = ctxt.nb_glyphs;
+  return lp_err;
+}
+
+enum lp_error
+lp_printer_print_text
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   struct lp_text* text,
+   const float color[3])
+{
+  struct text_draw draw;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer || !text || !color)
+    return LP_INVALID_ARGUMENT;
+
+  /* Rebuild the text geometry if its string, font or wrap width changed */
+  lp_err = text_setup(text);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+
+  draw.text = text;
+  draw.x = x;
+  draw.y = y;
+  draw.color[0] = color[0];
+  draw.color[1] = color[1];
+  draw.color[2] = color[2];
+  if(printer->hit_index) {
+    lp_err = text_index(text, printer->hit_index, x, y);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+  }
+  lp_err = scratch_push_back(&printer->text_queue, &draw, sizeof(draw));
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  LP(text_ref_get(text));
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_print_grid
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   struct lp_grid* grid)
+{
+  struct grid_draw draw;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer || !grid)
+    return LP_INVALID_ARGUMENT;
+
+  draw.grid = grid;
+  draw.x = x;
+  draw.y = y;
+  lp_err = scratch_push_back(&printer->grid_queue, &draw, sizeof(draw));
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  LP(grid_ref_get(grid));
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_print_scrollback
+  (struct lp_printer* printer,
+   struct lp_scrollback* scrollback,
+   const size_t scroll)
+{
+  const float white[3] = { 1.f, 1.f, 1.f };
+  struct print_context ctxt;
+  size_t id = 0;
+  int y = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer || !scrollback || !printer->font)
+    return LP_INVALID_ARGUMENT;
+  if(printer->viewport.x1 <= printer->viewport.x0
+  || printer->viewport.y1 <= printer->viewport.y0)  /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+
+  scrollback_sync(scrollback, printer);
+  print_context_setup(&ctxt, printer, white);
+
+  /* Stack the lines upward from the bottom of the viewport, from the most
+   * recent visible one, until the viewport is filled */
+  y = printer->viewport.y0;
+  for(id = scroll; y < printer->viewport.y1; ++id) {
+    struct scrollback_line* line = scrollback_get_line(scrollback, id);
+    struct string_view str;
+    if(!line)
+      break;
+    lp_err = scrollback_line_rows(printer, ctxt.line_space, line);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    string_view_init(&str, STRING_WCHAR, line->wstr, line->len);
+    glyph_color_setup(&ctxt.color, line->color);
+    /* No cursor is requested, so the layout of the line stops at the bottom
+     * of the viewport */
+    lp_err = print_context_string
+      (&ctxt, printer->viewport.x0, y + (line->nb_rows - 1) * ctxt.line_space,
+       &str, NULL, NULL);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    y += line->nb_rows * ctxt.line_space;
+  }
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_print_document
+  (struct lp_printer* printer,
+   struct lp_document* document,
+   const size_t first_row,
+   const float color[3])
+{
+  struct print_context ctxt;
+  struct paragraph_context paragraph_ctxt;
+  size_t id = 0;
+  size_t row = 0;
+  int y = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer || !document || !color || !printer->font)
+    return LP_INVALID_ARGUMENT;
+  if(printer->viewport.x1 <= printer->viewport.x0
+  || printer->viewport.y1 <= printer->viewport.y0)  /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+
+  document_sync(document, printer);
+  print_context_setup(&ctxt, printer, color);
+  paragraph_ctxt.printer = printer;
+  paragraph_ctxt.color = color;
+  paragraph_ctxt.line_space = ctxt.line_space;
+
+  lp_err = document_find_row
+    (document, first_row, document_paragraph_rows, &paragraph_ctxt,
+     &id, &row);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+
+  /* Print the paragraphs downward from the top of the viewport. The rows of
+   * the first paragraph that precede `first_row' are above the viewport */
+  y = printer->viewport.y1 - ctxt.line_space + (int)row * ctxt.line_space;
+  for(; y + ctxt.line_space > printer->viewport.y0; ++id) {
+    struct document_paragraph* paragraph = document_get_paragraph(document, id);
+    struct string_view str;
+    if(!paragraph)
+      break;
+    if(!paragraph->nb_rows) {
+      lp_err = document_paragraph_rows(&paragraph_ctxt, paragraph);
+      if(lp_err != LP_NO_ERROR)
+        return lp_err;
+    }
+    string_view_init(&str, STRING_WCHAR, paragraph->wstr, paragraph->len);
+    lp_err = print_context_string
+      (&ctxt, printer->viewport.x0, y, &str, NULL, NULL);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    y -= paragraph->nb_rows * ctxt.line_space;
+  }
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_get_document_rows
+  (struct lp_printer* printer,
+   struct lp_document* document,
+   const float color[3],
+   size_t* nb_rows)
+{
+  struct paragraph_context paragraph_ctxt;
+  struct lp_font_metrics font_metrics;
+
+  if(!printer || !document || !color || !nb_rows || !printer->font)
+    return LP_INVALID_ARGUMENT;
+
+  LP(font_get_metrics(printer->font, &font_metrics));
+  document_sync(document, printer);
+  paragraph_ctxt.printer = printer;
+  paragraph_ctxt.color = color;
+  paragraph_ctxt.line_space = font_metrics.line_space;
+  return document_rows_count
+    (document, document_paragraph_rows, &paragraph_ctxt, nb_rows);
+}
+
+enum lp_error
+lp_printer_print_recorder
+  (struct lp_printer* printer,
+   struct lp_recorder* recorder)
+{
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer || !recorder)
+    return LP_INVALID_ARGUMENT;
+
+  lp_err = scratch_push_back
+    (&printer->recorder_queue, &recorder, sizeof(struct lp_recorder*));
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  LP(recorder_ref_get(recorder));
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_printer_flush(struct lp_printer* printer)
+{
+  struct lp_recorder** queue = NULL;
+  size_t nb_recorders = 0;
+  size_t i = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(!printer)
+    return LP_INVALID_ARGUMENT;
+
+  /* Merge the queued recorders in their submission order */
+  queue = scratch_buffer(&printer->recorder_queue);
+  nb_recorders = printer->recorder_queue.id / sizeof(struct lp_recorder*);
+  if(nb_recorders) {
+    LP_TRACE_BEGIN(printer->lp, "lp_printer_merge_recorders");
+    for(i = 0; i < nb_recorders; ++i) {
+      const enum lp_error err = recorder_merge(queue[i], printer);
+      if(err != LP_NO_ERROR && lp_err == LP_NO_ERROR)
+        lp_err = err;
+    }
+    LP_TRACE_END(printer->lp, "lp_printer_merge_recorders", nb_recorders);
+  }
+  clear_recorder_queue(printer);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  return printer_flush_glyphs(printer);
+}
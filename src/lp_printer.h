@@ -5,7 +5,112 @@
 #include <wchar.h>
 
 struct lp_printer;
+struct lp_document;
 struct lp_font;
+struct lp_hit_index;
+struct lp_text;
+struct lp_grid;
+struct lp_recorder;
+struct lp_scrollback;
+
+/* Statistics of the printer layout cache */
+struct lp_printer_cache_stats {
+  size_t nb_hits; /* Number of strings printed from a cached glyph run */
+  size_t nb_misses; /* Number of strings laid out and then cached */
+  size_t nb_entries; /* Number of cached glyph runs */
+  size_t nb_max_entries; /* Capacity of the cache. 0 <=> disabled cache */
+  size_t memory_size; /* Size in bytes of the cached data */
+};
+
+/* Runtime statistics of the printer, accumulated until they are cleared, e.g.
+ * once per frame */
+struct lp_printer_stats {
+  size_t nb_glyphs; /* Number of flushed glyphs */
+  /* Number of laid out glyphs culled by the viewport. The layout of a string
+   * stops below the viewport; the glyphs that follow are not counted */
+  size_t nb_culled_glyphs;
+  size_t nb_flushes; /* Number of flushes of pending glyphs, texts or grids */
+  size_t nb_forced_flushes; /* Flushes due to the pending glyphs limit */
+  size_t nb_draw_calls;
+  size_t uploaded_size; /* Size in bytes of the uploaded glyph data */
+  /* Number of flushes whose glyph data were already stored on the GPU by a
+   * previous flush, e.g. an unchanged frame, and thus were not uploaded */
+  size_t nb_skipped_uploads;
+  size_t scratch_size; /* Current capacity in bytes of the glyph scratch */
+  /* Time in ms spent in the print functions and in the flushes, forced
+   * flushes included. Only measured if the printer timing is enabled */
+  double layout_time;
+  double flush_time;
+};
+
+/* Measurements of a laid out string */
+struct lp_printer_metrics {
+  int x_min, y_min; /* Lower left corner of the glyph cells bounds */
+  int x_max, y_max; /* Upper right corner of the glyph cells bounds */
+  int cur_x, cur_y; /* Pen position at the end of the string */
+  int nb_lines;
+  size_t nb_glyphs; /* Number of laid out glyphs. New lines are excluded */
+};
+
+/* Glyph positioned by the printer layout */
+struct lp_printer_glyph {
+  size_t id; /* Index of the glyph character in the string */
+  int x, y; /* Pen position */
+  int width; /* Advance of the pen */
+  /* Window space bounds of the glyph quad and its texture coordinates in the
+   * font texture */
+  struct { float x; float y; } pos[2], tex[2];
+};
+
+/* Layout of the printed glyphs submitted to the render backend */
+enum lp_printer_glyph_format {
+  /* One 20 bytes record per glyph (int16 bounds, uint16 texture coordinates
+   * and RGBA8 color) expanded to a quad by the vertex shader. Default. */
+  LP_PRINTER_GLYPH_RECORD,
+  /* Four float vertices per glyph (position, texcoord and color) and six
+   * indices. Fallback format. */
+  LP_PRINTER_GLYPH_VERTICES,
+  LP_PRINTER_GLYPH_FORMATS_COUNT
+};
+
+/* Window space rectangle */
+struct lp_printer_rect {
+  int x, y; /* Lower left corner */
+  int width, height;
+};
+
+/* Caller owned RGBA8 image */
+struct lp_printer_image {
+  /* Row 0 is the bottom row, as the rows read back from the render backend */
+  unsigned char* pixels;
+  int width, height;
+  size_t pitch; /* Size in bytes of a row */
+};
+
+/* Length of a NUL terminated span string */
+#define LP_PRINTER_SPAN_NUL_TERMINATED ((size_t)-1)
+
+enum lp_printer_encoding {
+  LP_PRINTER_ENCODING_WCHAR, /* wchar_t string */
+  LP_PRINTER_ENCODING_UTF8 /* UTF-8 char string */
+};
+
+/* Piece of text printed by lp_printer_print_spans */
+struct lp_printer_span {
+  const void* str; /* Code units with respect to `encoding' */
+  /* Number of code units of `str'. LP_PRINTER_SPAN_NUL_TERMINATED <=> the
+   * string is NUL terminated */
+  size_t len;
+  enum lp_printer_encoding encoding;
+  float color[3];
+  /* Print the span from (x, y) rather than from the end of the previous
+   * span */
+  int is_positioned;
+  int x, y;
+  /* Clip rectangle of the span glyphs. NULL <=> the clip rectangle of the
+   * printer, if any */
+  const struct lp_printer_rect* clip;
+};
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,11 +129,149 @@ LP_API enum lp_error
 lp_printer_ref_put
   (struct lp_printer* printer);
 
+/* Set the font of the next printed glyphs. Switching the font, or updating
+ * its data, neither flushes nor drops the pending glyphs: the glyphs of
+ * several fonts are batched and the flush issues one draw per run of glyphs
+ * printed with the same font */
 LP_API enum lp_error
 lp_printer_set_font
   (struct lp_printer* printer,
    struct lp_font* font);
 
+/* Define the GPU storage of the printer. The printed glyphs are uploaded in a
+ * ring of `nb_segments' vertex buffers, each one initially storing
+ * `nb_glyphs' glyphs. A segment is not re-used until the other ones were
+ * consumed, and the segments grow on flush when more glyphs are pending. */
+LP_API enum lp_error
+lp_printer_set_storage
+  (struct lp_printer* printer,
+   const int nb_segments,
+   const int nb_glyphs);
+
+/* Pending glyphs are flushed before the format switch. On a flush error the
+ * error is returned and the format is left unchanged */
+LP_API enum lp_error
+lp_printer_set_glyph_format
+  (struct lp_printer* printer,
+   const enum lp_printer_glyph_format format);
+
+/* Enable a bounded cache of the laid out glyph runs of the printed strings. A
+ * string printed again with the same font, line width and starting column is
+ * not laid out anew; its cached run is offset by the new origin. The cache is
+ * cleared on font change or font data update. 0 entries <=> no cache
+ * (default). The statistics are reset. */
+LP_API enum lp_error
+lp_printer_set_layout_cache
+  (struct lp_printer* printer,
+   const int nb_entries);
+
+/* Define the number of threads that lay out the strings of at least 8192
+ * characters. The strings are split at their hard line breaks and the chunks
+ * are laid out in parallel, for the same result as the serial layout. Such
+ * strings bypass the layout cache. 1 <=> serial layout (default), 0 <=> one
+ * thread per core. The layout is serial if the library was built without
+ * OpenMP support */
+LP_API enum lp_error
+lp_printer_set_layout_threads
+  (struct lp_printer* printer,
+   const unsigned nb_threads);
+
+/* Interpret the ANSI escape sequences of the printed strings rather than
+ * printing them. The SGR sequences set the color of the next glyphs: reset,
+ * 16 and 256 colors palettes, 24 bits colors and bold. The CUU, CUD, CUF, CUB
+ * and CHA sequences move the pen by lines or by advances of the space glyph,
+ * and the carriage return moves it to the left border of the viewport. The
+ * other sequences are skipped. Each printed string or span begins with its
+ * print color and the printer font. Such strings bypass the layout cache and
+ * are laid out serially. The measured and laid out strings are interpreted
+ * too. Disabled by default */
+LP_API enum lp_error
+lp_printer_set_ansi
+  (struct lp_printer* printer,
+   const int enable);
+
+/* Font of the glyphs printed in bold through the ANSI SGR sequences. It
+ * should share the line space of the printer font. The glyphs of both fonts
+ * are batched in a single flush that issues one draw per run of glyphs
+ * sharing a font. NULL <=> bold is ignored (default) */
+LP_API enum lp_error
+lp_printer_set_bold_font
+  (struct lp_printer* printer,
+   struct lp_font* font); /* May be NULL */
+
+/* Record the glyphs of the next printed strings and spans, of the visible
+ * scrollback lines and of the printed texts into `index', in order to
+ * resolve window positions to characters. The strings are laid out a second
+ * time for the index. NULL <=> no index (default) */
+LP_API enum lp_error
+lp_printer_set_hit_index
+  (struct lp_printer* printer,
+   struct lp_hit_index* index); /* May be NULL */
+
+/* Composite the flushed glyphs into `image' on the CPU rather than drawing
+ * them through the render backend, e.g. on a host without GPU. The image is
+ * the window: the glyphs are projected, sampled from the font bitmap cache
+ * and blended as by the GPU path, 4 pixels at a time where SSE2 is available
+ * with the same bytes as the scalar blend. The bands of image rows are
+ * composited on the layout threads. The retained texts and grids are not
+ * rasterized and are discarded on flush. The flush fails with
+ * LP_INVALID_ARGUMENT and discards the glyphs if the data of their font were
+ * set since their print. The pending glyphs are flushed before the target
+ * switch; its error is returned and the current target is kept. The image
+ * memory must outlive its use by the printer.
+ * NULL <=> draw through the render backend (default) */
+LP_API enum lp_error
+lp_printer_set_image
+  (struct lp_printer* printer,
+   const struct lp_printer_image* image); /* May be NULL */
+
+/* Clip the glyphs of the next prints against the window space rectangle. The
+ * glyphs that straddle its borders are cut on the CPU, so that the prints
+ * clipped by different rectangles are still drawn in a single draw call. The
+ * glyphs remain culled against the viewport. No clipping by default */
+LP_API enum lp_error
+lp_printer_set_clip_rect
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const int width,
+   const int height);
+
+LP_API enum lp_error
+lp_printer_clear_clip_rect
+  (struct lp_printer* printer);
+
+LP_API enum lp_error
+lp_printer_get_layout_cache_stats
+  (const struct lp_printer* printer,
+   struct lp_printer_cache_stats* stats);
+
+LP_API enum lp_error
+lp_printer_get_stats
+  (const struct lp_printer* printer,
+   struct lp_printer_stats* stats);
+
+LP_API enum lp_error
+lp_printer_clear_stats
+  (struct lp_printer* printer);
+
+/* Measure the layout and flush times of the statistics with a monotonic
+ * clock. The other counters are always accumulated. Disabled by default */
+LP_API enum lp_error
+lp_printer_set_timing
+  (struct lp_printer* printer,
+   const int enable);
+
+/* Print the current statistics of the printer from the pen position (x, y),
+ * one line per group of counters. The glyphs of this print are counted in the
+ * next statistics */
+LP_API enum lp_error
+lp_printer_print_stats
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const float color[3]);
+
 LP_API enum lp_error
 lp_printer_set_viewport
   (struct lp_printer* printer,
@@ -37,6 +280,8 @@ lp_printer_set_viewport
    const int width,
    const int height);
 
+/* When neither cur_x nor cur_y is requested, the layout stops as soon as the
+ * pen leaves the bottom of the viewport */
 LP_API enum lp_error
 lp_printer_print_wstring
   (struct lp_printer* printer,
@@ -47,6 +292,139 @@ lp_printer_print_wstring
    int* cur_x, /* May be NULL */
    int* cur_y); /* May be NULL */
 
+/* Print the `len' first characters of `wstr'. The string does not need to be
+ * NUL terminated */
+LP_API enum lp_error
+lp_printer_print_wstring_n
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const wchar_t* wstr,
+   const size_t len,
+   const float color[3],
+   int* cur_x, /* May be NULL */
+   int* cur_y); /* May be NULL */
+
+/* Print the `len' first bytes of the UTF-8 string `str'. The string does not
+ * need to be NUL terminated and is decoded on the fly. Invalid sequences are
+ * printed as the U+FFFD replacement character */
+LP_API enum lp_error
+lp_printer_print_utf8
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const char* str,
+   const size_t len,
+   const float color[3],
+   int* cur_x, /* May be NULL */
+   int* cur_y); /* May be NULL */
+
+/* Print the `nb_spans' spans in order. Each span continues from the pen
+ * position at the end of the previous one, or from (x, y) for the first span,
+ * unless it is explicitly positioned. The spans are validated and laid out in
+ * a single pass. (cur_x, cur_y) is the pen position at the end of the last
+ * span */
+LP_API enum lp_error
+lp_printer_print_spans
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const struct lp_printer_span* span_list,
+   const size_t nb_spans,
+   int* cur_x, /* May be NULL */
+   int* cur_y); /* May be NULL */
+
+/* Queue the retained text for the next flush. The text geometry is rebuilt
+ * only if its string, font or wrap width changed. (x, y) is the window
+ * position of the text origin. */
+LP_API enum lp_error
+lp_printer_print_text
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   struct lp_text* text,
+   const float color[3]);
+
+/* Queue the grid for the next flush. (x, y) is the window position of the
+ * bottom left corner of the grid. The cells changed since the previous draw
+ * of the grid are uploaded on flush, and the whole grid is drawn at once,
+ * below the glyphs of the flush */
+LP_API enum lp_error
+lp_printer_print_grid
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   struct lp_grid* grid);
+
+/* Print the lines of the scrollback that are visible in the viewport. The
+ * `scroll' most recent lines are hidden and the next one is printed at the
+ * bottom of the viewport, the older lines being stacked above it. Only the
+ * visible lines are laid out; the wrapped heights of the lines are cached in
+ * the scrollback until the font or the viewport width changes */
+LP_API enum lp_error
+lp_printer_print_scrollback
+  (struct lp_printer* printer,
+   struct lp_scrollback* scrollback,
+   const size_t scroll);
+
+/* Print the paragraphs of the document that are visible in the viewport,
+ * wrapped at its width. The row `first_row' of the wrapped document is
+ * printed at the top of the viewport and the following rows below it. Only
+ * the visible paragraphs and the paragraphs edited since the previous print
+ * are laid out; the wrapped rows are cached in the document until the font
+ * or the viewport width changes */
+LP_API enum lp_error
+lp_printer_print_document
+  (struct lp_printer* printer,
+   struct lp_document* document,
+   const size_t first_row,
+   const float color[3]);
+
+/* Overall number of rows of the document wrapped in the printer viewport,
+ * e.g. to size a scroll bar. The paragraphs whose rows are not cached are
+ * measured with the print `color' that parses their ANSI escape sequences */
+LP_API enum lp_error
+lp_printer_get_document_rows
+  (struct lp_printer* printer,
+   struct lp_document* document,
+   const float color[3],
+   size_t* nb_rows);
+
+/* Lay out the string exactly as lp_printer_print_wstring does, without
+ * generating any vertex nor culling the glyphs against the viewport */
+LP_API enum lp_error
+lp_printer_measure_wstring
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const wchar_t* wstr,
+   struct lp_printer_metrics* metrics);
+
+/* Write up to `max_nb_glyphs' positioned glyphs of the laid out string into
+ * `glyph_list'. `nb_glyphs' is the overall number of laid out glyphs, that may
+ * be greater than `max_nb_glyphs'. As lp_printer_measure_wstring, the glyphs
+ * are not culled against the viewport. */
+LP_API enum lp_error
+lp_printer_layout_wstring
+  (struct lp_printer* printer,
+   const int x,
+   const int y,
+   const wchar_t* wstr,
+   struct lp_printer_glyph* glyph_list, /* May be NULL if max_nb_glyphs is 0 */
+   const size_t max_nb_glyphs,
+   size_t* nb_glyphs,
+   int* cur_x, /* May be NULL */
+   int* cur_y); /* May be NULL */
+
+/* Queue the glyphs recorded by `recorder' for the next flush. The queued
+ * recorders are merged with the pending glyphs in their submission order at
+ * lp_printer_flush, and then cleared. The recorder must not be used until the
+ * flush */
+LP_API enum lp_error
+lp_printer_print_recorder
+  (struct lp_printer* printer,
+   struct lp_recorder* recorder);
+
 LP_API enum lp_error
 lp_printer_flush
   (struct lp_printer* printer);
@@ -0,0 +1,545 @@
+#ifndef LP_PRINTER_C_H
+#define LP_PRINTER_C_H
+
+#include "lp_font.h"
+#include "lp_layout_cache_c.h"
+#include "lp_printer.h"
+#include "lp_scratch_c.h"
+#include "lp_string_c.h"
+#include <rb/rb_types.h>
+#include <snlsys/math.h>
+#include <snlsys/ref_count.h>
+#include <snlsys/snlsys.h>
+#include <string.h>
+
+#ifdef __SSE__
+  #include <xmmintrin.h>
+#endif
+
+#define LP_SIZEOF_GLYPH_VERTEX ((3/*pos*/ + 2/*tex*/ + 3/*col*/)*sizeof(float))
+#define LP_GLYPH_ATTRIB_POSITION_ID 0
+#define LP_GLYPH_ATTRIB_TEXCOORD_ID 1
+#define LP_GLYPH_ATTRIB_COLOR_ID 2
+#define LP_GLYPH_ATTRIBS_COUNT 3
+#define LP_GLYPH_VERTICES_COUNT 4
+#define LP_GLYPH_INDICES_COUNT 6
+#define LP_SIZEOF_GLYPH_RECORD 20 /* 5 RGBA8 texels per glyph record */
+#define LP_GLYPH_RECORD_TEXELS_COUNT (LP_SIZEOF_GLYPH_RECORD / 4)
+#define LP_GLYPH_RECORDS_PER_ROW 64 /* Records per row of a record texture */
+#define LP_SIZEOF_GLYPH_RECORD_ROW \
+  (LP_GLYPH_RECORDS_PER_ROW * LP_SIZEOF_GLYPH_RECORD)
+#define LP_GLYPH_COUNT_DEFAULT 4096 /* Default per segment count of glyphes */
+#define LP_GLYPH_COUNT_MAX 65536 /* Maximum count of buffered glyphes */
+#define LP_SEGMENTS_COUNT_DEFAULT 3 /* Default number of vertex buffers */
+
+#define LP_TAB_SPACES_COUNT 4 /* This may be a configurable parameter */
+
+/* Minimum length in code units of a string laid out in parallel */
+#define LP_PARALLEL_LAYOUT_MIN_LEN 8192
+/* Minimum length in code units of a chunk of a string laid out in parallel */
+#define LP_PARALLEL_CHUNK_MIN_LEN 1024
+/* Number of chunks per layout thread. Several chunks per thread balance the
+ * workload of the threads whose chunks are longer, i.e. whose lines wrap */
+#define LP_PARALLEL_CHUNKS_PER_THREAD 4
+
+/* Number of image rows of a band composited by a thread of the CPU path */
+#define LP_RASTER_BAND_HEIGHT 32
+
+#define LP_FONT_TEX_UNIT 0
+#define LP_RECORD_TEX_UNIT 1
+
+struct lp_grid;
+struct lp_hit_index;
+struct lp_text;
+
+/* GPU vertex storage in which one flush is uploaded. The segments are used in
+ * a round-robin manner in order to avoid to overwrite a buffer that may still
+ * be read by the GPU. With the LP_PRINTER_GLYPH_RECORD format, the glyphs are
+ * stored in the record texture and the vertex array only binds the index
+ * buffer; the vertex shader expands each record into a quad. */
+struct segment {
+  struct rb_buffer* vertex_buffer;
+  struct rb_tex2d* record_tex;
+  uint32_t nb_record_rows; /* Number of rows of the record texture */
+  struct rb_vertex_array* vertex_array;
+  /* Fingerprint of the drawn glyph data stored in the segment, and its size
+   * in bytes. 0 <=> no valid data */
+  uint64_t fingerprint;
+  size_t data_size;
+  /* First glyph addressed by the vertex attribs of the vertex array, and these
+   * attribs. Always 0 with the LP_PRINTER_GLYPH_RECORD format */
+  uint32_t first_glyph;
+  struct rb_buffer_attrib attrib_list[LP_GLYPH_ATTRIBS_COUNT];
+};
+
+/* Pending glyphs printed with the same font, from `first_glyph' up to the
+ * first glyph of the next run. The font and its texture are referenced until
+ * the run is flushed, so that the glyphs are drawn with the texture they were
+ * laid out against even if the font data are updated meanwhile */
+struct font_run {
+  struct lp_font* font;
+  struct rb_tex2d* tex; /* Font texture. May be NULL */
+  uint32_t first_glyph;
+};
+
+/* Shading program of a glyph format */
+struct shading {
+  struct rb_shader* vertex_shader;
+  struct rb_program* program;
+  struct rb_uniform* uniform_sampler;
+  struct rb_uniform* uniform_records; /* NULL for LP_PRINTER_GLYPH_VERTICES */
+  struct rb_uniform* uniform_tint; /* NULL for LP_PRINTER_GLYPH_VERTICES */
+  /* Offset of the drawn glyph records. NULL for LP_PRINTER_GLYPH_VERTICES */
+  struct rb_uniform* uniform_first_glyph;
+  struct rb_uniform* uniform_scale;
+  struct rb_uniform* uniform_bias;
+  /* Uniform values kept by the program. They are submitted only on change */
+  int are_units_set; /* The sampler units and the tint are constant */
+  int is_scale_set, is_bias_set;
+  float scale[3], bias[3];
+  int first_glyph; /* The uniform is 0 once the program is linked */
+};
+
+/* Window coordinate of the printable zone */
+struct viewport {
+  int x0, y0, x1, y1;
+};
+
+/* Retained text queued for the next flush */
+struct text_draw {
+  struct lp_text* text;
+  int x, y;
+  float color[3];
+};
+
+/* Grid queued for the next flush */
+struct grid_draw {
+  struct lp_grid* grid;
+  int x, y;
+};
+
+struct layout_chunk;
+
+struct rsrc;
+
+struct lp_printer {
+  struct ref ref;
+  struct scratch scratch;
+  struct scratch text_queue; /* List of struct text_draw */
+  struct scratch grid_queue; /* List of struct grid_draw */
+  struct scratch recorder_queue; /* List of struct lp_recorder* */
+  struct viewport viewport;
+  struct viewport clip; /* Clip zone of the printed glyphs */
+  int is_clipped;
+  struct lp* lp;
+
+  struct lp_font* font;
+  lp_font_callback_T on_font_data_update;
+
+  /* ANSI escape sequences */
+  int is_ansi;
+  struct lp_font* bold_font; /* May be NULL */
+  lp_font_callback_T on_bold_font_data_update;
+  /* List of struct font_run of the pending glyphs. The prints begin a run
+   * with their font and the flushes release all of them */
+  struct scratch font_runs;
+
+  struct rsrc* rsrc; /* Programs, sampler and index buffer shared per lp */
+  struct rb_buffer* glyph_index_buffer; /* Reference onto the shared one */
+  struct segment* segment_list;
+  uint32_t nb_segments; /* Number of vertex buffers of the ring */
+  uint32_t segment_id; /* Index of the next segment to fill */
+
+  struct layout_cache cache; /* Laid out glyph runs of the printed strings */
+  uint32_t font_generation; /* Incremented on any change of the layout fonts */
+  /* Unique among the printers of its lp, unlike its address that may be
+   * reused once the printer is released. Never 0 */
+  uint32_t serial;
+
+  /* Per chunk data of the parallel layout, kept from one print to another */
+  struct layout_chunk* chunk_list;
+  size_t nb_max_chunks;
+  unsigned nb_layout_threads; /* 1 <=> serial layout */
+
+  /* CPU compositing of the flushed glyphs. Enabled if `image.pixels' is not
+   * NULL */
+  struct lp_printer_image image;
+  struct scratch raster_glyphs; /* List of struct raster_glyph */
+  struct scratch raster_bins; /* Per band glyph indices */
+
+  struct lp_printer_stats stats; /* The scratch size is set on query */
+  int is_timed; /* Accumulate the layout and flush times in the stats */
+
+  /* Index of the printed glyphs. NULL <=> the prints are not indexed */
+  struct lp_hit_index* hit_index;
+
+  enum lp_printer_glyph_format glyph_format;
+  uint32_t max_nb_glyphs; /* Maximum number of glyphs of a segment */
+  uint32_t nb_glyphs; /* Number of glyphs printed but not flushed */
+};
+
+/* Printer layout with which strings were measured, e.g. the wrapped rows of
+ * the scrollback lines or of the document paragraphs. The printer is not
+ * referenced: it is identified by its lp and its serial */
+struct layout_stamp {
+  const struct lp* lp;
+  uint32_t printer_serial; /* 0 <=> nothing was measured */
+  uint32_t font_generation;
+  int line_width;
+};
+
+/* Stamp the current layout of `printer'. Return 0 if it was already stamped,
+ * i.e. the measurements are still valid, and 1 if they are out of date */
+static FINLINE int
+layout_stamp_sync
+  (struct layout_stamp* stamp,
+   const struct lp_printer* printer)
+{
+  const int line_width = printer->viewport.x1 - printer->viewport.x0;
+  ASSERT(stamp && printer && printer->serial);
+
+  if(stamp->lp == printer->lp
+  && stamp->printer_serial == printer->serial
+  && stamp->font_generation == printer->font_generation
+  && stamp->line_width == line_width)
+    return 0;
+  stamp->lp = printer->lp;
+  stamp->printer_serial = printer->serial;
+  stamp->font_generation = printer->font_generation;
+  stamp->line_width = line_width;
+  return 1;
+}
+
+/* Invoked by the layout on each glyph that lies in the culling zone. `id' is
+ * the index of the glyph character in the string, (x, y) is the pen position
+ * of the glyph and `width' its advance. */
+typedef enum lp_error (*layout_glyph_T)
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width);
+
+/* Define whether a glyph entirely lies in the zone or not */
+static FINLINE int
+is_glyph_in_zone
+  (const struct viewport* zone,
+   const int x,
+   const int y,
+   const int width,
+   const int line_space)
+{
+  ASSERT(zone);
+  return x >= zone->x0
+      && y >= zone->y0
+      && x + width <= zone->x1
+      && y + line_space <= zone->y1;
+}
+
+/* Clip the quad of `glyph' whose pen position is (x, y) against `clip' along
+ * one axis. The clipped bounds and texture coordinates are written relatively
+ * to the pen. Return 0 if the quad is out of the clip range */
+static FINLINE int
+glyph_clip_axis
+  (const float pen,
+   const float clip_min,
+   const float clip_max,
+   float* pos0,
+   float* pos1,
+   float* tex0,
+   float* tex1)
+{
+  const float p0 = *pos0 + pen;
+  const float p1 = *pos1 + pen;
+  const float t0 = *tex0;
+  const float t1 = *tex1;
+  ASSERT(pos0 && pos1 && tex0 && tex1);
+
+  if(MAX(p0, p1) <= clip_min || MIN(p0, p1) >= clip_max)
+    return 0;
+  if(MIN(p0, p1) >= clip_min && MAX(p0, p1) <= clip_max)
+    return 1;
+  /* The quad straddles the clip range and has thus a non null extent */
+  *pos0 = MIN(MAX(p0, clip_min), clip_max);
+  *pos1 = MIN(MAX(p1, clip_min), clip_max);
+  *tex0 = t0 + (*pos0 - p0) * (t1 - t0) / (p1 - p0);
+  *tex1 = t0 + (*pos1 - p0) * (t1 - t0) / (p1 - p0);
+  *pos0 -= pen;
+  *pos1 -= pen;
+  return 1;
+}
+
+/* Cut the quad of `glyph' whose pen position is (x, y) by the `clip' zone.
+ * Return 0 if the glyph quad lies out of the zone */
+static FINLINE int
+glyph_clip
+  (const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const struct viewport* clip,
+   struct lp_font_glyph* dst)
+{
+  ASSERT(glyph && clip && dst);
+  *dst = *glyph;
+  return glyph_clip_axis
+    ((float)x, (float)clip->x0, (float)clip->x1,
+     &dst->pos[0].x, &dst->pos[1].x, &dst->tex[0].x, &dst->tex[1].x)
+      && glyph_clip_axis
+    ((float)y, (float)clip->y0, (float)clip->y1,
+     &dst->pos[0].y, &dst->pos[1].y, &dst->tex[0].y, &dst->tex[1].y);
+}
+
+/*******************************************************************************
+ *
+ * Glyph record helpers
+ *
+ ******************************************************************************/
+static FINLINE void
+write_u16(unsigned char* dst, const unsigned int val)
+{
+  ASSERT(dst && val <= 0xFFFF);
+  dst[0] = (unsigned char)(val & 0xFF);
+  dst[1] = (unsigned char)((val >> 8) & 0xFF);
+}
+
+static FINLINE unsigned int
+float_to_i16(const float val)
+{
+  const int i = (int)MIN(MAX(val, -32768.f), 32767.f);
+  return (unsigned int)i & 0xFFFF;
+}
+
+static FINLINE unsigned int
+float_to_unorm(const float val, const float max)
+{
+  return (unsigned int)(MIN(MAX(val, 0.f), 1.f) * max + 0.5f);
+}
+
+/* Size in bytes of a record texture storing `nb_glyphs'. The record textures
+ * store whole rows of records */
+static FINLINE size_t
+glyph_records_size(const uint32_t nb_glyphs)
+{
+  return (size_t)
+    ((nb_glyphs + LP_GLYPH_RECORDS_PER_ROW - 1) / LP_GLYPH_RECORDS_PER_ROW)
+  * LP_GLYPH_RECORDS_PER_ROW
+  * LP_SIZEOF_GLYPH_RECORD;
+}
+
+/* Size in bytes of one glyph in the scratch with respect to the glyph format */
+static FINLINE size_t
+sizeof_glyph(const enum lp_printer_glyph_format format)
+{
+  return format == LP_PRINTER_GLYPH_RECORD
+    ? LP_SIZEOF_GLYPH_RECORD
+    : LP_GLYPH_VERTICES_COUNT * LP_SIZEOF_GLYPH_VERTEX;
+}
+
+/* Color of the written glyphs, converted once per print to the encoding of
+ * each glyph format */
+struct glyph_color {
+  /* Last 4 floats of a glyph vertex, i.e. the v texcoord followed by the RGB
+   * color. The v texcoord is set per vertex */
+  float vertex[4];
+  unsigned char record[4]; /* RGBA8 */
+};
+
+static FINLINE void
+glyph_color_setup(struct glyph_color* dst, const float color[3])
+{
+  ASSERT(dst && color);
+  dst->vertex[0] = 0.f;
+  dst->vertex[1] = color[0];
+  dst->vertex[2] = color[1];
+  dst->vertex[3] = color[2];
+  dst->record[0] = (unsigned char)float_to_unorm(color[0], 255.f);
+  dst->record[1] = (unsigned char)float_to_unorm(color[1], 255.f);
+  dst->record[2] = (unsigned char)float_to_unorm(color[2], 255.f);
+  dst->record[3] = 255;
+}
+
+/* Write the record of `glyph' whose pen position is (x, y) */
+static FINLINE void
+glyph_record_write
+  (unsigned char record[LP_SIZEOF_GLYPH_RECORD],
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const struct glyph_color* color)
+{
+  ASSERT(record && glyph && color);
+  write_u16(record + 0, float_to_i16(glyph->pos[0].x + (float)x));
+  write_u16(record + 2, float_to_i16(glyph->pos[0].y + (float)y));
+  write_u16(record + 4, float_to_i16(glyph->pos[1].x + (float)x));
+  write_u16(record + 6, float_to_i16(glyph->pos[1].y + (float)y));
+  write_u16(record + 8, float_to_unorm(glyph->tex[0].x, 65535.f));
+  write_u16(record + 10, float_to_unorm(glyph->tex[0].y, 65535.f));
+  write_u16(record + 12, float_to_unorm(glyph->tex[1].x, 65535.f));
+  write_u16(record + 14, float_to_unorm(glyph->tex[1].y, 65535.f));
+  memcpy(record + 16, color->record, 4);
+}
+
+/* Write the 4 vertices of the `glyph' quad whose pen position is (x, y). The
+ * vertices are ordered bottom left, top left, top right and bottom right */
+static FINLINE void
+glyph_vertices_write
+  (float vertices[LP_GLYPH_VERTICES_COUNT*LP_SIZEOF_GLYPH_VERTEX/sizeof(float)],
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const struct glyph_color* color)
+{
+  ASSERT(vertices && glyph && color);
+#ifdef __SSE__
+  STATIC_ASSERT
+    (LP_SIZEOF_GLYPH_VERTEX == 8 * sizeof(float), Unexpected_vertex_size);
+  /* The glyph texcoords and bounds are loaded as (u0, v0, u1, v1) and
+   * (x0, y0, x1, y1) and the vertices are assembled with shuffles */
+  const __m128 tex = _mm_loadu_ps(&glyph->tex[0].x);
+  const __m128 pen = _mm_setr_ps((float)x, (float)y, (float)x, (float)y);
+  const __m128 pos = _mm_add_ps(_mm_loadu_ps(&glyph->pos[0].x), pen);
+  const __m128 zu = _mm_shuffle_ps /* (0, 0, u0, u1) */
+    (_mm_setzero_ps(), tex, _MM_SHUFFLE(2, 0, 0, 0));
+  const __m128 col = _mm_loadu_ps(color->vertex);
+  const __m128 v0 = _mm_shuffle_ps(tex, tex, _MM_SHUFFLE(1, 1, 1, 1));
+  const __m128 v1 = _mm_shuffle_ps(tex, tex, _MM_SHUFFLE(3, 3, 3, 3));
+  const __m128 top = _mm_move_ss(col, v0); /* (v0, r, g, b) */
+  const __m128 bottom = _mm_move_ss(col, v1); /* (v1, r, g, b) */
+  /* Bottom left: (x0, y1, 0, u0) */
+  _mm_storeu_ps(vertices + 0, _mm_shuffle_ps(pos, zu, _MM_SHUFFLE(2,0,3,0)));
+  _mm_storeu_ps(vertices + 4, bottom);
+  /* Top left: (x0, y0, 0, u0) */
+  _mm_storeu_ps(vertices + 8, _mm_shuffle_ps(pos, zu, _MM_SHUFFLE(2,0,1,0)));
+  _mm_storeu_ps(vertices + 12, top);
+  /* Top right: (x1, y0, 0, u1) */
+  _mm_storeu_ps(vertices + 16, _mm_shuffle_ps(pos, zu, _MM_SHUFFLE(3,0,1,2)));
+  _mm_storeu_ps(vertices + 20, top);
+  /* Bottom right: (x1, y1, 0, u1) */
+  _mm_storeu_ps(vertices + 24, _mm_shuffle_ps(pos, zu, _MM_SHUFFLE(3,0,3,2)));
+  _mm_storeu_ps(vertices + 28, bottom);
+#else
+  const float x0 = glyph->pos[0].x + (float)x;
+  const float y0 = glyph->pos[0].y + (float)y;
+  const float x1 = glyph->pos[1].x + (float)x;
+  const float y1 = glyph->pos[1].y + (float)y;
+  int i = 0;
+  #define SET_VERTEX(Dst, X, Y, U, V)                                          \
+    (Dst)[0] = (X), (Dst)[1] = (Y), (Dst)[2] = 0.f, (Dst)[3] = (U),            \
+    (Dst)[4] = (V)
+  SET_VERTEX(vertices + 0, x0, y1, glyph->tex[0].x, glyph->tex[1].y);
+  SET_VERTEX(vertices + 8, x0, y0, glyph->tex[0].x, glyph->tex[0].y);
+  SET_VERTEX(vertices + 16, x1, y0, glyph->tex[1].x, glyph->tex[0].y);
+  SET_VERTEX(vertices + 24, x1, y1, glyph->tex[1].x, glyph->tex[1].y);
+  #undef SET_VERTEX
+  for(i = 0; i < LP_GLYPH_VERTICES_COUNT; ++i) {
+    vertices[i*8 + 5] = color->vertex[1];
+    vertices[i*8 + 6] = color->vertex[2];
+    vertices[i*8 + 7] = color->vertex[3];
+  }
+#endif
+}
+
+/*******************************************************************************
+ *
+ * Internal printer functions
+ *
+ ******************************************************************************/
+/* Lay out `str' from the pen position (x, y). The lines are wrapped against
+ * the [wrap->x0, wrap->x1] range and `func' is invoked on the glyphs that
+ * entirely lie in `cull'. The glyph id is the offset in code units of its
+ * character in `str'. */
+extern enum lp_error
+printer_layout_string
+  (struct lp_font* font,
+   const struct viewport* wrap,
+   const struct viewport* cull, /* May be NULL <=> no culling */
+   const int x,
+   const int y,
+   const struct string_view* str,
+   layout_glyph_T func,
+   void* data,
+   int* cur_x, /* May be NULL */
+   int* cur_y, /* May be NULL */
+   int* nb_lines); /* May be NULL */
+
+/* Draw the pending glyphs and the queued texts. The queued recorders are not
+ * merged */
+extern enum lp_error
+printer_flush_glyphs
+  (struct lp_printer* printer);
+
+/* Append `nb_glyphs' glyphs written in the printer glyph format to the
+ * pending glyphs. The pending glyphs are flushed each time they reach
+ * LP_GLYPH_COUNT_MAX glyphs */
+extern enum lp_error
+printer_push_glyphs
+  (struct lp_printer* printer,
+   const void* glyphs,
+   const size_t nb_glyphs);
+
+/* Print `str' with the layout split at its hard line breaks and the chunks
+ * laid out on the printer layout threads. The printed glyphs are those of the
+ * serial layout, in the same order */
+extern enum lp_error
+printer_print_string_parallel
+  (struct lp_printer* printer,
+   const int line_space,
+   const int x,
+   const int y,
+   const struct string_view* str,
+   const struct glyph_color* color,
+   const struct viewport* clip, /* May be NULL <=> no clipping */
+   int* cur_x, /* May be NULL */
+   int* cur_y); /* May be NULL */
+
+extern void
+printer_parallel_release
+  (struct lp_printer* printer);
+
+/* Number of threads of the parallel layout and of the CPU compositing */
+extern unsigned
+printer_nb_threads
+  (const struct lp_printer* printer);
+
+/* Composite the pending glyphs into the printer image */
+extern enum lp_error
+printer_rasterize
+  (struct lp_printer* printer);
+
+extern void
+printer_raster_release
+  (struct lp_printer* printer);
+
+/* Bind the shading program and submit its constant uniforms and its scale if
+ * they changed */
+extern void
+shading_use
+  (struct lp* lp,
+   struct shading* shading,
+   const float scale[3]);
+
+/* Submit the bias uniform of the bound shading program if it changed */
+extern void
+shading_set_bias
+  (struct lp* lp,
+   struct shading* shading,
+   const float bias[3]);
+
+/* Submit the offset of the drawn glyph records of the bound shading program
+ * if it changed */
+extern void
+shading_set_first_glyph
+  (struct lp* lp,
+   struct shading* shading,
+   const uint32_t first_glyph);
+
+/* Create the immutable index buffer of `nb_glyphs' ordered glyph quads */
+extern enum lp_error
+create_glyph_index_buffer
+  (struct lp* lp,
+   const uint32_t nb_glyphs,
+   struct rb_buffer** index_buffer);
+
+#endif /* LP_PRINTER_C_H */
+
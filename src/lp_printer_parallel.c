@@ -0,0 +1,307 @@
+#include "lp_c.h"
+#include "lp_printer.h"
+#include "lp_printer_c.h"
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <snlsys/snlsys.h>
+#include <string.h>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+/* Part of a string laid out independently of the other parts. Except for the
+ * first one, a chunk begins right after a hard line break, i.e. at the left
+ * border of the wrap zone */
+struct layout_chunk {
+  struct string_view str;
+  /* List of struct layout_glyph whose dx is the window space pen position
+   * and dy the pen position relatively to the chunk origin */
+  struct scratch run;
+  struct scratch glyphs; /* Written glyphs in the printer glyph format */
+  int x, y; /* Pen position at the beginning of the chunk */
+  int end_x, end_dy; /* Pen position at the end of the chunk */
+  size_t nb_culled; /* Number of glyphs culled by the viewport */
+  enum lp_error lp_err;
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+/* Return the offset following the first hard line break at or after `begin'.
+ * Return `str->len' if there is none */
+static size_t
+next_line_begin(const struct string_view* str, const size_t begin)
+{
+  size_t i = begin;
+  ASSERT(str && begin <= str->len);
+  if(str->encoding == STRING_WCHAR) {
+    const wchar_t* wstr = str->data;
+    while(i < str->len && wstr[i] != L'\n')
+      ++i;
+  } else {
+    /* The new line byte is never part of a UTF-8 multi bytes sequence */
+    const char* utf8 = str->data;
+    while(i < str->len && utf8[i] != '\n')
+      ++i;
+  }
+  return MIN(i + 1, str->len);
+}
+
+static enum lp_error
+chunk_list_reserve(struct lp_printer* printer, const size_t nb_chunks)
+{
+  struct layout_chunk* chunk_list = NULL;
+  size_t i = 0;
+  ASSERT(printer);
+
+  if(nb_chunks <= printer->nb_max_chunks)
+    return LP_NO_ERROR;
+
+  chunk_list = MEM_REALLOC
+    (printer->lp->allocator, printer->chunk_list,
+     nb_chunks * sizeof(struct layout_chunk));
+  if(!chunk_list)
+    return LP_MEMORY_ERROR;
+  for(i = printer->nb_max_chunks; i < nb_chunks; ++i) {
+    scratch_init(printer->lp->allocator, &chunk_list[i].run);
+    scratch_init(printer->lp->allocator, &chunk_list[i].glyphs);
+  }
+  printer->chunk_list = chunk_list;
+  printer->nb_max_chunks = nb_chunks;
+  return LP_NO_ERROR;
+}
+
+/* Split `str' at hard line breaks in chunks of roughly `chunk_len' code
+ * units and reserve their memory. The memory is reserved here, on the calling
+ * thread, in order to not allocate on the layout threads */
+static enum lp_error
+split_string
+  (struct lp_printer* printer,
+   const struct string_view* str,
+   const size_t chunk_len,
+   size_t* out_nb_chunks)
+{
+  const size_t glyph_size = sizeof_glyph(printer->glyph_format);
+  size_t nb_chunks = 0;
+  size_t begin = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(printer && str && chunk_len && out_nb_chunks);
+
+  while(begin < str->len) {
+    struct layout_chunk* chunk = NULL;
+    const size_t end =
+      next_line_begin(str, MIN(begin + chunk_len, str->len) - 1);
+    const size_t len = end - begin;
+    const size_t unit_size =
+      str->encoding == STRING_WCHAR ? sizeof(wchar_t) : sizeof(char);
+
+    lp_err = chunk_list_reserve(printer, nb_chunks + 1);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    chunk = printer->chunk_list + nb_chunks;
+    string_view_init
+      (&chunk->str, str->encoding,
+       (const char*)str->data + begin * unit_size, len);
+    /* The number of code units bounds the number of glyphs */
+    scratch_clear(&chunk->run);
+    scratch_clear(&chunk->glyphs);
+    lp_err = scratch_reserve(&chunk->run, len * sizeof(struct layout_glyph));
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    lp_err = scratch_reserve(&chunk->glyphs, len * glyph_size);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    ++nb_chunks;
+    begin = end;
+  }
+  *out_nb_chunks = nb_chunks;
+  return LP_NO_ERROR;
+}
+
+static enum lp_error
+record_chunk_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width)
+{
+  struct layout_glyph* dst = NULL;
+  ASSERT(data && glyph);
+
+  /* The run memory was reserved by split_string */
+  dst = scratch_alloc(data, sizeof(struct layout_glyph));
+  ASSERT(dst != NULL);
+  dst->id = id;
+  dst->dx = x;
+  dst->dy = y;
+  dst->width = width;
+  dst->glyph = *glyph;
+  return LP_NO_ERROR;
+}
+
+/* Write the chunk glyphs that lie in the printer viewport */
+static void
+write_chunk_glyphs
+  (struct lp_printer* printer,
+   const int line_space,
+   const struct glyph_color* color,
+   const struct viewport* clip,
+   struct layout_chunk* chunk)
+{
+  const struct layout_glyph* run = NULL;
+  const size_t glyph_size = sizeof_glyph(printer->glyph_format);
+  size_t nb_glyphs = 0;
+  size_t i = 0;
+  ASSERT(printer && color && chunk);
+
+  run = scratch_buffer(&chunk->run);
+  nb_glyphs = chunk->run.id / sizeof(struct layout_glyph);
+  chunk->nb_culled = 0;
+  for(i = 0; i < nb_glyphs; ++i) {
+    const int x = run[i].dx;
+    const int y = chunk->y + run[i].dy;
+    const struct lp_font_glyph* glyph = &run[i].glyph;
+    struct lp_font_glyph clipped_glyph;
+    void* dst = NULL;
+    if(!is_glyph_in_zone(&printer->viewport, x, y, run[i].width, line_space)) {
+      ++chunk->nb_culled;
+      continue;
+    }
+    if(clip) {
+      if(!glyph_clip(glyph, x, y, clip, &clipped_glyph))
+        continue;
+      glyph = &clipped_glyph;
+    }
+    dst = scratch_alloc(&chunk->glyphs, glyph_size);
+    ASSERT(dst != NULL);
+    if(printer->glyph_format == LP_PRINTER_GLYPH_RECORD) {
+      glyph_record_write(dst, glyph, x, y, color);
+    } else {
+      glyph_vertices_write(dst, glyph, x, y, color);
+    }
+  }
+}
+
+/*******************************************************************************
+ *
+ * Internal printer functions
+ *
+ ******************************************************************************/
+enum lp_error
+printer_print_string_parallel
+  (struct lp_printer* printer,
+   const int line_space,
+   const int x,
+   const int y,
+   const struct string_view* str,
+   const struct glyph_color* color,
+   const struct viewport* clip,
+   int* cur_x,
+   int* cur_y)
+{
+  const unsigned nb_threads = printer_nb_threads(printer);
+  size_t chunk_len = 0;
+  size_t nb_chunks = 0;
+  size_t i = 0;
+  long ichunk = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(printer && printer->font && str && color);
+
+  chunk_len = MAX
+    (str->len / (nb_threads * LP_PARALLEL_CHUNKS_PER_THREAD),
+     LP_PARALLEL_CHUNK_MIN_LEN);
+  lp_err = split_string(printer, str, chunk_len, &nb_chunks);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  if(!nb_chunks) {
+    if(cur_x)
+      *cur_x = x;
+    if(cur_y)
+      *cur_y = y;
+    return LP_NO_ERROR;
+  }
+
+  /* Lay out each chunk from its own origin. Only the vertical position of a
+   * chunk depends on the previous chunks, i.e. on their number of lines */
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(nb_threads)
+#endif
+  for(ichunk = 0; ichunk < (long)nb_chunks; ++ichunk) {
+    struct layout_chunk* chunk = printer->chunk_list + ichunk;
+    int end_y = 0;
+    chunk->x = ichunk ? printer->viewport.x0 : x;
+    chunk->lp_err = printer_layout_string
+      (printer->font, &printer->viewport, NULL, chunk->x, 0, &chunk->str,
+       record_chunk_glyph, &chunk->run, &chunk->end_x, &end_y, NULL);
+    chunk->end_dy = end_y;
+  }
+
+  printer->chunk_list[0].y = y;
+  for(i = 0; i < nb_chunks; ++i) {
+    struct layout_chunk* chunk = printer->chunk_list + i;
+    if(chunk->lp_err != LP_NO_ERROR)
+      return chunk->lp_err;
+    if(i + 1 < nb_chunks)
+      chunk[1].y = chunk->y + chunk->end_dy;
+  }
+
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(nb_threads)
+#endif
+  for(ichunk = 0; ichunk < (long)nb_chunks; ++ichunk) {
+    write_chunk_glyphs
+      (printer, line_space, color, clip, printer->chunk_list + ichunk);
+  }
+
+  /* Join the written glyphs in the order of the chunks */
+  for(i = 0; i < nb_chunks; ++i) {
+    struct layout_chunk* chunk = printer->chunk_list + i;
+    printer->stats.nb_culled_glyphs += chunk->nb_culled;
+    lp_err = printer_push_glyphs
+      (printer, scratch_buffer(&chunk->glyphs),
+       chunk->glyphs.id / sizeof_glyph(printer->glyph_format));
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+  }
+  if(cur_x)
+    *cur_x = printer->chunk_list[nb_chunks - 1].end_x;
+  if(cur_y) {
+    const struct layout_chunk* last = printer->chunk_list + nb_chunks - 1;
+    *cur_y = last->y + last->end_dy;
+  }
+  return LP_NO_ERROR;
+}
+
+unsigned
+printer_nb_threads(const struct lp_printer* printer)
+{
+  ASSERT(printer);
+#ifdef _OPENMP
+  if(printer->nb_layout_threads == 0)
+    return (unsigned)omp_get_max_threads();
+  return printer->nb_layout_threads;
+#else
+  (void)printer;
+  return 1;
+#endif
+}
+
+void
+printer_parallel_release(struct lp_printer* printer)
+{
+  size_t i = 0;
+  ASSERT(printer);
+  for(i = 0; i < printer->nb_max_chunks; ++i) {
+    scratch_release(&printer->chunk_list[i].run);
+    scratch_release(&printer->chunk_list[i].glyphs);
+  }
+  if(printer->chunk_list)
+    MEM_FREE(printer->lp->allocator, printer->chunk_list);
+  printer->chunk_list = NULL;
+  printer->nb_max_chunks = 0;
+}
@@ -0,0 +1,441 @@
+#include "lp_c.h"
+#include "lp_font.h"
+#include "lp_printer.h"
+#include "lp_printer_c.h"
+#include <snlsys/math.h>
+#include <snlsys/snlsys.h>
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+/* Glyph quad in image space */
+struct raster_glyph {
+  int x0, y0, x1, y1; /* Range of the covered pixels [x0, x1[ x [y0, y1[ */
+  float u0, v0; /* Texture coordinates at the center of the pixel (x0, y0) */
+  float du, dv; /* Increments of the texture coordinates per pixel */
+  float color[4]; /* RGB color scaled to [0, 255]. The alpha is unused */
+};
+
+/* Font bitmap cache sampled by the glyphs */
+struct raster_bitmap {
+  const unsigned char* texels;
+  int width, height;
+  int Bpp;
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+static FINLINE unsigned int
+read_u16(const unsigned char* src)
+{
+  ASSERT(src);
+  return (unsigned int)src[0] | ((unsigned int)src[1] << 8);
+}
+
+static FINLINE float
+read_i16(const unsigned char* src)
+{
+  const unsigned int val = read_u16(src);
+  return val >= 32768 ? (float)val - 65536.f : (float)val;
+}
+
+/* Nearest texel of the clamped normalized coordinate `t' */
+static FINLINE int
+texel_coord(const float t, const int size)
+{
+  const int i = (int)floorf(t * (float)size);
+  return MIN(MAX(i, 0), size - 1);
+}
+
+/* Decode the glyph `id' of the `format' glyphs as the vertex shader of the
+ * format does. `pos' are the bounds (x0, y0, x1, y1) of the quad and `tex'
+ * their texture coordinates */
+static void
+decode_glyph
+  (const enum lp_printer_glyph_format format,
+   const void* glyphs,
+   const size_t id,
+   float pos[4],
+   float tex[4],
+   float color[3])
+{
+  int i = 0;
+  ASSERT(glyphs && pos && tex && color);
+
+  if(format == LP_PRINTER_GLYPH_RECORD) {
+    const unsigned char* record = (const unsigned char*)glyphs
+      + id * LP_SIZEOF_GLYPH_RECORD;
+    for(i = 0; i < 4; ++i) {
+      pos[i] = read_i16(record + i * 2);
+      tex[i] = (float)read_u16(record + 8 + i * 2) / 65535.f;
+    }
+    for(i = 0; i < 3; ++i)
+      color[i] = (float)record[16 + i] / 255.f;
+  } else {
+    /* The top left and bottom right vertices hold the quad bounds */
+    const float* vertices = (const float*)glyphs
+      + id * LP_GLYPH_VERTICES_COUNT * (LP_SIZEOF_GLYPH_VERTEX/sizeof(float));
+    const float* top_left = vertices + 8;
+    const float* bottom_right = vertices + 24;
+    pos[0] = top_left[0];
+    pos[1] = top_left[1];
+    pos[2] = bottom_right[0];
+    pos[3] = bottom_right[1];
+    tex[0] = top_left[3];
+    tex[1] = top_left[4];
+    tex[2] = bottom_right[3];
+    tex[3] = bottom_right[4];
+    for(i = 0; i < 3; ++i)
+      color[i] = top_left[5 + i];
+  }
+}
+
+/* Setup the image space quad of the glyph. Return 0 if it covers no pixel */
+static int
+setup_raster_glyph
+  (const struct lp_printer* printer,
+   const float pos[4],
+   const float tex[4],
+   const float color[3],
+   struct raster_glyph* glyph)
+{
+  const struct viewport* viewport = NULL;
+  float x0, y0, x1, y1, u0, v0, u1, v1;
+  float du, dv;
+  int px0, py0, px1, py1;
+  ASSERT(printer && pos && tex && color && glyph);
+
+  /* As the GPU projection, the glyph position is relative to the viewport
+   * origin and the quad is clipped against the viewport */
+  viewport = &printer->viewport;
+  x0 = pos[0] + (float)viewport->x0;
+  y0 = pos[1] + (float)viewport->y0;
+  x1 = pos[2] + (float)viewport->x0;
+  y1 = pos[3] + (float)viewport->y0;
+  u0 = tex[0]; v0 = tex[1];
+  u1 = tex[2]; v1 = tex[3];
+  if(x0 == x1 || y0 == y1)
+    return 0;
+  du = (u1 - u0) / (x1 - x0);
+  dv = (v1 - v0) / (y1 - y0);
+  if(x1 < x0) {
+    float tmp = x0; x0 = x1; x1 = tmp;
+    tmp = u0; u0 = u1; u1 = tmp;
+  }
+  if(y1 < y0) {
+    float tmp = y0; y0 = y1; y1 = tmp;
+    tmp = v0; v0 = v1; v1 = tmp;
+  }
+
+  /* The covered pixels are those whose center lies in the quad */
+  px0 = MAX((int)ceilf(x0 - 0.5f), MAX(viewport->x0, 0));
+  py0 = MAX((int)ceilf(y0 - 0.5f), MAX(viewport->y0, 0));
+  px1 = MIN((int)ceilf(x1 - 0.5f), MIN(viewport->x1, printer->image.width));
+  py1 = MIN((int)ceilf(y1 - 0.5f), MIN(viewport->y1, printer->image.height));
+  if(px0 >= px1 || py0 >= py1)
+    return 0;
+
+  glyph->x0 = px0;
+  glyph->y0 = py0;
+  glyph->x1 = px1;
+  glyph->y1 = py1;
+  glyph->u0 = u0 + ((float)px0 + 0.5f - x0) * du;
+  glyph->v0 = v0 + ((float)py0 + 0.5f - y0) * dv;
+  glyph->du = du;
+  glyph->dv = dv;
+  glyph->color[0] = color[0] * 255.f;
+  glyph->color[1] = color[1] * 255.f;
+  glyph->color[2] = color[2] * 255.f;
+  glyph->color[3] = 0.f;
+  return 1;
+}
+
+/* Blend the glyph color of coverage `val' as the GPU blend state does, i.e.
+ * dst.rgb = val * (val * color) + (1 - val) * dst.rgb and dst.a = val */
+static FINLINE void
+blend_pixel
+  (unsigned char dst[4],
+   const unsigned char val,
+   const float color[4])
+{
+  const float a = (float)val / 255.f;
+  int i = 0;
+  for(i = 0; i < 3; ++i) {
+    /* The products and their sum are separate statements so that they are
+     * not contracted in a fused multiply-add rounding unlike blend_pixel4 */
+    const float src = color[i] * a * a;
+    const float prev = (float)dst[i] * (1.f - a);
+    const float res = src + prev;
+    dst[i] = (unsigned char)MIN(res + 0.5f, 255.f);
+  }
+  dst[3] = val;
+}
+
+#ifdef __SSE2__
+/* Blend the glyph color onto the 4 consecutive pixels `dst' of coverages
+ * `val'. Each pixel is computed with the float operations of blend_pixel in
+ * the same order, so both paths give the same bytes */
+static FINLINE void
+blend_pixel4
+  (unsigned char dst[16],
+   const unsigned char val[4],
+   const __m128 color)
+{
+  const __m128 alpha_mask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i pixels = _mm_loadu_si128((const __m128i*)(const void*)dst);
+  const __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+  const __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+  __m128i ipixel[4];
+  int i = 0;
+
+  ipixel[0] = _mm_unpacklo_epi16(lo, zero);
+  ipixel[1] = _mm_unpackhi_epi16(lo, zero);
+  ipixel[2] = _mm_unpacklo_epi16(hi, zero);
+  ipixel[3] = _mm_unpackhi_epi16(hi, zero);
+  for(i = 0; i < 4; ++i) {
+    const __m128 a = _mm_set1_ps((float)val[i] / 255.f);
+    __m128 res = _mm_add_ps
+      (_mm_mul_ps(_mm_mul_ps(color, a), a),
+       _mm_mul_ps
+        (_mm_cvtepi32_ps(ipixel[i]), _mm_sub_ps(_mm_set1_ps(1.f), a)));
+    res = _mm_min_ps(_mm_add_ps(res, _mm_set1_ps(0.5f)), _mm_set1_ps(255.f));
+    /* The alpha channel is the coverage */
+    res = _mm_or_ps
+      (_mm_andnot_ps(alpha_mask, res),
+       _mm_and_ps(alpha_mask, _mm_set1_ps((float)val[i])));
+    ipixel[i] = _mm_cvttps_epi32(res);
+  }
+  _mm_storeu_si128((__m128i*)(void*)dst, _mm_packus_epi16
+    (_mm_packs_epi32(ipixel[0], ipixel[1]),
+     _mm_packs_epi32(ipixel[2], ipixel[3])));
+}
+#endif
+
+/* Composite the glyphs `ids' onto the image rows [y0, y1[ */
+static void
+composite_band
+  (const struct lp_printer_image* image,
+   const struct raster_bitmap* bitmap,
+   const struct raster_glyph* glyphs,
+   const size_t* ids,
+   const size_t nb_ids,
+   const int y0,
+   const int y1)
+{
+  size_t i = 0;
+  ASSERT(image && bitmap && glyphs && (ids || !nb_ids) && y0 <= y1);
+
+  for(i = 0; i < nb_ids; ++i) {
+    const struct raster_glyph* glyph = glyphs + ids[i];
+    const int row_begin = MAX(glyph->y0, y0);
+    const int row_end = MIN(glyph->y1, y1);
+#ifdef __SSE2__
+    const __m128 color = _mm_loadu_ps(glyph->color);
+#endif
+    int y = 0;
+
+    for(y = row_begin; y < row_end; ++y) {
+      const float v = glyph->v0 + (float)(y - glyph->y0) * glyph->dv;
+      const unsigned char* texels = bitmap->texels
+        + (size_t)texel_coord(v, bitmap->height)
+        * (size_t)bitmap->width * (size_t)bitmap->Bpp;
+      unsigned char* dst = image->pixels
+        + (size_t)y * image->pitch + (size_t)glyph->x0 * 4;
+      int x = glyph->x0;
+
+#ifdef __SSE2__
+      /* Blend 4 pixels per step. The remaining ones are blended below */
+      for(; x + 4 <= glyph->x1; x += 4, dst += 16) {
+        unsigned char val[4];
+        int k = 0;
+        for(k = 0; k < 4; ++k) {
+          const float u = glyph->u0 + (float)(x + k - glyph->x0) * glyph->du;
+          val[k] = texels[texel_coord(u, bitmap->width) * bitmap->Bpp];
+        }
+        blend_pixel4(dst, val, color);
+      }
+#endif
+      for(; x < glyph->x1; ++x, dst += 4) {
+        const float u = glyph->u0 + (float)(x - glyph->x0) * glyph->du;
+        const int tx = texel_coord(u, bitmap->width);
+        /* The first channel of the texel is the glyph coverage */
+        blend_pixel(dst, texels[tx * bitmap->Bpp], glyph->color);
+      }
+    }
+  }
+}
+
+/* Bin the glyphs per band of image rows in their print order. The bins are
+ * stored in the raster_bins scratch as the nb_bands + 1 offsets of the bands
+ * followed by the glyph indices */
+static enum lp_error
+bin_glyphs
+  (struct lp_printer* printer,
+   const struct raster_glyph* glyphs,
+   const size_t nb_glyphs,
+   const size_t nb_bands)
+{
+  size_t* offsets = NULL;
+  size_t* ids = NULL;
+  size_t i = 0;
+  int band = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(printer && (glyphs || !nb_glyphs) && nb_bands);
+
+  scratch_clear(&printer->raster_bins);
+  offsets = scratch_alloc(&printer->raster_bins, (nb_bands+1)*sizeof(size_t));
+  if(!offsets)
+    return LP_MEMORY_ERROR;
+  memset(offsets, 0, (nb_bands + 1) * sizeof(size_t));
+
+  /* Count the glyphs of each band */
+  for(i = 0; i < nb_glyphs; ++i) {
+    const int band_begin = glyphs[i].y0 / LP_RASTER_BAND_HEIGHT;
+    const int band_end = (glyphs[i].y1 - 1) / LP_RASTER_BAND_HEIGHT;
+    for(band = band_begin; band <= band_end; ++band)
+      ++offsets[band + 1];
+  }
+  for(i = 0; i < nb_bands; ++i)
+    offsets[i + 1] += offsets[i];
+
+  lp_err = scratch_reserve
+    (&printer->raster_bins, (nb_bands + 1 + offsets[nb_bands]) * sizeof(size_t));
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  offsets = scratch_buffer(&printer->raster_bins);
+  ids = offsets + nb_bands + 1;
+
+  /* Fill the bands, the band offset being used as the write cursor. The
+   * cursors end on the begin of the next band */
+  for(i = 0; i < nb_glyphs; ++i) {
+    const int band_begin = glyphs[i].y0 / LP_RASTER_BAND_HEIGHT;
+    const int band_end = (glyphs[i].y1 - 1) / LP_RASTER_BAND_HEIGHT;
+    for(band = band_begin; band <= band_end; ++band)
+      ids[offsets[band]++] = i;
+  }
+  for(i = nb_bands; i > 0; --i)
+    offsets[i] = offsets[i - 1];
+  offsets[0] = 0;
+  return LP_NO_ERROR;
+}
+
+/* Composite the pending glyphs [first, end[ sampling the bitmap cache of
+ * `font' */
+static enum lp_error
+rasterize_run
+  (struct lp_printer* printer,
+   struct lp_font* font,
+   const uint32_t first,
+   const uint32_t end)
+{
+  struct raster_bitmap bitmap;
+  struct raster_glyph* glyphs = NULL;
+  const size_t* offsets = NULL;
+  const size_t* ids = NULL;
+  size_t nb_glyphs = 0;
+  size_t nb_bands = 0;
+  size_t i = 0;
+  long iband = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(printer && printer->image.pixels && font && first <= end);
+
+  LP(font_get_bitmap_cache
+    (font, &bitmap.width, &bitmap.height, &bitmap.Bpp, &bitmap.texels));
+  if(!bitmap.texels || bitmap.width <= 0 || bitmap.height <= 0)
+    return LP_NO_ERROR;
+
+  /* Setup the image space quads of the glyphs */
+  scratch_clear(&printer->raster_glyphs);
+  lp_err = scratch_reserve
+    (&printer->raster_glyphs, (end - first) * sizeof(struct raster_glyph));
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  glyphs = scratch_buffer(&printer->raster_glyphs);
+  for(i = first; i < end; ++i) {
+    float pos[4], tex[4], color[3];
+    decode_glyph
+      (printer->glyph_format, scratch_buffer(&printer->scratch), i, pos, tex,
+       color);
+    nb_glyphs += (size_t)setup_raster_glyph
+      (printer, pos, tex, color, glyphs + nb_glyphs);
+  }
+  if(!nb_glyphs)
+    return LP_NO_ERROR;
+
+  nb_bands = ((size_t)printer->image.height + LP_RASTER_BAND_HEIGHT - 1)
+    / LP_RASTER_BAND_HEIGHT;
+  lp_err = bin_glyphs(printer, glyphs, nb_glyphs, nb_bands);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  offsets = scratch_buffer(&printer->raster_bins);
+  ids = offsets + nb_bands + 1;
+
+  /* The bands do not overlap and are thus composited independently */
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) \
+    num_threads(printer_nb_threads(printer))
+#endif
+  for(iband = 0; iband < (long)nb_bands; ++iband) {
+    const int y0 = (int)iband * LP_RASTER_BAND_HEIGHT;
+    const int y1 = MIN(y0 + LP_RASTER_BAND_HEIGHT, printer->image.height);
+    composite_band
+      (&printer->image, &bitmap, glyphs, ids + offsets[iband],
+       offsets[iband + 1] - offsets[iband], y0, y1);
+  }
+  return LP_NO_ERROR;
+}
+
+/*******************************************************************************
+ *
+ * Internal printer functions
+ *
+ ******************************************************************************/
+enum lp_error
+printer_rasterize(struct lp_printer* printer)
+{
+  const struct font_run* runs = NULL;
+  size_t nb_runs = 0;
+  size_t i = 0;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(printer && printer->image.pixels);
+
+  if(!printer->nb_glyphs || !printer->image.height)
+    return LP_NO_ERROR;
+
+  runs = scratch_buffer(&printer->font_runs);
+  nb_runs = printer->font_runs.id / sizeof(struct font_run);
+
+  /* Unlike its texture, the bitmap cache of a font is not kept by the run. It
+   * does not match the glyphs anymore if the font data were updated since
+   * their print, and the printed characters are not kept to lay them out
+   * again. Nothing is composited rather than a part of the glyphs */
+  for(i = 0; i < nb_runs; ++i) {
+    struct rb_tex2d* tex = NULL;
+    LP(font_get_texture(runs[i].font, &tex));
+    if(tex != runs[i].tex)
+      return LP_INVALID_ARGUMENT;
+  }
+
+  /* The runs are composited in their print order */
+  for(i = 0; i < nb_runs && lp_err == LP_NO_ERROR; ++i) {
+    const uint32_t end =
+      i + 1 < nb_runs ? runs[i + 1].first_glyph : printer->nb_glyphs;
+    lp_err = rasterize_run(printer, runs[i].font, runs[i].first_glyph, end);
+  }
+  return lp_err;
+}
+
+void
+printer_raster_release(struct lp_printer* printer)
+{
+  ASSERT(printer);
+  scratch_release(&printer->raster_glyphs);
+  scratch_release(&printer->raster_bins);
+}
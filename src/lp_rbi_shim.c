@@ -0,0 +1,751 @@
+#include "lp_rbi_shim.h"
+#include <rb/rbi.h>
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <snlsys/ref_count.h>
+#include <snlsys/snlsys.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SHIM_UNITS_COUNT 16 /* Texture units whose binds are tracked */
+
+/* Buffer or texture created through the shim */
+struct object_entry {
+  const void* object;
+  size_t size; /* Size in bytes of a buffer or of a texel of a texture */
+  unsigned int width, height; /* Dimensions of the texture level 0 */
+  size_t nb_refs;
+};
+
+struct lp_rbi_shim {
+  struct ref ref;
+  struct mem_allocator* allocator;
+  struct rbi driver; /* Null functions <=> forward to nothing */
+  struct lp_rbi_shim_counters counters;
+  size_t upload_limit; /* 0 <=> no limit */
+  uintptr_t nb_handles; /* Opaque handles created without driver */
+
+  struct object_entry* object_list;
+  size_t nb_objects;
+  size_t max_nb_objects;
+
+  /* Last submitted state. The shim assumes a single render context */
+  struct rb_program* program;
+  struct rb_vertex_array* vertex_array;
+  struct rb_tex2d* tex2d_list[SHIM_UNITS_COUNT];
+  struct rb_sampler* sampler_list[SHIM_UNITS_COUNT];
+  struct rb_blend_desc blend;
+  struct rb_depth_stencil_desc depth_stencil;
+  struct rb_viewport_desc viewport;
+  int is_blend_set;
+  int is_depth_stencil_set;
+  int is_viewport_set;
+};
+
+/* The rbi functions have no user data */
+static struct lp_rbi_shim* g_shim = NULL;
+
+#define COUNT(Name) (++g_shim->counters.nb_calls[LP_RBI_CALL_##Name])
+#define FORWARD(Name, Args) \
+  (g_shim->driver.Name ? g_shim->driver.Name Args : 0)
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+/* Unique non null handle of an object created without driver */
+static void*
+null_handle(void)
+{
+  ASSERT(g_shim);
+  return (void*)++g_shim->nb_handles;
+}
+
+static int
+is_null_driver(void)
+{
+  ASSERT(g_shim);
+  return g_shim->driver.create_context == NULL;
+}
+
+static struct object_entry*
+find_object(const void* object)
+{
+  size_t i = 0;
+  ASSERT(g_shim);
+  for(i = 0; i < g_shim->nb_objects; ++i) {
+    if(g_shim->object_list[i].object == object)
+      return g_shim->object_list + i;
+  }
+  return NULL;
+}
+
+static struct object_entry*
+register_object(const void* object, const size_t size)
+{
+  struct object_entry* entry = NULL;
+  ASSERT(g_shim && object);
+
+  if(g_shim->nb_objects == g_shim->max_nb_objects) {
+    const size_t max_nb_objects = MAX(g_shim->max_nb_objects * 2, (size_t)16);
+    entry = MEM_REALLOC(g_shim->allocator, g_shim->object_list,
+      max_nb_objects * sizeof(struct object_entry));
+    if(!entry)
+      return NULL;
+    g_shim->object_list = entry;
+    g_shim->max_nb_objects = max_nb_objects;
+  }
+  entry = g_shim->object_list + g_shim->nb_objects++;
+  entry->object = object;
+  entry->size = size;
+  entry->width = entry->height = 0;
+  entry->nb_refs = 1;
+  return entry;
+}
+
+static void
+unregister_object(struct object_entry* entry)
+{
+  ASSERT(g_shim && entry && g_shim->nb_objects);
+  *entry = g_shim->object_list[--g_shim->nb_objects];
+}
+
+static void
+object_ref_get(const void* object)
+{
+  struct object_entry* entry = find_object(object);
+  if(entry)
+    ++entry->nb_refs;
+}
+
+static void
+object_ref_put(const void* object)
+{
+  struct object_entry* entry = find_object(object);
+  if(entry && !--entry->nb_refs)
+    unregister_object(entry);
+}
+
+/* Size in bytes of a texel. 0 <=> unknown format whose uploads are not
+ * counted */
+static size_t
+texel_size(const enum rb_tex_format format)
+{
+  switch(format) {
+    case RB_R: return 1;
+    case RB_RGB: return 3;
+    case RB_RGBA: return 4;
+    default: return 0;
+  }
+}
+
+static void
+count_upload(const size_t size, const int is_out_of_range)
+{
+  ASSERT(g_shim);
+  g_shim->counters.uploaded_size += size;
+  if(is_out_of_range
+  || (g_shim->upload_limit && size > g_shim->upload_limit))
+    ++g_shim->counters.nb_oversized_uploads;
+}
+
+static void
+count_bind(const void* bound, const void* obj)
+{
+  ASSERT(g_shim);
+  ++g_shim->counters.nb_state_changes;
+  if(bound == obj)
+    ++g_shim->counters.nb_redundant_binds;
+}
+
+/* The descriptors are compared byte-wise */
+static void
+count_state(void* state, int* is_set, const void* desc, const size_t size)
+{
+  ASSERT(g_shim && state && is_set);
+  ++g_shim->counters.nb_state_changes;
+  if(!desc)
+    return;
+  if(*is_set && !memcmp(state, desc, size))
+    ++g_shim->counters.nb_redundant_states;
+  memcpy(state, desc, size);
+  *is_set = 1;
+}
+
+static void
+release_shim(struct ref* ref)
+{
+  struct lp_rbi_shim* shim = NULL;
+  ASSERT(ref);
+
+  shim = CONTAINER_OF(ref, struct lp_rbi_shim, ref);
+  if(shim->object_list)
+    MEM_FREE(shim->allocator, shim->object_list);
+  if(g_shim == shim)
+    g_shim = NULL;
+  MEM_FREE(shim->allocator, shim);
+}
+
+/*******************************************************************************
+ *
+ * Interposing rbi functions
+ *
+ ******************************************************************************/
+static int
+shim_create_context
+  (struct mem_allocator* allocator,
+   struct rb_context** ctxt)
+{
+  COUNT(create_context);
+  if(!is_null_driver())
+    return g_shim->driver.create_context(allocator, ctxt);
+  if(!ctxt)
+    return -1;
+  *ctxt = null_handle();
+  return 0;
+}
+
+static int
+shim_context_ref_get(struct rb_context* ctxt)
+{
+  COUNT(context_ref_get);
+  return FORWARD(context_ref_get, (ctxt));
+}
+
+static int
+shim_context_ref_put(struct rb_context* ctxt)
+{
+  COUNT(context_ref_put);
+  return FORWARD(context_ref_put, (ctxt));
+}
+
+static int
+shim_get_config(struct rb_context* ctxt, struct rb_config* cfg)
+{
+  COUNT(get_config);
+  if(!is_null_driver())
+    return g_shim->driver.get_config(ctxt, cfg);
+  if(!cfg)
+    return -1;
+  memset(cfg, 0, sizeof(struct rb_config));
+  cfg->max_tex_size = 4096;
+  return 0;
+}
+
+static int
+shim_clear
+  (struct rb_context* ctxt,
+   int flag,
+   const float rgba[4],
+   float depth,
+   char stencil)
+{
+  COUNT(clear);
+  return FORWARD(clear, (ctxt, flag, rgba, depth, stencil));
+}
+
+static int
+shim_blend(struct rb_context* ctxt, const struct rb_blend_desc* desc)
+{
+  COUNT(blend);
+  count_state(&g_shim->blend, &g_shim->is_blend_set, desc, sizeof(*desc));
+  return FORWARD(blend, (ctxt, desc));
+}
+
+static int
+shim_depth_stencil
+  (struct rb_context* ctxt,
+   const struct rb_depth_stencil_desc* desc)
+{
+  COUNT(depth_stencil);
+  count_state
+    (&g_shim->depth_stencil, &g_shim->is_depth_stencil_set, desc,
+     sizeof(*desc));
+  return FORWARD(depth_stencil, (ctxt, desc));
+}
+
+static int
+shim_viewport(struct rb_context* ctxt, const struct rb_viewport_desc* desc)
+{
+  COUNT(viewport);
+  count_state
+    (&g_shim->viewport, &g_shim->is_viewport_set, desc, sizeof(*desc));
+  return FORWARD(viewport, (ctxt, desc));
+}
+
+static int
+shim_draw_indexed
+  (struct rb_context* ctxt,
+   enum rb_primitive_type type,
+   unsigned int nb_indices)
+{
+  COUNT(draw_indexed);
+  return FORWARD(draw_indexed, (ctxt, type, nb_indices));
+}
+
+static int
+shim_create_tex2d
+  (struct rb_context* ctxt,
+   const struct rb_tex2d_desc* desc,
+   const void** data,
+   struct rb_tex2d** tex)
+{
+  struct object_entry* entry = NULL;
+  int err = 0;
+  COUNT(create_tex2d);
+  if(!is_null_driver()) {
+    err = g_shim->driver.create_tex2d(ctxt, desc, data, tex);
+  } else if(!desc || !tex) {
+    err = -1;
+  } else {
+    *tex = null_handle();
+  }
+  if(!err) {
+    entry = register_object(*tex, texel_size(desc->format));
+    if(!entry) {
+      if(!is_null_driver())
+        g_shim->driver.tex2d_ref_put(*tex);
+      err = -1;
+    } else {
+      entry->width = desc->width;
+      entry->height = desc->height;
+    }
+  }
+  return err;
+}
+
+static int
+shim_tex2d_ref_get(struct rb_tex2d* tex)
+{
+  COUNT(tex2d_ref_get);
+  object_ref_get(tex);
+  return FORWARD(tex2d_ref_get, (tex));
+}
+
+static int
+shim_tex2d_ref_put(struct rb_tex2d* tex)
+{
+  COUNT(tex2d_ref_put);
+  object_ref_put(tex);
+  return FORWARD(tex2d_ref_put, (tex));
+}
+
+static int
+shim_bind_tex2d
+  (struct rb_context* ctxt,
+   struct rb_tex2d* tex,
+   unsigned int unit)
+{
+  COUNT(bind_tex2d);
+  if(unit < SHIM_UNITS_COUNT) {
+    count_bind(g_shim->tex2d_list[unit], tex);
+    g_shim->tex2d_list[unit] = tex;
+  } else {
+    ++g_shim->counters.nb_state_changes;
+  }
+  return FORWARD(bind_tex2d, (ctxt, tex, unit));
+}
+
+static int
+shim_tex2d_data(struct rb_tex2d* tex, unsigned int level, const void* data)
+{
+  const struct object_entry* entry = NULL;
+  COUNT(tex2d_data);
+  /* The whole level is sent */
+  entry = find_object(tex);
+  if(entry && level < 32) {
+    count_upload
+      ((size_t)MAX(entry->width >> level, 1u)
+     * (size_t)MAX(entry->height >> level, 1u)
+     * entry->size, 0);
+  }
+  return FORWARD(tex2d_data, (tex, level, data));
+}
+
+static int
+shim_create_sampler
+  (struct rb_context* ctxt,
+   const struct rb_sampler_desc* desc,
+   struct rb_sampler** sampler)
+{
+  COUNT(create_sampler);
+  if(!is_null_driver())
+    return g_shim->driver.create_sampler(ctxt, desc, sampler);
+  if(!desc || !sampler)
+    return -1;
+  *sampler = null_handle();
+  return 0;
+}
+
+static int
+shim_sampler_ref_get(struct rb_sampler* sampler)
+{
+  COUNT(sampler_ref_get);
+  return FORWARD(sampler_ref_get, (sampler));
+}
+
+static int
+shim_sampler_ref_put(struct rb_sampler* sampler)
+{
+  COUNT(sampler_ref_put);
+  return FORWARD(sampler_ref_put, (sampler));
+}
+
+static int
+shim_bind_sampler
+  (struct rb_context* ctxt,
+   struct rb_sampler* sampler,
+   unsigned int unit)
+{
+  COUNT(bind_sampler);
+  if(unit < SHIM_UNITS_COUNT) {
+    count_bind(g_shim->sampler_list[unit], sampler);
+    g_shim->sampler_list[unit] = sampler;
+  } else {
+    ++g_shim->counters.nb_state_changes;
+  }
+  return FORWARD(bind_sampler, (ctxt, sampler, unit));
+}
+
+static int
+shim_create_buffer
+  (struct rb_context* ctxt,
+   const struct rb_buffer_desc* desc,
+   const void* data,
+   struct rb_buffer** buffer)
+{
+  int err = 0;
+  COUNT(create_buffer);
+  if(!is_null_driver()) {
+    err = g_shim->driver.create_buffer(ctxt, desc, data, buffer);
+  } else if(!desc || !buffer) {
+    err = -1;
+  } else {
+    *buffer = null_handle();
+  }
+  if(!err && !register_object(*buffer, desc->size)) {
+    if(!is_null_driver())
+      g_shim->driver.buffer_ref_put(*buffer);
+    err = -1;
+  }
+  return err;
+}
+
+static int
+shim_buffer_ref_get(struct rb_buffer* buffer)
+{
+  COUNT(buffer_ref_get);
+  object_ref_get(buffer);
+  return FORWARD(buffer_ref_get, (buffer));
+}
+
+static int
+shim_buffer_ref_put(struct rb_buffer* buffer)
+{
+  COUNT(buffer_ref_put);
+  object_ref_put(buffer);
+  return FORWARD(buffer_ref_put, (buffer));
+}
+
+static int
+shim_buffer_data
+  (struct rb_buffer* buffer,
+   int offset,
+   int size,
+   const void* data)
+{
+  const struct object_entry* entry = NULL;
+  COUNT(buffer_data);
+  if(offset >= 0 && size >= 0) {
+    entry = find_object(buffer);
+    count_upload
+      ((size_t)size, entry && (size_t)offset + (size_t)size > entry->size);
+  } else {
+    ++g_shim->counters.nb_oversized_uploads;
+  }
+  return FORWARD(buffer_data, (buffer, offset, size, data));
+}
+
+static int
+shim_create_vertex_array
+  (struct rb_context* ctxt,
+   struct rb_vertex_array** array)
+{
+  COUNT(create_vertex_array);
+  if(!is_null_driver())
+    return g_shim->driver.create_vertex_array(ctxt, array);
+  if(!array)
+    return -1;
+  *array = null_handle();
+  return 0;
+}
+
+static int
+shim_vertex_array_ref_get(struct rb_vertex_array* array)
+{
+  COUNT(vertex_array_ref_get);
+  return FORWARD(vertex_array_ref_get, (array));
+}
+
+static int
+shim_vertex_array_ref_put(struct rb_vertex_array* array)
+{
+  COUNT(vertex_array_ref_put);
+  return FORWARD(vertex_array_ref_put, (array));
+}
+
+static int
+shim_bind_vertex_array
+  (struct rb_context* ctxt,
+   struct rb_vertex_array* array)
+{
+  COUNT(bind_vertex_array);
+  count_bind(g_shim->vertex_array, array);
+  g_shim->vertex_array = array;
+  return FORWARD(bind_vertex_array, (ctxt, array));
+}
+
+static int
+shim_vertex_attrib_array
+  (struct rb_vertex_array* array,
+   struct rb_buffer* buffer,
+   int count,
+   const struct rb_buffer_attrib* attrib_list)
+{
+  COUNT(vertex_attrib_array);
+  return FORWARD(vertex_attrib_array, (array, buffer, count, attrib_list));
+}
+
+static int
+shim_remove_vertex_attrib
+  (struct rb_vertex_array* array,
+   int count,
+   const int* attrib_id_list)
+{
+  COUNT(remove_vertex_attrib);
+  return FORWARD(remove_vertex_attrib, (array, count, attrib_id_list));
+}
+
+static int
+shim_vertex_index_array
+  (struct rb_vertex_array* array,
+   struct rb_buffer* buffer)
+{
+  COUNT(vertex_index_array);
+  return FORWARD(vertex_index_array, (array, buffer));
+}
+
+static int
+shim_create_shader
+  (struct rb_context* ctxt,
+   enum rb_shader_type type,
+   const char* source,
+   size_t length,
+   struct rb_shader** shader)
+{
+  COUNT(create_shader);
+  if(!is_null_driver())
+    return g_shim->driver.create_shader(ctxt, type, source, length, shader);
+  if(!source || !shader)
+    return -1;
+  *shader = null_handle();
+  return 0;
+}
+
+static int
+shim_shader_ref_get(struct rb_shader* shader)
+{
+  COUNT(shader_ref_get);
+  return FORWARD(shader_ref_get, (shader));
+}
+
+static int
+shim_shader_ref_put(struct rb_shader* shader)
+{
+  COUNT(shader_ref_put);
+  return FORWARD(shader_ref_put, (shader));
+}
+
+static int
+shim_create_program(struct rb_context* ctxt, struct rb_program** program)
+{
+  COUNT(create_program);
+  if(!is_null_driver())
+    return g_shim->driver.create_program(ctxt, program);
+  if(!program)
+    return -1;
+  *program = null_handle();
+  return 0;
+}
+
+static int
+shim_program_ref_get(struct rb_program* program)
+{
+  COUNT(program_ref_get);
+  return FORWARD(program_ref_get, (program));
+}
+
+static int
+shim_program_ref_put(struct rb_program* program)
+{
+  COUNT(program_ref_put);
+  return FORWARD(program_ref_put, (program));
+}
+
+static int
+shim_attach_shader(struct rb_program* program, struct rb_shader* shader)
+{
+  COUNT(attach_shader);
+  return FORWARD(attach_shader, (program, shader));
+}
+
+static int
+shim_link_program(struct rb_program* program)
+{
+  COUNT(link_program);
+  return FORWARD(link_program, (program));
+}
+
+static int
+shim_bind_program(struct rb_context* ctxt, struct rb_program* program)
+{
+  COUNT(bind_program);
+  count_bind(g_shim->program, program);
+  g_shim->program = program;
+  return FORWARD(bind_program, (ctxt, program));
+}
+
+static int
+shim_get_named_uniform
+  (struct rb_context* ctxt,
+   struct rb_program* program,
+   const char* name,
+   struct rb_uniform** uniform)
+{
+  COUNT(get_named_uniform);
+  if(!is_null_driver())
+    return g_shim->driver.get_named_uniform(ctxt, program, name, uniform);
+  if(!name || !uniform)
+    return -1;
+  *uniform = null_handle();
+  return 0;
+}
+
+static int
+shim_uniform_ref_get(struct rb_uniform* uniform)
+{
+  COUNT(uniform_ref_get);
+  return FORWARD(uniform_ref_get, (uniform));
+}
+
+static int
+shim_uniform_ref_put(struct rb_uniform* uniform)
+{
+  COUNT(uniform_ref_put);
+  return FORWARD(uniform_ref_put, (uniform));
+}
+
+static int
+shim_uniform_data(struct rb_uniform* uniform, int count, const void* data)
+{
+  COUNT(uniform_data);
+  return FORWARD(uniform_data, (uniform, count, data));
+}
+
+/*******************************************************************************
+ *
+ * lp_rbi_shim functions
+ *
+ ******************************************************************************/
+enum lp_error
+lp_rbi_shim_create
+  (struct mem_allocator* allocator,
+   const struct rbi* driver,
+   struct lp_rbi_shim** out_shim)
+{
+  struct lp_rbi_shim* shim = NULL;
+  struct mem_allocator* alloc = allocator ? allocator : &mem_default_allocator;
+
+  if(!out_shim || g_shim)
+    return LP_INVALID_ARGUMENT;
+  if(driver) {
+    #define RB_FUNC(func_name, ...)                                            \
+      if(!driver->func_name)                                                   \
+        return LP_INVALID_ARGUMENT;
+    #include <rb/rb_func.h>
+    #undef RB_FUNC
+  }
+
+  shim = MEM_CALLOC(alloc, 1, sizeof(struct lp_rbi_shim));
+  if(!shim)
+    return LP_MEMORY_ERROR;
+  ref_init(&shim->ref);
+  shim->allocator = alloc;
+  if(driver)
+    shim->driver = *driver;
+  g_shim = shim;
+  *out_shim = shim;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_rbi_shim_ref_get(struct lp_rbi_shim* shim)
+{
+  if(!shim)
+    return LP_INVALID_ARGUMENT;
+  ref_get(&shim->ref);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_rbi_shim_ref_put(struct lp_rbi_shim* shim)
+{
+  if(!shim)
+    return LP_INVALID_ARGUMENT;
+  ref_put(&shim->ref, release_shim);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_rbi_shim_get_rbi(struct lp_rbi_shim* shim, struct rbi* rbi)
+{
+  if(!shim || !rbi)
+    return LP_INVALID_ARGUMENT;
+  *rbi = shim->driver;
+  #define RB_FUNC(func_name, ...) rbi->func_name = shim_##func_name;
+  #include <rb/rb_func.h>
+  #undef RB_FUNC
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_rbi_shim_set_upload_limit(struct lp_rbi_shim* shim, const size_t size)
+{
+  if(!shim)
+    return LP_INVALID_ARGUMENT;
+  shim->upload_limit = size;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_rbi_shim_get_counters
+  (const struct lp_rbi_shim* shim,
+   struct lp_rbi_shim_counters* counters)
+{
+  if(!shim || !counters)
+    return LP_INVALID_ARGUMENT;
+  *counters = shim->counters;
+  counters->nb_live_objects = shim->nb_objects;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_rbi_shim_clear_counters(struct lp_rbi_shim* shim)
+{
+  if(!shim)
+    return LP_INVALID_ARGUMENT;
+  memset(&shim->counters, 0, sizeof(struct lp_rbi_shim_counters));
+  return LP_NO_ERROR;
+}
+
@@ -0,0 +1,89 @@
+#ifndef LP_RBI_SHIM_H
+#define LP_RBI_SHIM_H
+
+#include "lp.h"
+#include <stddef.h>
+
+/* Render backend interface that interposes an rbi driver. Its functions count
+ * the calls submitted to the backend by type and flag the redundant binds and
+ * state sets as well as the oversized uploads, before forwarding them to the
+ * driver. Without driver the calls are forwarded to nothing: the created
+ * objects are opaque handles that must not be given to a real backend. It is
+ * meant to check the backend cost of the library without GPU, e.g. one frame
+ * of a scene costs 1 draw. The rbi functions have no user data, hence a single
+ * shim may exist at a time. The shim is not thread safe */
+struct lp_rbi_shim;
+
+enum lp_rbi_call {
+  #define RB_FUNC(name, ...) LP_RBI_CALL_##name,
+  #include <rb/rb_func.h>
+  #undef RB_FUNC
+  LP_RBI_CALLS_COUNT
+};
+
+struct lp_rbi_shim_counters {
+  size_t nb_calls[LP_RBI_CALLS_COUNT]; /* Indexed by enum lp_rbi_call */
+  /* Calls that change the pipeline state, i.e. the blend, depth stencil and
+   * viewport sets and the program, vertex array, texture and sampler binds */
+  size_t nb_state_changes;
+  size_t nb_redundant_binds; /* Binds of the object already bound */
+  size_t nb_redundant_states; /* Sets of the state already set */
+  /* Buffer updates out of the buffer range and buffer or texture updates
+   * larger than the upload limit */
+  size_t nb_oversized_uploads;
+  size_t uploaded_size; /* Bytes sent by the buffer and texture updates */
+  /* Buffers and textures created and not released yet. Not reset by the
+   * clear of the counters */
+  size_t nb_live_objects;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Fail if a shim already exists */
+LP_API enum lp_error
+lp_rbi_shim_create
+  (struct mem_allocator* allocator, /* May be NULL */
+   const struct rbi* driver, /* May be NULL <=> forward to nothing */
+   struct lp_rbi_shim** shim);
+
+LP_API enum lp_error
+lp_rbi_shim_ref_get
+  (struct lp_rbi_shim* shim);
+
+LP_API enum lp_error
+lp_rbi_shim_ref_put
+  (struct lp_rbi_shim* shim);
+
+/* Fill `rbi' with the interposing functions. It can be given to lp_create
+ * and must not be used once the shim is released */
+LP_API enum lp_error
+lp_rbi_shim_get_rbi
+  (struct lp_rbi_shim* shim,
+   struct rbi* rbi);
+
+/* Buffer or texture updates larger than `size' bytes are flagged as
+ * oversized. 0 <=> no limit, the default */
+LP_API enum lp_error
+lp_rbi_shim_set_upload_limit
+  (struct lp_rbi_shim* shim,
+   const size_t size);
+
+LP_API enum lp_error
+lp_rbi_shim_get_counters
+  (const struct lp_rbi_shim* shim,
+   struct lp_rbi_shim_counters* counters);
+
+/* Reset the counters. The tracked state is kept, i.e. a redundant bind right
+ * after the clear is still flagged */
+LP_API enum lp_error
+lp_rbi_shim_clear_counters
+  (struct lp_rbi_shim* shim);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LP_RBI_SHIM_H */
+
@@ -0,0 +1,245 @@
+#include "lp_c.h"
+#include "lp_font.h"
+#include "lp_printer_c.h"
+#include "lp_recorder.h"
+#include "lp_recorder_c.h"
+#include <snlsys/mem_allocator.h>
+#include <snlsys/snlsys.h>
+#include <string.h>
+
+struct lp_recorder {
+  struct ref ref;
+  struct lp* lp;
+
+  /* Printer state snapshot by lp_recorder_begin. Neither the printer nor its
+   * font are referenced: the reference counts are not thread safe and
+   * lp_recorder_begin may be invoked by the recording thread. The printer
+   * keeps its font alive and the font generation tells apart a font that
+   * reuses the address of a released one */
+  const struct lp_printer* printer;
+  struct lp_font* font;
+  uint32_t font_generation;
+  enum lp_printer_glyph_format glyph_format;
+  struct viewport viewport;
+
+  struct scratch scratch; /* Recorded glyphs in `glyph_format' */
+  size_t nb_glyphs;
+};
+
+struct record_context {
+  struct lp_recorder* recorder;
+  struct glyph_color color;
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+static void
+reset_recorder(struct lp_recorder* recorder)
+{
+  ASSERT(recorder);
+  recorder->printer = NULL;
+  recorder->font = NULL;
+  recorder->nb_glyphs = 0;
+  scratch_clear(&recorder->scratch);
+}
+
+static enum lp_error
+record_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width)
+{
+  struct record_context* ctxt = data;
+  struct lp_recorder* recorder = NULL;
+  void* dst = NULL;
+  (void)id, (void)width;
+  ASSERT(data && glyph);
+
+  recorder = ctxt->recorder;
+  dst = scratch_alloc
+    (&recorder->scratch, sizeof_glyph(recorder->glyph_format));
+  if(!dst)
+    return LP_MEMORY_ERROR;
+  if(recorder->glyph_format == LP_PRINTER_GLYPH_RECORD) {
+    glyph_record_write(dst, glyph, x, y, &ctxt->color);
+  } else {
+    glyph_vertices_write(dst, glyph, x, y, &ctxt->color);
+  }
+  ++recorder->nb_glyphs;
+  return LP_NO_ERROR;
+}
+
+static enum lp_error
+record_string
+  (struct lp_recorder* recorder,
+   const int x,
+   const int y,
+   const struct string_view* str,
+   const float color[3],
+   int* cur_x,
+   int* cur_y)
+{
+  struct record_context ctxt;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(recorder && recorder->font && str && color);
+
+  ctxt.recorder = recorder;
+  glyph_color_setup(&ctxt.color, color);
+  /* The string length bounds its number of glyphs */
+  lp_err = scratch_grow
+    (&recorder->scratch, str->len * sizeof_glyph(recorder->glyph_format));
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  return printer_layout_string
+    (recorder->font, &recorder->viewport, &recorder->viewport, x, y, str,
+     record_glyph, &ctxt, cur_x, cur_y, NULL);
+}
+
+static void
+release_recorder(struct ref* ref)
+{
+  struct lp* lp = NULL;
+  struct lp_recorder* recorder = NULL;
+  ASSERT(NULL != ref);
+
+  recorder = CONTAINER_OF(ref, struct lp_recorder, ref);
+
+  reset_recorder(recorder);
+  scratch_release(&recorder->scratch);
+  lp = recorder->lp;
+  MEM_FREE(lp->allocator, recorder);
+  LP(ref_put(lp));
+}
+
+/*******************************************************************************
+ *
+ * Internal recorder functions
+ *
+ ******************************************************************************/
+enum lp_error
+recorder_merge(struct lp_recorder* recorder, struct lp_printer* printer)
+{
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(recorder && printer);
+
+  if(recorder->printer == printer
+  && recorder->font == printer->font
+  && recorder->font_generation == printer->font_generation
+  && recorder->glyph_format == printer->glyph_format
+  && !memcmp(&recorder->viewport, &printer->viewport, sizeof(struct viewport))) {
+    lp_err = printer_push_glyphs
+      (printer, scratch_buffer(&recorder->scratch), recorder->nb_glyphs);
+  }
+  reset_recorder(recorder);
+  return lp_err;
+}
+
+/*******************************************************************************
+ *
+ * Recorder functions
+ *
+ ******************************************************************************/
+enum lp_error
+lp_recorder_create(struct lp* lp, struct lp_recorder** out_recorder)
+{
+  struct lp_recorder* recorder = NULL;
+
+  if(UNLIKELY(!lp || !out_recorder))
+    return LP_INVALID_ARGUMENT;
+
+  recorder = MEM_CALLOC(lp->allocator, 1, sizeof(struct lp_recorder));
+  if(UNLIKELY(!recorder))
+    return LP_MEMORY_ERROR;
+
+  ref_init(&recorder->ref);
+  recorder->lp = lp;
+  LP(ref_get(lp));
+  scratch_init(lp->allocator, &recorder->scratch);
+  *out_recorder = recorder;
+
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_recorder_ref_get(struct lp_recorder* recorder)
+{
+  if(UNLIKELY(!recorder))
+    return LP_INVALID_ARGUMENT;
+  ref_get(&recorder->ref);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_recorder_ref_put(struct lp_recorder* recorder)
+{
+  if(UNLIKELY(!recorder))
+    return LP_INVALID_ARGUMENT;
+  ref_put(&recorder->ref, release_recorder);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_recorder_begin(struct lp_recorder* recorder, struct lp_printer* printer)
+{
+  if(UNLIKELY(!recorder || !printer || !printer->font))
+    return LP_INVALID_ARGUMENT;
+
+  reset_recorder(recorder);
+  recorder->printer = printer;
+  recorder->font = printer->font;
+  recorder->font_generation = printer->font_generation;
+  recorder->glyph_format = printer->glyph_format;
+  recorder->viewport = printer->viewport;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_recorder_print_wstring
+  (struct lp_recorder* recorder,
+   const int x,
+   const int y,
+   const wchar_t* wstr,
+   const float color[3],
+   int* cur_x,
+   int* cur_y)
+{
+  struct string_view str;
+
+  if(!recorder || !wstr || !color || !recorder->font)
+    return LP_INVALID_ARGUMENT;
+  if(recorder->viewport.x1 <= recorder->viewport.x0
+  || recorder->viewport.y1 <= recorder->viewport.y0) /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+
+  string_view_init(&str, STRING_WCHAR, wstr, wcslen(wstr));
+  return record_string(recorder, x, y, &str, color, cur_x, cur_y);
+}
+
+enum lp_error
+lp_recorder_print_utf8
+  (struct lp_recorder* recorder,
+   const int x,
+   const int y,
+   const char* str,
+   const size_t len,
+   const float color[3],
+   int* cur_x,
+   int* cur_y)
+{
+  struct string_view view;
+
+  if(!recorder || (!str && len) || !color || !recorder->font)
+    return LP_INVALID_ARGUMENT;
+  if(recorder->viewport.x1 <= recorder->viewport.x0
+  || recorder->viewport.y1 <= recorder->viewport.y0) /* No printable zone */
+    return LP_INVALID_ARGUMENT;
+
+  string_view_init(&view, STRING_UTF8, str, len);
+  return record_string(recorder, x, y, &view, color, cur_x, cur_y);
+}
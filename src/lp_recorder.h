@@ -0,0 +1,74 @@
+#ifndef LP_RECORDER_H
+#define LP_RECORDER_H
+
+#include "lp.h"
+#include <wchar.h>
+
+/* A recorder lays out and writes printed glyphs without any access to the
+ * render backend. Each recorder is fed by a single thread, possibly not the
+ * one that owns the render context. The recorded glyphs are then submitted
+ * to the printer with lp_printer_print_recorder and merged at its flush.
+ *
+ * lp_recorder_begin snapshots the printer font, viewport and glyph format
+ * without referencing them, hence it can be invoked by the recording thread.
+ * The printer must not change its font while the recorder records. If the
+ * printer state changes before the recorder is merged, the recorded glyphs
+ * are discarded. Once merged, the recorder is cleared and must begin again
+ * before recording. The recorder allocations use the lp allocator, which
+ * must thus be thread safe. */
+struct lp_recorder;
+struct lp_printer;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LP_API enum lp_error
+lp_recorder_create
+  (struct lp* lp,
+   struct lp_recorder** recorder);
+
+LP_API enum lp_error
+lp_recorder_ref_get
+  (struct lp_recorder* recorder);
+
+LP_API enum lp_error
+lp_recorder_ref_put
+  (struct lp_recorder* recorder);
+
+/* Clear the recorded glyphs and set up the recorder against the current
+ * state of `printer'. Must be invoked while the printer is not modified */
+LP_API enum lp_error
+lp_recorder_begin
+  (struct lp_recorder* recorder,
+   struct lp_printer* printer);
+
+/* Record the string as lp_printer_print_wstring would print it. The layout
+ * cache of the printer is not used */
+LP_API enum lp_error
+lp_recorder_print_wstring
+  (struct lp_recorder* recorder,
+   const int x,
+   const int y,
+   const wchar_t* wstr,
+   const float color[3],
+   int* cur_x, /* May be NULL */
+   int* cur_y); /* May be NULL */
+
+/* Record the `len' first bytes of the UTF-8 string `str' */
+LP_API enum lp_error
+lp_recorder_print_utf8
+  (struct lp_recorder* recorder,
+   const int x,
+   const int y,
+   const char* str,
+   const size_t len,
+   const float color[3],
+   int* cur_x, /* May be NULL */
+   int* cur_y); /* May be NULL */
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LP_RECORDER_H */
@@ -0,0 +1,14 @@
+#ifndef LP_RECORDER_C_H
+#define LP_RECORDER_C_H
+
+#include "lp_recorder.h"
+
+/* Append the recorded glyphs to the pending glyphs of `printer' and clear the
+ * recorder. The glyphs are discarded if the printer state changed since
+ * lp_recorder_begin */
+extern enum lp_error
+recorder_merge
+  (struct lp_recorder* recorder,
+   struct lp_printer* printer);
+
+#endif /* LP_RECORDER_C_H */
@@ -0,0 +1,114 @@
+#include "lp_c.h"
+#include "lp_render_state_c.h"
+#include <rb/rbi.h>
+#include <snlsys/snlsys.h>
+#include <string.h>
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+static void
+blend(struct lp* lp, const int enable)
+{
+  const struct rb_blend_desc blend_desc = {
+    .enable = enable,
+    .src_blend_RGB = RB_BLEND_SRC_ALPHA,
+    .src_blend_Alpha = RB_BLEND_ONE,
+    .dst_blend_RGB = RB_BLEND_ONE_MINUS_SRC_ALPHA,
+    .dst_blend_Alpha = RB_BLEND_ZERO,
+    .blend_op_RGB = RB_BLEND_OP_ADD,
+    .blend_op_Alpha = RB_BLEND_OP_ADD
+  };
+  ASSERT(lp);
+  RBI(lp->rbi, blend(lp->rb_ctxt, &blend_desc));
+}
+
+/*******************************************************************************
+ *
+ * Internal render state functions
+ *
+ ******************************************************************************/
+void
+render_state_setup(struct lp* lp)
+{
+  const struct rb_depth_stencil_desc depth_stencil_desc = {
+    .enable_depth_test = 0,
+    .enable_depth_write = 0,
+    .enable_stencil_test = 0,
+    .front_face_op.write_mask = 0,
+    .back_face_op.write_mask = 0
+  };
+  ASSERT(lp);
+
+  render_state_invalidate(lp);
+  RBI(lp->rbi, depth_stencil(lp->rb_ctxt, &depth_stencil_desc));
+  blend(lp, 1);
+}
+
+void
+render_state_reset(struct lp* lp)
+{
+  unsigned int i = 0;
+  ASSERT(lp);
+
+  blend(lp, 0);
+  RBI(lp->rbi, bind_program(lp->rb_ctxt, NULL));
+  RBI(lp->rbi, bind_vertex_array(lp->rb_ctxt, NULL));
+  for(i = 0; i < LP_TEX_UNITS_COUNT; ++i) {
+    RBI(lp->rbi, bind_tex2d(lp->rb_ctxt, NULL, i));
+    RBI(lp->rbi, bind_sampler(lp->rb_ctxt, NULL, i));
+  }
+  render_state_invalidate(lp);
+}
+
+void
+render_state_invalidate(struct lp* lp)
+{
+  ASSERT(lp);
+  lp->state.is_viewport_set = 0;
+  lp->state.program = NULL;
+  memset(lp->state.sampler_list, 0, sizeof(lp->state.sampler_list));
+}
+
+void
+render_state_viewport(struct lp* lp, const struct rb_viewport_desc* viewport)
+{
+  struct render_state* state = NULL;
+  ASSERT(lp && viewport);
+
+  state = &lp->state;
+  if(state->is_viewport_set
+  && state->viewport.x == viewport->x
+  && state->viewport.y == viewport->y
+  && state->viewport.width == viewport->width
+  && state->viewport.height == viewport->height)
+    return;
+  RBI(lp->rbi, viewport(lp->rb_ctxt, viewport));
+  state->viewport = *viewport;
+  state->is_viewport_set = 1;
+}
+
+void
+render_state_bind_program(struct lp* lp, struct rb_program* program)
+{
+  ASSERT(lp);
+  if(lp->state.program == program)
+    return;
+  RBI(lp->rbi, bind_program(lp->rb_ctxt, program));
+  lp->state.program = program;
+}
+
+void
+render_state_bind_sampler
+  (struct lp* lp,
+   struct rb_sampler* sampler,
+   const unsigned int unit)
+{
+  ASSERT(lp && unit < LP_TEX_UNITS_COUNT);
+  if(lp->state.sampler_list[unit] == sampler)
+    return;
+  RBI(lp->rbi, bind_sampler(lp->rb_ctxt, sampler, unit));
+  lp->state.sampler_list[unit] = sampler;
+}
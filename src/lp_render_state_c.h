@@ -0,0 +1,54 @@
+#ifndef LP_RENDER_STATE_C_H
+#define LP_RENDER_STATE_C_H
+
+#include <rb/rb_types.h>
+
+#define LP_TEX_UNITS_COUNT 2 /* Number of texture units used by the library */
+
+struct lp;
+
+/* Render state last submitted to the render backend. The state calls that
+ * would not change it are skipped. The textures and the vertex arrays are not
+ * tracked since the backend may re-bind them on resource updates. */
+struct render_state {
+  int is_in_frame; /* Between lp_begin_frame and lp_end_frame */
+  int is_viewport_set;
+  struct rb_viewport_desc viewport;
+  struct rb_program* program;
+  struct rb_sampler* sampler_list[LP_TEX_UNITS_COUNT];
+};
+
+/* Set the state shared by all the draws, i.e. no depth/stencil test and the
+ * glyph blending, and forget the tracked state */
+extern void
+render_state_setup
+  (struct lp* lp);
+
+/* Unbind the library resources and disable the blending */
+extern void
+render_state_reset
+  (struct lp* lp);
+
+/* Forget the tracked state, e.g. when a tracked resource is released. The
+ * next state calls are all submitted */
+extern void
+render_state_invalidate
+  (struct lp* lp);
+
+extern void
+render_state_viewport
+  (struct lp* lp,
+   const struct rb_viewport_desc* viewport);
+
+extern void
+render_state_bind_program
+  (struct lp* lp,
+   struct rb_program* program);
+
+extern void
+render_state_bind_sampler
+  (struct lp* lp,
+   struct rb_sampler* sampler,
+   const unsigned int unit);
+
+#endif /* LP_RENDER_STATE_C_H */
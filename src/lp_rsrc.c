@@ -0,0 +1,336 @@
+#include "lp_c.h"
+#include "lp_rsrc_c.h"
+#include <rb/rbi.h>
+#include <snlsys/mem_allocator.h>
+#include <snlsys/snlsys.h>
+#include <float.h>
+#include <string.h>
+
+/*******************************************************************************
+ *
+ * Embedded shader sources
+ *
+ ******************************************************************************/
+static const char* print_vs_src =
+  "#version 330\n"
+  "layout(location =" STR(LP_GLYPH_ATTRIB_POSITION_ID) ") in vec3 pos;\n"
+  "layout(location =" STR(LP_GLYPH_ATTRIB_TEXCOORD_ID) ") in vec2 tex;\n"
+  "layout(location =" STR(LP_GLYPH_ATTRIB_COLOR_ID) ") in vec3 col;\n"
+  "uniform vec3 scale;\n"
+  "uniform vec3 bias;\n"
+  "smooth out vec2 glyph_tex;\n"
+  "flat   out vec3 glyph_col;\n"
+  "void main()\n"
+  "{\n"
+  "  glyph_tex = tex;\n"
+  "  glyph_col = col;\n"
+  "  gl_Position = vec4(pos * scale + bias, 1.f);\n"
+  "}\n";
+
+/* Expand the glyph record `first_glyph + gl_VertexID / 4' into the quad corner
+ * `gl_VertexID % 4'. A record is made of 5 RGBA8 texels storing the int16
+ * quad bounds, the uint16 normalized texture coordinates and the RGBA8
+ * color, each 16 bits value being stored as little endian. */
+static const char* print_record_vs_src =
+  "#version 330\n"
+  "uniform sampler2D glyph_records;\n"
+  "uniform vec3 tint;\n"
+  "uniform vec3 scale;\n"
+  "uniform vec3 bias;\n"
+  "uniform int first_glyph;\n"
+  "smooth out vec2 glyph_tex;\n"
+  "flat   out vec3 glyph_col;\n"
+  "vec4 fetch(int glyph, int texel)\n"
+  "{\n"
+  "  ivec2 coord = ivec2\n"
+  "    ((glyph % " STR(LP_GLYPH_RECORDS_PER_ROW) ")\n"
+  "     * " STR(LP_GLYPH_RECORD_TEXELS_COUNT) " + texel,\n"
+  "     glyph / " STR(LP_GLYPH_RECORDS_PER_ROW) ");\n"
+  "  return floor(texelFetch(glyph_records, coord, 0) * 255.f + 0.5f);\n"
+  "}\n"
+  "vec2 unpack_u16(vec4 texel)\n"
+  "{\n"
+  "  return texel.xz + texel.yw * 256.f;\n"
+  "}\n"
+  "vec2 unpack_i16(vec4 texel)\n"
+  "{\n"
+  "  vec2 val = unpack_u16(texel);\n"
+  "  return val - step(32768.f, val) * 65536.f;\n"
+  "}\n"
+  "void main()\n"
+  "{\n"
+  "  int glyph = first_glyph + gl_VertexID / 4;\n"
+  "  int corner = gl_VertexID % 4;\n"
+  "  vec4 pos = vec4(unpack_i16(fetch(glyph, 0)), unpack_i16(fetch(glyph, 1)));\n"
+  "  vec4 tex = vec4\n"
+  "    (unpack_u16(fetch(glyph, 2)), unpack_u16(fetch(glyph, 3))) / 65535.f;\n"
+  "  /* Corners: bottom left, top left, top right and bottom right */\n"
+  "  bool right = corner >= 2;\n"
+  "  bool top = corner == 1 || corner == 2;\n"
+  "  glyph_tex = vec2(right ? tex.z : tex.x, top ? tex.y : tex.w);\n"
+  "  glyph_col = fetch(glyph, 4).rgb / 255.f * tint;\n"
+  "  gl_Position = vec4\n"
+  "    (vec3(right ? pos.z : pos.x, top ? pos.y : pos.w, 0.f) * scale + bias,\n"
+  "     1.f);\n"
+  "}\n";
+
+static const char* print_fs_src =
+  "#version 330\n"
+  "uniform sampler2D glyph_cache;\n"
+  "smooth in vec2 glyph_tex;\n"
+  "flat   in vec3 glyph_col;\n"
+  "out vec4 color;\n"
+  "void main()\n"
+  "{\n"
+  "  float val = texture(glyph_cache, glyph_tex).r;\n"
+  "  color = vec4(val * glyph_col, val);\n"
+  "}\n";
+
+/* The grid cells are opaque quads whose texture coordinates extrapolate those
+ * of the cell glyph. The texels out of the glyph bounds are background */
+static const char* grid_vs_src =
+  "#version 330\n"
+  "layout(location =" STR(LP_GRID_ATTRIB_POSITION_ID) ") in vec2 pos;\n"
+  "layout(location =" STR(LP_GRID_ATTRIB_TEXCOORD_ID) ") in vec2 tex;\n"
+  "layout(location =" STR(LP_GRID_ATTRIB_TEX_BOUNDS_ID) ") in vec4 bounds;\n"
+  "layout(location =" STR(LP_GRID_ATTRIB_FG_ID) ") in vec3 fg;\n"
+  "layout(location =" STR(LP_GRID_ATTRIB_BG_ID) ") in vec3 bg;\n"
+  "uniform vec3 scale;\n"
+  "uniform vec3 bias;\n"
+  "smooth out vec2 cell_tex;\n"
+  "flat   out vec4 cell_bounds;\n"
+  "flat   out vec3 cell_fg;\n"
+  "flat   out vec3 cell_bg;\n"
+  "void main()\n"
+  "{\n"
+  "  cell_tex = tex;\n"
+  "  cell_bounds = bounds;\n"
+  "  cell_fg = fg;\n"
+  "  cell_bg = bg;\n"
+  "  gl_Position = vec4(vec3(pos, 0.f) * scale + bias, 1.f);\n"
+  "}\n";
+
+static const char* grid_fs_src =
+  "#version 330\n"
+  "uniform sampler2D glyph_cache;\n"
+  "smooth in vec2 cell_tex;\n"
+  "flat   in vec4 cell_bounds;\n"
+  "flat   in vec3 cell_fg;\n"
+  "flat   in vec3 cell_bg;\n"
+  "out vec4 color;\n"
+  "void main()\n"
+  "{\n"
+  "  bool in_glyph =\n"
+  "     all(greaterThanEqual(cell_tex, cell_bounds.xy))\n"
+  "  && all(lessThanEqual(cell_tex, cell_bounds.zw));\n"
+  "  float val = in_glyph ? texture(glyph_cache, cell_tex).r : 0.f;\n"
+  "  color = vec4(mix(cell_bg, cell_fg, val), 1.f);\n"
+  "}\n";
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+static void
+setup_shading
+  (struct rsrc* rsrc,
+   struct shading* shading,
+   struct rb_shader* fragment_shader,
+   const int has_records)
+{
+  struct rbi* rbi = NULL;
+  struct rb_context* ctxt = NULL;
+  ASSERT(rsrc && shading && shading->vertex_shader && fragment_shader);
+
+  rbi = rsrc->lp->rbi;
+  ctxt = rsrc->lp->rb_ctxt;
+
+  /* Shading program */
+  RBI(rbi, create_program(ctxt, &shading->program));
+  RBI(rbi, attach_shader(shading->program, shading->vertex_shader));
+  RBI(rbi, attach_shader(shading->program, fragment_shader));
+  RBI(rbi, link_program(shading->program));
+
+  /* Uniforms */
+  RBI(rbi, get_named_uniform
+    (ctxt, shading->program, "glyph_cache", &shading->uniform_sampler));
+  RBI(rbi, get_named_uniform
+    (ctxt, shading->program, "scale", &shading->uniform_scale));
+  RBI(rbi, get_named_uniform
+    (ctxt, shading->program, "bias", &shading->uniform_bias));
+  if(has_records) {
+    RBI(rbi, get_named_uniform
+      (ctxt, shading->program, "glyph_records", &shading->uniform_records));
+    RBI(rbi, get_named_uniform
+      (ctxt, shading->program, "tint", &shading->uniform_tint));
+    RBI(rbi, get_named_uniform
+      (ctxt, shading->program, "first_glyph", &shading->uniform_first_glyph));
+  }
+}
+
+static void
+rsrc_rb_init(struct rsrc* rsrc)
+{
+  struct rb_sampler_desc sampler_desc;
+  struct rbi* rbi = NULL;
+  struct rb_context* ctxt = NULL;
+  int i = 0;
+  ASSERT(rsrc);
+
+  rbi = rsrc->lp->rbi;
+  ctxt = rsrc->lp->rb_ctxt;
+
+  #define REGISTER_ATTRIB(Id, Index, Type, Offset )                            \
+    {                                                                          \
+      rsrc->glyph_attrib_list[Id].index = Index;                               \
+      rsrc->glyph_attrib_list[Id].stride = LP_SIZEOF_GLYPH_VERTEX;             \
+      rsrc->glyph_attrib_list[Id].offset = Offset;                             \
+      rsrc->glyph_attrib_list[Id].type = Type;                                 \
+    } (void)0
+  REGISTER_ATTRIB(0, LP_GLYPH_ATTRIB_POSITION_ID, RB_FLOAT3, 0 * sizeof(float));
+  REGISTER_ATTRIB(1, LP_GLYPH_ATTRIB_TEXCOORD_ID, RB_FLOAT2, 3 * sizeof(float));
+  REGISTER_ATTRIB(2, LP_GLYPH_ATTRIB_COLOR_ID,    RB_FLOAT3, 5 * sizeof(float));
+  #undef REGISTER_ATTRIB
+
+  /* Sampler */
+  sampler_desc.filter = RB_MIN_POINT_MAG_POINT_MIP_POINT;
+  sampler_desc.address_u = RB_ADDRESS_CLAMP;
+  sampler_desc.address_v = RB_ADDRESS_CLAMP;
+  sampler_desc.address_w = RB_ADDRESS_CLAMP;
+  sampler_desc.lod_bias = 0;
+  sampler_desc.min_lod = -FLT_MAX;
+  sampler_desc.max_lod = FLT_MAX;
+  sampler_desc.max_anisotropy = 1;
+  RBI(rbi, create_sampler(ctxt, &sampler_desc, &rsrc->sampler));
+
+  /* Shaders */
+  RBI(rbi, create_shader
+    (ctxt, RB_VERTEX_SHADER, print_vs_src, strlen(print_vs_src),
+     &rsrc->shading_list[LP_PRINTER_GLYPH_VERTICES].vertex_shader));
+  RBI(rbi, create_shader
+    (ctxt, RB_VERTEX_SHADER, print_record_vs_src, strlen(print_record_vs_src),
+     &rsrc->shading_list[LP_PRINTER_GLYPH_RECORD].vertex_shader));
+  RBI(rbi, create_shader
+    (ctxt, RB_FRAGMENT_SHADER, print_fs_src, strlen(print_fs_src),
+     &rsrc->fragment_shader));
+  RBI(rbi, create_shader
+    (ctxt, RB_VERTEX_SHADER, grid_vs_src, strlen(grid_vs_src),
+     &rsrc->grid_shading.vertex_shader));
+  RBI(rbi, create_shader
+    (ctxt, RB_FRAGMENT_SHADER, grid_fs_src, strlen(grid_fs_src),
+     &rsrc->grid_fragment_shader));
+
+  for(i = 0; i < LP_PRINTER_GLYPH_FORMATS_COUNT; ++i) {
+    setup_shading
+      (rsrc, rsrc->shading_list + i, rsrc->fragment_shader,
+       i == LP_PRINTER_GLYPH_RECORD);
+  }
+  setup_shading(rsrc, &rsrc->grid_shading, rsrc->grid_fragment_shader, 0);
+}
+
+static void
+release_shading(struct rbi* rbi, struct shading* shading)
+{
+  ASSERT(rbi && shading);
+  #define REF_PUT(Type, Data) if(Data) RBI(rbi, Type ## _ref_put(Data))
+  REF_PUT(shader, shading->vertex_shader);
+  REF_PUT(program, shading->program);
+  REF_PUT(uniform, shading->uniform_sampler);
+  REF_PUT(uniform, shading->uniform_records);
+  REF_PUT(uniform, shading->uniform_tint);
+  REF_PUT(uniform, shading->uniform_first_glyph);
+  REF_PUT(uniform, shading->uniform_scale);
+  REF_PUT(uniform, shading->uniform_bias);
+  #undef REF_PUT
+}
+
+static void
+release_rsrc(struct ref* ref)
+{
+  struct rsrc* rsrc = NULL;
+  struct lp* lp = NULL;
+  struct rbi* rbi = NULL;
+  int i = 0;
+  ASSERT(NULL != ref);
+
+  rsrc = CONTAINER_OF(ref, struct rsrc, ref);
+  lp = rsrc->lp;
+  rbi = lp->rbi;
+
+  for(i = 0; i < LP_PRINTER_GLYPH_FORMATS_COUNT; ++i)
+    release_shading(rbi, rsrc->shading_list + i);
+  release_shading(rbi, &rsrc->grid_shading);
+  if(rsrc->fragment_shader)
+    RBI(rbi, shader_ref_put(rsrc->fragment_shader));
+  if(rsrc->grid_fragment_shader)
+    RBI(rbi, shader_ref_put(rsrc->grid_fragment_shader));
+  if(rsrc->sampler)
+    RBI(rbi, sampler_ref_put(rsrc->sampler));
+  if(rsrc->glyph_index_buffer)
+    RBI(rbi, buffer_ref_put(rsrc->glyph_index_buffer));
+
+  /* The released program and sampler may still be tracked as bound */
+  render_state_invalidate(lp);
+  lp->rsrc = NULL;
+  MEM_FREE(lp->allocator, rsrc);
+}
+
+/*******************************************************************************
+ *
+ * Internal resources functions
+ *
+ ******************************************************************************/
+enum lp_error
+rsrc_get(struct lp* lp, struct rsrc** out_rsrc)
+{
+  struct rsrc* rsrc = NULL;
+  ASSERT(lp && out_rsrc);
+
+  if(lp->rsrc) {
+    ref_get(&lp->rsrc->ref);
+    *out_rsrc = lp->rsrc;
+    return LP_NO_ERROR;
+  }
+
+  rsrc = MEM_CALLOC(lp->allocator, 1, sizeof(struct rsrc));
+  if(!rsrc)
+    return LP_MEMORY_ERROR;
+  ref_init(&rsrc->ref);
+  rsrc->lp = lp;
+  rsrc_rb_init(rsrc);
+  lp->rsrc = rsrc;
+  *out_rsrc = rsrc;
+  return LP_NO_ERROR;
+}
+
+void
+rsrc_ref_put(struct rsrc* rsrc)
+{
+  ASSERT(rsrc);
+  ref_put(&rsrc->ref, release_rsrc);
+}
+
+enum lp_error
+rsrc_get_glyph_index_buffer
+  (struct rsrc* rsrc,
+   const uint32_t nb_glyphs,
+   struct rb_buffer** index_buffer)
+{
+  ASSERT(rsrc && nb_glyphs && index_buffer);
+
+  if(nb_glyphs > rsrc->nb_indexed_glyphs) {
+    struct rb_buffer* buffer = NULL;
+    const enum lp_error lp_err =
+      create_glyph_index_buffer(rsrc->lp, nb_glyphs, &buffer);
+    if(lp_err != LP_NO_ERROR)
+      return lp_err;
+    if(rsrc->glyph_index_buffer)
+      RBI(rsrc->lp->rbi, buffer_ref_put(rsrc->glyph_index_buffer));
+    rsrc->glyph_index_buffer = buffer;
+    rsrc->nb_indexed_glyphs = nb_glyphs;
+  }
+  RBI(rsrc->lp->rbi, buffer_ref_get(rsrc->glyph_index_buffer));
+  *index_buffer = rsrc->glyph_index_buffer;
+  return LP_NO_ERROR;
+}
@@ -0,0 +1,45 @@
+#ifndef LP_RSRC_C_H
+#define LP_RSRC_C_H
+
+#include "lp_printer_c.h"
+#include <snlsys/ref_count.h>
+
+/* Immutable GPU resources shared by the printers of a struct lp. They are
+ * created by the first printer and released with the last one. */
+struct rsrc {
+  struct ref ref;
+  struct lp* lp; /* Not referenced. The owners of the resources reference it */
+
+  struct rb_buffer_attrib glyph_attrib_list[LP_GLYPH_ATTRIBS_COUNT];
+  struct shading shading_list[LP_PRINTER_GLYPH_FORMATS_COUNT];
+  struct shading grid_shading;
+  struct rb_shader* fragment_shader;
+  struct rb_shader* grid_fragment_shader;
+  struct rb_sampler* sampler;
+
+  /* Index buffer of the largest number of glyphs requested so far */
+  struct rb_buffer* glyph_index_buffer;
+  uint32_t nb_indexed_glyphs;
+};
+
+/* Return the shared resources of `lp', created if they do not exist yet. The
+ * returned resources are referenced by the caller */
+extern enum lp_error
+rsrc_get
+  (struct lp* lp,
+   struct rsrc** rsrc);
+
+extern void
+rsrc_ref_put
+  (struct rsrc* rsrc);
+
+/* Return a reference onto a shared index buffer of at least `nb_glyphs' glyph
+ * quads. A larger buffer replaces the shared one; the previous buffer is kept
+ * alive by the references of the vertex arrays that use it */
+extern enum lp_error
+rsrc_get_glyph_index_buffer
+  (struct rsrc* rsrc,
+   const uint32_t nb_glyphs,
+   struct rb_buffer** index_buffer);
+
+#endif /* LP_RSRC_C_H */
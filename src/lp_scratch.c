@@ -0,0 +1,75 @@
+#include "lp_scratch_c.h"
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <string.h>
+
+void
+scratch_init(struct mem_allocator* allocator, struct scratch* scratch)
+{
+  ASSERT(allocator && scratch);
+  memset(scratch, 0, sizeof(struct scratch));
+  scratch->allocator = allocator;
+}
+
+enum lp_error
+scratch_reserve(struct scratch* scratch, size_t size)
+{
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(scratch && scratch->allocator);
+
+  if(size <= scratch->size)
+    return LP_NO_ERROR;
+
+  if(scratch->buffer) {
+    scratch->buffer = MEM_REALLOC(scratch->allocator, scratch->buffer, size);
+  } else {
+    scratch->buffer = MEM_ALIGNED_ALLOC(scratch->allocator, size, 16);
+    memset(scratch->buffer, 0, size);
+  }
+  if(!scratch->buffer) {
+    lp_err = LP_MEMORY_ERROR;
+    goto error;
+  }
+  scratch->size = size;
+
+exit:
+  return lp_err;
+error:
+  if(scratch->buffer) {
+    MEM_FREE(scratch->allocator, scratch->buffer);
+    scratch->buffer = NULL;
+  }
+  scratch->size = 0;
+  scratch->id = 0;
+  goto exit;
+}
+
+enum lp_error
+scratch_grow(struct scratch* scratch, size_t size)
+{
+  ASSERT(scratch);
+  if(scratch->id + size <= scratch->size)
+    return LP_NO_ERROR;
+  return scratch_reserve(scratch, MAX(scratch->id + size, scratch->size * 2));
+}
+
+void
+scratch_release(struct scratch* scratch)
+{
+  ASSERT(scratch && scratch->allocator);
+  MEM_FREE(scratch->allocator, scratch->buffer);
+}
+
+enum lp_error
+scratch_push_back(struct scratch* scratch, const void* data, size_t size)
+{
+  void* mem = NULL;
+  ASSERT(scratch && data);
+
+  mem = scratch_alloc(scratch, size);
+  if(!mem)
+    return LP_MEMORY_ERROR;
+  memcpy(mem, data, size);
+  return LP_NO_ERROR;
+}
+
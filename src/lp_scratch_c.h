@@ -0,0 +1,82 @@
+#ifndef LP_SCRATCH_C_H
+#define LP_SCRATCH_C_H
+
+#include "lp_error.h"
+#include <snlsys/snlsys.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct mem_allocator;
+
+/* Minimal scratch data structure */
+struct scratch {
+  struct mem_allocator* allocator;
+  void* buffer;
+  size_t size;
+  size_t id;
+};
+
+/*******************************************************************************
+ *
+ * Minimal implementation of a growable scratch buffer
+ *
+ ******************************************************************************/
+extern void
+scratch_init
+  (struct mem_allocator* allocator,
+   struct scratch* scratch);
+
+extern enum lp_error
+scratch_reserve
+  (struct scratch* scratch,
+   size_t size);
+
+/* Ensure that `size' bytes can be appended to the scratch without further
+ * allocation. The scratch grows geometrically to amortize the successive
+ * reservations */
+extern enum lp_error
+scratch_grow
+  (struct scratch* scratch,
+   size_t size);
+
+extern void
+scratch_release
+  (struct scratch* scratch);
+
+extern enum lp_error
+scratch_push_back
+  (struct scratch* scratch,
+   const void* data,
+   size_t size);
+
+static FINLINE void
+scratch_clear(struct scratch* scratch)
+{
+  ASSERT(scratch);
+  scratch->id = 0;
+}
+
+/* Append `size' uninitialized bytes to the scratch and return their address
+ * in order to write the data in place. Return NULL on allocation error */
+static FINLINE void*
+scratch_alloc(struct scratch* scratch, const size_t size)
+{
+  void* mem = NULL;
+  ASSERT(scratch);
+  if(UNLIKELY(scratch->id + size > scratch->size)
+  && scratch_grow(scratch, size) != LP_NO_ERROR)
+    return NULL;
+  mem = (void*)((uintptr_t)scratch->buffer + scratch->id);
+  scratch->id += size;
+  return mem;
+}
+
+static FINLINE void*
+scratch_buffer(struct scratch* scratch)
+{
+  ASSERT(scratch);
+  return scratch->buffer;
+}
+
+#endif /* LP_SCRATCH_C_H */
+
@@ -0,0 +1,236 @@
+#include "lp_c.h"
+#include "lp_printer_c.h"
+#include "lp_scrollback.h"
+#include "lp_scrollback_c.h"
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <snlsys/snlsys.h>
+#include <string.h>
+
+#define LP_SCROLLBACK_LINES_COUNT_DEFAULT 1024
+
+struct lp_scrollback {
+  struct ref ref;
+  struct lp* lp;
+
+  /* Ring of lines. The oldest line is `line_list[first]' */
+  struct scrollback_line* line_list;
+  size_t max_nb_lines;
+  size_t first;
+  size_t nb_lines;
+
+  struct layout_stamp stamp; /* Layout with which the lines were measured */
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+static void
+release_lines(struct lp_scrollback* scrollback)
+{
+  size_t i = 0;
+  ASSERT(scrollback);
+
+  for(i = 0; i < scrollback->max_nb_lines; ++i) {
+    if(scrollback->line_list[i].wstr)
+      MEM_FREE(scrollback->lp->allocator, scrollback->line_list[i].wstr);
+  }
+  if(scrollback->line_list)
+    MEM_FREE(scrollback->lp->allocator, scrollback->line_list);
+  scrollback->line_list = NULL;
+  scrollback->max_nb_lines = 0;
+  scrollback->first = 0;
+  scrollback->nb_lines = 0;
+}
+
+static void
+release_scrollback(struct ref* ref)
+{
+  struct lp* lp = NULL;
+  struct lp_scrollback* scrollback = NULL;
+  ASSERT(NULL != ref);
+
+  scrollback = CONTAINER_OF(ref, struct lp_scrollback, ref);
+
+  release_lines(scrollback);
+  lp = scrollback->lp;
+  MEM_FREE(lp->allocator, scrollback);
+  LP(ref_put(lp));
+}
+
+/*******************************************************************************
+ *
+ * Internal scrollback functions
+ *
+ ******************************************************************************/
+void
+scrollback_sync
+  (struct lp_scrollback* scrollback,
+   const struct lp_printer* printer)
+{
+  size_t i = 0;
+  ASSERT(scrollback && printer);
+
+  if(!layout_stamp_sync(&scrollback->stamp, printer))
+    return;
+  for(i = 0; i < scrollback->max_nb_lines; ++i)
+    scrollback->line_list[i].nb_rows = 0;
+}
+
+struct scrollback_line*
+scrollback_get_line(struct lp_scrollback* scrollback, const size_t id)
+{
+  ASSERT(scrollback);
+  if(id >= scrollback->nb_lines)
+    return NULL;
+  return scrollback->line_list
+    + (scrollback->first + scrollback->nb_lines - 1 - id)
+    % scrollback->max_nb_lines;
+}
+
+/*******************************************************************************
+ *
+ * lp_scrollback functions
+ *
+ ******************************************************************************/
+enum lp_error
+lp_scrollback_create(struct lp* lp, struct lp_scrollback** out_scrollback)
+{
+  struct lp_scrollback* scrollback = NULL;
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(UNLIKELY(!lp || !out_scrollback))
+    return LP_INVALID_ARGUMENT;
+
+  scrollback = MEM_CALLOC(lp->allocator, 1, sizeof(struct lp_scrollback));
+  if(UNLIKELY(!scrollback))
+    return LP_MEMORY_ERROR;
+
+  ref_init(&scrollback->ref);
+  scrollback->lp = lp;
+  LP(ref_get(lp));
+  lp_err = lp_scrollback_set_max_lines
+    (scrollback, LP_SCROLLBACK_LINES_COUNT_DEFAULT);
+  if(lp_err != LP_NO_ERROR) {
+    LP(scrollback_ref_put(scrollback));
+    return lp_err;
+  }
+  *out_scrollback = scrollback;
+
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_scrollback_ref_get(struct lp_scrollback* scrollback)
+{
+  if(UNLIKELY(!scrollback))
+    return LP_INVALID_ARGUMENT;
+  ref_get(&scrollback->ref);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_scrollback_ref_put(struct lp_scrollback* scrollback)
+{
+  if(UNLIKELY(!scrollback))
+    return LP_INVALID_ARGUMENT;
+  ref_put(&scrollback->ref, release_scrollback);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_scrollback_set_max_lines
+  (struct lp_scrollback* scrollback,
+   const size_t max_nb_lines)
+{
+  struct scrollback_line* line_list = NULL;
+  size_t nb_lines = 0;
+  size_t i = 0;
+
+  if(UNLIKELY(!scrollback || !max_nb_lines))
+    return LP_INVALID_ARGUMENT;
+  if(max_nb_lines == scrollback->max_nb_lines)
+    return LP_NO_ERROR;
+
+  line_list = MEM_CALLOC
+    (scrollback->lp->allocator, max_nb_lines, sizeof(struct scrollback_line));
+  if(!line_list)
+    return LP_MEMORY_ERROR;
+
+  /* Move the most recent lines in order, from the oldest kept one */
+  nb_lines = MIN(scrollback->nb_lines, max_nb_lines);
+  for(i = 0; i < nb_lines; ++i) {
+    struct scrollback_line* line =
+      scrollback_get_line(scrollback, nb_lines - 1 - i);
+    line_list[i] = *line;
+    memset(line, 0, sizeof(struct scrollback_line));
+  }
+  release_lines(scrollback);
+  scrollback->line_list = line_list;
+  scrollback->max_nb_lines = max_nb_lines;
+  scrollback->nb_lines = nb_lines;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_scrollback_push_wstring
+  (struct lp_scrollback* scrollback,
+   const wchar_t* wstr,
+   const float color[3])
+{
+  struct scrollback_line* line = NULL;
+  size_t len = 0;
+
+  if(UNLIKELY(!scrollback || !wstr || !color))
+    return LP_INVALID_ARGUMENT;
+
+  /* Re-use the memory of the evicted line if the ring is full */
+  line = scrollback->line_list
+    + (scrollback->first + scrollback->nb_lines) % scrollback->max_nb_lines;
+  len = wcslen(wstr);
+  if(len + 1 > line->capacity) {
+    wchar_t* dst = MEM_REALLOC
+      (scrollback->lp->allocator, line->wstr, (len + 1) * sizeof(wchar_t));
+    if(!dst)
+      return LP_MEMORY_ERROR;
+    line->wstr = dst;
+    line->capacity = len + 1;
+  }
+  memcpy(line->wstr, wstr, (len + 1) * sizeof(wchar_t));
+  line->len = len;
+  line->color[0] = color[0];
+  line->color[1] = color[1];
+  line->color[2] = color[2];
+  line->nb_rows = 0;
+
+  if(scrollback->nb_lines < scrollback->max_nb_lines) {
+    ++scrollback->nb_lines;
+  } else {
+    scrollback->first = (scrollback->first + 1) % scrollback->max_nb_lines;
+  }
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_scrollback_clear(struct lp_scrollback* scrollback)
+{
+  if(UNLIKELY(!scrollback))
+    return LP_INVALID_ARGUMENT;
+  /* Keep the line memory for the next pushes */
+  scrollback->first = 0;
+  scrollback->nb_lines = 0;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_scrollback_get_lines_count
+  (const struct lp_scrollback* scrollback,
+   size_t* nb_lines)
+{
+  if(UNLIKELY(!scrollback || !nb_lines))
+    return LP_INVALID_ARGUMENT;
+  *nb_lines = scrollback->nb_lines;
+  return LP_NO_ERROR;
+}
@@ -0,0 +1,59 @@
+#ifndef LP_SCROLLBACK_H
+#define LP_SCROLLBACK_H
+
+#include "lp.h"
+#include <stddef.h>
+#include <wchar.h>
+
+/* A scrollback is a bounded history of lines, e.g. the output of a log. Once
+ * full, pushing a line evicts the oldest one. The wrapped height of each line
+ * is measured once and cached, so that printing the scrollback only lays out
+ * the lines that are visible, whatever the size of the history. */
+struct lp_scrollback;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LP_API enum lp_error
+lp_scrollback_create
+  (struct lp* lp,
+   struct lp_scrollback** scrollback);
+
+LP_API enum lp_error
+lp_scrollback_ref_get
+  (struct lp_scrollback* scrollback);
+
+LP_API enum lp_error
+lp_scrollback_ref_put
+  (struct lp_scrollback* scrollback);
+
+/* Define the maximum number of lines of the history. The most recent lines
+ * are kept. Default is 1024 */
+LP_API enum lp_error
+lp_scrollback_set_max_lines
+  (struct lp_scrollback* scrollback,
+   const size_t max_nb_lines);
+
+/* Append a copy of `wstr' as the most recent line. The line may contain new
+ * line characters */
+LP_API enum lp_error
+lp_scrollback_push_wstring
+  (struct lp_scrollback* scrollback,
+   const wchar_t* wstr,
+   const float color[3]);
+
+LP_API enum lp_error
+lp_scrollback_clear
+  (struct lp_scrollback* scrollback);
+
+LP_API enum lp_error
+lp_scrollback_get_lines_count
+  (const struct lp_scrollback* scrollback,
+   size_t* nb_lines);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LP_SCROLLBACK_H */
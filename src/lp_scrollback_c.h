@@ -0,0 +1,30 @@
+#ifndef LP_SCROLLBACK_C_H
+#define LP_SCROLLBACK_C_H
+
+#include "lp_scrollback.h"
+
+struct lp_printer;
+
+struct scrollback_line {
+  wchar_t* wstr;
+  size_t len;
+  size_t capacity; /* Number of wchar_t allocated for `wstr' */
+  float color[3];
+  int nb_rows; /* Number of wrapped rows. 0 <=> not measured yet */
+};
+
+/* Invalidate the cached line heights if they were not measured with the
+ * current font and line width of `printer' */
+extern void
+scrollback_sync
+  (struct lp_scrollback* scrollback,
+   const struct lp_printer* printer);
+
+/* Return the line printed `id' lines above the most recent one, or NULL if
+ * the history has not as many lines */
+extern struct scrollback_line*
+scrollback_get_line
+  (struct lp_scrollback* scrollback,
+   const size_t id);
+
+#endif /* LP_SCROLLBACK_C_H */
@@ -0,0 +1,173 @@
+#ifndef LP_STRING_C_H
+#define LP_STRING_C_H
+
+#include <snlsys/snlsys.h>
+#include <stddef.h>
+#include <wchar.h>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+#define LP_REPLACEMENT_CHAR 0xFFFD
+
+enum string_encoding {
+  STRING_WCHAR,
+  STRING_UTF8
+};
+
+/* Read only view onto a length delimited string. The string does not need to
+ * be NUL terminated */
+struct string_view {
+  enum string_encoding encoding;
+  const void* data;
+  size_t len; /* Number of code units, i.e. wchar_t or bytes */
+};
+
+/* Sequential decoder of the characters of a string view */
+struct string_reader {
+  const struct string_view* str;
+  size_t offset; /* Offset in code units of the next character */
+  size_t ascii_end; /* End of the UTF-8 ASCII run beginning before `offset' */
+};
+
+static FINLINE void
+string_view_init
+  (struct string_view* str,
+   const enum string_encoding encoding,
+   const void* data,
+   const size_t len)
+{
+  ASSERT(str && (data || !len));
+  str->encoding = encoding;
+  str->data = data;
+  str->len = len;
+}
+
+static FINLINE size_t
+string_view_size(const struct string_view* str)
+{
+  ASSERT(str);
+  return str->len
+    * (str->encoding == STRING_WCHAR ? sizeof(wchar_t) : sizeof(char));
+}
+
+/*******************************************************************************
+ *
+ * UTF-8 helpers
+ *
+ ******************************************************************************/
+/* Return the end of the run of ASCII bytes beginning at `begin' */
+static FINLINE size_t
+utf8_ascii_run_end
+  (const unsigned char* str,
+   const size_t begin,
+   const size_t end)
+{
+  size_t i = begin;
+  ASSERT(str && begin <= end);
+#ifdef __SSE2__
+  /* Skip 16 bytes at once while none of them has its high bit set */
+  for(; i + 16 <= end; i += 16) {
+    const __m128i bytes = _mm_loadu_si128((const __m128i*)(str + i));
+    if(_mm_movemask_epi8(bytes))
+      break;
+  }
+#endif
+  while(i < end && str[i] < 0x80)
+    ++i;
+  return i;
+}
+
+/* Decode the multi bytes sequence at `*offset' and move the offset past it.
+ * Invalid, overlong or truncated sequences consume one byte and are decoded
+ * as the replacement character, as are the code points that do not fit in a
+ * wchar_t */
+static FINLINE wchar_t
+utf8_decode
+  (const unsigned char* str,
+   const size_t len,
+   size_t* offset)
+{
+  const unsigned char lead = str[*offset];
+  unsigned long cp = 0;
+  unsigned long cp_min = 0;
+  size_t nb_continuations = 0;
+  size_t i = 0;
+  ASSERT(str && offset && *offset < len);
+
+  if(lead >= 0xC2 && lead <= 0xDF) {
+    cp = lead & 0x1F; cp_min = 0x80; nb_continuations = 1;
+  } else if(lead >= 0xE0 && lead <= 0xEF) {
+    cp = lead & 0x0F; cp_min = 0x800; nb_continuations = 2;
+  } else if(lead >= 0xF0 && lead <= 0xF4) {
+    cp = lead & 0x07; cp_min = 0x10000; nb_continuations = 3;
+  } else {
+    goto error;
+  }
+  if(len - *offset <= nb_continuations)
+    goto error;
+  for(i = 1; i <= nb_continuations; ++i) {
+    const unsigned char byte = str[*offset + i];
+    if((byte & 0xC0) != 0x80)
+      goto error;
+    cp = (cp << 6) | (byte & 0x3F);
+  }
+  if(cp < cp_min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    goto error;
+  *offset += nb_continuations + 1;
+  return cp > (unsigned long)WCHAR_MAX ? LP_REPLACEMENT_CHAR : (wchar_t)cp;
+
+error:
+  *offset += 1;
+  return LP_REPLACEMENT_CHAR;
+}
+
+/*******************************************************************************
+ *
+ * String reader
+ *
+ ******************************************************************************/
+static FINLINE void
+string_reader_init(struct string_reader* reader, const struct string_view* str)
+{
+  ASSERT(reader && str);
+  reader->str = str;
+  reader->offset = 0;
+  reader->ascii_end = 0;
+}
+
+/* Decode the next character and return its offset in `id'. Return 0 once the
+ * whole string was read */
+static FINLINE int
+string_reader_next
+  (struct string_reader* reader,
+   size_t* id,
+   wchar_t* ch)
+{
+  const struct string_view* str = NULL;
+  ASSERT(reader && id && ch);
+
+  str = reader->str;
+  if(reader->offset >= str->len)
+    return 0;
+
+  *id = reader->offset;
+  if(str->encoding == STRING_WCHAR) {
+    *ch = ((const wchar_t*)str->data)[reader->offset++];
+  } else {
+    const unsigned char* utf8 = str->data;
+    /* ASCII fast path. The run end is found once for all its characters */
+    if(reader->offset >= reader->ascii_end && utf8[reader->offset] < 0x80) {
+      reader->ascii_end = utf8_ascii_run_end(utf8, reader->offset, str->len);
+    }
+    if(reader->offset < reader->ascii_end) {
+      *ch = (wchar_t)utf8[reader->offset++];
+    } else {
+      *ch = utf8_decode(utf8, str->len, &reader->offset);
+    }
+  }
+  return 1;
+}
+
+#endif /* LP_STRING_C_H */
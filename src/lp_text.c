@@ -0,0 +1,372 @@
+#include "lp_c.h"
+#include "lp_font.h"
+#include "lp_hit_index_c.h"
+#include "lp_printer_c.h"
+#include "lp_text.h"
+#include "lp_text_c.h"
+#include <rb/rbi.h>
+#include <snlsys/mem_allocator.h>
+#include <snlsys/snlsys.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+
+struct lp_text {
+  struct ref ref;
+  struct lp* lp;
+
+  struct lp_font* font;
+  lp_font_callback_T on_font_data_update;
+
+  wchar_t* wstr;
+  int wrap_width;
+  bool is_dirty;
+
+  /* Geometry */
+  struct rb_tex2d* record_tex;
+  struct rb_buffer* index_buffer;
+  struct rb_vertex_array* vertex_array;
+  uint32_t nb_glyphs;
+  int cur_x, cur_y;
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+static void
+release_geometry(struct lp_text* text)
+{
+  ASSERT(text);
+
+  #define REF_PUT(Type, Data)                                                  \
+    if(Data) {                                                                 \
+      RBI(text->lp->rbi, Type ## _ref_put(Data));                              \
+      Data = NULL;                                                             \
+    } (void)0
+  REF_PUT(tex2d, text->record_tex);
+  REF_PUT(buffer, text->index_buffer);
+  REF_PUT(vertex_array, text->vertex_array);
+  #undef REF_PUT
+  text->nb_glyphs = 0;
+  text->cur_x = 0;
+  text->cur_y = 0;
+}
+
+static enum lp_error
+push_glyph
+  (void* data,
+   const size_t id,
+   const struct lp_font_glyph* glyph,
+   const int x,
+   const int y,
+   const int width)
+{
+  /* The text color is applied through the tint uniform */
+  const float white[3] = { 1.f, 1.f, 1.f };
+  struct glyph_color color;
+  unsigned char* record = NULL;
+  (void)id, (void)width;
+  ASSERT(data && glyph);
+  record = scratch_alloc(data, LP_SIZEOF_GLYPH_RECORD);
+  if(!record)
+    return LP_MEMORY_ERROR;
+  glyph_color_setup(&color, white);
+  glyph_record_write(record, glyph, x, y, &color);
+  return LP_NO_ERROR;
+}
+
+static void
+on_font_data_update(struct lp_font* font, void* data)
+{
+  (void)font;
+  struct lp_text* text = data;
+  ASSERT(font && data && text->font == font);
+  text->is_dirty = true;
+}
+
+static void
+release_text(struct ref* ref)
+{
+  struct lp* lp = NULL;
+  struct lp_text* text = NULL;
+  ASSERT(NULL != ref);
+
+  text = CONTAINER_OF(ref, struct lp_text, ref);
+
+  release_geometry(text);
+  CALLBACK_DISCONNECT(&text->on_font_data_update);
+  if(text->font)
+    LP(font_ref_put(text->font));
+  if(text->wstr)
+    MEM_FREE(text->lp->allocator, text->wstr);
+  lp = text->lp;
+  MEM_FREE(lp->allocator, text);
+  LP(ref_put(lp));
+}
+
+/*******************************************************************************
+ *
+ * Internal text functions
+ *
+ ******************************************************************************/
+enum lp_error
+text_setup(struct lp_text* text)
+{
+  struct scratch scratch;
+  struct string_view str;
+  struct viewport wrap;
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(text);
+
+  if(!text->is_dirty)
+    return LP_NO_ERROR;
+
+  release_geometry(text);
+  scratch_init(text->lp->allocator, &scratch);
+  if(!text->font || !text->wstr)
+    goto exit;
+
+  /* Lay out the text in its own space, i.e. with respect to the origin */
+  wrap.x0 = 0;
+  wrap.y0 = 0;
+  wrap.x1 = text->wrap_width ? text->wrap_width : INT_MAX;
+  wrap.y1 = 0;
+  string_view_init(&str, STRING_WCHAR, text->wstr, wcslen(text->wstr));
+  /* Reserve the records of the whole string at once. Its length bounds its
+   * number of glyphs */
+  lp_err = scratch_reserve
+    (&scratch, glyph_records_size((uint32_t)str.len));
+  if(lp_err != LP_NO_ERROR)
+    goto error;
+  lp_err = printer_layout_string
+    (text->font, &wrap, NULL, 0, 0, &str, push_glyph, &scratch,
+     &text->cur_x, &text->cur_y, NULL);
+  if(lp_err != LP_NO_ERROR)
+    goto error;
+
+  text->nb_glyphs = (uint32_t)(scratch.id / LP_SIZEOF_GLYPH_RECORD);
+  if(text->nb_glyphs) {
+    struct rb_tex2d_desc tex2d_desc;
+    const size_t size = glyph_records_size(text->nb_glyphs);
+    const void* records = NULL;
+
+    /* The record texture stores whole rows of records */
+    lp_err = scratch_reserve(&scratch, size);
+    if(lp_err != LP_NO_ERROR)
+      goto error;
+    records = scratch_buffer(&scratch);
+
+    memset(&tex2d_desc, 0, sizeof(tex2d_desc));
+    tex2d_desc.width = LP_GLYPH_RECORDS_PER_ROW * LP_GLYPH_RECORD_TEXELS_COUNT;
+    tex2d_desc.height = (unsigned int)
+      (size / (LP_GLYPH_RECORDS_PER_ROW * LP_SIZEOF_GLYPH_RECORD));
+    tex2d_desc.mip_count = 1;
+    tex2d_desc.format = RB_RGBA;
+    tex2d_desc.usage = RB_USAGE_IMMUTABLE;
+    tex2d_desc.compress = 0;
+    RBI(text->lp->rbi, create_tex2d
+      (text->lp->rb_ctxt, &tex2d_desc, &records, &text->record_tex));
+
+    lp_err = create_glyph_index_buffer
+      (text->lp, text->nb_glyphs, &text->index_buffer);
+    if(lp_err != LP_NO_ERROR)
+      goto error;
+    RBI(text->lp->rbi, create_vertex_array
+      (text->lp->rb_ctxt, &text->vertex_array));
+    RBI(text->lp->rbi, vertex_index_array
+      (text->vertex_array, text->index_buffer));
+  }
+
+exit:
+  text->is_dirty = false;
+  scratch_release(&scratch);
+  return lp_err;
+error:
+  release_geometry(text);
+  goto exit;
+}
+
+void
+text_draw
+  (struct lp_text* text,
+   struct shading* shading,
+   const float bias[3],
+   const float color[3])
+{
+  struct rb_tex2d* font_tex = NULL;
+  struct rbi* rbi = NULL;
+  struct rb_context* rb_ctxt = NULL;
+  ASSERT(text && shading && bias && color && !text->is_dirty);
+
+  if(!text->nb_glyphs)
+    return;
+
+  rbi = text->lp->rbi;
+  rb_ctxt = text->lp->rb_ctxt;
+  LP(font_get_texture(text->font, &font_tex));
+  RBI(rbi, bind_tex2d(rb_ctxt, font_tex, LP_FONT_TEX_UNIT));
+  RBI(rbi, bind_tex2d(rb_ctxt, text->record_tex, LP_RECORD_TEX_UNIT));
+  shading_set_bias(text->lp, shading, bias);
+  RBI(rbi, uniform_data(shading->uniform_tint, 1, color));
+  RBI(rbi, bind_vertex_array(rb_ctxt, text->vertex_array));
+  RBI(rbi, draw_indexed
+    (rb_ctxt, RB_TRIANGLE_LIST, text->nb_glyphs * LP_GLYPH_INDICES_COUNT));
+}
+
+enum lp_error
+text_index
+  (struct lp_text* text,
+   struct lp_hit_index* index,
+   const int x,
+   const int y)
+{
+  struct lp_font_metrics font_metrics;
+  struct hit_recorder recorder;
+  struct string_view str;
+  struct viewport wrap;
+  int end[2] = { 0, 0 };
+  enum lp_error lp_err = LP_NO_ERROR;
+  ASSERT(text && index);
+
+  if(!text->font || !text->wstr)
+    return LP_NO_ERROR;
+
+  /* Same layout as the text geometry, offset by the text position */
+  wrap.x0 = 0;
+  wrap.y0 = 0;
+  wrap.x1 = text->wrap_width ? text->wrap_width : INT_MAX;
+  wrap.y1 = 0;
+  string_view_init(&str, STRING_WCHAR, text->wstr, wcslen(text->wstr));
+  LP(font_get_metrics(text->font, &font_metrics));
+  lp_err = hit_index_begin_string
+    (index, &str, 0, 0, x, y, font_metrics.line_space, &recorder);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  lp_err = printer_layout_string
+    (text->font, &wrap, NULL, 0, 0, &str, hit_index_record_glyph, &recorder,
+     end + 0, end + 1, NULL);
+  hit_index_end_string(&recorder, end[0], end[1]);
+  return lp_err;
+}
+
+/*******************************************************************************
+ *
+ * lp_text functions
+ *
+ ******************************************************************************/
+enum lp_error
+lp_text_create(struct lp* lp, struct lp_text** out_text)
+{
+  struct lp_text* text = NULL;
+
+  if(UNLIKELY(!lp || !out_text))
+    return LP_INVALID_ARGUMENT;
+
+  text = MEM_CALLOC(lp->allocator, 1, sizeof(struct lp_text));
+  if(UNLIKELY(!text))
+    return LP_MEMORY_ERROR;
+
+  ref_init(&text->ref);
+  text->lp = lp;
+  LP(ref_get(lp));
+  CALLBACK_INIT(&text->on_font_data_update);
+  CALLBACK_SETUP(&text->on_font_data_update, on_font_data_update, text);
+  *out_text = text;
+
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_text_ref_get(struct lp_text* text)
+{
+  if(UNLIKELY(!text))
+    return LP_INVALID_ARGUMENT;
+  ref_get(&text->ref);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_text_ref_put(struct lp_text* text)
+{
+  if(UNLIKELY(!text))
+    return LP_INVALID_ARGUMENT;
+  ref_put(&text->ref, release_text);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_text_set_font(struct lp_text* text, struct lp_font* font)
+{
+  if(UNLIKELY(!text || !font))
+    return LP_INVALID_ARGUMENT;
+
+  if(font != text->font) {
+    if(text->font) {
+      LP(font_ref_put(text->font));
+    }
+    LP(font_ref_get(font));
+    CALLBACK_DISCONNECT(&text->on_font_data_update);
+    LP(font_signal_connect
+      (font, LP_FONT_SIGNAL_DATA_UPDATE, &text->on_font_data_update));
+    text->font = font;
+    text->is_dirty = true;
+  }
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_text_set_wstring(struct lp_text* text, const wchar_t* wstr)
+{
+  wchar_t* dst = NULL;
+  size_t len = 0;
+
+  if(UNLIKELY(!text || !wstr))
+    return LP_INVALID_ARGUMENT;
+
+  if(text->wstr && !wcscmp(text->wstr, wstr))
+    return LP_NO_ERROR;
+
+  len = wcslen(wstr);
+  dst = MEM_ALLOC(text->lp->allocator, (len + 1) * sizeof(wchar_t));
+  if(!dst)
+    return LP_MEMORY_ERROR;
+  memcpy(dst, wstr, (len + 1) * sizeof(wchar_t));
+  if(text->wstr)
+    MEM_FREE(text->lp->allocator, text->wstr);
+  text->wstr = dst;
+  text->is_dirty = true;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_text_set_wrap_width(struct lp_text* text, const int width)
+{
+  if(UNLIKELY(!text || width < 0))
+    return LP_INVALID_ARGUMENT;
+  if(width != text->wrap_width) {
+    text->wrap_width = width;
+    text->is_dirty = true;
+  }
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_text_get_cursor(struct lp_text* text, int* cur_x, int* cur_y)
+{
+  enum lp_error lp_err = LP_NO_ERROR;
+
+  if(UNLIKELY(!text))
+    return LP_INVALID_ARGUMENT;
+
+  lp_err = text_setup(text);
+  if(lp_err != LP_NO_ERROR)
+    return lp_err;
+  if(cur_x)
+    *cur_x = text->cur_x;
+  if(cur_y)
+    *cur_y = text->cur_y;
+  return LP_NO_ERROR;
+}
+
@@ -0,0 +1,60 @@
+#ifndef LP_TEXT_H
+#define LP_TEXT_H
+
+#include "lp.h"
+#include <wchar.h>
+
+/* A text is a string laid out once into GPU resident geometry. It is drawn
+ * through lp_printer_print_text with a translation and a color, and its
+ * geometry is only rebuilt when its string, its font or its wrap width
+ * changes. */
+struct lp_text;
+struct lp_font;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LP_API enum lp_error
+lp_text_create
+  (struct lp* lp,
+   struct lp_text** text);
+
+LP_API enum lp_error
+lp_text_ref_get
+  (struct lp_text* text);
+
+LP_API enum lp_error
+lp_text_ref_put
+  (struct lp_text* text);
+
+LP_API enum lp_error
+lp_text_set_font
+  (struct lp_text* text,
+   struct lp_font* font);
+
+/* The string is copied */
+LP_API enum lp_error
+lp_text_set_wstring
+  (struct lp_text* text,
+   const wchar_t* wstr);
+
+/* Width in pixels beyond which the text lines are wrapped. 0 <=> no wrap */
+LP_API enum lp_error
+lp_text_set_wrap_width
+  (struct lp_text* text,
+   const int width);
+
+/* Pen position at the end of the text, relative to the text origin */
+LP_API enum lp_error
+lp_text_get_cursor
+  (struct lp_text* text,
+   int* cur_x, /* May be NULL */
+   int* cur_y); /* May be NULL */
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LP_TEXT_H */
+
@@ -0,0 +1,33 @@
+#ifndef LP_TEXT_C_H
+#define LP_TEXT_C_H
+
+#include "lp_text.h"
+
+struct lp_hit_index;
+struct shading;
+
+/* Rebuild the text geometry if its string, font or wrap width changed */
+extern enum lp_error
+text_setup
+  (struct lp_text* text);
+
+/* Draw the text with the record shading program. The program, the samplers
+ * and the scale uniform are assumed to be already set */
+extern void
+text_draw
+  (struct lp_text* text,
+   struct shading* shading,
+   const float bias[3],
+   const float color[3]);
+
+/* Record the glyphs of the text drawn at the window position (x, y) into
+ * the hit index */
+extern enum lp_error
+text_index
+  (struct lp_text* text,
+   struct lp_hit_index* index,
+   const int x,
+   const int y);
+
+#endif /* LP_TEXT_C_H */
+
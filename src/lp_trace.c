@@ -0,0 +1,154 @@
+/* clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+#include "lp_c.h"
+#include "lp_trace.h"
+#include <snlsys/mem_allocator.h>
+#include <snlsys/ref_count.h>
+#include <snlsys/snlsys.h>
+#include <stdio.h>
+#include <time.h>
+
+struct lp_trace_chrome {
+  struct ref ref;
+  struct lp* lp;
+  FILE* stream;
+  struct timespec origin;
+  int is_empty; /* No event was written yet */
+};
+
+/*******************************************************************************
+ *
+ * Helper functions
+ *
+ ******************************************************************************/
+/* Microseconds elapsed since the creation of the trace */
+static double
+trace_time(const struct lp_trace_chrome* trace)
+{
+  struct timespec now;
+  ASSERT(trace);
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - trace->origin.tv_sec) * 1.0e6
+       + (double)(now.tv_nsec - trace->origin.tv_nsec) * 1.0e-3;
+}
+
+static void
+write_separator(struct lp_trace_chrome* trace)
+{
+  ASSERT(trace);
+  if(trace->is_empty) {
+    trace->is_empty = 0;
+  } else {
+    fputs(",\n", trace->stream);
+  }
+}
+
+/* The zone names are static identifiers that need no JSON escaping */
+static void
+begin_zone(const char* name, void* data)
+{
+  struct lp_trace_chrome* trace = data;
+  ASSERT(name && data);
+  write_separator(trace);
+  fprintf(trace->stream,
+    "{\"name\":\"%s\",\"cat\":\"lp\",\"ph\":\"B\",\"ts\":%.3f,"
+    "\"pid\":0,\"tid\":0}",
+    name, trace_time(trace));
+}
+
+static void
+end_zone(const char* name, const size_t payload, void* data)
+{
+  struct lp_trace_chrome* trace = data;
+  ASSERT(name && data);
+  write_separator(trace);
+  fprintf(trace->stream,
+    "{\"name\":\"%s\",\"cat\":\"lp\",\"ph\":\"E\",\"ts\":%.3f,"
+    "\"pid\":0,\"tid\":0,\"args\":{\"payload\":%lu}}",
+    name, trace_time(trace), (unsigned long)payload);
+}
+
+static void
+release_trace(struct ref* ref)
+{
+  struct lp* lp = NULL;
+  struct lp_trace_chrome* trace = NULL;
+  ASSERT(ref);
+
+  trace = CONTAINER_OF(ref, struct lp_trace_chrome, ref);
+  fputs("\n]\n", trace->stream);
+  fclose(trace->stream);
+  lp = trace->lp;
+  MEM_FREE(lp->allocator, trace);
+  LP(ref_put(lp));
+}
+
+/*******************************************************************************
+ *
+ * lp_trace_chrome functions
+ *
+ ******************************************************************************/
+enum lp_error
+lp_trace_chrome_create
+  (struct lp* lp,
+   const char* filename,
+   struct lp_trace_chrome** out_trace)
+{
+  struct lp_trace_chrome* trace = NULL;
+  FILE* stream = NULL;
+
+  if(!lp || !filename || !out_trace)
+    return LP_INVALID_ARGUMENT;
+
+  stream = fopen(filename, "w");
+  if(!stream)
+    return LP_UNKNOWN_ERROR;
+
+  trace = MEM_CALLOC(lp->allocator, 1, sizeof(struct lp_trace_chrome));
+  if(!trace) {
+    fclose(stream);
+    return LP_MEMORY_ERROR;
+  }
+  ref_init(&trace->ref);
+  trace->lp = lp;
+  LP(ref_get(lp));
+  trace->stream = stream;
+  trace->is_empty = 1;
+  clock_gettime(CLOCK_MONOTONIC, &trace->origin);
+  fputs("[\n", stream);
+  *out_trace = trace;
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_trace_chrome_ref_get(struct lp_trace_chrome* trace)
+{
+  if(!trace)
+    return LP_INVALID_ARGUMENT;
+  ref_get(&trace->ref);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_trace_chrome_ref_put(struct lp_trace_chrome* trace)
+{
+  if(!trace)
+    return LP_INVALID_ARGUMENT;
+  ref_put(&trace->ref, release_trace);
+  return LP_NO_ERROR;
+}
+
+enum lp_error
+lp_trace_chrome_get_hooks
+  (struct lp_trace_chrome* trace,
+   struct lp_trace_hooks* hooks)
+{
+  if(!trace || !hooks)
+    return LP_INVALID_ARGUMENT;
+  hooks->begin = begin_zone;
+  hooks->end = end_zone;
+  hooks->data = trace;
+  return LP_NO_ERROR;
+}
+
@@ -0,0 +1,45 @@
+#ifndef LP_TRACE_H
+#define LP_TRACE_H
+
+#include "lp.h"
+
+/* Trace sink that writes the zones reported by the trace hooks of an lp in
+ * the Chrome/Perfetto JSON trace format, i.e. a JSON array of duration
+ * events. The timestamps are in microseconds from the creation of the sink and
+ * the payload of a zone is the `payload' argument of its end event. The sink
+ * is not thread safe: its hooks must be set on the lps used by a single
+ * thread. The file is complete once the sink is released */
+struct lp_trace_chrome;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Return LP_UNKNOWN_ERROR if the file `filename' cannot be opened */
+LP_API enum lp_error
+lp_trace_chrome_create
+  (struct lp* lp,
+   const char* filename,
+   struct lp_trace_chrome** trace);
+
+LP_API enum lp_error
+lp_trace_chrome_ref_get
+  (struct lp_trace_chrome* trace);
+
+LP_API enum lp_error
+lp_trace_chrome_ref_put
+  (struct lp_trace_chrome* trace);
+
+/* Hooks to set with lp_set_trace_hooks. They do not reference the sink, which
+ * must outlive them */
+LP_API enum lp_error
+lp_trace_chrome_get_hooks
+  (struct lp_trace_chrome* trace,
+   struct lp_trace_hooks* hooks);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LP_TRACE_H */
+
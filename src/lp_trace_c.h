@@ -0,0 +1,36 @@
+#ifndef LP_TRACE_C_H
+#define LP_TRACE_C_H
+
+#include "lp_c.h"
+#include <snlsys/snlsys.h>
+
+/* Zones of the library work reported to the trace hooks of the lp. Without
+ * LP_TRACE, the zones are compiled out and their arguments are not
+ * evaluated */
+#ifdef LP_TRACE
+  #define LP_TRACE_BEGIN(Lp, Name) trace_begin((Lp), (Name))
+  #define LP_TRACE_END(Lp, Name, Payload) \
+    trace_end((Lp), (Name), (size_t)(Payload))
+#else
+  #define LP_TRACE_BEGIN(Lp, Name) (void)0
+  #define LP_TRACE_END(Lp, Name, Payload) (void)0
+#endif
+
+static FINLINE void
+trace_begin(struct lp* lp, const char* name)
+{
+  ASSERT(lp && name);
+  if(lp->trace.begin)
+    lp->trace.begin(name, lp->trace.data);
+}
+
+static FINLINE void
+trace_end(struct lp* lp, const char* name, const size_t payload)
+{
+  ASSERT(lp && name);
+  if(lp->trace.end)
+    lp->trace.end(name, payload, lp->trace.data);
+}
+
+#endif /* LP_TRACE_C_H */
+
@@ -0,0 +1,340 @@
+#include "lp.h"
+#include "lp_document.h"
+#include "lp_font.h"
+#include "lp_hit_index.h"
+#include "lp_printer.h"
+#include "lp_rbi_shim.h"
+#include "test_lp_utils.h"
+#include <rb/rbi.h>
+#include <snlsys/mem_allocator.h>
+#include <string.h>
+#include <wchar.h>
+
+#define BAD_ARG LP_INVALID_ARGUMENT
+#define OK LP_NO_ERROR
+
+#define NB_PARAGRAPHS 1000
+
+static void
+check_paragraph
+  (struct lp_document* document,
+   const size_t paragraph,
+   const wchar_t* ref)
+{
+  const wchar_t* wstr = NULL;
+  size_t len = 0;
+  CHECK(lp_document_get_paragraph(document, paragraph, &wstr, &len), OK);
+  CHECK(len, wcslen(ref));
+  CHECK(wcscmp(wstr, ref), 0);
+}
+
+static void
+check_hit
+  (struct lp_hit_index* index,
+   const int x,
+   const int y,
+   const size_t string,
+   const size_t offset)
+{
+  struct lp_hit hit;
+  int is_hit = 0;
+  CHECK(lp_hit_index_hit_test(index, x, y, &hit, &is_hit), OK);
+  CHECK(is_hit, 1);
+  CHECK(hit.string, string);
+  CHECK(hit.offset, offset);
+}
+
+static void
+test_edit(struct lp* lp)
+{
+  struct lp_document* document = NULL;
+  struct lp_document_pos begin;
+  struct lp_document_pos end;
+  const wchar_t* wstr = NULL;
+  size_t count = 0;
+
+  CHECK(lp_document_create(NULL, NULL), BAD_ARG);
+  CHECK(lp_document_create(lp, NULL), BAD_ARG);
+  CHECK(lp_document_create(NULL, &document), BAD_ARG);
+  CHECK(lp_document_create(lp, &document), OK);
+
+  CHECK(lp_document_get_paragraphs_count(NULL, NULL), BAD_ARG);
+  CHECK(lp_document_get_paragraphs_count(document, NULL), BAD_ARG);
+  CHECK(lp_document_get_paragraphs_count(NULL, &count), BAD_ARG);
+  CHECK(lp_document_get_paragraphs_count(document, &count), OK);
+  CHECK(count, 1);
+  CHECK(lp_document_get_paragraph(NULL, 0, &wstr, NULL), BAD_ARG);
+  CHECK(lp_document_get_paragraph(document, 1, &wstr, NULL), BAD_ARG);
+  CHECK(lp_document_get_paragraph(document, 0, NULL, NULL), BAD_ARG);
+  CHECK(lp_document_get_paragraph(document, 0, &wstr, NULL), OK);
+  check_paragraph(document, 0, L"");
+
+  CHECK(lp_document_set_wstring(NULL, L"abc"), BAD_ARG);
+  CHECK(lp_document_set_wstring(document, NULL), BAD_ARG);
+  CHECK(lp_document_set_wstring(document, L"abc\ndef\n\nghi"), OK);
+  CHECK(lp_document_get_paragraphs_count(document, &count), OK);
+  CHECK(count, 4);
+  check_paragraph(document, 0, L"abc");
+  check_paragraph(document, 1, L"def");
+  check_paragraph(document, 2, L"");
+  check_paragraph(document, 3, L"ghi");
+
+  begin.paragraph = 1;
+  begin.offset = 1;
+  CHECK(lp_document_insert_wstring(NULL, &begin, L"xy", &end), BAD_ARG);
+  CHECK(lp_document_insert_wstring(document, NULL, L"xy", &end), BAD_ARG);
+  CHECK(lp_document_insert_wstring(document, &begin, NULL, &end), BAD_ARG);
+  CHECK(lp_document_insert_wstring(document, &begin, L"xy", &end), OK);
+  CHECK(end.paragraph, 1);
+  CHECK(end.offset, 3);
+  check_paragraph(document, 1, L"dxyef");
+  CHECK(lp_document_insert_wstring(document, &end, L"z", NULL), OK);
+  check_paragraph(document, 1, L"dxyzef");
+
+  begin.offset = 7;
+  CHECK(lp_document_insert_wstring(document, &begin, L"z", NULL), BAD_ARG);
+  begin.paragraph = 4;
+  begin.offset = 0;
+  CHECK(lp_document_insert_wstring(document, &begin, L"z", NULL), BAD_ARG);
+
+  /* The new lines split the paragraph */
+  begin.paragraph = 0;
+  begin.offset = 1;
+  CHECK(lp_document_insert_wstring(document, &begin, L"k\nl\nm", &end), OK);
+  CHECK(end.paragraph, 2);
+  CHECK(end.offset, 1);
+  CHECK(lp_document_get_paragraphs_count(document, &count), OK);
+  CHECK(count, 6);
+  check_paragraph(document, 0, L"ak");
+  check_paragraph(document, 1, L"l");
+  check_paragraph(document, 2, L"mbc");
+  check_paragraph(document, 3, L"dxyzef");
+  check_paragraph(document, 4, L"");
+  check_paragraph(document, 5, L"ghi");
+
+  begin.paragraph = 5;
+  begin.offset = 3;
+  CHECK(lp_document_insert_wstring(document, &begin, L"\n", &end), OK);
+  CHECK(end.paragraph, 6);
+  CHECK(end.offset, 0);
+  check_paragraph(document, 5, L"ghi");
+  check_paragraph(document, 6, L"");
+
+  /* The erase merges the paragraphs */
+  CHECK(lp_document_erase(NULL, &begin, &end), BAD_ARG);
+  CHECK(lp_document_erase(document, NULL, &end), BAD_ARG);
+  CHECK(lp_document_erase(document, &begin, NULL), BAD_ARG);
+  CHECK(lp_document_erase(document, &end, &begin), BAD_ARG);
+  CHECK(lp_document_erase(document, &begin, &end), OK);
+  CHECK(lp_document_get_paragraphs_count(document, &count), OK);
+  CHECK(count, 6);
+  check_paragraph(document, 5, L"ghi");
+
+  begin.paragraph = 0;
+  begin.offset = 1;
+  end.paragraph = 2;
+  end.offset = 1;
+  CHECK(lp_document_erase(document, &begin, &end), OK);
+  CHECK(lp_document_get_paragraphs_count(document, &count), OK);
+  CHECK(count, 4);
+  check_paragraph(document, 0, L"abc");
+  check_paragraph(document, 1, L"dxyzef");
+  check_paragraph(document, 3, L"ghi");
+
+  begin.paragraph = end.paragraph = 1;
+  begin.offset = 1;
+  end.offset = 4;
+  CHECK(lp_document_erase(document, &begin, &end), OK);
+  check_paragraph(document, 1, L"def");
+  end.offset = 4;
+  CHECK(lp_document_erase(document, &begin, &end), BAD_ARG);
+
+  CHECK(lp_document_clear(NULL), BAD_ARG);
+  CHECK(lp_document_clear(document), OK);
+  CHECK(lp_document_get_paragraphs_count(document, &count), OK);
+  CHECK(count, 1);
+  check_paragraph(document, 0, L"");
+
+  CHECK(lp_document_ref_get(NULL), BAD_ARG);
+  CHECK(lp_document_ref_get(document), OK);
+  CHECK(lp_document_ref_put(NULL), BAD_ARG);
+  CHECK(lp_document_ref_put(document), OK);
+  CHECK(lp_document_ref_put(document), OK);
+}
+
+static void
+test_print(struct lp* lp, struct lp_printer* printer)
+{
+  const float color[3] = { 1.f, 1.f, 1.f };
+  struct lp_document* document = NULL;
+  struct lp_hit_index* index = NULL;
+  struct lp_document_pos pos;
+  size_t count = 0;
+  size_t i = 0;
+
+  /* Each paragraph of 15 glyphs is wrapped on 2 rows of the 60 pixels wide
+   * viewport, that shows 10 rows */
+  CHECK(lp_document_create(lp, &document), OK);
+  pos.paragraph = 0;
+  pos.offset = 0;
+  for(i = 0; i < NB_PARAGRAPHS; ++i) {
+    const wchar_t* wstr = i ? L"\nabcdefghijklmno" : L"abcdefghijklmno";
+    CHECK(lp_document_insert_wstring(document, &pos, wstr, &pos), OK);
+  }
+  CHECK(lp_document_get_paragraphs_count(document, &count), OK);
+  CHECK(count, NB_PARAGRAPHS);
+
+  CHECK(lp_hit_index_create(lp, &index), OK);
+  CHECK(lp_printer_set_hit_index(printer, index), OK);
+
+  CHECK(lp_printer_get_document_rows(NULL, document, color, &count), BAD_ARG);
+  CHECK(lp_printer_get_document_rows(printer, NULL, color, &count), BAD_ARG);
+  CHECK(lp_printer_get_document_rows(printer, document, NULL, &count),
+    BAD_ARG);
+  CHECK(lp_printer_get_document_rows(printer, document, color, NULL),
+    BAD_ARG);
+  CHECK(lp_printer_get_document_rows(printer, document, color, &count), OK);
+  CHECK(count, 2 * NB_PARAGRAPHS);
+
+  /* Only the visible paragraphs are printed */
+  CHECK(lp_printer_print_document(NULL, document, 0, color), BAD_ARG);
+  CHECK(lp_printer_print_document(printer, NULL, 0, color), BAD_ARG);
+  CHECK(lp_printer_print_document(printer, document, 0, NULL), BAD_ARG);
+  CHECK(lp_printer_print_document(printer, document, 0, color), OK);
+  CHECK(lp_printer_flush(printer), OK);
+  CHECK(lp_hit_index_get_strings_count(index, &count), OK);
+  CHECK(count, 5);
+  check_hit(index, 1, 91, 0, 0);
+  check_hit(index, 1, 81, 0, 10);
+  check_hit(index, 1, 1, 4, 10);
+
+  /* The first row of the viewport is the second row of a paragraph */
+  CHECK(lp_hit_index_clear(index), OK);
+  CHECK(lp_printer_print_document(printer, document, 1001, color), OK);
+  CHECK(lp_printer_flush(printer), OK);
+  CHECK(lp_hit_index_get_strings_count(index, &count), OK);
+  CHECK(count, 6);
+  check_hit(index, 1, 91, 0, 10);
+  check_hit(index, 1, 81, 1, 0);
+  check_hit(index, 1, 1, 5, 0);
+
+  /* Split a paragraph of the middle of the document. Its following rows are
+   * shifted by one row */
+  pos.paragraph = NB_PARAGRAPHS / 2;
+  pos.offset = 0;
+  CHECK(lp_document_insert_wstring(document, &pos, L"\n", NULL), OK);
+  CHECK(lp_printer_get_document_rows(printer, document, color, &count), OK);
+  CHECK(count, 2 * NB_PARAGRAPHS + 1);
+  CHECK(lp_hit_index_clear(index), OK);
+  CHECK(lp_printer_print_document(printer, document, NB_PARAGRAPHS, color),
+    OK);
+  CHECK(lp_printer_flush(printer), OK);
+  check_hit(index, 1, 81, 1, 0); /* The empty paragraph is at the top */
+
+  /* Rows past the end of the document print nothing */
+  CHECK(lp_hit_index_clear(index), OK);
+  CHECK(lp_printer_print_document
+    (printer, document, 2 * NB_PARAGRAPHS + 1, color), OK);
+  CHECK(lp_printer_flush(printer), OK);
+  CHECK(lp_hit_index_get_strings_count(index, &count), OK);
+  CHECK(count, 0);
+
+  /* A wider viewport invalidates the cached rows */
+  CHECK(lp_printer_set_viewport(printer, 0, 0, 90, 100), OK);
+  CHECK(lp_printer_get_document_rows(printer, document, color, &count), OK);
+  CHECK(count, NB_PARAGRAPHS + 1);
+
+  CHECK(lp_printer_set_hit_index(printer, NULL), OK);
+  CHECK(lp_hit_index_ref_put(index), OK);
+  CHECK(lp_document_ref_put(document), OK);
+}
+
+/* The address of a released printer may be reused by the next created one.
+ * The rows measured with the former must not be reused by the latter */
+static void
+test_printer_reuse
+  (struct lp* lp,
+   struct lp_font* font,
+   struct lp_font* wide_font)
+{
+  const float color[3] = { 1.f, 1.f, 1.f };
+  struct lp_document* document = NULL;
+  struct lp_printer* printer = NULL;
+  struct lp_document_pos pos;
+  size_t count = 0;
+  size_t i = 0;
+
+  CHECK(lp_document_create(lp, &document), OK);
+  pos.paragraph = 0;
+  pos.offset = 0;
+  for(i = 0; i < 10; ++i) {
+    const wchar_t* wstr = i ? L"\nabcdefghijklmno" : L"abcdefghijklmno";
+    CHECK(lp_document_insert_wstring(document, &pos, wstr, &pos), OK);
+  }
+
+  /* The paragraphs of 15 glyphs fit in a row of 90 pixels */
+  CHECK(lp_printer_create(lp, &printer), OK);
+  CHECK(lp_printer_set_font(printer, font), OK);
+  CHECK(lp_printer_set_viewport(printer, 0, 0, 90, 100), OK);
+  CHECK(lp_printer_get_document_rows(printer, document, color, &count), OK);
+  CHECK(count, 10);
+  CHECK(lp_printer_ref_put(printer), OK);
+
+  /* Same font generation and line width, but wider glyphs */
+  CHECK(lp_printer_create(lp, &printer), OK);
+  CHECK(lp_printer_set_font(printer, wide_font), OK);
+  CHECK(lp_printer_set_viewport(printer, 0, 0, 90, 100), OK);
+  CHECK(lp_printer_get_document_rows(printer, document, color, &count), OK);
+  CHECK(count, 20);
+  CHECK(lp_printer_ref_put(printer), OK);
+
+  CHECK(lp_document_ref_put(document), OK);
+}
+
+int
+main(int argc, char** argv)
+{
+  struct lp_font_glyph_desc glyph_list[NB_GLYPHS];
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  struct lp_rbi_shim* shim = NULL;
+  struct lp* lp = NULL;
+  struct lp_font* font = NULL;
+  struct lp_font* wide_font = NULL;
+  struct lp_printer* printer = NULL;
+  size_t i = 0;
+  (void)argc, (void)argv;
+
+  CHECK(lp_rbi_shim_create(NULL, NULL, &shim), OK);
+  CHECK(lp_rbi_shim_get_rbi(shim, &rbi), OK);
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+
+  setup_synthetic_font(glyph_list, NULL);
+
+  CHECK(lp_create(&rbi, rb_ctxt, NULL, &lp), OK);
+  CHECK(lp_font_create(lp, &font), OK);
+  CHECK(lp_font_set_data(font, LINE_SPACE, NB_GLYPHS, glyph_list), OK);
+  CHECK(lp_printer_create(lp, &printer), OK);
+  CHECK(lp_printer_set_font(printer, font), OK);
+  CHECK(lp_printer_set_viewport(printer, 0, 0, 60, 100), OK);
+
+  test_edit(lp);
+  test_print(lp, printer);
+
+  for(i = 0; i < NB_GLYPHS; ++i)
+    glyph_list[i].width = GLYPH_WIDTH + 3;
+  CHECK(lp_font_create(lp, &wide_font), OK);
+  CHECK(lp_font_set_data(wide_font, LINE_SPACE, NB_GLYPHS, glyph_list), OK);
+  test_printer_reuse(lp, font, wide_font);
+
+  CHECK(lp_printer_ref_put(printer), OK);
+  CHECK(lp_font_ref_put(wide_font), OK);
+  CHECK(lp_font_ref_put(font), OK);
+  CHECK(lp_ref_put(lp), OK);
+  RBI(&rbi, context_ref_put(rb_ctxt));
+  CHECK(lp_rbi_shim_ref_put(shim), OK);
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+  return 0;
+}
+
@@ -0,0 +1,237 @@
+#include "lp.h"
+#include "lp_font.h"
+#include "lp_grid.h"
+#include "lp_printer.h"
+#include "lp_rbi_shim.h"
+#include "test_lp_utils.h"
+#include <rb/rbi.h>
+#include <rb/rb_types.h>
+#include <snlsys/mem_allocator.h>
+#include <string.h>
+#include <wm/wm_device.h>
+#include <wm/wm_window.h>
+
+#define BAD_ARG LP_INVALID_ARGUMENT
+#define OK LP_NO_ERROR
+
+/* Print the grid alone and return the backend calls of its flush */
+static void
+flush_grid
+  (struct lp_printer* printer,
+   struct lp_grid* grid,
+   struct lp_rbi_shim* shim,
+   struct lp_rbi_shim_counters* counters)
+{
+  CHECK(lp_rbi_shim_clear_counters(shim), OK);
+  CHECK(lp_printer_print_grid(printer, 0, 0, grid), OK);
+  CHECK(lp_printer_flush(printer), OK);
+  CHECK(lp_rbi_shim_get_counters(shim, counters), OK);
+}
+
+int
+main(int argc, char** argv)
+{
+  /* Miscellaneous data */
+  FILE* file = NULL;
+  const char* driver_name = NULL;
+  const char* font_name = NULL;
+  /* Window Manager */
+  struct wm_device* wm_dev = NULL;
+  struct wm_window* wm_win = NULL;
+  const struct wm_window_desc wm_win_desc = {
+    .width = 640, .height = 480, .fullscreen = false
+  };
+  /* Render backend, whose calls are counted by the shim */
+  struct rbi driver;
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  struct lp_rbi_shim* shim = NULL;
+  struct lp_rbi_shim_counters counters;
+  /* LP data structure */
+  struct lp* lp = NULL;
+  struct lp_font* lp_font0 = NULL;
+  struct lp_font* lp_font1 = NULL;
+  struct lp_printer* lp_printer = NULL;
+  struct lp_grid* lp_grid = NULL;
+
+  struct lp_font_glyph_desc glyph_list[5];
+  struct lp_grid_cell cells[4];
+  const struct lp_grid_cell blank = {
+    L' ', { 1.f, 1.f, 1.f }, { 0.f, 0.f, 0.f }, 0
+  };
+  size_t row_size = 0; /* Uploaded bytes of a row of 80 cells */
+  size_t cell_size = 0;
+  int nb_cols = 0;
+  int nb_rows = 0;
+  int i = 0;
+
+  if(argc != 3) {
+    printf("usage: %s RB_DRIVER FONT\n", argv[0]);
+    return -1;
+  }
+  driver_name = argv[1];
+  font_name = argv[2];
+
+  file = fopen(driver_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid driver %s\n", driver_name);
+    return -1;
+  }
+  fclose(file);
+
+  file = fopen(font_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid font name %s\n", font_name);
+    return -1;
+  }
+  fclose(file);
+
+  WM(create_device(NULL, &wm_dev));
+  WM(create_window(wm_dev, &wm_win_desc, &wm_win));
+  CHECK(rbi_init(driver_name, &driver), 0);
+  CHECK(lp_rbi_shim_create(NULL, &driver, &shim), OK);
+  CHECK(lp_rbi_shim_get_rbi(shim, &rbi), OK);
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+
+  LP(create(&rbi, rb_ctxt, NULL, &lp));
+  LP(font_create(lp, &lp_font0));
+  LP(font_create(lp, &lp_font1));
+  LP(printer_create(lp, &lp_printer));
+  LP(printer_set_font(lp_printer, lp_font0));
+  LP(printer_set_viewport(lp_printer, 0, 0, 640, 480));
+
+  CHECK(lp_grid_create(NULL, NULL), BAD_ARG);
+  CHECK(lp_grid_create(lp, NULL), BAD_ARG);
+  CHECK(lp_grid_create(NULL, &lp_grid), BAD_ARG);
+  CHECK(lp_grid_create(lp, &lp_grid), OK);
+
+  /* An empty grid without font draws nothing */
+  CHECK(lp_printer_print_grid(lp_printer, 0, 0, lp_grid), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  CHECK(lp_grid_set_font(NULL, NULL), BAD_ARG);
+  CHECK(lp_grid_set_font(lp_grid, NULL), BAD_ARG);
+  CHECK(lp_grid_set_font(NULL, lp_font0), BAD_ARG);
+  CHECK(lp_grid_set_font(lp_grid, lp_font0), OK);
+
+  CHECK(lp_grid_resize(NULL, 80, 24), BAD_ARG);
+  CHECK(lp_grid_resize(lp_grid, -1, 24), BAD_ARG);
+  CHECK(lp_grid_resize(lp_grid, 80, -1), BAD_ARG);
+  CHECK(lp_grid_resize(lp_grid, 0, 0), OK);
+  CHECK(lp_grid_resize(lp_grid, 80, 24), OK);
+
+  CHECK(lp_grid_get_size(NULL, &nb_cols, &nb_rows), BAD_ARG);
+  CHECK(lp_grid_get_size(lp_grid, NULL, NULL), OK);
+  CHECK(lp_grid_get_size(lp_grid, &nb_cols, &nb_rows), OK);
+  CHECK(nb_cols, 80);
+  CHECK(nb_rows, 24);
+
+  for(i = 0; i < 4; ++i) {
+    cells[i] = blank;
+    cells[i].character = L"Test"[i];
+    cells[i].fg[1] = 0.5f;
+  }
+  cells[2].attribs = LP_GRID_INVERSE;
+  cells[3].attribs = LP_GRID_HIDDEN;
+
+  CHECK(lp_grid_set_cells(NULL, 0, 0, cells, 4), BAD_ARG);
+  CHECK(lp_grid_set_cells(lp_grid, 0, 0, NULL, 4), BAD_ARG);
+  CHECK(lp_grid_set_cells(lp_grid, 0, 0, cells, -1), BAD_ARG);
+  CHECK(lp_grid_set_cells(lp_grid, -1, 0, cells, 4), BAD_ARG);
+  CHECK(lp_grid_set_cells(lp_grid, 0, -1, cells, 4), BAD_ARG);
+  CHECK(lp_grid_set_cells(lp_grid, 0, 24, cells, 4), BAD_ARG);
+  CHECK(lp_grid_set_cells(lp_grid, 77, 0, cells, 4), BAD_ARG);
+  CHECK(lp_grid_set_cells(lp_grid, 76, 0, cells, 4), OK);
+  CHECK(lp_grid_set_cells(lp_grid, 0, 0, cells, 0), OK);
+  CHECK(lp_grid_set_cells(lp_grid, 0, 23, cells, 4), OK);
+
+  CHECK(lp_printer_print_grid(NULL, 0, 0, NULL), BAD_ARG);
+  CHECK(lp_printer_print_grid(lp_printer, 0, 0, NULL), BAD_ARG);
+  CHECK(lp_printer_print_grid(NULL, 0, 0, lp_grid), BAD_ARG);
+
+  /* The whole grid is uploaded row per row. Its cells are indexed by the index
+   * buffer shared with the printer */
+  flush_grid(lp_printer, lp_grid, shim, &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_create_buffer], 1);
+  CHECK(counters.nb_calls[LP_RBI_CALL_buffer_data], 24);
+  CHECK(counters.nb_calls[LP_RBI_CALL_draw_indexed], 1);
+  CHECK(counters.nb_oversized_uploads, 0);
+  CHECK(counters.uploaded_size % 24, 0);
+  row_size = counters.uploaded_size / 24;
+  CHECK(row_size % 80, 0);
+  cell_size = row_size / 80;
+  NCHECK(cell_size, 0);
+
+  /* Patch the changed cells of the uploaded grid. Unchanged cells are not
+   * uploaded anew */
+  CHECK(lp_grid_set_cells(lp_grid, 40, 12, cells, 4), OK);
+  CHECK(lp_grid_set_cells(lp_grid, 10, 12, cells, 4), OK);
+  CHECK(lp_grid_set_cells(lp_grid, 40, 12, cells, 4), OK);
+  flush_grid(lp_printer, lp_grid, shim, &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_buffer_data], 1);
+  CHECK(counters.uploaded_size, 34 * cell_size); /* Cells [10, 44[ */
+  CHECK(lp_grid_set_cells(lp_grid, 0, 3, cells, 4), OK);
+  CHECK(lp_grid_set_cells(lp_grid, 0, 7, cells, 4), OK);
+  flush_grid(lp_printer, lp_grid, shim, &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_buffer_data], 2);
+  CHECK(counters.uploaded_size, 2 * 4 * cell_size);
+  flush_grid(lp_printer, lp_grid, shim, &counters);
+  CHECK(counters.uploaded_size, 0);
+
+  /* Update the grid while it is queued. A new font writes all the cells anew
+   * into the same buffer */
+  CHECK(lp_rbi_shim_clear_counters(shim), OK);
+  CHECK(lp_printer_print_grid(lp_printer, 0, 0, lp_grid), OK);
+  CHECK(lp_grid_set_font(lp_grid, lp_font1), OK);
+  CHECK(lp_grid_set_cells(lp_grid, 0, 5, cells, 4), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_rbi_shim_get_counters(shim, &counters), OK);
+  CHECK(counters.nb_calls[LP_RBI_CALL_create_buffer], 0);
+  CHECK(counters.uploaded_size, 24 * row_size);
+
+  /* As do the new data of the grid font */
+  setup_synthetic_font(glyph_list, L"Test ");
+  CHECK(lp_font_set_data(lp_font1, GLYPH_HEIGHT, 5, glyph_list), OK);
+  flush_grid(lp_printer, lp_grid, shim, &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_create_buffer], 0);
+  CHECK(counters.nb_calls[LP_RBI_CALL_buffer_data], 24);
+  CHECK(counters.uploaded_size, 24 * row_size);
+
+  /* Only the changed range of each row is cleared: 4 cells on the rows 0, 3,
+   * 5, 7 and 23, and the cells [10, 44[ of the row 12 */
+  CHECK(lp_grid_clear(NULL, &blank), BAD_ARG);
+  CHECK(lp_grid_clear(lp_grid, NULL), BAD_ARG);
+  CHECK(lp_grid_clear(lp_grid, &blank), OK);
+  flush_grid(lp_printer, lp_grid, shim, &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_buffer_data], 6);
+  CHECK(counters.uploaded_size, (5 * 4 + 34) * cell_size);
+
+  CHECK(lp_grid_clear(lp_grid, &blank), OK);
+  CHECK(lp_printer_print_grid(lp_printer, 0, 0, lp_grid), OK);
+  CHECK(lp_grid_resize(lp_grid, 132, 50), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  CHECK(lp_grid_ref_get(NULL), BAD_ARG);
+  CHECK(lp_grid_ref_get(lp_grid), OK);
+  CHECK(lp_grid_ref_put(NULL), BAD_ARG);
+  CHECK(lp_grid_ref_put(lp_grid), OK);
+
+  /* The printer keeps a reference onto the queued grid */
+  CHECK(lp_printer_print_grid(lp_printer, 0, 0, lp_grid), OK);
+  CHECK(lp_grid_ref_put(lp_grid), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  LP(printer_ref_put(lp_printer));
+  LP(font_ref_put(lp_font0));
+  LP(font_ref_put(lp_font1));
+  LP(ref_put(lp));
+  RBI(&rbi, context_ref_put(rb_ctxt));
+  CHECK(lp_rbi_shim_ref_put(shim), OK);
+  CHECK(rbi_shutdown(&driver), 0);
+  WM(device_ref_put(wm_dev));
+  WM(window_ref_put(wm_win));
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+  return 0;
+}
+
@@ -0,0 +1,197 @@
+#include "lp.h"
+#include "lp_font.h"
+#include "lp_hit_index.h"
+#include "lp_printer.h"
+#include "lp_rbi_shim.h"
+#include "lp_text.h"
+#include "test_lp_utils.h"
+#include <rb/rbi.h>
+#include <snlsys/mem_allocator.h>
+#include <string.h>
+
+#define BAD_ARG LP_INVALID_ARGUMENT
+#define OK LP_NO_ERROR
+
+static void
+check_hit
+  (struct lp_hit_index* index,
+   const int x,
+   const int y,
+   const size_t string,
+   const size_t offset,
+   const size_t caret)
+{
+  struct lp_hit hit;
+  int is_hit = 0;
+  CHECK(lp_hit_index_hit_test(index, x, y, &hit, &is_hit), OK);
+  CHECK(is_hit, 1);
+  CHECK(hit.string, string);
+  CHECK(hit.offset, offset);
+  CHECK(hit.caret, caret);
+}
+
+static void
+check_miss(struct lp_hit_index* index, const int x, const int y)
+{
+  struct lp_hit hit;
+  int is_hit = 1;
+  CHECK(lp_hit_index_hit_test(index, x, y, &hit, &is_hit), OK);
+  CHECK(is_hit, 0);
+}
+
+static void
+check_caret
+  (struct lp_hit_index* index,
+   const size_t string,
+   const size_t offset,
+   const int x,
+   const int y)
+{
+  int caret[2] = { 0, 0 };
+  CHECK(lp_hit_index_get_caret
+    (index, string, offset, caret + 0, caret + 1), OK);
+  CHECK(caret[0], x);
+  CHECK(caret[1], y);
+}
+
+int
+main(int argc, char** argv)
+{
+  struct lp_font_glyph_desc glyph_list[NB_GLYPHS];
+  struct lp_hit hit;
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  struct lp_rbi_shim* shim = NULL;
+  struct lp* lp = NULL;
+  struct lp_font* font = NULL;
+  struct lp_printer* printer = NULL;
+  struct lp_text* text = NULL;
+  struct lp_hit_index* index = NULL;
+  const float color[3] = { 1.f, 1.f, 1.f };
+  size_t count = 0;
+  int is_hit = 0;
+  int x = 0;
+  int y = 0;
+  (void)argc, (void)argv;
+
+  CHECK(lp_rbi_shim_create(NULL, NULL, &shim), OK);
+  CHECK(lp_rbi_shim_get_rbi(shim, &rbi), OK);
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+
+  setup_synthetic_font(glyph_list, NULL);
+
+  CHECK(lp_create(&rbi, rb_ctxt, NULL, &lp), OK);
+  CHECK(lp_font_create(lp, &font), OK);
+  CHECK(lp_font_set_data(font, LINE_SPACE, NB_GLYPHS, glyph_list), OK);
+  CHECK(lp_printer_create(lp, &printer), OK);
+  CHECK(lp_printer_set_font(printer, font), OK);
+  CHECK(lp_printer_set_viewport(printer, 0, 0, 640, 480), OK);
+
+  CHECK(lp_hit_index_create(NULL, NULL), BAD_ARG);
+  CHECK(lp_hit_index_create(lp, NULL), BAD_ARG);
+  CHECK(lp_hit_index_create(NULL, &index), BAD_ARG);
+  CHECK(lp_hit_index_create(lp, &index), OK);
+
+  CHECK(lp_hit_index_get_strings_count(NULL, NULL), BAD_ARG);
+  CHECK(lp_hit_index_get_strings_count(index, NULL), BAD_ARG);
+  CHECK(lp_hit_index_get_strings_count(NULL, &count), BAD_ARG);
+  CHECK(lp_hit_index_get_strings_count(index, &count), OK);
+  CHECK(count, 0);
+
+  CHECK(lp_hit_index_hit_test(NULL, 0, 0, &hit, &is_hit), BAD_ARG);
+  CHECK(lp_hit_index_hit_test(index, 0, 0, NULL, &is_hit), BAD_ARG);
+  CHECK(lp_hit_index_hit_test(index, 0, 0, &hit, NULL), BAD_ARG);
+  check_miss(index, 0, 0);
+
+  CHECK(lp_printer_set_hit_index(NULL, index), BAD_ARG);
+  CHECK(lp_printer_set_hit_index(printer, index), OK);
+
+  /* The new line moves the pen to the left border of the viewport */
+  CHECK(lp_printer_print_wstring
+    (printer, 10, 100, L"abc\ndef", color, NULL, NULL), OK);
+  CHECK(lp_hit_index_get_strings_count(index, &count), OK);
+  CHECK(count, 1);
+  check_hit(index, 10, 100, 0, 0, 0);
+  check_hit(index, 15, 109, 0, 0, 1);
+  check_hit(index, 17, 105, 0, 1, 1);
+  check_hit(index, 27, 100, 0, 2, 3);
+  check_hit(index, 7, 95, 0, 5, 5);
+  check_miss(index, 28, 100);
+  check_miss(index, 9, 100);
+  check_miss(index, 11, 110);
+  check_miss(index, 18, 90);
+
+  CHECK(lp_hit_index_get_caret(NULL, 0, 0, &x, &y), BAD_ARG);
+  CHECK(lp_hit_index_get_caret(index, 1, 0, &x, &y), BAD_ARG);
+  CHECK(lp_hit_index_get_caret(index, 0, 8, &x, &y), BAD_ARG);
+  CHECK(lp_hit_index_get_caret(index, 0, 0, NULL, &y), BAD_ARG);
+  CHECK(lp_hit_index_get_caret(index, 0, 0, &x, NULL), BAD_ARG);
+  check_caret(index, 0, 0, 10, 100);
+  check_caret(index, 0, 2, 22, 100);
+  check_caret(index, 0, 3, 28, 100); /* New line */
+  check_caret(index, 0, 4, 0, 90);
+  check_caret(index, 0, 7, 18, 90); /* End of string */
+
+  /* The string printed last wins */
+  CHECK(lp_printer_print_wstring
+    (printer, 10, 100, L"zz", color, NULL, NULL), OK);
+  check_hit(index, 11, 101, 1, 0, 0);
+  check_hit(index, 23, 101, 0, 2, 2);
+
+  /* The glyphs out of the viewport are indexed */
+  CHECK(lp_printer_print_wstring
+    (printer, 10, -50, L"xy", color, NULL, NULL), OK);
+  check_hit(index, 20, -45, 2, 1, 2);
+
+  /* The offsets of UTF-8 strings are in bytes */
+  CHECK(lp_printer_print_utf8
+    (printer, 300, 200, "a\xC3\xA9" "b", 4, color, NULL, NULL), OK);
+  CHECK(lp_hit_index_get_caret(index, 3, 3, &x, &y), OK);
+  CHECK(y, 200);
+  check_hit(index, x, 200, 3, 3, 3);
+  check_hit(index, x - 1, 200, 3, 1, 3);
+  check_hit(index, 305, 200, 3, 0, 1);
+
+  /* Texts are indexed at their print position */
+  CHECK(lp_text_create(lp, &text), OK);
+  CHECK(lp_text_set_font(text, font), OK);
+  CHECK(lp_text_set_wstring(text, L"ab"), OK);
+  CHECK(lp_printer_print_text(printer, 400, 50, text, color), OK);
+  check_hit(index, 407, 51, 4, 1, 1);
+  check_caret(index, 4, 2, 412, 50);
+
+  CHECK(lp_printer_flush(printer), OK);
+  CHECK(lp_hit_index_get_strings_count(index, &count), OK);
+  CHECK(count, 5);
+
+  CHECK(lp_hit_index_clear(NULL), BAD_ARG);
+  CHECK(lp_hit_index_clear(index), OK);
+  CHECK(lp_hit_index_get_strings_count(index, &count), OK);
+  CHECK(count, 0);
+  check_miss(index, 10, 100);
+
+  /* Detached index */
+  CHECK(lp_printer_set_hit_index(printer, NULL), OK);
+  CHECK(lp_printer_print_wstring
+    (printer, 10, 100, L"abc", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(printer), OK);
+  CHECK(lp_hit_index_get_strings_count(index, &count), OK);
+  CHECK(count, 0);
+
+  CHECK(lp_hit_index_ref_get(NULL), BAD_ARG);
+  CHECK(lp_hit_index_ref_get(index), OK);
+  CHECK(lp_hit_index_ref_put(NULL), BAD_ARG);
+  CHECK(lp_hit_index_ref_put(index), OK);
+  CHECK(lp_hit_index_ref_put(index), OK);
+
+  CHECK(lp_text_ref_put(text), OK);
+  CHECK(lp_printer_ref_put(printer), OK);
+  CHECK(lp_font_ref_put(font), OK);
+  CHECK(lp_ref_put(lp), OK);
+  RBI(&rbi, context_ref_put(rb_ctxt));
+  CHECK(lp_rbi_shim_ref_put(shim), OK);
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+  return 0;
+}
+
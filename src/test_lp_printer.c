@@ -31,6 +31,22 @@ main(int argc, char** argv)
   struct lp_font* lp_font0 = NULL;
   struct lp_font* lp_font1 = NULL;
   struct lp_printer* lp_printer = NULL;
+  struct lp_printer* lp_printer2 = NULL;
+  struct lp_printer_cache_stats cache_stats;
+  struct lp_printer_stats stats;
+  struct lp_printer_metrics metrics;
+  struct lp_printer_glyph glyphs[4];
+  struct lp_font_glyph glyph;
+  size_t nb_glyphs = 0;
+  int cur[2] = { 0, 0 };
+  int ref[2] = { 0, 0 };
+  struct lp_printer_span spans[2];
+  struct lp_printer_rect clip;
+  struct lp_printer_image image;
+  static unsigned char pixels[8 * 8 * 4];
+  #define BIG_STRING_LEN 20000
+  static wchar_t big_wstr[BIG_STRING_LEN + 1];
+  size_t i = 0;
 
   float color[3] = { 1.f, 1.f, 1.f };
 
@@ -74,6 +90,16 @@ main(int argc, char** argv)
   CHECK(lp_printer_set_font(NULL, lp_font0), BAD_ARG);
   CHECK(lp_printer_set_font(lp_printer, lp_font0), OK);
 
+  CHECK(lp_printer_set_storage(NULL, 0, 0), BAD_ARG);
+  CHECK(lp_printer_set_storage(lp_printer, 0, 0), BAD_ARG);
+  CHECK(lp_printer_set_storage(NULL, 2, 0), BAD_ARG);
+  CHECK(lp_printer_set_storage(lp_printer, 2, 0), BAD_ARG);
+  CHECK(lp_printer_set_storage(NULL, 0, 16), BAD_ARG);
+  CHECK(lp_printer_set_storage(lp_printer, 0, 16), BAD_ARG);
+  CHECK(lp_printer_set_storage(NULL, 2, 16), BAD_ARG);
+  CHECK(lp_printer_set_storage(lp_printer, 2,-16), BAD_ARG);
+  CHECK(lp_printer_set_storage(lp_printer, 2, 16), OK);
+
   CHECK(lp_printer_set_viewport(NULL, 1, 1,-1,-1), BAD_ARG);
   CHECK(lp_printer_set_viewport(NULL,-1,-1, 1, 1), BAD_ARG);
   CHECK(lp_printer_set_viewport(lp_printer, 1, 1,-1,-1), BAD_ARG);
@@ -98,11 +124,321 @@ main(int argc, char** argv)
   CHECK(lp_printer_print_wstring
     (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
 
+  CHECK(lp_printer_print_wstring_n
+    (NULL, 0, 0, L"Test", 4, color, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_wstring_n
+    (lp_printer, 0, 0, NULL, 4, color, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_wstring_n
+    (lp_printer, 0, 0, L"Test", 4, NULL, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_wstring_n
+    (lp_printer, 0, 0, NULL, 0, color, NULL, NULL), OK);
+  CHECK(lp_printer_print_wstring_n
+    (lp_printer, 0, 0, L"Te\nst", 3, color, &cur[0], &cur[1]), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Te\n", color, &ref[0], &ref[1]), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+
+  CHECK(lp_printer_print_utf8
+    (NULL, 0, 0, "Test", 4, color, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_utf8
+    (lp_printer, 0, 0, NULL, 4, color, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_utf8
+    (lp_printer, 0, 0, "Test", 4, NULL, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_utf8
+    (lp_printer, 0, 0, NULL, 0, color, NULL, NULL), OK);
+  CHECK(lp_printer_print_utf8
+    (lp_printer, 0, 0, "Te\nst", 3, color, &cur[0], &cur[1]), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  /* Multi bytes, truncated and invalid sequences */
+  CHECK(lp_printer_print_utf8
+    (lp_printer, 0, 0, "\xC3\xA9\xE2\x82\xAC\n", 6, color, &cur[0], &cur[1]),
+    OK);
+  CHECK(lp_printer_print_utf8
+    (lp_printer, 0, 0, "\xC3\n\xFF\xE2\x82", 5, color, NULL, NULL), OK);
+
+  spans[0].str = L"Te";
+  spans[0].len = LP_PRINTER_SPAN_NUL_TERMINATED;
+  spans[0].encoding = LP_PRINTER_ENCODING_WCHAR;
+  spans[0].color[0] = spans[0].color[1] = spans[0].color[2] = 1.f;
+  spans[0].is_positioned = 0;
+  spans[0].clip = NULL;
+  spans[1] = spans[0];
+  spans[1].str = "\nst";
+  spans[1].len = 1;
+  spans[1].encoding = LP_PRINTER_ENCODING_UTF8;
+  CHECK(lp_printer_print_spans(NULL, 0, 0, spans, 2, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_spans(lp_printer, 0, 0, NULL, 2, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_spans(lp_printer, 0, 0, NULL, 0, cur, cur+1), OK);
+  CHECK(cur[0], 0);
+  CHECK(cur[1], 0);
+  CHECK(lp_printer_print_spans(lp_printer, 0, 0, spans, 2, cur, cur+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  spans[1].is_positioned = 1;
+  spans[1].x = 0;
+  spans[1].y = 0;
+  CHECK(lp_printer_print_spans(lp_printer, 0, 0, spans, 2, cur, cur+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  spans[1].str = NULL;
+  CHECK(lp_printer_print_spans(lp_printer, 0, 0, spans, 2, NULL, NULL), BAD_ARG);
+  spans[1].len = 0;
+  CHECK(lp_printer_print_spans(lp_printer, 0, 0, spans, 2, NULL, NULL), OK);
+
+  /* The remaining line width is carried from span to span, even past a glyph
+   * wider than the line */
+  CHECK(lp_font_get_glyph(lp_font0, L'W', &glyph), OK);
+  CHECK(lp_printer_set_viewport(lp_printer, 0, 0, glyph.width/2 + 1, 480), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 400, L"Wi", color, ref+0, ref+1), OK);
+  spans[0].str = L"W";
+  spans[1].str = L"i";
+  spans[1].len = LP_PRINTER_SPAN_NUL_TERMINATED;
+  spans[1].encoding = LP_PRINTER_ENCODING_WCHAR;
+  spans[1].is_positioned = 0;
+  CHECK(lp_printer_print_spans(lp_printer, 0, 400, spans, 2, cur, cur+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  spans[0].str = L"Te";
+  spans[1].str = "\nst";
+  spans[1].len = 1;
+  spans[1].encoding = LP_PRINTER_ENCODING_UTF8;
+  CHECK(lp_printer_set_viewport(lp_printer,-1,-1, 1, 1), OK);
+
+  /* Clipping cuts the printed glyphs but not the layout */
+  CHECK(lp_printer_set_clip_rect(NULL, 0, 0, 8, 8), BAD_ARG);
+  CHECK(lp_printer_set_clip_rect(lp_printer, 0, 0, -1, 8), BAD_ARG);
+  CHECK(lp_printer_set_clip_rect(lp_printer, 0, 0, 8, -1), BAD_ARG);
+  CHECK(lp_printer_set_clip_rect(lp_printer, 2, 0, 5, 5), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Te\n", color, cur+0, cur+1), OK);
+  CHECK(lp_printer_clear_clip_rect(NULL), BAD_ARG);
+  CHECK(lp_printer_clear_clip_rect(lp_printer), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Te\n", color, ref+0, ref+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  clip.x = 1;
+  clip.y = 0;
+  clip.width = 3;
+  clip.height = 4;
+  spans[0].clip = &clip;
+  spans[1].clip = NULL;
+  CHECK(lp_printer_print_spans(lp_printer, 0, 0, spans, 2, NULL, NULL), OK);
+  clip.width = -1;
+  CHECK(lp_printer_print_spans(lp_printer, 0, 0, spans, 2, NULL, NULL), BAD_ARG);
+  spans[0].clip = NULL;
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  /* Large string laid out serially and then in parallel */
+  for(i = 0; i < BIG_STRING_LEN; ++i)
+    big_wstr[i] = i % 61 == 60 ? L'\n' : (wchar_t)(L'a' + (wchar_t)(i % 26));
+  big_wstr[BIG_STRING_LEN] = L'\0';
+  CHECK(lp_printer_set_layout_threads(NULL, 0), BAD_ARG);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, big_wstr, color, ref+0, ref+1), OK);
+  CHECK(lp_printer_set_layout_threads(lp_printer, 0), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, big_wstr, color, cur+0, cur+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  CHECK(lp_printer_set_layout_threads(lp_printer, 3), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, big_wstr, color, cur+0, cur+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  CHECK(lp_printer_set_layout_threads(lp_printer, 1), OK);
+
+  /* ANSI escape sequences are consumed rather than printed */
+  CHECK(lp_printer_set_ansi(NULL, 1), BAD_ARG);
+  CHECK(lp_printer_set_bold_font(NULL, lp_font1), BAD_ARG);
+  CHECK(lp_printer_set_ansi(lp_printer, 1), OK);
+  CHECK(lp_printer_set_bold_font(lp_printer, lp_font1), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Te\n", color, ref+0, ref+1), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"\x1b[1;31mT\x1b[38;5;82me\x1b[0m\n", color,
+     cur+0, cur+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  CHECK(lp_printer_print_utf8
+    (lp_printer, 0, 0, "\x1b[38;2;255;128;0mTe\x1b[22m\n\x1b[", 27, color,
+     cur+0, cur+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  CHECK(lp_printer_measure_wstring
+    (lp_printer, 0, 0, L"\x1b[32mTe\x1b[m\nst", &metrics), OK);
+  CHECK(metrics.nb_lines, 2);
+  CHECK(metrics.nb_glyphs, 4);
+  /* The OSC and DCS strings are skipped up to their BEL or ST terminator. An
+   * ESC that is not the ST begins the next sequence */
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"\x1b]0;title\x07T\x1bP1$r\x1b\\e\n", color,
+     cur+0, cur+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+  CHECK(lp_printer_measure_wstring
+    (lp_printer, 0, 0, L"\x1b]2;a b\x1b[1mT\x1b]8;;\x1b\\e", &metrics), OK);
+  CHECK(metrics.nb_lines, 1);
+  CHECK(metrics.nb_glyphs, 2);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_printer_set_bold_font(lp_printer, NULL), OK);
+  CHECK(lp_printer_set_ansi(lp_printer, 0), OK);
+
+  /* CPU compositing into a caller image */
+  image.pixels = pixels;
+  image.width = 8;
+  image.height = 8;
+  image.pitch = 8 * 4;
+  CHECK(lp_printer_set_image(NULL, &image), BAD_ARG);
+  image.pitch = 7 * 4;
+  CHECK(lp_printer_set_image(lp_printer, &image), BAD_ARG);
+  image.pitch = 8 * 4;
+  image.pixels = NULL;
+  CHECK(lp_printer_set_image(lp_printer, &image), BAD_ARG);
+  image.pixels = pixels;
+  CHECK(lp_printer_set_image(lp_printer, &image), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_printer_set_layout_threads(lp_printer, 0), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_printer_set_layout_threads(lp_printer, 1), OK);
+  CHECK(lp_printer_set_image(lp_printer, NULL), OK);
+
+  CHECK(lp_printer_set_glyph_format(NULL, LP_PRINTER_GLYPH_VERTICES), BAD_ARG);
+  CHECK(lp_printer_set_glyph_format
+    (lp_printer, LP_PRINTER_GLYPH_FORMATS_COUNT), BAD_ARG);
+  CHECK(lp_printer_set_glyph_format(lp_printer, LP_PRINTER_GLYPH_VERTICES), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_set_glyph_format(lp_printer, LP_PRINTER_GLYPH_RECORD), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+
+  CHECK(lp_printer_measure_wstring(NULL, 0, 0, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_measure_wstring(lp_printer, 0, 0, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_measure_wstring(lp_printer, 0, 0, L"Te", NULL), BAD_ARG);
+  CHECK(lp_printer_measure_wstring(NULL, 0, 0, L"Te", &metrics), BAD_ARG);
+  CHECK(lp_printer_measure_wstring(lp_printer, 0, 0, L"Te\nst", &metrics), OK);
+  CHECK(metrics.nb_lines, 2);
+  CHECK(metrics.nb_glyphs, 4);
+
+  CHECK(lp_printer_layout_wstring
+    (NULL, 0, 0, NULL, NULL, 0, NULL, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_layout_wstring
+    (lp_printer, 0, 0, L"Test", NULL, 0, NULL, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_layout_wstring
+    (lp_printer, 0, 0, L"Test", NULL, 4, &nb_glyphs, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_layout_wstring
+    (lp_printer, 0, 0, L"Test", NULL, 0, &nb_glyphs, NULL, NULL), OK);
+  CHECK(nb_glyphs, 4);
+  CHECK(lp_printer_layout_wstring
+    (lp_printer, 0, 0, L"Te\nst", glyphs, 4, &nb_glyphs, NULL, NULL), OK);
+  CHECK(nb_glyphs, 4);
+  CHECK(glyphs[0].id, 0);
+  CHECK(glyphs[2].id, 3);
+  CHECK(glyphs[2].x, -1); /* Wrapped to the viewport left border */
+
+  CHECK(lp_printer_set_layout_cache(NULL, 0), BAD_ARG);
+  CHECK(lp_printer_set_layout_cache(lp_printer, -1), BAD_ARG);
+  CHECK(lp_printer_set_layout_cache(lp_printer, 16), OK);
+  CHECK(lp_printer_get_layout_cache_stats(NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_get_layout_cache_stats(lp_printer, NULL), BAD_ARG);
+  CHECK(lp_printer_get_layout_cache_stats(NULL, &cache_stats), BAD_ARG);
+  CHECK(lp_printer_get_layout_cache_stats(lp_printer, &cache_stats), OK);
+  CHECK(cache_stats.nb_hits, 0);
+  CHECK(cache_stats.nb_misses, 0);
+  CHECK(cache_stats.nb_entries, 0);
+  CHECK(cache_stats.nb_max_entries, 16);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_get_layout_cache_stats(lp_printer, &cache_stats), OK);
+  CHECK(cache_stats.nb_hits, 1);
+  CHECK(cache_stats.nb_misses, 1);
+  CHECK(cache_stats.nb_entries, 1);
+  NCHECK(cache_stats.memory_size, 0);
+
   CHECK(lp_printer_set_font(lp_printer, lp_font1), OK);
+  CHECK(lp_printer_get_layout_cache_stats(lp_printer, &cache_stats), OK);
+  CHECK(cache_stats.nb_entries, 0);
+  CHECK(lp_printer_set_layout_cache(lp_printer, 0), OK);
 
   CHECK(lp_printer_flush(NULL), BAD_ARG);
   CHECK(lp_printer_flush(lp_printer), OK);
 
+  /* Runtime statistics */
+  CHECK(lp_printer_clear_stats(NULL), BAD_ARG);
+  CHECK(lp_printer_clear_stats(lp_printer), OK);
+  CHECK(lp_printer_get_stats(NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_get_stats(lp_printer, NULL), BAD_ARG);
+  CHECK(lp_printer_get_stats(NULL, &stats), BAD_ARG);
+  CHECK(lp_printer_get_stats(lp_printer, &stats), OK);
+  CHECK(stats.nb_glyphs, 0);
+  CHECK(stats.nb_flushes, 0);
+  CHECK(stats.nb_draw_calls, 0);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_printer_flush(lp_printer), OK); /* Nothing to flush */
+  CHECK(lp_printer_get_stats(lp_printer, &stats), OK);
+  CHECK(stats.nb_flushes, stats.nb_glyphs ? 1 : 0); /* Unless all culled */
+  CHECK(stats.nb_forced_flushes, 0);
+  CHECK(stats.nb_glyphs + stats.nb_culled_glyphs, 4);
+  CHECK(stats.layout_time, 0.0); /* Timing is disabled */
+  CHECK(stats.flush_time, 0.0);
+  CHECK(lp_printer_set_timing(NULL, 1), BAD_ARG);
+  CHECK(lp_printer_set_timing(lp_printer, 1), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_printer_get_stats(lp_printer, &stats), OK);
+  CHECK(stats.layout_time >= 0.0, 1);
+  CHECK(stats.flush_time >= 0.0, 1);
+  CHECK(lp_printer_set_timing(lp_printer, 0), OK);
+  CHECK(lp_printer_print_stats(NULL, 0, 0, color), BAD_ARG);
+  CHECK(lp_printer_print_stats(lp_printer, 0, 0, NULL), BAD_ARG);
+  CHECK(lp_printer_print_stats(lp_printer, 0, 0, color), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_printer_clear_stats(lp_printer), OK);
+  CHECK(lp_printer_get_stats(lp_printer, &stats), OK);
+  CHECK(stats.nb_flushes, 0);
+
+  /* Flush within a frame. The shared render state is set once */
+  CHECK(lp_end_frame(NULL), BAD_ARG);
+  CHECK(lp_end_frame(lp), BAD_ARG);
+  CHECK(lp_begin_frame(NULL), BAD_ARG);
+  CHECK(lp_begin_frame(lp), OK);
+  CHECK(lp_begin_frame(lp), BAD_ARG);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 10, 10, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_end_frame(lp), OK);
+  CHECK(lp_end_frame(lp), BAD_ARG);
+
+  /* The GPU resources are shared by the printers of the lp and outlive the
+   * printer that created them */
+  CHECK(lp_printer_create(lp, &lp_printer2), OK);
+  CHECK(lp_printer_set_font(lp_printer2, lp_font0), OK);
+  CHECK(lp_printer_set_viewport(lp_printer2, 0, 0, 800, 600), OK);
+  CHECK(lp_printer_set_storage(lp_printer2, 1, 4096), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer2, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer2), OK);
+  CHECK(lp_printer_ref_put(lp_printer2), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
   CHECK(lp_printer_ref_get(NULL), BAD_ARG);
   CHECK(lp_printer_ref_get(lp_printer), OK);
   CHECK(lp_printer_ref_put(NULL), BAD_ARG);
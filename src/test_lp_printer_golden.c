@@ -0,0 +1,443 @@
+#include "lp.h"
+#include "lp_font.h"
+#include "lp_printer.h"
+#include "lp_recorder.h"
+#include <font_rsrc.h>
+#include <rb/rbi.h>
+#include <snlsys/math.h>
+#include <snlsys/mem_allocator.h>
+#include <wm/wm_device.h>
+#include <wm/wm_window.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define BAD_ARG LP_INVALID_ARGUMENT
+#define OK LP_NO_ERROR
+
+#define IMG_WIDTH 256
+#define IMG_HEIGHT 128
+#define IMG_PITCH (IMG_WIDTH * 4)
+#define IMG_SIZE (IMG_PITCH * IMG_HEIGHT)
+#define STRING_LEN 9000 /* Beyond the parallel layout threshold */
+#define CHARSET_LEN 95
+
+/* Synthetic font of the checked-in reference image. Its glyph bitmaps are
+ * fully opaque or transparent so that the composited pixels do not depend on
+ * the rounding of the blend */
+#define GOLDEN_WIDTH 64
+#define GOLDEN_HEIGHT 48 /* Two bands of composited rows */
+#define GOLDEN_SIZE (GOLDEN_WIDTH * GOLDEN_HEIGHT * 4)
+#define GOLDEN_GLYPHS_COUNT 8 /* 'A' to 'H' */
+#define GOLDEN_GLYPH_WIDTH 6
+#define GOLDEN_GLYPH_HEIGHT 8
+#define GOLDEN_GLYPH_ADVANCE 7
+#define GOLDEN_LINE_SPACE 10
+
+/* Each variant prints `str' with an optimization of the printer enabled. Its
+ * composited image must be the same as the one of the default printer */
+enum variant {
+  VARIANT_LAYOUT_CACHE,
+  VARIANT_LAYOUT_THREADS,
+  VARIANT_GLYPH_VERTICES,
+  VARIANT_SPANS,
+  VARIANT_UTF8,
+  VARIANT_RECORDER,
+  VARIANTS_COUNT
+};
+
+static void
+render
+  (struct lp_printer* printer,
+   struct lp_recorder* recorder,
+   const wchar_t* wstr,
+   const char* utf8,
+   const int variant, /* < 0 <=> reference rendering */
+   unsigned char* pixels)
+{
+  const float color[3] = { 1.f, 0.5f, 0.25f };
+  struct lp_printer_image image;
+  struct lp_printer_span spans[2];
+  const size_t len = wcslen(wstr);
+  int i = 0;
+
+  memset(pixels, 0, IMG_SIZE);
+  image.pixels = pixels;
+  image.width = IMG_WIDTH;
+  image.height = IMG_HEIGHT;
+  image.pitch = IMG_PITCH;
+  CHECK(lp_printer_set_image(printer, &image), OK);
+
+  switch(variant) {
+    case VARIANT_LAYOUT_CACHE:
+      CHECK(lp_printer_set_layout_cache(printer, 4), OK);
+      /* The second print is a cache hit */
+      for(i = 0; i < 2; ++i) {
+        memset(pixels, 0, IMG_SIZE);
+        CHECK(lp_printer_print_wstring
+          (printer, 3, IMG_HEIGHT - 20, wstr, color, NULL, NULL), OK);
+        CHECK(lp_printer_flush(printer), OK);
+      }
+      CHECK(lp_printer_set_layout_cache(printer, 0), OK);
+      break;
+    case VARIANT_LAYOUT_THREADS:
+      CHECK(lp_printer_set_layout_threads(printer, 0), OK);
+      CHECK(lp_printer_print_wstring
+        (printer, 3, IMG_HEIGHT - 20, wstr, color, NULL, NULL), OK);
+      CHECK(lp_printer_flush(printer), OK);
+      CHECK(lp_printer_set_layout_threads(printer, 1), OK);
+      break;
+    case VARIANT_GLYPH_VERTICES:
+      CHECK(lp_printer_set_glyph_format
+        (printer, LP_PRINTER_GLYPH_VERTICES), OK);
+      CHECK(lp_printer_print_wstring
+        (printer, 3, IMG_HEIGHT - 20, wstr, color, NULL, NULL), OK);
+      CHECK(lp_printer_flush(printer), OK);
+      CHECK(lp_printer_set_glyph_format(printer, LP_PRINTER_GLYPH_RECORD), OK);
+      break;
+    case VARIANT_SPANS:
+      spans[0].str = wstr;
+      spans[0].len = len / 3;
+      spans[0].encoding = LP_PRINTER_ENCODING_WCHAR;
+      memcpy(spans[0].color, color, sizeof(color));
+      spans[0].is_positioned = 0;
+      spans[0].clip = NULL;
+      spans[1] = spans[0];
+      spans[1].str = wstr + len / 3;
+      spans[1].len = LP_PRINTER_SPAN_NUL_TERMINATED;
+      CHECK(lp_printer_print_spans
+        (printer, 3, IMG_HEIGHT - 20, spans, 2, NULL, NULL), OK);
+      CHECK(lp_printer_flush(printer), OK);
+      break;
+    case VARIANT_UTF8:
+      CHECK(lp_printer_print_utf8
+        (printer, 3, IMG_HEIGHT - 20, utf8, len, color, NULL, NULL), OK);
+      CHECK(lp_printer_flush(printer), OK);
+      break;
+    case VARIANT_RECORDER:
+      CHECK(lp_recorder_begin(recorder, printer), OK);
+      CHECK(lp_recorder_print_wstring
+        (recorder, 3, IMG_HEIGHT - 20, wstr, color, NULL, NULL), OK);
+      CHECK(lp_printer_print_recorder(printer, recorder), OK);
+      CHECK(lp_printer_flush(printer), OK);
+      break;
+    default: /* Reference */
+      CHECK(lp_printer_print_wstring
+        (printer, 3, IMG_HEIGHT - 20, wstr, color, NULL, NULL), OK);
+      CHECK(lp_printer_flush(printer), OK);
+      break;
+  }
+  CHECK(lp_printer_set_image(printer, NULL), OK);
+}
+
+/* Read the RGBA PAM image `path' into `pixels'. The image rows are stored
+ * from top to bottom while the printer image rows go upward */
+static void
+read_golden_image(const char* path, unsigned char* pixels)
+{
+  FILE* file = NULL;
+  int width = 0, height = 0, depth = 0, maxval = 0;
+  int y = 0;
+  ASSERT(path && pixels);
+
+  file = fopen(path, "rb");
+  if(!file)
+    fprintf(stderr, "Invalid golden image %s\n", path);
+  NCHECK(file, NULL);
+  CHECK(fscanf(file,
+    "P7 WIDTH %d HEIGHT %d DEPTH %d MAXVAL %d TUPLTYPE RGB_ALPHA ENDHDR",
+    &width, &height, &depth, &maxval), 4);
+  CHECK(width, GOLDEN_WIDTH);
+  CHECK(height, GOLDEN_HEIGHT);
+  CHECK(depth, 4);
+  CHECK(maxval, 255);
+  CHECK(fgetc(file), '\n');
+  for(y = GOLDEN_HEIGHT - 1; y >= 0; --y) {
+    CHECK(fread(pixels + y * GOLDEN_WIDTH * 4, GOLDEN_WIDTH * 4, 1, file), 1);
+  }
+  CHECK(fgetc(file), EOF);
+  fclose(file);
+}
+
+/* Whether the bitmap texel (x, y) of the synthetic glyph `id' is opaque. The
+ * first row marks the top of the glyph */
+static bool
+golden_texel(const int id, const int x, const int y)
+{
+  return y == 0 || x == id % GOLDEN_GLYPH_WIDTH || (x * y + id) % 5 == 0;
+}
+
+/* Composite the golden string with the synthetic font and compare the image
+ * to the checked-in reference `path', serially and in parallel and for each
+ * glyph format */
+static void
+check_golden_image(struct lp* lp, const char* path)
+{
+  const float color[3] = { 1.f, 0.2f, 0.f };
+  static unsigned char bitmaps
+    [GOLDEN_GLYPHS_COUNT][GOLDEN_GLYPH_HEIGHT][GOLDEN_GLYPH_WIDTH];
+  static unsigned char ref[GOLDEN_SIZE];
+  static unsigned char img[GOLDEN_SIZE];
+  struct lp_font_glyph_desc glyph_list[GOLDEN_GLYPHS_COUNT];
+  struct lp_printer_image image;
+  struct lp_font* font = NULL;
+  struct lp_printer* printer = NULL;
+  int id = 0, x = 0, y = 0;
+  int i = 0;
+  ASSERT(lp && path);
+
+  read_golden_image(path, ref);
+
+  for(id = 0; id < GOLDEN_GLYPHS_COUNT; ++id) {
+    for(y = 0; y < GOLDEN_GLYPH_HEIGHT; ++y) {
+      for(x = 0; x < GOLDEN_GLYPH_WIDTH; ++x)
+        bitmaps[id][y][x] = golden_texel(id, x, y) ? 255 : 0;
+    }
+    glyph_list[id].width = GOLDEN_GLYPH_ADVANCE;
+    glyph_list[id].character = (wchar_t)(L'A' + id);
+    glyph_list[id].bitmap_left = id % 2;
+    glyph_list[id].bitmap_top = -(id % 3);
+    glyph_list[id].bitmap.width = GOLDEN_GLYPH_WIDTH;
+    glyph_list[id].bitmap.height = GOLDEN_GLYPH_HEIGHT;
+    glyph_list[id].bitmap.bytes_per_pixel = 1;
+    glyph_list[id].bitmap.buffer = bitmaps[id][0];
+  }
+  LP(font_create(lp, &font));
+  LP(font_set_data
+    (font, GOLDEN_LINE_SPACE, GOLDEN_GLYPHS_COUNT, glyph_list));
+  LP(printer_create(lp, &printer));
+  LP(printer_set_font(printer, font));
+  LP(printer_set_viewport(printer, 0, 0, GOLDEN_WIDTH, GOLDEN_HEIGHT));
+
+  image.pixels = img;
+  image.width = GOLDEN_WIDTH;
+  image.height = GOLDEN_HEIGHT;
+  image.pitch = GOLDEN_WIDTH * 4;
+  CHECK(lp_printer_set_image(printer, &image), OK);
+
+  /* A new line, a wrapped line and glyphs across the composited bands */
+  for(i = 0; i < 4; ++i) {
+    CHECK(lp_printer_set_layout_threads(printer, i % 2 ? 0 : 1), OK);
+    CHECK(lp_printer_set_glyph_format(printer, i < 2
+      ? LP_PRINTER_GLYPH_RECORD : LP_PRINTER_GLYPH_VERTICES), OK);
+    memset(img, 0, GOLDEN_SIZE);
+    CHECK(lp_printer_print_wstring
+      (printer, 2, 34, L"ABCDEFGH\nHGFEDCBAABCD", color, NULL, NULL), OK);
+    CHECK(lp_printer_flush(printer), OK);
+    if(memcmp(ref, img, GOLDEN_SIZE)) {
+      fprintf(stderr, "The image %d differs from %s\n", i, path);
+      CHECK(memcmp(ref, img, GOLDEN_SIZE), 0);
+    }
+  }
+  CHECK(lp_printer_set_image(printer, NULL), OK);
+
+  LP(printer_ref_put(printer));
+  LP(font_ref_put(font));
+}
+
+int
+main(int argc, char** argv)
+{
+  /* Miscellaneous data */
+  FILE* file = NULL;
+  const char* driver_name = NULL;
+  const char* font_name = NULL;
+  const char* golden_name = NULL;
+  int line_space = 0;
+  bool b = false;
+  size_t i = 0;
+  /* Window Manager */
+  struct wm_device* wm_dev = NULL;
+  struct wm_window* wm_win = NULL;
+  const struct wm_window_desc wm_win_desc = {
+    .width = 1, .height = 1, .fullscreen = false
+  };
+  /* Render backend */
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  /* Resources data */
+  unsigned char* glyph_bitmap_list[CHARSET_LEN];
+  struct font_system* font_sys = NULL;
+  struct font_rsrc* font_rsrc = NULL;
+  struct font_glyph* font_glyph = NULL;
+  /* LP data structure */
+  struct lp_font_glyph_desc lp_font_glyph_desc_list[CHARSET_LEN];
+  struct lp* lp = NULL;
+  struct lp_font* lp_font = NULL;
+  struct lp_printer* lp_printer = NULL;
+  struct lp_recorder* lp_recorder = NULL;
+  /* Printed strings and composited images */
+  static wchar_t wstr[STRING_LEN + 1];
+  static char utf8[STRING_LEN + 1];
+  static unsigned char ref[IMG_SIZE];
+  static unsigned char img[IMG_SIZE];
+  struct lp_printer_image image;
+  const float color[3] = { 1.f, 1.f, 1.f };
+  int variant = 0;
+
+  if(argc != 4) {
+    printf("usage: %s RB_DRIVER FONT GOLDEN_IMAGE\n", argv[0]);
+    return -1;
+  }
+  driver_name = argv[1];
+  font_name = argv[2];
+  golden_name = argv[3];
+
+  file = fopen(driver_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid driver %s\n", driver_name);
+    return -1;
+  }
+  fclose(file);
+
+  file = fopen(font_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid font name %s\n", font_name);
+    return -1;
+  }
+  fclose(file);
+
+  WM(create_device(NULL, &wm_dev));
+  WM(create_window(wm_dev, &wm_win_desc, &wm_win));
+  CHECK(rbi_init(driver_name, &rbi), 0);
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+
+  /* Printable ASCII characters */
+  FONT(system_create(NULL, &font_sys));
+  FONT(rsrc_create(font_sys, font_name, &font_rsrc));
+  FONT(rsrc_get_line_space(font_rsrc, &line_space));
+  if(FONT(rsrc_is_scalable(font_rsrc, &b)), b) {
+    FONT(rsrc_set_size(font_rsrc, 16, 16));
+  }
+  for(i = 0; i < CHARSET_LEN; ++i) {
+    struct font_glyph_desc font_glyph_desc;
+    int width = 0;
+    int height = 0;
+    int Bpp = 0;
+
+    FONT(rsrc_get_glyph(font_rsrc, (wchar_t)(L' ' + i), &font_glyph));
+    FONT(glyph_get_bitmap(font_glyph, true, &width, &height, &Bpp, NULL));
+    glyph_bitmap_list[i] = NULL;
+    if(width && height) {
+      glyph_bitmap_list[i] = MEM_CALLOC
+        (&mem_default_allocator, (size_t)(width*height), (size_t)Bpp);
+      NCHECK(glyph_bitmap_list[i], NULL);
+      FONT(glyph_get_bitmap
+        (font_glyph, true, &width, &height, &Bpp, glyph_bitmap_list[i]));
+    }
+    lp_font_glyph_desc_list[i].bitmap.width = width;
+    lp_font_glyph_desc_list[i].bitmap.height = height;
+    lp_font_glyph_desc_list[i].bitmap.bytes_per_pixel = Bpp;
+    lp_font_glyph_desc_list[i].bitmap.buffer = glyph_bitmap_list[i];
+
+    FONT(glyph_get_desc(font_glyph, &font_glyph_desc));
+    lp_font_glyph_desc_list[i].width = font_glyph_desc.width;
+    lp_font_glyph_desc_list[i].character = font_glyph_desc.character;
+    lp_font_glyph_desc_list[i].bitmap_left = font_glyph_desc.bbox.x_min;
+    lp_font_glyph_desc_list[i].bitmap_top = font_glyph_desc.bbox.y_min;
+
+    FONT(glyph_ref_put(font_glyph));
+  }
+
+  LP(create(&rbi, rb_ctxt, NULL, &lp));
+  check_golden_image(lp, golden_name);
+
+  LP(font_create(lp, &lp_font));
+  LP(font_set_data(lp_font, line_space, CHARSET_LEN, lp_font_glyph_desc_list));
+  LP(printer_create(lp, &lp_printer));
+  LP(printer_set_font(lp_printer, lp_font));
+  LP(printer_set_viewport(lp_printer, 0, 0, IMG_WIDTH, IMG_HEIGHT));
+  LP(recorder_create(lp, &lp_recorder));
+
+  /* Words, tabulations and new lines. The long lines are wrapped */
+  for(i = 0; i < STRING_LEN; ++i) {
+    char c = (char)('!' + i % 94);
+    if(i % 97 == 96) c = '\n';
+    else if(i % 13 == 12) c = '\t';
+    else if(i % 7 == 6) c = ' ';
+    utf8[i] = c;
+    wstr[i] = (wchar_t)c;
+  }
+  utf8[STRING_LEN] = '\0';
+  wstr[STRING_LEN] = L'\0';
+
+  /* The variants of the printer must composite the image of its default
+   * configuration */
+  render(lp_printer, lp_recorder, wstr, utf8, -1, ref);
+  i = 0;
+  while(i < IMG_SIZE && !ref[i])
+    ++i;
+  NCHECK(i, IMG_SIZE); /* Something was composited */
+
+  /* The printer is deterministic */
+  render(lp_printer, lp_recorder, wstr, utf8, -1, img);
+  CHECK(memcmp(ref, img, IMG_SIZE), 0);
+
+  for(variant = 0; variant < VARIANTS_COUNT; ++variant) {
+    render(lp_printer, lp_recorder, wstr, utf8, variant, img);
+    if(memcmp(ref, img, IMG_SIZE)) {
+      fprintf(stderr, "Variant %d differs from the reference image\n", variant);
+      CHECK(memcmp(ref, img, IMG_SIZE), 0);
+    }
+  }
+
+  /* The glyphs printed before an update of their font data are not
+   * composited */
+  memset(img, 0, IMG_SIZE);
+  image.pixels = img;
+  image.width = IMG_WIDTH;
+  image.height = IMG_HEIGHT;
+  image.pitch = IMG_PITCH;
+  LP(printer_set_image(lp_printer, &image));
+  LP(printer_print_wstring
+    (lp_printer, 3, IMG_HEIGHT - 20, L"Test", color, NULL, NULL));
+  LP(font_set_data(lp_font, line_space, CHARSET_LEN, lp_font_glyph_desc_list));
+  CHECK(lp_printer_flush(lp_printer), BAD_ARG);
+  i = 0;
+  while(i < IMG_SIZE && !img[i])
+    ++i;
+  CHECK(i, IMG_SIZE);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  /* A target switch reports the failed flush and keeps the current target */
+  LP(printer_print_wstring
+    (lp_printer, 3, IMG_HEIGHT - 20, L"Test", color, NULL, NULL));
+  LP(font_set_data(lp_font, line_space, CHARSET_LEN, lp_font_glyph_desc_list));
+  CHECK(lp_printer_set_image(lp_printer, NULL), BAD_ARG);
+  LP(printer_print_wstring
+    (lp_printer, 3, IMG_HEIGHT - 20, L"Test", color, NULL, NULL));
+  CHECK(lp_printer_flush(lp_printer), OK);
+  i = 0;
+  while(i < IMG_SIZE && !img[i])
+    ++i;
+  NCHECK(i, IMG_SIZE);
+
+  /* A failed format switch keeps the current format, i.e. the next switch
+   * flushes again */
+  for(i = 0; i < 2; ++i) {
+    LP(printer_print_wstring
+      (lp_printer, 3, IMG_HEIGHT - 20, L"Test", color, NULL, NULL));
+    LP(font_set_data
+      (lp_font, line_space, CHARSET_LEN, lp_font_glyph_desc_list));
+    CHECK(lp_printer_set_glyph_format
+      (lp_printer, LP_PRINTER_GLYPH_VERTICES), BAD_ARG);
+  }
+  CHECK(lp_printer_set_image(lp_printer, NULL), OK);
+
+  for(i = 0; i < CHARSET_LEN; ++i) {
+    if(glyph_bitmap_list[i])
+      MEM_FREE(&mem_default_allocator, glyph_bitmap_list[i]);
+  }
+  LP(recorder_ref_put(lp_recorder));
+  LP(printer_ref_put(lp_printer));
+  LP(font_ref_put(lp_font));
+  LP(ref_put(lp));
+  FONT(rsrc_ref_put(font_rsrc));
+  FONT(system_ref_put(font_sys));
+  RBI(&rbi, context_ref_put(rb_ctxt));
+  CHECK(rbi_shutdown(&rbi), 0);
+  WM(window_ref_put(wm_win));
+  WM(device_ref_put(wm_dev));
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+  return 0;
+}
@@ -0,0 +1,192 @@
+#include "lp.h"
+#include "lp_font.h"
+#include "lp_printer.h"
+#include "lp_rbi_shim.h"
+#include "test_lp_utils.h"
+#include <rb/rbi.h>
+#include <snlsys/mem_allocator.h>
+#include <string.h>
+#include <wchar.h>
+
+#define BAD_ARG LP_INVALID_ARGUMENT
+#define OK LP_NO_ERROR
+
+#define LONG_STR_LEN 130
+
+/* Print one string in a frame and return the backend calls it costs */
+static void
+draw_frame
+  (struct lp* lp,
+   struct lp_printer* printer,
+   struct lp_rbi_shim* shim,
+   const wchar_t* wstr,
+   struct lp_rbi_shim_counters* counters)
+{
+  const float color[3] = { 1.f, 1.f, 1.f };
+
+  CHECK(lp_rbi_shim_clear_counters(shim), OK);
+  CHECK(lp_begin_frame(lp), OK);
+  CHECK(lp_printer_print_wstring
+    (printer, 0, 100, wstr, color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(printer), OK);
+  CHECK(lp_end_frame(lp), OK);
+  CHECK(lp_rbi_shim_get_counters(shim, counters), OK);
+}
+
+int
+main(int argc, char** argv)
+{
+  wchar_t long_str[LONG_STR_LEN + 1];
+  struct lp_font_glyph_desc glyph_list[NB_GLYPHS];
+  struct lp_rbi_shim_counters counters;
+  const float color[3] = { 1.f, 1.f, 1.f };
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  struct lp_rbi_shim* shim = NULL;
+  struct lp_rbi_shim* shim2 = NULL;
+  struct lp* lp = NULL;
+  struct lp_font* font = NULL;
+  struct lp_font* font2 = NULL;
+  struct lp_printer* printer = NULL;
+  size_t nb_live_objects = 0;
+  size_t i = 0;
+  (void)argc, (void)argv;
+
+  CHECK(lp_rbi_shim_create(NULL, NULL, NULL), BAD_ARG);
+  CHECK(lp_rbi_shim_create(NULL, NULL, &shim), OK);
+  CHECK(lp_rbi_shim_create(NULL, NULL, &shim2), BAD_ARG);
+
+  CHECK(lp_rbi_shim_get_rbi(NULL, NULL), BAD_ARG);
+  CHECK(lp_rbi_shim_get_rbi(shim, NULL), BAD_ARG);
+  CHECK(lp_rbi_shim_get_rbi(NULL, &rbi), BAD_ARG);
+  CHECK(lp_rbi_shim_get_rbi(shim, &rbi), OK);
+
+  CHECK(lp_rbi_shim_get_counters(NULL, NULL), BAD_ARG);
+  CHECK(lp_rbi_shim_get_counters(shim, NULL), BAD_ARG);
+  CHECK(lp_rbi_shim_get_counters(NULL, &counters), BAD_ARG);
+  CHECK(lp_rbi_shim_get_counters(shim, &counters), OK);
+  for(i = 0; i < LP_RBI_CALLS_COUNT; ++i)
+    CHECK(counters.nb_calls[i], 0);
+
+  /* The calls are counted without driver */
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+  NCHECK(rb_ctxt, NULL);
+  CHECK(lp_rbi_shim_get_counters(shim, &counters), OK);
+  CHECK(counters.nb_calls[LP_RBI_CALL_create_context], 1);
+  CHECK(lp_rbi_shim_clear_counters(NULL), BAD_ARG);
+  CHECK(lp_rbi_shim_clear_counters(shim), OK);
+  CHECK(lp_rbi_shim_get_counters(shim, &counters), OK);
+  CHECK(counters.nb_calls[LP_RBI_CALL_create_context], 0);
+
+  setup_synthetic_font(glyph_list, NULL);
+
+  CHECK(lp_create(&rbi, rb_ctxt, NULL, &lp), OK);
+  CHECK(lp_font_create(lp, &font), OK);
+  CHECK(lp_font_set_data(font, GLYPH_HEIGHT, NB_GLYPHS, glyph_list), OK);
+  CHECK(lp_printer_create(lp, &printer), OK);
+  CHECK(lp_printer_set_font(printer, font), OK);
+  CHECK(lp_printer_set_viewport(printer, 0, 0, 640, 480), OK);
+
+  /* Warm up the printer storage */
+  draw_frame(lp, printer, shim, L"hello world", &counters);
+
+  /* One frame of a single string */
+  draw_frame(lp, printer, shim, L"hello world", &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_draw_indexed], 1);
+  CHECK(counters.nb_calls[LP_RBI_CALL_create_buffer], 0);
+  CHECK(counters.nb_calls[LP_RBI_CALL_create_tex2d], 0);
+  CHECK(counters.nb_state_changes <= 16, 1);
+  CHECK(counters.nb_redundant_binds, 0);
+  CHECK(counters.nb_oversized_uploads, 0);
+
+  /* The glyph records are uploaded in a texture sized to the flushed glyphs,
+   * i.e. 1 row of 64 records of 20 bytes rather than the storage capacity */
+  draw_frame(lp, printer, shim, L"hello again", &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_tex2d_data], 1);
+  CHECK(counters.uploaded_size, 64 * 20);
+  /* 3 rows of records rounded up to 4 */
+  for(i = 0; i < LONG_STR_LEN; ++i)
+    long_str[i] = L'a' + (wchar_t)(i % NB_GLYPHS);
+  long_str[LONG_STR_LEN] = L'\0';
+  draw_frame(lp, printer, shim, long_str, &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_tex2d_data], 1);
+  CHECK(counters.uploaded_size, 4 * 64 * 20);
+  CHECK(counters.nb_oversized_uploads, 0);
+
+  /* The vertices are uploaded into a buffer */
+  CHECK(lp_printer_set_glyph_format(printer, LP_PRINTER_GLYPH_VERTICES), OK);
+  draw_frame(lp, printer, shim, L"hello world", &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_draw_indexed], 1);
+  CHECK(counters.nb_calls[LP_RBI_CALL_buffer_data], 1);
+  CHECK(counters.uploaded_size > 0, 1);
+  CHECK(counters.nb_oversized_uploads, 0);
+
+  /* An unchanged frame is drawn without upload */
+  draw_frame(lp, printer, shim, L"hello world", &counters);
+  CHECK(counters.nb_calls[LP_RBI_CALL_draw_indexed], 1);
+  CHECK(counters.nb_calls[LP_RBI_CALL_buffer_data], 0);
+  CHECK(counters.uploaded_size, 0);
+
+  CHECK(lp_rbi_shim_set_upload_limit(NULL, 1), BAD_ARG);
+  CHECK(lp_rbi_shim_set_upload_limit(shim, 1), OK);
+  draw_frame(lp, printer, shim, L"hello again", &counters);
+  CHECK(counters.nb_oversized_uploads, 1);
+  CHECK(lp_rbi_shim_set_upload_limit(shim, 0), OK);
+
+  /* The glyphs of several fonts are drawn from a single upload, one draw per
+   * run of glyphs of the same font */
+  CHECK(lp_font_create(lp, &font2), OK);
+  CHECK(lp_font_set_data(font2, GLYPH_HEIGHT, NB_GLYPHS, glyph_list), OK);
+  CHECK(lp_rbi_shim_clear_counters(shim), OK);
+  CHECK(lp_printer_print_wstring
+    (printer, 0, 100, L"abc", color, NULL, NULL), OK);
+  CHECK(lp_printer_set_font(printer, font2), OK);
+  CHECK(lp_printer_print_wstring
+    (printer, 0, 80, L"def", color, NULL, NULL), OK);
+  /* The pending glyphs of an updated font are kept with its former texture */
+  CHECK(lp_font_set_data(font, GLYPH_HEIGHT, NB_GLYPHS, glyph_list), OK);
+  CHECK(lp_printer_set_font(printer, font), OK);
+  CHECK(lp_printer_print_wstring
+    (printer, 0, 60, L"ghi", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(printer), OK);
+  CHECK(lp_rbi_shim_get_counters(shim, &counters), OK);
+  CHECK(counters.nb_calls[LP_RBI_CALL_draw_indexed], 3);
+  CHECK(counters.nb_calls[LP_RBI_CALL_buffer_data], 1);
+  CHECK(counters.nb_calls[LP_RBI_CALL_create_buffer], 0);
+  CHECK(counters.nb_calls[LP_RBI_CALL_create_vertex_array], 0);
+  /* The flush released the runs: the font texture is not kept by the printer
+   * once the font data are set again */
+  nb_live_objects = counters.nb_live_objects;
+  CHECK(lp_font_set_data(font, GLYPH_HEIGHT, NB_GLYPHS, glyph_list), OK);
+  CHECK(lp_rbi_shim_get_counters(shim, &counters), OK);
+  CHECK(counters.nb_live_objects, nb_live_objects);
+  CHECK(lp_font_ref_put(font2), OK);
+
+  /* Redundant state calls submitted directly to the backend */
+  CHECK(lp_rbi_shim_clear_counters(shim), OK);
+  RBI(&rbi, bind_program(rb_ctxt, NULL));
+  RBI(&rbi, bind_program(rb_ctxt, NULL));
+  CHECK(lp_rbi_shim_get_counters(shim, &counters), OK);
+  CHECK(counters.nb_calls[LP_RBI_CALL_bind_program], 2);
+  CHECK(counters.nb_state_changes, 2);
+  CHECK(counters.nb_redundant_binds, 2);
+
+  CHECK(lp_printer_ref_put(printer), OK);
+  CHECK(lp_font_ref_put(font), OK);
+  CHECK(lp_ref_put(lp), OK);
+  RBI(&rbi, context_ref_put(rb_ctxt));
+
+  CHECK(lp_rbi_shim_ref_get(NULL), BAD_ARG);
+  CHECK(lp_rbi_shim_ref_get(shim), OK);
+  CHECK(lp_rbi_shim_ref_put(NULL), BAD_ARG);
+  CHECK(lp_rbi_shim_ref_put(shim), OK);
+  CHECK(lp_rbi_shim_ref_put(shim), OK);
+
+  /* Once released, another shim can be created */
+  CHECK(lp_rbi_shim_create(NULL, NULL, &shim), OK);
+  CHECK(lp_rbi_shim_ref_put(shim), OK);
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+  return 0;
+}
+
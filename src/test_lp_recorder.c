@@ -0,0 +1,163 @@
+#include "lp.h"
+#include "lp_font.h"
+#include "lp_printer.h"
+#include "lp_recorder.h"
+#include <rb/rbi.h>
+#include <rb/rb_types.h>
+#include <snlsys/mem_allocator.h>
+#include <wm/wm_device.h>
+#include <wm/wm_window.h>
+
+#define BAD_ARG LP_INVALID_ARGUMENT
+#define OK LP_NO_ERROR
+
+int
+main(int argc, char** argv)
+{
+  /* Miscellaneous data */
+  FILE* file = NULL;
+  const char* driver_name = NULL;
+  const char* font_name = NULL;
+  /* Window Manager */
+  struct wm_device* wm_dev = NULL;
+  struct wm_window* wm_win = NULL;
+  const struct wm_window_desc wm_win_desc = {
+    .width = 640, .height = 480, .fullscreen = false
+  };
+  /* Render backend */
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  /* LP data structure */
+  struct lp* lp = NULL;
+  struct lp_font* lp_font0 = NULL;
+  struct lp_font* lp_font1 = NULL;
+  struct lp_printer* lp_printer = NULL;
+  struct lp_recorder* lp_recorder0 = NULL;
+  struct lp_recorder* lp_recorder1 = NULL;
+
+  float color[3] = { 1.f, 1.f, 1.f };
+  int cur[2] = { 0, 0 };
+  int ref[2] = { 0, 0 };
+
+  if(argc != 3) {
+    printf("usage: %s RB_DRIVER FONT\n", argv[0]);
+    return -1;
+  }
+  driver_name = argv[1];
+  font_name = argv[2];
+
+  file = fopen(driver_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid driver %s\n", driver_name);
+    return -1;
+  }
+  fclose(file);
+
+  file = fopen(font_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid font name %s\n", font_name);
+    return -1;
+  }
+  fclose(file);
+
+  WM(create_device(NULL, &wm_dev));
+  WM(create_window(wm_dev, &wm_win_desc, &wm_win));
+  CHECK(rbi_init(driver_name, &rbi), 0);
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+
+  LP(create(&rbi, rb_ctxt, NULL, &lp));
+  LP(font_create(lp, &lp_font0));
+  LP(font_create(lp, &lp_font1));
+  LP(printer_create(lp, &lp_printer));
+  LP(printer_set_font(lp_printer, lp_font0));
+  LP(printer_set_viewport(lp_printer, 0, 0, 640, 480));
+
+  CHECK(lp_recorder_create(NULL, NULL), BAD_ARG);
+  CHECK(lp_recorder_create(lp, NULL), BAD_ARG);
+  CHECK(lp_recorder_create(NULL, &lp_recorder0), BAD_ARG);
+  CHECK(lp_recorder_create(lp, &lp_recorder0), OK);
+  CHECK(lp_recorder_create(lp, &lp_recorder1), OK);
+
+  /* A recorder records nothing before it begins */
+  CHECK(lp_recorder_print_wstring
+    (lp_recorder0, 0, 0, L"Test", color, NULL, NULL), BAD_ARG);
+
+  CHECK(lp_recorder_begin(NULL, NULL), BAD_ARG);
+  CHECK(lp_recorder_begin(lp_recorder0, NULL), BAD_ARG);
+  CHECK(lp_recorder_begin(NULL, lp_printer), BAD_ARG);
+  CHECK(lp_recorder_begin(lp_recorder0, lp_printer), OK);
+  CHECK(lp_recorder_begin(lp_recorder1, lp_printer), OK);
+
+  CHECK(lp_recorder_print_wstring
+    (NULL, 0, 0, L"Test", color, NULL, NULL), BAD_ARG);
+  CHECK(lp_recorder_print_wstring
+    (lp_recorder0, 0, 0, NULL, color, NULL, NULL), BAD_ARG);
+  CHECK(lp_recorder_print_wstring
+    (lp_recorder0, 0, 0, L"Test", NULL, NULL, NULL), BAD_ARG);
+  CHECK(lp_recorder_print_wstring
+    (lp_recorder0, 0, 0, L"Te\nst", color, cur+0, cur+1), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Te\nst", color, ref+0, ref+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+
+  CHECK(lp_recorder_print_utf8
+    (NULL, 0, 0, "Test", 4, color, NULL, NULL), BAD_ARG);
+  CHECK(lp_recorder_print_utf8
+    (lp_recorder1, 0, 0, NULL, 4, color, NULL, NULL), BAD_ARG);
+  CHECK(lp_recorder_print_utf8
+    (lp_recorder1, 0, 0, "Test", 4, NULL, NULL, NULL), BAD_ARG);
+  CHECK(lp_recorder_print_utf8
+    (lp_recorder1, 0, 0, "Te\nst", 6, color, cur+0, cur+1), OK);
+  CHECK(cur[0], ref[0]);
+  CHECK(cur[1], ref[1]);
+
+  CHECK(lp_printer_print_recorder(NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_recorder(lp_printer, NULL), BAD_ARG);
+  CHECK(lp_printer_print_recorder(NULL, lp_recorder0), BAD_ARG);
+  CHECK(lp_printer_print_recorder(lp_printer, lp_recorder1), OK);
+  CHECK(lp_printer_print_recorder(lp_printer, lp_recorder0), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  /* A merged recorder must begin again */
+  CHECK(lp_recorder_print_wstring
+    (lp_recorder0, 0, 0, L"Test", color, NULL, NULL), BAD_ARG);
+
+  /* The glyphs recorded against a previous printer state are discarded */
+  CHECK(lp_recorder_begin(lp_recorder0, lp_printer), OK);
+  CHECK(lp_recorder_print_wstring
+    (lp_recorder0, 0, 0, L"Test", color, NULL, NULL), OK);
+  LP(printer_set_font(lp_printer, lp_font1));
+  CHECK(lp_printer_print_recorder(lp_printer, lp_recorder0), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  CHECK(lp_recorder_ref_get(NULL), BAD_ARG);
+  CHECK(lp_recorder_ref_get(lp_recorder0), OK);
+  CHECK(lp_recorder_ref_put(NULL), BAD_ARG);
+  CHECK(lp_recorder_ref_put(lp_recorder0), OK);
+
+  /* The printer keeps a reference onto the queued recorder */
+  CHECK(lp_recorder_begin(lp_recorder0, lp_printer), OK);
+  CHECK(lp_recorder_print_wstring
+    (lp_recorder0, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_print_recorder(lp_printer, lp_recorder0), OK);
+  CHECK(lp_recorder_ref_put(lp_recorder0), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  /* A recorder that began can be released before being merged */
+  CHECK(lp_recorder_begin(lp_recorder1, lp_printer), OK);
+  CHECK(lp_recorder_ref_put(lp_recorder1), OK);
+
+  LP(printer_ref_put(lp_printer));
+  LP(font_ref_put(lp_font0));
+  LP(font_ref_put(lp_font1));
+  LP(ref_put(lp));
+  RBI(&rbi, context_ref_put(rb_ctxt));
+  CHECK(rbi_shutdown(&rbi), 0);
+  WM(device_ref_put(wm_dev));
+  WM(window_ref_put(wm_win));
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+  return 0;
+}
+
@@ -0,0 +1,159 @@
+#include "lp.h"
+#include "lp_font.h"
+#include "lp_printer.h"
+#include "lp_scrollback.h"
+#include <rb/rbi.h>
+#include <rb/rb_types.h>
+#include <snlsys/mem_allocator.h>
+#include <wm/wm_device.h>
+#include <wm/wm_window.h>
+
+#define BAD_ARG LP_INVALID_ARGUMENT
+#define OK LP_NO_ERROR
+
+int
+main(int argc, char** argv)
+{
+  /* Miscellaneous data */
+  FILE* file = NULL;
+  const char* driver_name = NULL;
+  const char* font_name = NULL;
+  /* Window Manager */
+  struct wm_device* wm_dev = NULL;
+  struct wm_window* wm_win = NULL;
+  const struct wm_window_desc wm_win_desc = {
+    .width = 640, .height = 480, .fullscreen = false
+  };
+  /* Render backend */
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  /* LP data structure */
+  struct lp* lp = NULL;
+  struct lp_font* lp_font0 = NULL;
+  struct lp_font* lp_font1 = NULL;
+  struct lp_printer* lp_printer = NULL;
+  struct lp_scrollback* lp_sb = NULL;
+
+  const float color[3] = { 1.f, 1.f, 0.f };
+  wchar_t wstr[64];
+  size_t nb_lines = 0;
+  size_t i = 0;
+
+  if(argc != 3) {
+    printf("usage: %s RB_DRIVER FONT\n", argv[0]);
+    return -1;
+  }
+  driver_name = argv[1];
+  font_name = argv[2];
+
+  file = fopen(driver_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid driver %s\n", driver_name);
+    return -1;
+  }
+  fclose(file);
+
+  file = fopen(font_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid font name %s\n", font_name);
+    return -1;
+  }
+  fclose(file);
+
+  WM(create_device(NULL, &wm_dev));
+  WM(create_window(wm_dev, &wm_win_desc, &wm_win));
+  CHECK(rbi_init(driver_name, &rbi), 0);
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+
+  LP(create(&rbi, rb_ctxt, NULL, &lp));
+  LP(font_create(lp, &lp_font0));
+  LP(font_create(lp, &lp_font1));
+  LP(printer_create(lp, &lp_printer));
+  LP(printer_set_font(lp_printer, lp_font0));
+  LP(printer_set_viewport(lp_printer, 0, 0, 640, 480));
+
+  CHECK(lp_scrollback_create(NULL, NULL), BAD_ARG);
+  CHECK(lp_scrollback_create(lp, NULL), BAD_ARG);
+  CHECK(lp_scrollback_create(NULL, &lp_sb), BAD_ARG);
+  CHECK(lp_scrollback_create(lp, &lp_sb), OK);
+
+  CHECK(lp_scrollback_get_lines_count(NULL, NULL), BAD_ARG);
+  CHECK(lp_scrollback_get_lines_count(lp_sb, NULL), BAD_ARG);
+  CHECK(lp_scrollback_get_lines_count(NULL, &nb_lines), BAD_ARG);
+  CHECK(lp_scrollback_get_lines_count(lp_sb, &nb_lines), OK);
+  CHECK(nb_lines, 0);
+
+  /* An empty scrollback prints nothing */
+  CHECK(lp_printer_print_scrollback(NULL, NULL, 0), BAD_ARG);
+  CHECK(lp_printer_print_scrollback(lp_printer, NULL, 0), BAD_ARG);
+  CHECK(lp_printer_print_scrollback(NULL, lp_sb, 0), BAD_ARG);
+  CHECK(lp_printer_print_scrollback(lp_printer, lp_sb, 0), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  CHECK(lp_scrollback_push_wstring(NULL, NULL, NULL), BAD_ARG);
+  CHECK(lp_scrollback_push_wstring(lp_sb, NULL, color), BAD_ARG);
+  CHECK(lp_scrollback_push_wstring(lp_sb, L"Test", NULL), BAD_ARG);
+  CHECK(lp_scrollback_push_wstring(NULL, L"Test", color), BAD_ARG);
+  CHECK(lp_scrollback_push_wstring(lp_sb, L"Test", color), OK);
+  CHECK(lp_scrollback_push_wstring(lp_sb, L"", color), OK);
+  CHECK(lp_scrollback_push_wstring(lp_sb, L"Multi\nline", color), OK);
+  CHECK(lp_scrollback_get_lines_count(lp_sb, &nb_lines), OK);
+  CHECK(nb_lines, 3);
+
+  CHECK(lp_scrollback_set_max_lines(NULL, 16), BAD_ARG);
+  CHECK(lp_scrollback_set_max_lines(lp_sb, 0), BAD_ARG);
+  CHECK(lp_scrollback_set_max_lines(lp_sb, 2), OK);
+  CHECK(lp_scrollback_get_lines_count(lp_sb, &nb_lines), OK);
+  CHECK(nb_lines, 2);
+  CHECK(lp_scrollback_set_max_lines(lp_sb, 256), OK);
+  CHECK(lp_scrollback_get_lines_count(lp_sb, &nb_lines), OK);
+  CHECK(nb_lines, 2);
+
+  /* Fill the history beyond its capacity. The oldest lines are evicted */
+  for(i = 0; i < 1000; ++i) {
+    swprintf(wstr, sizeof(wstr)/sizeof(wchar_t), L"Line %lu", (unsigned long)i);
+    CHECK(lp_scrollback_push_wstring(lp_sb, wstr, color), OK);
+  }
+  CHECK(lp_scrollback_get_lines_count(lp_sb, &nb_lines), OK);
+  CHECK(nb_lines, 256);
+
+  CHECK(lp_printer_print_scrollback(lp_printer, lp_sb, 0), OK);
+  CHECK(lp_printer_print_scrollback(lp_printer, lp_sb, 100), OK);
+  CHECK(lp_printer_print_scrollback(lp_printer, lp_sb, 255), OK);
+  CHECK(lp_printer_print_scrollback(lp_printer, lp_sb, 1000), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  /* The cached heights are measured anew with the new font and width */
+  LP(printer_set_font(lp_printer, lp_font1));
+  CHECK(lp_printer_print_scrollback(lp_printer, lp_sb, 0), OK);
+  LP(printer_set_viewport(lp_printer, 0, 0, 64, 480));
+  CHECK(lp_printer_print_scrollback(lp_printer, lp_sb, 0), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  CHECK(lp_scrollback_clear(NULL), BAD_ARG);
+  CHECK(lp_scrollback_clear(lp_sb), OK);
+  CHECK(lp_scrollback_get_lines_count(lp_sb, &nb_lines), OK);
+  CHECK(nb_lines, 0);
+  CHECK(lp_scrollback_push_wstring(lp_sb, L"Test", color), OK);
+  CHECK(lp_printer_print_scrollback(lp_printer, lp_sb, 0), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  CHECK(lp_scrollback_ref_get(NULL), BAD_ARG);
+  CHECK(lp_scrollback_ref_get(lp_sb), OK);
+  CHECK(lp_scrollback_ref_put(NULL), BAD_ARG);
+  CHECK(lp_scrollback_ref_put(lp_sb), OK);
+  CHECK(lp_scrollback_ref_put(lp_sb), OK);
+
+  LP(printer_ref_put(lp_printer));
+  LP(font_ref_put(lp_font0));
+  LP(font_ref_put(lp_font1));
+  LP(ref_put(lp));
+  RBI(&rbi, context_ref_put(rb_ctxt));
+  CHECK(rbi_shutdown(&rbi), 0);
+  WM(device_ref_put(wm_dev));
+  WM(window_ref_put(wm_win));
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+  return 0;
+}
+
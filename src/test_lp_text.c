@@ -0,0 +1,140 @@
+#include "lp.h"
+#include "lp_font.h"
+#include "lp_printer.h"
+#include "lp_text.h"
+#include <rb/rbi.h>
+#include <rb/rb_types.h>
+#include <snlsys/mem_allocator.h>
+#include <wm/wm_device.h>
+#include <wm/wm_window.h>
+
+#define BAD_ARG LP_INVALID_ARGUMENT
+#define OK LP_NO_ERROR
+
+int
+main(int argc, char** argv)
+{
+  /* Miscellaneous data */
+  FILE* file = NULL;
+  const char* driver_name = NULL;
+  const char* font_name = NULL;
+  /* Window Manager */
+  struct wm_device* wm_dev = NULL;
+  struct wm_window* wm_win = NULL;
+  const struct wm_window_desc wm_win_desc = {
+    .width = 640, .height = 480, .fullscreen = false
+  };
+  /* Render backend */
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  /* LP data structure */
+  struct lp* lp = NULL;
+  struct lp_font* lp_font0 = NULL;
+  struct lp_font* lp_font1 = NULL;
+  struct lp_printer* lp_printer = NULL;
+  struct lp_text* lp_text = NULL;
+
+  float color[3] = { 1.f, 1.f, 1.f };
+  int x = 0;
+  int y = 0;
+
+  if(argc != 3) {
+    printf("usage: %s RB_DRIVER FONT\n", argv[0]);
+    return -1;
+  }
+  driver_name = argv[1];
+  font_name = argv[2];
+
+  file = fopen(driver_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid driver %s\n", driver_name);
+    return -1;
+  }
+  fclose(file);
+
+  file = fopen(font_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid font name %s\n", font_name);
+    return -1;
+  }
+  fclose(file);
+
+  WM(create_device(NULL, &wm_dev));
+  WM(create_window(wm_dev, &wm_win_desc, &wm_win));
+  CHECK(rbi_init(driver_name, &rbi), 0);
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+
+  LP(create(&rbi, rb_ctxt, NULL, &lp));
+  LP(font_create(lp, &lp_font0));
+  LP(font_create(lp, &lp_font1));
+  LP(printer_create(lp, &lp_printer));
+  LP(printer_set_font(lp_printer, lp_font0));
+  LP(printer_set_viewport(lp_printer, 0, 0, 640, 480));
+
+  CHECK(lp_text_create(NULL, NULL), BAD_ARG);
+  CHECK(lp_text_create(lp, NULL), BAD_ARG);
+  CHECK(lp_text_create(NULL, &lp_text), BAD_ARG);
+  CHECK(lp_text_create(lp, &lp_text), OK);
+
+  /* A text without font nor string draws nothing */
+  CHECK(lp_printer_print_text(lp_printer, 0, 0, lp_text, color), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  CHECK(lp_text_set_font(NULL, NULL), BAD_ARG);
+  CHECK(lp_text_set_font(lp_text, NULL), BAD_ARG);
+  CHECK(lp_text_set_font(NULL, lp_font0), BAD_ARG);
+  CHECK(lp_text_set_font(lp_text, lp_font0), OK);
+
+  CHECK(lp_text_set_wstring(NULL, NULL), BAD_ARG);
+  CHECK(lp_text_set_wstring(lp_text, NULL), BAD_ARG);
+  CHECK(lp_text_set_wstring(NULL, L"Test"), BAD_ARG);
+  CHECK(lp_text_set_wstring(lp_text, L"Test"), OK);
+  CHECK(lp_text_set_wstring(lp_text, L"Test"), OK);
+
+  CHECK(lp_text_set_wrap_width(NULL, 0), BAD_ARG);
+  CHECK(lp_text_set_wrap_width(lp_text, -1), BAD_ARG);
+  CHECK(lp_text_set_wrap_width(lp_text, 0), OK);
+  CHECK(lp_text_set_wrap_width(lp_text, 128), OK);
+
+  CHECK(lp_text_get_cursor(NULL, &x, &y), BAD_ARG);
+  CHECK(lp_text_get_cursor(lp_text, NULL, NULL), OK);
+  CHECK(lp_text_get_cursor(lp_text, &x, &y), OK);
+
+  CHECK(lp_printer_print_text(NULL, 0, 0, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_text(lp_printer, 0, 0, NULL, NULL), BAD_ARG);
+  CHECK(lp_printer_print_text(NULL, 0, 0, lp_text, NULL), BAD_ARG);
+  CHECK(lp_printer_print_text(lp_printer, 0, 0, lp_text, NULL), BAD_ARG);
+  CHECK(lp_printer_print_text(NULL, 0, 0, NULL, color), BAD_ARG);
+  CHECK(lp_printer_print_text(lp_printer, 0, 0, NULL, color), BAD_ARG);
+  CHECK(lp_printer_print_text(NULL, 0, 0, lp_text, color), BAD_ARG);
+  CHECK(lp_printer_print_text(lp_printer, 0, 0, lp_text, color), OK);
+  CHECK(lp_printer_print_text(lp_printer, 10, 20, lp_text, color), OK);
+
+  /* Update the text while it is queued */
+  CHECK(lp_text_set_font(lp_text, lp_font1), OK);
+  CHECK(lp_text_set_wstring(lp_text, L"Hello\nWorld"), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  CHECK(lp_text_ref_get(NULL), BAD_ARG);
+  CHECK(lp_text_ref_get(lp_text), OK);
+  CHECK(lp_text_ref_put(NULL), BAD_ARG);
+  CHECK(lp_text_ref_put(lp_text), OK);
+
+  /* The printer keeps a reference onto the queued text */
+  CHECK(lp_printer_print_text(lp_printer, 0, 0, lp_text, color), OK);
+  CHECK(lp_text_ref_put(lp_text), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+
+  LP(printer_ref_put(lp_printer));
+  LP(font_ref_put(lp_font0));
+  LP(font_ref_put(lp_font1));
+  LP(ref_put(lp));
+  RBI(&rbi, context_ref_put(rb_ctxt));
+  CHECK(rbi_shutdown(&rbi), 0);
+  WM(device_ref_put(wm_dev));
+  WM(window_ref_put(wm_win));
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+  return 0;
+}
+
@@ -0,0 +1,170 @@
+#include "lp.h"
+#include "lp_font.h"
+#include "lp_printer.h"
+#include "lp_trace.h"
+#include <rb/rbi.h>
+#include <rb/rb_types.h>
+#include <snlsys/mem_allocator.h>
+#include <wm/wm_device.h>
+#include <wm/wm_window.h>
+#include <string.h>
+
+#define BAD_ARG LP_INVALID_ARGUMENT
+#define OK LP_NO_ERROR
+
+struct zone_counter {
+  size_t nb_begins;
+  size_t nb_ends;
+  int depth; /* Current nesting level */
+};
+
+static void
+count_begin(const char* name, void* data)
+{
+  struct zone_counter* counter = data;
+  NCHECK(name, NULL);
+  ++counter->nb_begins;
+  ++counter->depth;
+}
+
+static void
+count_end(const char* name, const size_t payload, void* data)
+{
+  struct zone_counter* counter = data;
+  NCHECK(name, NULL);
+  (void)payload;
+  ++counter->nb_ends;
+  --counter->depth;
+  CHECK(counter->depth >= 0, 1);
+}
+
+int
+main(int argc, char** argv)
+{
+  /* Miscellaneous data */
+  FILE* file = NULL;
+  const char* driver_name = NULL;
+  const char* font_name = NULL;
+  /* Written in the working directory of the test, i.e. the build tree */
+  const char* trace_name = "test_lp_trace.json";
+  char buf[4];
+  long size = 0;
+  /* Window Manager */
+  struct wm_device* wm_dev = NULL;
+  struct wm_window* wm_win = NULL;
+  const struct wm_window_desc wm_win_desc = {
+    .width = 640, .height = 480, .fullscreen = false
+  };
+  /* Render backend */
+  struct rbi rbi;
+  struct rb_context* rb_ctxt = NULL;
+  /* LP data structure */
+  struct lp* lp = NULL;
+  struct lp_font* lp_font = NULL;
+  struct lp_printer* lp_printer = NULL;
+  struct lp_trace_chrome* trace = NULL;
+  struct lp_trace_hooks hooks;
+  struct zone_counter counter;
+
+  const float color[3] = { 1.f, 1.f, 1.f };
+
+  if(argc != 3) {
+    printf("usage: %s RB_DRIVER FONT\n", argv[0]);
+    return -1;
+  }
+  driver_name = argv[1];
+  font_name = argv[2];
+
+  file = fopen(driver_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid driver %s\n", driver_name);
+    return -1;
+  }
+  fclose(file);
+
+  file = fopen(font_name, "r");
+  if(!file) {
+    fprintf(stderr, "Invalid font name %s\n", font_name);
+    return -1;
+  }
+  fclose(file);
+
+  WM(create_device(NULL, &wm_dev));
+  WM(create_window(wm_dev, &wm_win_desc, &wm_win));
+  CHECK(rbi_init(driver_name, &rbi), 0);
+  RBI(&rbi, create_context(NULL, &rb_ctxt));
+
+  LP(create(&rbi, rb_ctxt, NULL, &lp));
+  LP(font_create(lp, &lp_font));
+  LP(printer_create(lp, &lp_printer));
+  LP(printer_set_font(lp_printer, lp_font));
+  LP(printer_set_viewport(lp_printer, 0, 0, 640, 480));
+
+  /* Client hooks. The zones are balanced whether they are compiled or not */
+  memset(&counter, 0, sizeof(counter));
+  hooks.begin = count_begin;
+  hooks.end = count_end;
+  hooks.data = &counter;
+  CHECK(lp_set_trace_hooks(NULL, &hooks), BAD_ARG);
+  CHECK(lp_set_trace_hooks(lp, &hooks), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(counter.nb_begins, counter.nb_ends);
+  CHECK(counter.depth, 0);
+  CHECK(lp_set_trace_hooks(lp, NULL), OK);
+
+  /* Chrome trace sink */
+  CHECK(lp_trace_chrome_create(NULL, NULL, NULL), BAD_ARG);
+  CHECK(lp_trace_chrome_create(lp, NULL, NULL), BAD_ARG);
+  CHECK(lp_trace_chrome_create(NULL, trace_name, NULL), BAD_ARG);
+  CHECK(lp_trace_chrome_create(lp, trace_name, NULL), BAD_ARG);
+  CHECK(lp_trace_chrome_create(NULL, NULL, &trace), BAD_ARG);
+  CHECK(lp_trace_chrome_create(lp, NULL, &trace), BAD_ARG);
+  CHECK(lp_trace_chrome_create(NULL, trace_name, &trace), BAD_ARG);
+  CHECK(lp_trace_chrome_create
+    (lp, "test_lp_trace_no_dir/trace.json", &trace), LP_UNKNOWN_ERROR);
+  CHECK(lp_trace_chrome_create(lp, trace_name, &trace), OK);
+
+  CHECK(lp_trace_chrome_get_hooks(NULL, NULL), BAD_ARG);
+  CHECK(lp_trace_chrome_get_hooks(trace, NULL), BAD_ARG);
+  CHECK(lp_trace_chrome_get_hooks(NULL, &hooks), BAD_ARG);
+  CHECK(lp_trace_chrome_get_hooks(trace, &hooks), OK);
+  CHECK(lp_set_trace_hooks(lp, &hooks), OK);
+  CHECK(lp_printer_print_wstring
+    (lp_printer, 0, 0, L"Test", color, NULL, NULL), OK);
+  CHECK(lp_printer_flush(lp_printer), OK);
+  CHECK(lp_set_trace_hooks(lp, NULL), OK);
+
+  CHECK(lp_trace_chrome_ref_get(NULL), BAD_ARG);
+  CHECK(lp_trace_chrome_ref_get(trace), OK);
+  CHECK(lp_trace_chrome_ref_put(NULL), BAD_ARG);
+  CHECK(lp_trace_chrome_ref_put(trace), OK);
+  CHECK(lp_trace_chrome_ref_put(trace), OK);
+
+  /* The released trace is a JSON array */
+  file = fopen(trace_name, "r");
+  NCHECK(file, NULL);
+  CHECK(fread(buf, 1, 1, file), 1);
+  CHECK(buf[0], '[');
+  CHECK(fseek(file, 0, SEEK_END), 0);
+  size = ftell(file);
+  CHECK(size >= 4, 1);
+  CHECK(fseek(file, -2, SEEK_END), 0);
+  CHECK(fread(buf, 1, 2, file), 2);
+  CHECK(buf[0], ']');
+  CHECK(buf[1], '\n');
+  fclose(file);
+  CHECK(remove(trace_name), 0);
+
+  LP(printer_ref_put(lp_printer));
+  LP(font_ref_put(lp_font));
+  LP(ref_put(lp));
+  RBI(&rbi, context_ref_put(rb_ctxt));
+  CHECK(rbi_shutdown(&rbi), 0);
+  WM(device_ref_put(wm_dev));
+  WM(window_ref_put(wm_win));
+
+  CHECK(MEM_ALLOCATED_SIZE(&mem_default_allocator), 0);
+  return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef TEST_LP_UTILS_H
+#define TEST_LP_UTILS_H
+
+#include "lp_font.h"
+#include <snlsys/snlsys.h>
+#include <string.h>
+#include <wchar.h>
+
+/* Synthetic font of the tests that do not load a font resource */
+#define NB_GLYPHS 26
+#define GLYPH_WIDTH 6
+#define GLYPH_HEIGHT 8
+#define LINE_SPACE 10
+
+/* Fill `glyph_list' with the glyphs of the `charset' characters, or of the
+ * NB_GLYPHS lower case letters if `charset' is NULL. Each glyph is a fully
+ * covered GLYPH_WIDTH x GLYPH_HEIGHT bitmap advancing by GLYPH_WIDTH */
+static void
+setup_synthetic_font
+  (struct lp_font_glyph_desc* glyph_list,
+   const wchar_t* charset) /* May be NULL */
+{
+  static unsigned char bitmap[GLYPH_WIDTH * GLYPH_HEIGHT];
+  const size_t nb_glyphs = charset ? wcslen(charset) : NB_GLYPHS;
+  size_t i = 0;
+  ASSERT(glyph_list);
+
+  memset(bitmap, 0xFF, sizeof(bitmap));
+  for(i = 0; i < nb_glyphs; ++i) {
+    glyph_list[i].character =
+      charset ? charset[i] : (wchar_t)(L'a' + (wchar_t)i);
+    glyph_list[i].width = GLYPH_WIDTH;
+    glyph_list[i].bitmap_left = 0;
+    glyph_list[i].bitmap_top = 0;
+    glyph_list[i].bitmap.width = GLYPH_WIDTH;
+    glyph_list[i].bitmap.height = GLYPH_HEIGHT;
+    glyph_list[i].bitmap.bytes_per_pixel = 1;
+    glyph_list[i].bitmap.buffer = bitmap;
+  }
+}
+
+#endif /* TEST_LP_UTILS_H */